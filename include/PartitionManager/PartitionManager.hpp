@@ -42,18 +42,35 @@ class BasicFlags {
 public:
   BasicFlags();
 
+  /// @brief Scan partition tables. Called after parsing command line, when the used plugin is known.
+  void scanTables(PartitionMap::ScanSource source = PartitionMap::FULL_SCAN);
+
+  /// @brief Enable I/O statistics if requested (--stats, --stats-file). Must be called before partitions are opened.
+  void enableStats() const;
+
+  /// @brief Print and/or write collected I/O statistics. Closes opened partitions. Errors are logged, never thrown.
+  void reportStats() noexcept;
+
+  /// @brief Check whether progress is shown (not quiet) or written as events (--progress-fd).
+  bool showProgress() const noexcept;
+
   std::pair<std::unique_ptr<PartitionMap::PartitionTableData>,
             std::unique_ptr<PartitionMap::DynamicTableData>>
       partitionTables; ///< Partition tables.
-  std::string logFile; ///< Log file path.
-
-  bool onLogical;    ///< Only process logical partitions.
-  bool quietProcess; ///< Turn on/off quiet processing.
-  bool verboseMode;  ///< Turn on/off verbose processing.
-  bool viewVersion;  ///< Print version and exit.
-  bool viewLicense;  ///< View license and exit.
-  bool forceProcess; ///< Enable force processes.
-  bool noWorkOnUsed; ///< Don't work on used partitions.
+  std::string logFile;     ///< Log file path.
+  std::string statsFile;   ///< Write I/O statistics to this file as JSON.
+  uint64_t stallThreshold; ///< I/O calls slower than this (as milliseconds) are reported as stalls. 0 = disabled.
+  int progressFd;          ///< Write progress events to this file descriptor as JSON lines. -1 = disabled.
+
+  bool onLogical;     ///< Only process logical partitions.
+  bool quietProcess;  ///< Turn on/off quiet processing.
+  bool verboseMode;   ///< Turn on/off verbose processing.
+  bool viewVersion;   ///< Print version and exit.
+  bool viewLicense;   ///< View license and exit.
+  bool forceProcess;  ///< Enable force processes.
+  bool noWorkOnUsed;  ///< Don't work on used partitions.
+  bool directLogical; ///< Access logical partitions through super instead of device-mapper.
+  bool printStats;    ///< Print I/O statistics at exit.
 };
 
 using Error = Helper::Error;
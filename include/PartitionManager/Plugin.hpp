@@ -25,7 +25,7 @@
 #define PARTITION_MANAGER_PLUGIN_HPP
 
 #define PM "PluginManager"
-#define PM_VERSION "1.1" ///< PluginManager version.
+#define PM_VERSION "1.2" ///< PluginManager version.
 
 // clang-format off
 #define Flags          (*flags) ///< Flags pointer
@@ -73,6 +73,7 @@
 #include <dlfcn.h>
 #include <libhelper/logging.hpp>
 #include <libhelper/cmdline.hpp>
+#include <libhelper/trace.hpp>
 #include <libpartition_map/lib.hpp>
 
 namespace PartitionManager {
@@ -104,6 +105,19 @@ public:
   virtual PLUGIN_SECTION std::string getName() = 0;
   /// @brief Get plugin version.
   virtual PLUGIN_SECTION std::string getVersion() = 0;
+
+  /**
+   * @brief Returns true if the plugin needs GPT data loaded by gptfdisk.
+   * @note Partition tables are scanned after the command line is parsed, don't use them in @c onLoad().
+   *       Plugins that only need names, sizes and paths of partitions should return false; tables are listed from sysfs then.
+   */
+  virtual PLUGIN_SECTION bool needsGptData() { return true; }
+
+  /**
+   * @brief Returns true if the plugin may write to partitions or partition tables.
+   * @note Partition tables of such plugins are always read from the disk, the scan cache is not used.
+   */
+  virtual PLUGIN_SECTION bool writesPartitions() { return true; }
 }; // class BasicPlugin
 
 using PluginError = Helper::Error;
@@ -188,6 +202,7 @@ public:
     for (auto &plugin : BuiltinPluginRegistry<BasePluginClass>::getInstance().getPlugins()) {
       auto pluginHandle = plugin();
       Log::info("Loading built-in plugin: {}.", pluginHandle->getName());
+      Helper::Trace::Span span("plugin", "load {}", pluginHandle->getName());
       if (!pluginHandle->onLoad(mainApp, mainFlags)) return false;
       builtinPlugins.emplace_back(std::move(pluginHandle));
     }
@@ -198,6 +213,7 @@ public:
   /// @brief Load external plugin.
   bool loadPlugin(const std::string &pluginPath) {
     Log::info("Loading external plugin: {}.", std::quoted_string(pluginPath));
+    Helper::Trace::Span span("plugin", "load {}", pluginPath);
     void *handle = dlopen(pluginPath.c_str(), RTLD_NOW | RTLD_GLOBAL);
     if (!handle) throw PluginError("dlopen failed: {}: {}", pluginPath, dlerror());
 
@@ -223,6 +239,7 @@ public:
   /// @brief Run a plugin.
   bool run(const std::string &name) {
     Log::info("Running {} plugin if exists.", std::quoted_string(name));
+    Helper::Trace::Span span("plugin", "run {}", name);
     for (auto &plugin : plugins) {
       if (plugin.name == name) return plugin.instance->run();
     }
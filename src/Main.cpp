@@ -48,11 +48,12 @@ constexpr char kAbortedMessage[] = "\nAborted.\n";
  * @brief Signal handler for SIGINT and SIGABRT.
  *
  * This function handles interrupt signals (CTRL+C) and abort signals,
- * printing an appropriate message and exiting with a status code.
+ * flushing queued log lines, printing an appropriate message and exiting with a status code.
  *
  * @param sig The signal number (SIGINT or SIGABRT).
  */
 static void sigHandler(int sig) {
+  Helper::LogSink::flushFromSignal(); // Queued log lines are written before exit.
   if (sig == SIGINT) {
     write(STDERR_FILENO, kInterruptedMessage, sizeof(kInterruptedMessage) - 1);
     exit(128 + SIGINT);
@@ -109,7 +110,7 @@ int main(int argc, char **argv) {
 
     PartitionManager::BasicFlags Flags;
     std::vector<std::string> plugins;
-    std::string pluginPath;
+    std::string pluginPath, logLevel = "info", traceFile;
 
     app.setLicenseString(
         "Copyright (C) 2026 Yağız Zengin\nPartition Manager Tool is written by Yağız Zengin, licensed under GNU GPLv3 license.\nThis "
@@ -118,6 +119,10 @@ int main(int argc, char **argv) {
         "bugs to https://github.com/ShawkTeam/pmt-renovated/issues");
 
     app.addOption("-L,--log-file", Flags.logFile, "Set log file.")->early();
+    app.addOption("--log-level", logLevel, "Set minimum level of written logs (info, warning, error).")
+        ->early()
+        ->check(Helper::CMDLine::Checkers::IsMember({"info", "warning", "error"}));
+    app.addOption("--trace", traceFile, "Record a timeline of operations to the input file (Chrome trace-event format).")->early();
     app.addOption("-p,--plugins", plugins, "Load input plugin files.")->early();
     app.addOption("-d,--plugin-directory", pluginPath, "Load plugins from the input directory.")
         ->early()
@@ -128,13 +133,24 @@ int main(int argc, char **argv) {
     app.addFlag("-s,--select-on-duplicate", Flags.noWorkOnUsed, "Select partition for work if has input named duplicate partitions.");
     app.addFlag("-f,--force", Flags.forceProcess, "Force process to be processed.");
     app.addFlag("-l,--logical", Flags.onLogical, "Specify that the target partition is logical.");
+    app.addFlag("--direct-logical", Flags.directLogical,
+                "Access logical partitions through super instead of device-mapper (unmapped ones always are).");
+    app.addFlag("--stats", Flags.printStats, "Print I/O statistics (bytes, calls, latency percentiles) of partitions at exit.");
+    app.addOption("--stats-file", Flags.statsFile, "Write I/O statistics to the input file as JSON.");
+    app.addOption("--stall-threshold", Flags.stallThreshold,
+                  "Report reads and writes slower than this as stalls, in milliseconds (0 = disabled, default 1000).");
+    app.addOption("--progress-fd", Flags.progressFd, "Write progress events to the input file descriptor as JSON lines.");
     app.addFlag("-v,--version", Flags.viewVersion, "Print version and exit.");
     app.addFlag("--license", Flags.viewLicense, "Print license and exit.");
 
     app.parse_earlies(argc, argv);
 
     Helper::Logger::Properties::setPrinting(Flags.verboseMode);
+    Helper::Logger::Properties::setLevel(logLevel == "error"     ? Helper::LogLevels::ERROR
+                                         : logLevel == "warning" ? Helper::LogLevels::WARNING
+                                                                 : Helper::LogLevels::INFO);
     Helper::Logger::Properties::setFile(Flags.logFile, true);
+    if (!traceFile.empty()) Helper::Trace::start(traceFile); // Written on exit.
     PartitionManager::BasicManager manager(app, Flags);
 
     manager.loadBuiltinPlugins(); // Load built-in plugins if existed.
@@ -172,16 +188,28 @@ int main(int argc, char **argv) {
 
     if (!Helper::Android::isHasRootPrivileges()) // Root access is a fundamental requirement for this program.
       throw PartitionManager::Error("This program requires super-user privileges.");
+
+    const std::string used = manager.getUsed();
+    if (used.empty()) throw PartitionManager::Error("Unknown main command speficied! Use --help for more information.");
+
+    // Read-only metadata commands don't need gptfdisk, their tables are listed from sysfs.
+    const bool needsGptData = manager.getPlugin(used)->get().needsGptData();
+    // Cache files can be outdated or changed by others; writes always use tables read from the disk.
+    if (manager.getPlugin(used)->get().writesPartitions()) PartitionMap::ScanCache::setDirectory({});
+    Flags.enableStats();
+    if (Flags.progressFd != -1) PartitionMap::ProgressRenderer::setEventFd(Flags.progressFd);
+    auto statsReport = Helper::makeScopeGuard([&Flags] { Flags.reportStats(); }); // Also reported if the operation fails.
+    Flags.scanTables(needsGptData ? PartitionMap::FULL_SCAN : PartitionMap::SYSFS_SCAN);
+
     if (Tables.tableNamesEmpty()) throw PartitionManager::Error("Cannot find any partition table on this device.");
-    if (!Tables && !Flags.forceProcess)
+    if (needsGptData && !Tables && !Flags.forceProcess)
       throw PartitionManager::Error(
           "Problem(s) have been detected in your device's partition table. Please use -f (--force) to continue.");
 
     if (Flags.onLogical &&
         !Tables.isHasSuperPartition()) // If the device doesn't have a super partition, it means there are no logical partitions.
       throw PartitionManager::Error("This device doesn't contains logical partitions. But you used -l (--logical) flag.");
-
-    if (manager.getUsed().empty()) throw PartitionManager::Error("Unknown main command speficied! Use --help for more information.");
+    if (Flags.directLogical && Flags.partitionTables.second) Flags.partitionTables.second->setDirectIO(true);
 
     return !manager.runUsed(); // If the operation is successful, it returns true, which is equal to 1.
   } catch (Helper::Error &error) {
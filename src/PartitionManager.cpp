@@ -21,32 +21,178 @@
  * @brief Implementation of PartitionManager core functionality.
  *
  * This file contains the implementation of the BasicFlags constructor,
- * initialization function, and version string generation for the
- * Partition Manager Tool.
+ * initialization function, I/O statistics reporting and version string
+ * generation for the Partition Manager Tool.
  */
 
+#include <future>
+#include <map>
 #include <memory>
 #include <PartitionManager/PartitionManager.hpp>
 #include <generated/buildInfo.hpp>
+#include <rapidjson/document.h>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
 
 namespace PartitionManager {
 
+namespace {
+
+/// @brief Stall handler of libopenpart, called from I/O threads.
+void logStall(const char *path, int write, uint64_t offset, size_t count, uint64_t ns) {
+  Log::warning("I/O stall on {}: {} of {} bytes at offset {} took {:.1f} ms.", path, write ? "write" : "read", count, offset,
+               static_cast<double>(ns) / 1e6);
+}
+
+std::string formatDirection(const openpart_io_stats_t &stats) {
+  using PartitionMap::IOStats;
+  const double seconds = static_cast<double>(stats.total_ns) / 1e9;
+  const double mib = static_cast<double>(stats.bytes) / (1024.0 * 1024.0);
+  return fmt::format("{:.1f} MiB in {} calls ({:.1f} MiB/s), p50 {} p99 {} max {}, {} retries, {} short, {} errors, {} stalls", mib,
+                     stats.calls, seconds > 0 ? mib / seconds : 0.0, IOStats::formatLatency(openpart_stats_percentile(&stats, 50)),
+                     IOStats::formatLatency(openpart_stats_percentile(&stats, 99)), IOStats::formatLatency(stats.max_ns),
+                     stats.retries, stats.short_ops, stats.errors, stats.stalls);
+}
+
+rapidjson::Value directionToJson(const openpart_io_stats_t &stats, rapidjson::Document::AllocatorType &allocator) {
+  rapidjson::Value object(rapidjson::kObjectType), histogram(rapidjson::kArrayType);
+  object.AddMember("calls", stats.calls, allocator);
+  object.AddMember("bytes", stats.bytes, allocator);
+  object.AddMember("retries", stats.retries, allocator);
+  object.AddMember("shortOps", stats.short_ops, allocator);
+  object.AddMember("errors", stats.errors, allocator);
+  object.AddMember("stalls", stats.stalls, allocator);
+  object.AddMember("totalNs", stats.total_ns, allocator);
+  object.AddMember("maxNs", stats.max_ns, allocator);
+  object.AddMember("p50Ns", openpart_stats_percentile(&stats, 50), allocator);
+  object.AddMember("p99Ns", openpart_stats_percentile(&stats, 99), allocator);
+  for (const uint64_t count : stats.histogram)
+    histogram.PushBack(count, allocator);
+  object.AddMember("histogram", histogram, allocator);
+  return object;
+}
+
+} // namespace
+
 /**
  * @brief Constructor for BasicFlags.
  *
- * Initializes the BasicFlags structure with default values and creates
- * partition table data objects for both classic and dynamic partitions.
+ * Initializes the BasicFlags structure with default values.
+ * Partition tables are created later by scanTables().
  */
 BasicFlags::BasicFlags()
-    : logFile(Helper::Logger::Properties::FILE), onLogical(false), quietProcess(false), verboseMode(false), viewVersion(false),
-      viewLicense(false), forceProcess(false), noWorkOnUsed(false) {
+    : logFile(Helper::Logger::Properties::FILE), stallThreshold(1000), progressFd(-1), onLogical(false), quietProcess(false),
+      verboseMode(false), viewVersion(false), viewLicense(false), forceProcess(false), noWorkOnUsed(false), directLogical(false),
+      printStats(false) {}
+
+/**
+ * @brief Create partition table data objects for both classic and dynamic partitions.
+ *
+ * Both tables are scanned concurrently.
+ *
+ * @param source Source of classic partition list. @c SYSFS_SCAN skips gptfdisk.
+ */
+void BasicFlags::scanTables(PartitionMap::ScanSource source) {
+  // Super metadata is read while GPT tables are scanned.
+  auto dynamicTable = std::async(std::launch::async, [] {
+    Helper::Trace::nameThread("super scanner");
+    return std::make_unique<PartitionMap::DynamicTableData>();
+  });
+  partitionTables.first = std::make_unique<PartitionMap::PartitionTableData>(source);
+  partitionTables.second = dynamicTable.get();
+}
+
+/**
+ * @brief Enable libopenpart statistics and stall reporting.
+ *
+ * Statistics are kept only for handles opened after this call, so it must run before any partition I/O.
+ */
+void BasicFlags::enableStats() const {
+  if (!printStats && statsFile.empty()) return;
+  openpart_stats_enable(1);
+  openpart_stats_set_stall(stallThreshold * 1000 * 1000, stallThreshold > 0 ? logStall : nullptr);
+}
+
+/**
+ * @brief Report I/O statistics of the run.
+ *
+ * Opened partitions are closed first, so their statistics are collected too. Statistics are keyed by device path;
+ * partitions accessed through super with direct I/O are counted for super.
+ */
+void BasicFlags::reportStats() noexcept {
+  if (!printStats && statsFile.empty()) return;
+
   try {
-    partitionTables.first = std::make_unique<PartitionMap::PartitionTableData>();
-    partitionTables.second = std::make_unique<PartitionMap::DynamicTableData>();
-  } catch (...) {
+    std::map<std::string, std::string> names; // Device path -> partition name.
+    const auto collectTable = [&names](PartitionMap::BaseTableData *table) {
+      if (!table) return;
+      for (auto &partition : *table) {
+        if (partition.isOpened()) partition.closeFdNow();
+        if (partition.isDirectIO()) continue;
+        std::error_code ec;
+        const auto path = std::filesystem::canonical(partition.path(), ec);
+        if (!ec) names.emplace(path.string(), partition.name());
+      }
+    };
+    collectTable(partitionTables.first.get());
+    collectTable(partitionTables.second.get());
+
+    const auto collected = PartitionMap::IOStats::collected();
+    const auto nameOf = [&names](const std::string &path) {
+      const auto it = names.find(path);
+      return it == names.end() ? std::string() : it->second;
+    };
+
+    if (printStats) {
+      Log::println("I/O statistics:");
+      if (collected.empty()) Log::println("  No partition I/O was done.");
+      for (const auto &[path, stats] : collected) {
+        const std::string name = nameOf(path);
+        Log::println("  {}{}:", path, name.empty() ? "" : " (" + name + ")");
+        if (stats.read.calls > 0) Log::println("    read:  {}", formatDirection(stats.read));
+        if (stats.write.calls > 0) Log::println("    write: {}", formatDirection(stats.write));
+      }
+    }
+
+    if (!statsFile.empty()) {
+      rapidjson::Document d;
+      d.SetObject();
+      auto &allocator = d.GetAllocator();
+      d.AddMember("stallThresholdMs", stallThreshold, allocator);
+
+      rapidjson::Value devices(rapidjson::kArrayType);
+      for (const auto &[path, stats] : collected) {
+        const std::string name = nameOf(path);
+        rapidjson::Value device(rapidjson::kObjectType), vPath, vName;
+        vPath.SetString(path.c_str(), path.length(), allocator);
+        vName.SetString(name.c_str(), name.length(), allocator);
+        device.AddMember("path", vPath, allocator);
+        device.AddMember("partition", vName, allocator);
+        device.AddMember("read", directionToJson(stats.read, allocator), allocator);
+        device.AddMember("write", directionToJson(stats.write, allocator), allocator);
+        devices.PushBack(device, allocator);
+      }
+      d.AddMember("devices", devices, allocator);
+
+      rapidjson::StringBuffer buffer;
+      rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+      d.Accept(writer);
+      Helper::UniqueFP fp(statsFile, "w");
+      if (!fp || fp.printf("{}\n", buffer.GetString()) < 0)
+        Log::error("Cannot write I/O statistics to {}: {}", std::quoted_string(statsFile), strerror(errno));
+    }
+  } catch (const std::exception &e) {
+    Log::error("Cannot report I/O statistics: {}", e.what());
   }
 }
 
+/**
+ * @brief Check whether progress renderers are needed.
+ *
+ * Quiet mode only silences the terminal, progress events are still written to --progress-fd.
+ */
+bool BasicFlags::showProgress() const noexcept { return !quietProcess || progressFd != -1; }
+
 /**
  * @brief Initialization function called at program startup.
  *
@@ -28,12 +28,15 @@
 #include <chrono>
 #include <fcntl.h>
 #include <future>
+#include <map>
+#include <numeric>
+#include <unistd.h>
 #include <PartitionManager/PartitionManager.hpp>
 #include <PartitionManager/Plugin.hpp>
 #include <private/android_filesystem_config.h>
 
 #define PLUGIN "BackupPlugin"
-#define PLUGIN_VERSION "1.3"
+#define PLUGIN_VERSION "1.5"
 
 namespace PartitionManager {
 
@@ -45,13 +48,45 @@ namespace PartitionManager {
  * configurable buffer sizes and optional verification of the backup.
  */
 class BackupPlugin final : public BasicPlugin {
+  /// @brief A partition to be backed up in a LUN sweep.
+  struct SweepTarget {
+    const PartitionMap::Partition_t *partition;
+    std::string name, output;
+    uint64_t start, size;
+  };
+
   std::vector<std::string> partitions, outputNames;
   std::string outputDirectory;
   uint64_t bufferSize = 0;
-  bool noSetPermissions = false, verify = false;
+  bool noSetPermissions = false, verify = false, sweep = false;
+
+  static constexpr uint64_t MIN_BUFFER_SIZE = 1024;                  ///< 1KB minimum buffer size
+  static constexpr uint64_t MAX_BUFFER_SIZE = 128ULL * 1024 * 1024;  ///< 128MB maximum buffer size
+  static constexpr uint64_t MIN_SWEEP_BUFFER_SIZE = 8 * 1024 * 1024; ///< 8MB minimum buffer size for sweeps
+
+  /// @brief Verify and set permissions of a written backup image.
+  std::optional<AsyncResult_t> finishOutput(const PartitionMap::Partition_t &partition, const std::string &partitionName,
+                                            const std::string &outputName) const {
+    if (verify && partition.isDirectIO()) {
+      Log::warning("Skipping verification of {}: Partition is not mapped, it's read through super.", partitionName);
+    } else if (verify) {
+      if (!Helper::sha256Compare(partition.absolutePath(), outputName)) {
+        return AsyncResult_t::Error("Verification failed: {} and {} have different SHA-256 hashes.",
+                                    partition.absolutePath().string(), outputName);
+      }
+      Log::info("SHA-256 verification successful for {}", outputName);
+    }
+
+    if (!noSetPermissions) {
+      if (!Helper::changeOwner(outputName, AID_EVERYBODY, AID_EVERYBODY))
+        Log::info("Failed to change owner of output file: {}. Access problems may occur in non-root users.");
+      if (!Helper::changeMode(outputName, DEFAULT_FILE_PERMS))
+        Log::info("Failed to change mode of output file to {:o}: {}. Access problems may occur in non-root users.", DEFAULT_FILE_PERMS,
+                  outputName);
+    }
 
-  static constexpr uint64_t MIN_BUFFER_SIZE = 1024;                 ///< 1KB minimum buffer size
-  static constexpr uint64_t MAX_BUFFER_SIZE = 128ULL * 1024 * 1024; ///< 128MB maximum buffer size
+    return std::nullopt;
+  }
 
 public:
   Helper::CMDLine::Subcommand *cmd = nullptr;
@@ -83,6 +118,8 @@ public:
         ->check(Helper::CMDLine::Checkers::BufferSizeCheck(MIN_BUFFER_SIZE, MAX_BUFFER_SIZE));
     cmd->addFlag("-n,--no-set-perms", noSetPermissions, "Don't change permission and owner after progress")->defaultValue(false);
     cmd->addFlag("-S,--verify", verify, "Verify SHA-256 of the backup image(s)")->defaultValue(false);
+    cmd->addFlag("--sweep", sweep, "Read partitions of each LUN in one sequential sweep (for many small partitions)")
+        ->defaultValue(false);
     cmd->addFlag("-v,--version", nullptr, "View version of plugin.")
         ->superior()
         ->callback(Helper::CMDLine::Callbacks::ViewPluginVersion(PLUGIN, PLUGIN_VERSION));
@@ -109,6 +146,7 @@ public:
    */
   PLUGIN_SECTION AsyncResult_t runAsync(const std::string &partitionName, const std::string &outputName,
                                         PartitionMap::ProgressRenderer *renderer) const {
+    Helper::Trace::Span span("job", "backup {}", partitionName);
     std::optional<PartitionMap::TableType> tType;
     auto *table = getCorrectTableObj(partitionName, Flags.partitionTables.first.get(), Flags.partitionTables.second.get(), tType);
     const PartitionMap::Partition_t *partition = setupPartition(partitionName, table);
@@ -147,24 +185,124 @@ public:
     }
 
     if (progress) progress->finished.store(true, std::memory_order_relaxed);
+    if (auto error = finishOutput(*partition, partitionName, outputName)) return std::move(*error);
 
-    if (verify) {
-      if (!Helper::sha256Compare(partition->absolutePath(), outputName)) {
-        return AsyncResult_t::Error("Verification failed: {} and {} have different SHA-256 hashes.",
-                                    partition->absolutePath().string(), outputName);
+    return AsyncResult_t::Success("Partition {} successfully backed up to {}", partitionName, outputName);
+  }
+
+  /**
+   * @brief Back up partitions of a LUN with one sequential sweep.
+   *
+   * Partitions are read in LBA order through large buffers, and every buffer is split into the outputs of partitions
+   * it covers. Small gaps between partitions are read and dropped, so the LUN is read with a few large I/Os.
+   *
+   * @param tablePath Path of LUN (like /dev/block/sda).
+   * @param targets Partitions of LUN, sorted by start address.
+   * @param renderer Optional progress renderer for displaying progress.
+   * @return AsyncResult_t Result of the asynchronous operation.
+   */
+  PLUGIN_SECTION AsyncResult_t sweepAsync(const std::filesystem::path &tablePath, const std::vector<SweepTarget> &targets,
+                                          PartitionMap::ProgressRenderer *renderer) const {
+    const std::string lun = tablePath.filename().string();
+    Helper::Trace::Span span("job", "sweep {}", lun);
+    std::vector<Helper::UniqueFD> outputs;
+    outputs.reserve(targets.size());
+    for (const auto &target : targets) {
+      if (Helper::fileIsExists(target.output) && !Flags.forceProcess)
+        return AsyncResult_t::Error("File {} already exists. Remove it, or use --force (-f) flag.", target.output);
+      outputs.emplace_back(target.output, O_WRONLY | O_CREAT | O_TRUNC, DEFAULT_FILE_PERMS);
+      if (!outputs.back()) return AsyncResult_t::Error("Cannot create {}: {}", target.output, strerror(errno));
+    }
+
+    const auto device = Helper::UniqueFD(tablePath, O_RDONLY);
+    if (!device) return AsyncResult_t::Error("Cannot open {}: {}", tablePath.string(), strerror(errno));
+    posix_fadvise(device.fd(), 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    const uint64_t buf = std::max(bufferSize, MIN_SWEEP_BUFFER_SIZE);
+    std::vector<char> buffer(buf);
+    uint64_t total = 0, done = 0, reads = 0;
+    for (const auto &target : targets)
+      total += target.size;
+    Log::info("Sweeping {} for {} partition(s) with buffer size {}", lun, targets.size(), buf);
+
+    std::shared_ptr<PartitionMap::Progress_t> progress;
+    if (renderer) progress = renderer->add(fmt::format("{} ({} partitions)", lun, targets.size()), total);
+
+    size_t first = 0; // First target which isn't completely written.
+    while (first < targets.size()) {
+      // A run is a range of partitions with gaps smaller than buffer, read without seeking.
+      uint64_t runEnd = targets[first].start + targets[first].size;
+      size_t last = first + 1;
+      for (; last < targets.size() && targets[last].start <= runEnd + buf; last++)
+        runEnd = std::max(runEnd, targets[last].start + targets[last].size);
+
+      for (uint64_t position = targets[first].start; position < runEnd;) {
+        const size_t toRead = std::min<uint64_t>(buf, runEnd - position);
+        Helper::Trace::Span readSpan("read", "read {} at {}", lun, position);
+        const ssize_t bytesRead = pread(device.fd(), buffer.data(), toRead, static_cast<off_t>(position));
+        if (bytesRead != static_cast<ssize_t>(toRead)) {
+          if (progress) progress->failed.store(true, std::memory_order_relaxed);
+          return AsyncResult_t::Error("Failed to read {} at {}: {}", tablePath.string(), position,
+                                      bytesRead == -1 ? strerror(errno) : "Unexpected end of device");
+        }
+        reads++;
+
+        for (size_t i = first; i < last; i++) {
+          const uint64_t begin = std::max(position, targets[i].start);
+          const uint64_t end = std::min(position + toRead, targets[i].start + targets[i].size);
+          if (begin >= end) continue;
+
+          if (pwrite(outputs[i].fd(), buffer.data() + (begin - position), end - begin, static_cast<off_t>(begin - targets[i].start)) !=
+              static_cast<ssize_t>(end - begin)) {
+            if (progress) progress->failed.store(true, std::memory_order_relaxed);
+            return AsyncResult_t::Error("Failed to write partition {} to image {}: {}", targets[i].name, targets[i].output,
+                                        strerror(errno));
+          }
+          done += end - begin;
+        }
+
+        position += toRead;
+        if (progress) progress->done.store(done, std::memory_order_relaxed);
       }
-      Log::info("SHA-256 verification successful for {}", outputName);
+      first = last;
     }
 
-    if (!noSetPermissions) {
-      if (!Helper::changeOwner(outputName, AID_EVERYBODY, AID_EVERYBODY))
-        Log::info("Failed to change owner of output file: {}. Access problems may occur in non-root users.");
-      if (!Helper::changeMode(outputName, DEFAULT_FILE_PERMS))
-        Log::info("Failed to change mode of output file to {:o}: {}. Access problems may occur in non-root users.", DEFAULT_FILE_PERMS,
-                  outputName);
+    outputs.clear(); // Close outputs before verifying.
+    if (progress) progress->finished.store(true, std::memory_order_relaxed);
+    for (const auto &target : targets) {
+      if (auto error = finishOutput(*target.partition, target.name, target.output)) return std::move(*error);
     }
 
-    return AsyncResult_t::Success("Partition {} successfully backed up to {}", partitionName, outputName);
+    return AsyncResult_t::Success("{} partition(s) of {} successfully backed up with {} read(s)", targets.size(), lun, reads);
+  }
+
+  /**
+   * @brief Group partitions by LUN for sweeping. Logical partitions are returned to be backed up one by one.
+   *
+   * @param outputs Output names of partitions.
+   * @return Partitions of each LUN sorted by start address, and indexes of partitions which cannot be swept.
+   */
+  std::pair<std::map<std::filesystem::path, std::vector<SweepTarget>>, std::vector<size_t>>
+  planSweep(const std::vector<std::string> &outputs) const {
+    std::map<std::filesystem::path, std::vector<SweepTarget>> luns;
+    std::vector<size_t> others;
+
+    for (size_t i = 0; i < partitions.size(); i++) {
+      std::optional<PartitionMap::TableType> tType;
+      auto *table = getCorrectTableObj(partitions[i], Flags.partitionTables.first.get(), Flags.partitionTables.second.get(), tType);
+      const PartitionMap::Partition_t *partition = setupPartition(partitions[i], table);
+
+      if (!partition || tType != PartitionMap::CLASSIC || Flags.onLogical || partition->size() == 0) {
+        others.push_back(i); // Errors are reported by runAsync().
+        continue;
+      }
+      luns[partition->tablePath()].push_back({partition, partitions[i], outputs[i], partition->start(), partition->size()});
+    }
+
+    for (auto &[path, targets] : luns) {
+      std::sort(targets.begin(), targets.end(), [](const SweepTarget &a, const SweepTarget &b) { return a.start < b.start; });
+    }
+    return {std::move(luns), std::move(others)};
   }
 
   /**
@@ -179,15 +317,27 @@ public:
     Helper::AsyncManager<AsyncResult_t> manager;
     manager.print = false;
     std::unique_ptr<PartitionMap::ProgressRenderer> renderer;
-    if (!Flags.quietProcess) renderer = std::make_unique<PartitionMap::ProgressRenderer>();
+    if (Flags.showProgress()) renderer = std::make_unique<PartitionMap::ProgressRenderer>(Flags.quietProcess);
 
+    std::vector<std::string> outputs;
     for (size_t i = 0; i < partitions.size(); i++) {
-      std::string partitionName = partitions[i];
-      std::string outputName = outputNames.empty() ? partitionName + ".img" : outputNames[i];
-      if (!outputDirectory.empty()) outputName.insert(0, outputDirectory + '/');
+      outputs.push_back(outputNames.empty() ? partitions[i] + ".img" : outputNames[i]);
+      if (!outputDirectory.empty()) outputs.back().insert(0, outputDirectory + '/');
+    }
+
+    std::map<std::filesystem::path, std::vector<SweepTarget>> luns;
+    std::vector<size_t> singles(partitions.size());
+    std::iota(singles.begin(), singles.end(), 0);
+    if (sweep) std::tie(luns, singles) = planSweep(outputs);
 
-      manager.addProcess(&BackupPlugin::runAsync, this, partitionName, outputName, renderer.get());
-      Log::info("Created thread for backing up {}", partitionName);
+    for (const auto &[tablePath, targets] : luns) {
+      manager.addProcess(&BackupPlugin::sweepAsync, this, tablePath, targets, renderer.get());
+      Log::info("Created thread for sweeping {} ({} partitions)", tablePath.string(), targets.size());
+    }
+
+    for (const size_t i : singles) {
+      manager.addProcess(&BackupPlugin::runAsync, this, partitions[i], outputs[i], renderer.get());
+      Log::info("Created thread for backing up {}", partitions[i]);
     }
 
     PLUGIN_END_WITH_RENDERER(renderer, manager);
@@ -198,6 +348,9 @@ public:
 
   /// @brief Get the plugin version.
   PLUGIN_SECTION std::string getVersion() override { return PLUGIN_VERSION; }
+
+  /// @brief Partitions are read into image files, never written.
+  PLUGIN_SECTION bool writesPartitions() override { return false; }
 };
 
 } // namespace PartitionManager
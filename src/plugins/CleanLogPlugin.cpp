@@ -75,6 +75,12 @@ public:
   /// @brief Check if the plugin's subcommand was used.
   PLUGIN_SECTION bool used() override { return cmd->isUsed(); }
 
+  /// @brief Partition tables are not used, gptfdisk is not needed.
+  PLUGIN_SECTION bool needsGptData() override { return false; }
+
+  /// @brief Doesn't access partitions, only log files are removed.
+  PLUGIN_SECTION bool writesPartitions() override { return false; }
+
   /**
    * @brief Run the log cleaning operation.
    *
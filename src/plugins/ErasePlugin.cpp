@@ -31,7 +31,7 @@
 #include <PartitionManager/Plugin.hpp>
 
 #define PLUGIN "ErasePlugin"
-#define PLUGIN_VERSION "1.3"
+#define PLUGIN_VERSION "1.4"
 
 namespace PartitionManager {
 
@@ -99,6 +99,7 @@ public:
    * @return AsyncResult_t Result of the asynchronous operation.
    */
   PLUGIN_SECTION AsyncResult_t runAsync(const std::string &partitionName) const {
+    Helper::Trace::Span span("job", "erase {}", partitionName);
     std::optional<PartitionMap::TableType> tType;
     auto *table = getCorrectTableObj(partitionName, Flags.partitionTables.first.get(), Flags.partitionTables.second.get(), tType);
     const PartitionMap::Partition_t *partition = setupPartition(partitionName, table);
@@ -117,8 +118,12 @@ public:
     setupBufferSize(buf, partitionName, table);
     Log::info("Using buffer size: {}", buf);
 
-    auto pfd = Helper::UniqueFD(partition->absolutePath(), O_WRONLY);
-    if (!pfd) return AsyncResult_t::Error("Can't open partition {}: {}", partitionName, strerror(errno));
+    openpart_t *op = nullptr;
+    try {
+      op = partition->openPart(OP_RDWR); // Super partition with direct I/O.
+    } catch (Error &err) {
+      return AsyncResult_t::Error("Can't open partition {}: {}", partitionName, err.what());
+    }
 
     if (!Flags.forceProcess) {
       if (!Helper::confirmPrompt("Are you sure you want to continue? This could render your device "
@@ -138,7 +143,7 @@ public:
     while (bytesWritten < partitionSize) {
       size_t toWrite = std::min<uint64_t>(buf, partitionSize - bytesWritten);
 
-      if (const ssize_t result = pfd.write(buffer.get(), toWrite); result == -1) {
+      if (const ssize_t result = partition->writeAt(buffer.get(), toWrite, bytesWritten); result == -1) {
         return AsyncResult_t::Error("Can't write zero bytes to partition {}: {}", partitionName, strerror(errno));
       } else if (result == 0) {
         return AsyncResult_t::Error("Write operation returned 0 bytes for partition {}", partitionName);
@@ -147,6 +152,7 @@ public:
       }
     }
 
+    openpart_sync(op);
     return AsyncResult_t::Success("Successfully wrote zero bytes to partition {}", partitionName);
   }
 
@@ -107,6 +107,7 @@ public:
    */
   PLUGIN_SECTION AsyncResult_t runAsync(const std::string &partitionName, const std::string &imageName,
                                         PartitionMap::ProgressRenderer *renderer) const {
+    Helper::Trace::Span span("job", "flash {}", partitionName);
     if (!Helper::fileIsExists(imageName)) return AsyncResult_t::Error("Couldn't find image file: {}", imageName);
 
     std::optional<PartitionMap::TableType> tType;
@@ -175,7 +176,7 @@ public:
     Helper::AsyncManager<AsyncResult_t> manager;
     manager.print = false;
     std::unique_ptr<PartitionMap::ProgressRenderer> renderer;
-    if (!Flags.quietProcess) renderer = std::make_unique<PartitionMap::ProgressRenderer>();
+    if (Flags.showProgress()) renderer = std::make_unique<PartitionMap::ProgressRenderer>(Flags.quietProcess);
 
     for (size_t i = 0; i < partitions.size(); i++) {
       manager.addProcess(&FlashPlugin::runAsync, this, partitions[i], imageNames[i], renderer.get());
@@ -82,9 +82,8 @@ private:
         Log::info("Closing opened file descriptors by libpartition_map before reading {}.", final);
         pTab->forEach([&name] FOREACH_PARTITIONS_LAMBDA_PARAMETERS {
           if (partition.tableName() == name) {
-            if (!partition.closeFdNow())
-              Log::warning("Cannot close {} (fd {}): {}", partition.path().string(), openpart_get_fd(partition.getOpenPart()),
-                           strerror(errno));
+            if (partition.isOpened() && !partition.closeFdNow())
+              Log::warning("Cannot close {}: {}", partition.path().string(), strerror(errno));
           }
           return true;
         });
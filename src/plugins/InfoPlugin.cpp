@@ -25,6 +25,8 @@
  * GUID, and other metadata. It supports both human-readable and JSON output formats.
  */
 
+#include <algorithm>
+#include <unordered_set>
 #include <PartitionManager/PartitionManager.hpp>
 #include <PartitionManager/Plugin.hpp>
 #include <rapidjson/document.h>
@@ -33,7 +35,7 @@
 #include <rapidjson/prettywriter.h>
 
 #define PLUGIN "InfoPlugin"
-#define PLUGIN_VERSION "1.2"
+#define PLUGIN_VERSION "1.4"
 
 namespace PartitionManager {
 
@@ -48,7 +50,39 @@ class InfoPlugin final : public BasicPlugin {
   std::vector<std::string> partitions;
   std::string jNamePartition, jNameTable, jNameSize, jNameLogical;
   int jIndentSize = 2;
-  bool jsonFormat = false, asByte = true, asKiloBytes = false, asMega = false, asGiga = false;
+  bool jsonFormat = false, asByte = true, asKiloBytes = false, asMega = false, asGiga = false, fsInfo = false;
+
+  /// @brief Filesystem info of a partition, probed with openpart_probe_all().
+  struct FsInfo {
+    std::string type, uuid, label;
+  };
+
+  /// @brief Probe filesystems of partitions concurrently (one read per partition).
+  static std::vector<FsInfo> probeFilesystems(const std::vector<const PartitionMap::Partition_t *> &parts) {
+    std::vector<openpart_t *> handles;
+    for (const auto *part : parts) {
+      try {
+        // With direct I/O the opened device is super, probing it would give wrong results.
+        handles.push_back(part->isDirectIO() ? nullptr : part->openPart(OP_RDONLY));
+      } catch (const Helper::Error &e) {
+        Log::warning("{}", e.what());
+        handles.push_back(nullptr);
+      }
+    }
+
+    Log::info("Probing filesystems of {} partitions...", handles.size());
+    openpart_probe_all(handles.data(), handles.size(), 0);
+
+    std::vector<FsInfo> infos;
+    for (auto *handle : handles) {
+      const char *type = handle ? openpart_get_fstype(handle) : nullptr;
+      const char *uuid = handle ? openpart_get_uuid(handle) : nullptr;
+      const char *label = handle ? openpart_get_label(handle) : nullptr;
+      infos.push_back({type ? type : "unknown", uuid ? uuid : "", label ? label : ""});
+    }
+
+    return infos;
+  }
 
 public:
   Helper::CMDLine::Subcommand *cmd = nullptr;
@@ -80,6 +114,7 @@ public:
                  "Print info(s) as JSON body. The body of each partition will "
                  "be written separately")
         ->defaultValue(false);
+    cmd->addFlag("--fs", fsInfo, "View filesystem type, UUID and label of partitions (probed in parallel).")->defaultValue(false);
     cmd->addFlag("--as-byte", asByte, "View sizes as byte.")->defaultValue(true);
     cmd->addFlag("--as-kilobyte", asKiloBytes, "View sizes as kilobyte.")->defaultValue(false);
     cmd->addFlag("--as-megabyte", asMega, "View sizes as megabyte.")->defaultValue(false);
@@ -106,27 +141,27 @@ public:
   /// @brief Check if the plugin's subcommand was used.
   PLUGIN_SECTION bool used() override { return cmd->isUsed(); }
 
+  /// @brief Only names, sizes and paths of partitions are used, gptfdisk is not needed.
+  PLUGIN_SECTION bool needsGptData() override { return false; }
+
+  /// @brief Only reads partition info and filesystem headers.
+  PLUGIN_SECTION bool writesPartitions() override { return false; }
+
   /**
    * @brief Run the info display operation.
    *
    * @return true if the operation succeeded.
    */
   PLUGIN_SECTION bool run() override {
-    std::vector<PartitionMap::Partition_t> jParts;
+    std::vector<const PartitionMap::Partition_t *> selected;
     PartitionMap::SizeUnit multiple;
     if (asByte) multiple = PartitionMap::BYTE;
     if (asKiloBytes) multiple = PartitionMap::KiB;
     if (asMega) multiple = PartitionMap::MiB;
     if (asGiga) multiple = PartitionMap::GiB;
 
-    auto getter = [this, &jParts, &multiple] FOREACH_PARTITIONS_LAMBDA_PARAMETERS_CONST -> bool {
-      if (jsonFormat)
-        jParts.push_back(partition);
-      else
-        Log::println("partition={} table={} size={} isLogical={}", partition.name(),
-                     partition.isLogicalPartition() ? "" : partition.tableName(), partition.formattedSizeString(multiple, true),
-                     partition.isLogicalPartition());
-
+    auto getter = [&selected] FOREACH_PARTITIONS_LAMBDA_PARAMETERS_CONST -> bool {
+      selected.push_back(&partition);
       return true;
     };
 
@@ -148,7 +183,26 @@ public:
       dTab->forEachFor(partitions, getter);
     }
 
-    if (jsonFormat) {
+    // A partition given more than once is listed once, so its handle isn't probed twice.
+    std::unordered_set<const PartitionMap::Partition_t *> seen;
+    selected.erase(std::remove_if(selected.begin(), selected.end(), [&seen](const auto *part) { return !seen.insert(part).second; }),
+                   selected.end());
+
+    const std::vector<FsInfo> fsInfos = fsInfo ? probeFilesystems(selected) : std::vector<FsInfo>{};
+
+    if (!jsonFormat) {
+      for (size_t i = 0; i < selected.size(); ++i) {
+        const auto &partition = *selected[i];
+        if (fsInfo)
+          Log::println("partition={} table={} size={} isLogical={} fsType={} uuid={} label={}", partition.name(),
+                       partition.isLogicalPartition() ? "" : partition.tableName(), partition.formattedSizeString(multiple, true),
+                       partition.isLogicalPartition(), fsInfos[i].type, fsInfos[i].uuid, fsInfos[i].label);
+        else
+          Log::println("partition={} table={} size={} isLogical={}", partition.name(),
+                       partition.isLogicalPartition() ? "" : partition.tableName(), partition.formattedSizeString(multiple, true),
+                       partition.isLogicalPartition());
+      }
+    } else {
       rapidjson::Document d;
       d.SetObject();
       auto &allocator = d.GetAllocator();
@@ -160,7 +214,8 @@ public:
 
       rapidjson::Value partitionsArray(rapidjson::kArrayType);
 
-      for (auto &part : jParts) {
+      for (size_t i = 0; i < selected.size(); ++i) {
+        const auto &part = *selected[i];
         rapidjson::Value partObj(rapidjson::kObjectType);
 
         // --json-partition-name
@@ -187,6 +242,17 @@ public:
         kLogical.SetString(jNameLogical.c_str(), jNameLogical.length(), allocator);
         partObj.AddMember(kLogical, part.isLogicalPartition(), allocator);
 
+        // --fs
+        if (fsInfo) {
+          rapidjson::Value vType, vUuid, vLabel;
+          vType.SetString(fsInfos[i].type.c_str(), fsInfos[i].type.length(), allocator);
+          vUuid.SetString(fsInfos[i].uuid.c_str(), fsInfos[i].uuid.length(), allocator);
+          vLabel.SetString(fsInfos[i].label.c_str(), fsInfos[i].label.length(), allocator);
+          partObj.AddMember("fsType", vType, allocator);
+          partObj.AddMember("uuid", vUuid, allocator);
+          partObj.AddMember("label", vLabel, allocator);
+        }
+
         partitionsArray.PushBack(partObj, allocator);
       }
 
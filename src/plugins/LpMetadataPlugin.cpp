@@ -28,10 +28,9 @@
 #include <PartitionManager/PartitionManager.hpp>
 #include <PartitionManager/Plugin.hpp>
 #include <liblp/metadata_format.h>
-#include <libopenpart/openpart.h>
 
 #define PLUGIN "LpMetadataPlugin"
-#define PLUGIN_VERSION "1.0"
+#define PLUGIN_VERSION "1.4"
 
 namespace PartitionManager {
 
@@ -45,11 +44,171 @@ namespace PartitionManager {
 class LpMetadataPlugin final : public BasicPlugin {
 public:
   Helper::CMDLine::Subcommand *mainCmd = nullptr, *subCmdFirst = nullptr, *subCmdSecond = nullptr;
+  Helper::CMDLine::Subcommand *unpackCmd = nullptr, *packCmd = nullptr;
+  Helper::CMDLine::Subcommand *resizeCmd = nullptr, *createCmd = nullptr, *removeCmd = nullptr;
   BasicFlags *flags = nullptr;
   PartitionMap::DynamicTableData *dTab = nullptr;
 
 private:
-  std::vector<std::string> partitions;
+  std::vector<std::string> partitions, unpackPartitions, packGroups, packPartitions, packImages, removePartitions;
+  std::string superImage, outputDirectory, packOutput, editPartition, editGroup;
+  uint32_t slot = 0;
+  uint64_t deviceSize = 0, metadataSize = 0, alignment = 0, blockSize = 0, editSize = 0;
+  uint32_t metadataSlots = 0;
+  bool packSparse = false, editReadonly = false;
+
+  /// @brief Split a layout argument by @p delim, keeping empty fields.
+  static std::vector<std::string> fields(const std::string &arg, char delim) {
+    std::vector<std::string> result;
+    std::stringstream ss(arg);
+    std::string field;
+    while (std::getline(ss, field, delim))
+      result.push_back(field);
+    return result;
+  }
+
+  /// @brief Parse size field of a layout argument (like 4GB).
+  static uint64_t parseSize(const std::string &value, const std::string &arg) {
+    try {
+      return std::stoull(Helper::CMDLine::Transformers::AsSizeValue(false)(value));
+    } catch (std::exception &) {
+      throw Error("Invalid size in {}: {}", arg, value);
+    }
+  }
+
+  /**
+   * @brief Convert pack arguments to layout.
+   *
+   * @return Layout.
+   */
+  PartitionMap::SuperLayout packLayout() const {
+    PartitionMap::SuperLayout layout;
+    layout.deviceSize = deviceSize;
+    layout.metadataSize = static_cast<uint32_t>(metadataSize);
+    layout.metadataSlots = metadataSlots;
+    layout.alignment = static_cast<uint32_t>(alignment);
+    layout.blockSize = static_cast<uint32_t>(blockSize);
+
+    for (const auto &arg : packGroups) {
+      const auto parts = fields(arg, ':');
+      if (parts.size() != 2 || parts[0].empty()) throw Error("Invalid group (expected name:size): {}", arg);
+      layout.groups.push_back({parts[0], parseSize(parts[1], arg)});
+    }
+
+    for (const auto &arg : packPartitions) {
+      const auto parts = fields(arg, ':');
+      if (parts.size() < 2 || parts.size() > 4 || parts[0].empty())
+        throw Error("Invalid partition (expected name:attributes[:size[:group]]): {}", arg);
+
+      PartitionMap::SuperLayout::Partition partition;
+      partition.name = parts[0];
+      if (parts[1] == "readonly")
+        partition.attributes = LP_PARTITION_ATTR_READONLY;
+      else if (parts[1] != "none" && !parts[1].empty())
+        throw Error("Unknown partition attribute (expected readonly or none): {}", parts[1]);
+      if (parts.size() > 2 && !parts[2].empty()) partition.size = parseSize(parts[2], arg);
+      if (parts.size() > 3 && !parts[3].empty()) partition.group = parts[3];
+      layout.partitions.push_back(std::move(partition));
+    }
+
+    for (const auto &arg : packImages) {
+      const size_t pos = arg.find('=');
+      if (pos == std::string::npos) throw Error("Invalid image (expected name=path): {}", arg);
+
+      const std::string name = arg.substr(0, pos);
+      auto it = std::find_if(layout.partitions.begin(), layout.partitions.end(), [&](const auto &p) { return p.name == name; });
+      if (it == layout.partitions.end()) throw Error("Image is given for unknown partition: {}", name);
+      if (!Helper::fileIsExists(arg.substr(pos + 1))) throw Error("Couldn't find image file: {}", arg.substr(pos + 1));
+      it->image = arg.substr(pos + 1);
+    }
+
+    return layout;
+  }
+
+  /**
+   * @brief Pack super image from given layout and images.
+   *
+   * @return true if successful.
+   */
+  bool pack() {
+    if (Helper::fileIsExists(packOutput) && !Flags.forceProcess)
+      throw Error("File {} already exists. Remove it, or use --force (-f) flag.", packOutput);
+
+    const PartitionMap::SuperLayout layout = packLayout();
+    std::unique_ptr<PartitionMap::ProgressRenderer> renderer;
+    std::map<std::string, std::shared_ptr<PartitionMap::Progress_t>> progresses;
+    if (Flags.showProgress() && !packSparse) {
+      renderer = std::make_unique<PartitionMap::ProgressRenderer>(Flags.quietProcess);
+      for (const auto &partition : layout.partitions) {
+        if (!partition.image.empty())
+          progresses[partition.name] = renderer->add(partition.name, std::filesystem::file_size(partition.image));
+      }
+      renderer->start();
+    }
+
+    auto callback = [&progresses](const std::string &name, uint64_t done, uint64_t) {
+      if (const auto it = progresses.find(name); it != progresses.end()) it->second->done.store(done, std::memory_order_relaxed);
+    };
+
+    std::unique_ptr<android::fs_mgr::LpMetadata> metadata;
+    try {
+      metadata = PartitionMap::SuperImage::pack(layout, packOutput, packSparse, callback);
+    } catch (Error &) {
+      for (auto &[name, progress] : progresses)
+        progress->failed.store(true, std::memory_order_relaxed);
+      if (renderer) renderer->stop();
+      throw;
+    }
+
+    for (auto &[name, progress] : progresses)
+      progress->finished.store(true, std::memory_order_relaxed);
+    if (renderer) renderer->stop();
+
+    Log::println("Packed {} logical partition(s) into {} ({}, {} bytes)", metadata->partitions.size(), packOutput,
+                 packSparse ? "sparse" : "raw", layout.deviceSize);
+    return true;
+  }
+
+  /**
+   * @brief Resize, create or remove logical partitions by editing super metadata in place.
+   *
+   * @return true if successful.
+   */
+  bool editMetadata() {
+    std::vector<std::string> names = removeCmd->isUsed() ? removePartitions : std::vector<std::string>{editPartition};
+    for (const auto &name : names) {
+      if (!createCmd->isUsed() && !dTab->hasPartition(name)) throw Error("Couldn't find logical partition: {}", name);
+      if (!Helper::isExists(Helper::pathJoin("/dev/block/mapper", name))) continue;
+
+      // Extents dropped from a mapped partition are still used by its device-mapper table, new allocations may overlap them.
+      if (removeCmd->isUsed() || (resizeCmd->isUsed() && editSize < dTab->partitionInfo(name)->size))
+        throw Error("{} is mapped by device-mapper, it cannot be shrunk or removed. Unmap it first (or do it from recovery).", name);
+      Log::warning("{} is mapped by device-mapper, new layout is used after it's remapped (or after reboot).", name);
+    }
+
+    if (!Flags.forceProcess) {
+      if (!Helper::confirmPrompt("Are you sure you want to continue? Super metadata will be rewritten. Do not continue if you "
+                                 "do not know what you are doing!"))
+        throw Error("Operation canceled by user.");
+    }
+
+    if (resizeCmd->isUsed()) {
+      dTab->resizePartition(editPartition, editSize);
+      Log::println("Resized {} to {} bytes ({} bytes free in super)", editPartition, dTab->partitionInfo(editPartition)->size,
+                   dTab->freeSpace());
+    } else if (createCmd->isUsed()) {
+      dTab->createPartition(editPartition, editGroup, editReadonly ? LP_PARTITION_ATTR_READONLY : LP_PARTITION_ATTR_NONE, editSize);
+      Log::println("Created {} in group {} with {} bytes ({} bytes free in super)", editPartition, editGroup,
+                   dTab->partitionInfo(editPartition)->size, dTab->freeSpace());
+    } else {
+      for (const auto &name : names) {
+        dTab->removePartition(name);
+        Log::println("Removed {} ({} bytes free in super)", name, dTab->freeSpace());
+      }
+    }
+
+    return true;
+  }
 
   /**
    * @brief Read and display partition group metadata.
@@ -57,9 +216,12 @@ private:
    * @return true if successful.
    */
   bool readGroupMetadata() {
-    for (const auto &group : dTab->getGroups()) {
-      Log::println("name={} max_size={} flags={}", std::string(group.name), group.maximum_size,
-                   (group.flags & LP_GROUP_SLOT_SUFFIXED ? "slot_suffixed" : ""));
+    const auto &model = dTab->getModel();
+    const auto &groups = dTab->getGroups();
+    for (size_t i = 0; i < groups.size(); ++i) {
+      Log::println("name={} max_size={} used_size={} free_size={} partitions={} flags={}", std::string(groups[i].name),
+                   groups[i].maximum_size, model.groups[i].usedSize, dTab->freeSpace(groups[i].name), model.groups[i].partitions,
+                   (groups[i].flags & LP_GROUP_SLOT_SUFFIXED ? "slot_suffixed" : ""));
     }
 
     return true;
@@ -72,22 +234,11 @@ private:
    */
   bool readPartitionMetadata() {
     const auto &tableMetadata = dTab->getMetadata();
-    auto reader = [&tableMetadata] FOREACH_LP_METADATA_PARTITION_PARAMETERS_CONST -> bool {
+    auto reader = [this, &tableMetadata] FOREACH_LP_METADATA_PARTITION_PARAMETERS_CONST -> bool {
       const auto &group = tableMetadata.groups[metadata.group_index];
-      const auto &path = Helper::pathJoin("/dev/block/mapper", metadata.name);
-      openpart_t *op = openpart_open(path.c_str(), OP_RDONLY, 0);
-      if (!op) {
-        Log::error("Failed to open partition: {}", path.string());
-        return false;
-      }
+      const auto *info = dTab->partitionInfo(metadata.name);
+      const uint64_t size = info ? info->size : 0; // Calculated from extents, the partition is not opened.
 
-      uint64_t size = openpart_get_size(op);
-      if (size == UINT64_MAX) {
-        Log::error("Failed to get size of partition: {}: {}", path.string(), openpart_strerror(op));
-        size = 0;
-      }
-
-      openpart_close(&op);
       std::vector<std::string> attr_strs;
       attr_strs.reserve(4);
       if (metadata.attributes & LP_PARTITION_ATTR_READONLY) attr_strs.push_back("readonly");
@@ -95,7 +246,8 @@ private:
       if (metadata.attributes & LP_PARTITION_ATTR_UPDATED) attr_strs.push_back("updated");
       if (metadata.attributes & LP_PARTITION_ATTR_DISABLED) attr_strs.push_back("disabled");
 
-      Log::print("name={} group={} size={} attributes=", std::string(metadata.name), std::string(group.name), size);
+      Log::print("name={} group={} size={} extents={} attributes=", std::string(metadata.name), std::string(group.name), size,
+                 metadata.num_extents);
       for (const auto &attr : attr_strs) {
         Log::print("{}", attr);
         if (&attr != &attr_strs.back()) Log::print(",");
@@ -117,6 +269,72 @@ private:
     return true;
   }
 
+  /**
+   * @brief Extract a logical partition from super image.
+   *
+   * @param super Super image.
+   * @param name Partition name.
+   * @param renderer Optional progress renderer for displaying progress.
+   * @return AsyncResult_t Result of the asynchronous operation.
+   */
+  AsyncResult_t unpackAsync(const PartitionMap::SuperImage &super, const std::string &name,
+                            PartitionMap::ProgressRenderer *renderer) const {
+    Helper::Trace::Span span("job", "unpack {}", name);
+    std::string output = name + ".img";
+    if (!outputDirectory.empty()) output.insert(0, outputDirectory + '/');
+    if (Helper::fileIsExists(output) && !Flags.forceProcess)
+      return AsyncResult_t::Error("File {} already exists. Remove it, or use --force (-f) flag.", output);
+
+    std::shared_ptr<PartitionMap::Progress_t> progress;
+    if (renderer) progress = renderer->add(name, super.partitionSize(name));
+
+    try {
+      super.extract(name, output, [&progress](uint64_t done, uint64_t) {
+        if (progress) progress->done.store(done, std::memory_order_relaxed);
+      });
+    } catch (Error &err) {
+      if (progress) progress->failed.store(true, std::memory_order_relaxed);
+      return AsyncResult_t::Error("Failed to extract {} from {}: {}", name, super.path().string(), err.what());
+    }
+
+    if (progress) progress->finished.store(true, std::memory_order_relaxed);
+    return AsyncResult_t::Success("Partition {} successfully extracted to {}", name, output);
+  }
+
+  /**
+   * @brief Extract logical partitions from super image concurrently.
+   *
+   * @return true if all partitions extracted.
+   */
+  bool unpack() {
+    const std::string path = superImage == "super" && !Helper::fileIsExists(superImage) ? "/dev/block/by-name/super" : superImage;
+    const PartitionMap::SuperImage super(path, slot);
+
+    std::vector<std::string> names = unpackPartitions;
+    if (names.empty()) {
+      for (const auto &metadata : super.getMetadata().partitions) {
+        if (super.partitionSize(metadata.name) != 0)
+          names.emplace_back(metadata.name);
+        else
+          Log::info("Skipping empty logical partition: {}", std::string(metadata.name));
+      }
+    }
+
+    for (const auto &name : names) {
+      if (super.partitionSize(name) == UINT64_MAX) throw Error("Couldn't find logical partition in {}: {}", path, name);
+    }
+
+    Helper::AsyncManager<AsyncResult_t> manager;
+    manager.print = false;
+    std::unique_ptr<PartitionMap::ProgressRenderer> renderer;
+    if (Flags.showProgress()) renderer = std::make_unique<PartitionMap::ProgressRenderer>(Flags.quietProcess);
+
+    for (const auto &name : names)
+      manager.addProcess(&LpMetadataPlugin::unpackAsync, this, std::cref(super), name, renderer.get());
+
+    PLUGIN_END_WITH_RENDERER(renderer, manager);
+  }
+
 public:
   /// @brief Default constructor.
   PLUGIN_SECTION LpMetadataPlugin() = default;
@@ -139,6 +357,54 @@ public:
     subCmdSecond = mainCmd->addSubcommand("read-partition", "Read logical partition metadata structures.")
                        ->footer("Use get-all or getvar-all as partition name for reading all partitions");
     subCmdSecond->addOption("partition(s)", partitions, "Partition name(s)")->required();
+    unpackCmd = mainCmd->addSubcommand("unpack", "Extract logical partitions from super image or super partition.")
+                    ->footer("Use super as image name for reading super partition of device. All non-empty partitions are "
+                             "extracted if no partition name is given.");
+    unpackCmd->addOption("image", superImage, "Super image (raw or sparse) or super partition")->required();
+    unpackCmd->addOption("partition(s)", unpackPartitions, "Partition name(s)");
+    unpackCmd->addOption("-O,--output-directory", outputDirectory, "Directory to save the partition image(s)")
+        ->check(Helper::CMDLine::Checkers::ExistingDirectory());
+    unpackCmd->addOption("-s,--slot", slot, "Metadata slot")->defaultValue(0);
+
+    packCmd = mainCmd->addSubcommand("pack", "Pack super image from logical partition images (like lpmake).")
+                  ->footer("Partitions are defined as name:attributes[:size[:group]] (attributes: readonly or none, size is the "
+                           "image size if not given), groups as name:size and images as name=path.");
+    packCmd->addOption("-o,--output", packOutput, "Output super image")->required();
+    packCmd->addOption("--device-size", deviceSize, "Size of super partition")
+        ->transform(Helper::CMDLine::Transformers::AsSizeValue(false))
+        ->required();
+    packCmd->addOption("-m,--metadata-size", metadataSize, "Maximum size of metadata")
+        ->transform(Helper::CMDLine::Transformers::AsSizeValue(false))
+        ->defaultValue("64KB");
+    packCmd->addOption("-s,--metadata-slots", metadataSlots, "Count of metadata slots")->defaultValue(2);
+    packCmd->addOption("-g,--group", packGroups, "Partition group(s)");
+    packCmd->addOption("--partition", packPartitions, "Logical partition(s)")->required();
+    packCmd->addOption("-i,--image", packImages, "Image(s) of partitions");
+    packCmd->addOption("--alignment", alignment, "Partition alignment")
+        ->transform(Helper::CMDLine::Transformers::AsSizeValue(false))
+        ->defaultValue("1MB");
+    packCmd->addOption("--block-size", blockSize, "Logical block size")
+        ->transform(Helper::CMDLine::Transformers::AsSizeValue(false))
+        ->defaultValue("4KB");
+    packCmd->addFlag("-S,--sparse", packSparse, "Write as Android sparse image")->defaultValue(false);
+
+    resizeCmd = mainCmd->addSubcommand("resize", "Resize logical partition by editing super metadata in place.")
+                    ->footer("Only metadata is written, existing extents are not moved.");
+    resizeCmd->addOption("partition", editPartition, "Partition name")->required();
+    resizeCmd->addOption("size", editSize, "New size of partition")
+        ->transform(Helper::CMDLine::Transformers::AsSizeValue(false))
+        ->required();
+
+    createCmd = mainCmd->addSubcommand("create", "Create logical partition by editing super metadata in place.");
+    createCmd->addOption("partition", editPartition, "Partition name")->required();
+    createCmd->addOption("size", editSize, "Size of partition")
+        ->transform(Helper::CMDLine::Transformers::AsSizeValue(false))
+        ->required();
+    createCmd->addOption("-g,--group", editGroup, "Group of partition")->defaultValue("default");
+    createCmd->addFlag("-r,--readonly", editReadonly, "Set readonly attribute")->defaultValue(false);
+
+    removeCmd = mainCmd->addSubcommand("remove", "Remove logical partition(s) by editing super metadata in place.");
+    removeCmd->addOption("partition(s)", removePartitions, "Partition name(s)")->required();
 
     mainCmd->addFlag("-v,--version", nullptr, "View version of plugin.")
         ->superior()
@@ -165,17 +431,25 @@ public:
    */
   PLUGIN_SECTION bool used() override { return mainCmd->isUsed(); }
 
+  /// @brief Only editing commands write to super.
+  PLUGIN_SECTION bool writesPartitions() override { return resizeCmd->isUsed() || createCmd->isUsed() || removeCmd->isUsed(); }
+
   /**
    * @brief Run the metadata display operation.
    *
    * @return true if the operation succeeded.
    */
   PLUGIN_SECTION bool run() override {
+    // These work on images, device doesn't need dynamic partitions.
+    if (unpackCmd->isUsed()) return unpack();
+    if (packCmd->isUsed()) return pack();
+
     dTab = GET_DYNAMIC_TABLE_DATA_PTR();
     if (!dTab->isSupported()) throw Error("This device doesn't support dynamic partitions.");
 
     if (subCmdFirst->isUsed()) return readGroupMetadata();
     if (subCmdSecond->isUsed()) return readPartitionMetadata();
+    if (resizeCmd->isUsed() || createCmd->isUsed() || removeCmd->isUsed()) return editMetadata();
     return false;
   }
 
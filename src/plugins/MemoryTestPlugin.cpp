@@ -20,33 +20,724 @@
  * @author Yağız Zengin ([YZBruh](https://github.com/YZBruh))
  * @brief Implementation of the MemoryTestPlugin for testing I/O speed.
  *
- * This file implements the MemoryTestPlugin class which provides functionality
- * to test partition memory by performing read and write operations to verify
- * data integrity and measure performance.
+ * This file implements the MemoryTestPlugin class which benchmarks storage with
+ * fio-like workloads (sequential or random, reads, writes or a mix of them) run
+ * by parallel jobs, and reports throughput and latency percentiles. Partitions
+ * can be benchmarked through openpart with a sweep of block sizes and job counts.
  */
 
+#include <algorithm>
 #include <chrono>
 #include <cstring>
+#include <functional>
 #include <random>
 #include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
 #include <PartitionManager/PartitionManager.hpp>
 #include <PartitionManager/Plugin.hpp>
+#include <rapidjson/document.h>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+
+#if __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+#include <linux/io_uring.h>
+#define HAVE_IO_URING
+#endif
 
 #define PLUGIN "MemoryTestPlugin"
-#define PLUGIN_VERSION "1.2"
+#define PLUGIN_VERSION "2.1"
 
 namespace PartitionManager {
 
 /**
- * @brief Plugin for testing partition memory.
+ * @brief Plugin for benchmarking storage.
  *
- * This plugin provides functionality to test partition memory by performing
- * read and write operations to verify data integrity and measure performance.
+ * Workloads are run one after another on a test file or a partition. Every workload is run by
+ * parallel jobs; with io_uring each job keeps multiple requests in flight.
  */
 class MemoryTestPlugin final : public BasicPlugin {
-  uint64_t bufferSize = MB(4), testFileSize = 0;
+  using Clock = std::chrono::steady_clock;
+
+  using IOStats = PartitionMap::IOStats;
+  using Workload = PartitionMap::IOWorkload;
+
+  /// @brief I/O target of a benchmark job. Every job opens its own target.
+  class Target {
+  public:
+    virtual ~Target() = default;
+    virtual ssize_t readAt(void *buffer, size_t size, uint64_t offset) = 0;
+    virtual ssize_t writeAt(const void *buffer, size_t size, uint64_t offset) = 0;
+
+    /// @brief Get file descriptor for io_uring, -1 if the target can only be used synchronously.
+    virtual int fd(bool write) const {
+      (void)write;
+      return -1;
+    }
+  };
+
+  /// @brief Test file, with separate descriptors for reads and writes (they may use different flags).
+  class FileTarget final : public Target {
+    Helper::UniqueFD readFd, writeFd;
+
+  public:
+    FileTarget(const std::string &path, int readFlags, int writeFlags)
+        : readFd(path, O_RDONLY | readFlags), writeFd(path, O_WRONLY | writeFlags) {
+      if (!readFd || !writeFd) throw Error("Can't open test file: {}", strerror(errno));
+    }
+
+    ssize_t readAt(void *buffer, size_t size, uint64_t offset) override {
+      return pread(readFd.fd(), buffer, size, static_cast<off_t>(offset));
+    }
+
+    ssize_t writeAt(const void *buffer, size_t size, uint64_t offset) override {
+      return pwrite(writeFd.fd(), buffer, size, static_cast<off_t>(offset));
+    }
+
+    int fd(bool write) const override { return write ? writeFd.fd() : readFd.fd(); }
+  };
+
+  /// @brief Partition, accessed through its openpart handle like backup and flash do. Jobs share the handle.
+  class PartitionTarget final : public Target {
+    const PartitionMap::Partition_t &partition;
+
+  public:
+    explicit PartitionTarget(const PartitionMap::Partition_t &part) : partition(part) {}
+
+    ssize_t readAt(void *buffer, size_t size, uint64_t offset) override { return partition.readAt(buffer, size, offset); }
+
+    ssize_t writeAt(const void *buffer, size_t size, uint64_t offset) override {
+      return partition.writeAt(buffer, size, offset);
+    }
+  };
+
+  /// @brief Parameters of a benchmark.
+  struct Spec {
+    Workload workload;
+    uint64_t size;                                 // Size of tested region.
+    uint64_t blockSize;                            // Size of each request.
+    unsigned jobs, depth;                          // Parallel jobs, requests in flight per job.
+    bool useRing;                                  // io_uring or pread()/pwrite().
+    std::string mode;                              // Description of I/O mode (for reports).
+    std::chrono::seconds runtime;                  // 0 = until every job has done its share of the region.
+    std::function<std::unique_ptr<Target>()> open; // Open target of a job.
+  };
+
+  /// @brief Result of a benchmark.
+  struct Result {
+    Spec spec;
+    double seconds = 0;
+    openpart_io_stats_t read{}, write{}; // Shared by jobs, updated atomically.
+  };
+
+#ifdef HAVE_IO_URING
+  /// @brief Minimal io_uring instance. System calls are used directly, liburing isn't available.
+  class Ring {
+    int ringFd = -1;
+    void *sqRing = MAP_FAILED, *cqRing = MAP_FAILED, *sqeArea = MAP_FAILED;
+    size_t sqRingSize = 0, cqRingSize = 0, sqeAreaSize = 0;
+    unsigned *sqHead = nullptr, *sqTail = nullptr, *sqMask = nullptr, *sqArray = nullptr;
+    unsigned *cqHead = nullptr, *cqTail = nullptr, *cqMask = nullptr;
+    io_uring_sqe *sqes = nullptr;
+    io_uring_cqe *cqes = nullptr;
+
+    template <typename T> static T *at(void *base, uint32_t offset) {
+      return reinterpret_cast<T *>(static_cast<char *>(base) + offset);
+    }
+
+    void release() noexcept {
+      if (sqeArea != MAP_FAILED) munmap(sqeArea, sqeAreaSize);
+      if (cqRing != MAP_FAILED && cqRing != sqRing) munmap(cqRing, cqRingSize);
+      if (sqRing != MAP_FAILED) munmap(sqRing, sqRingSize);
+      if (ringFd != -1) close(ringFd);
+      sqeArea = cqRing = sqRing = MAP_FAILED;
+      ringFd = -1;
+    }
+
+  public:
+    explicit Ring(unsigned entries) {
+      io_uring_params params{};
+      ringFd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+      if (ringFd < 0) throw Error("Cannot setup io_uring: {}", strerror(errno));
+
+      const bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+      sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+      cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+      if (singleMap) sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+      sqeAreaSize = params.sq_entries * sizeof(io_uring_sqe);
+
+      constexpr int prot = PROT_READ | PROT_WRITE, flags = MAP_SHARED | MAP_POPULATE;
+      sqRing = mmap(nullptr, sqRingSize, prot, flags, ringFd, IORING_OFF_SQ_RING);
+      cqRing = singleMap ? sqRing : mmap(nullptr, cqRingSize, prot, flags, ringFd, IORING_OFF_CQ_RING);
+      sqeArea = mmap(nullptr, sqeAreaSize, prot, flags, ringFd, IORING_OFF_SQES);
+      if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqeArea == MAP_FAILED) {
+        const int err = errno;
+        release();
+        throw Error("Cannot map io_uring: {}", strerror(err));
+      }
+
+      sqHead = at<unsigned>(sqRing, params.sq_off.head);
+      sqTail = at<unsigned>(sqRing, params.sq_off.tail);
+      sqMask = at<unsigned>(sqRing, params.sq_off.ring_mask);
+      sqArray = at<unsigned>(sqRing, params.sq_off.array);
+      cqHead = at<unsigned>(cqRing, params.cq_off.head);
+      cqTail = at<unsigned>(cqRing, params.cq_off.tail);
+      cqMask = at<unsigned>(cqRing, params.cq_off.ring_mask);
+      cqes = at<io_uring_cqe>(cqRing, params.cq_off.cqes);
+      sqes = static_cast<io_uring_sqe *>(sqeArea);
+    }
+
+    ~Ring() { release(); }
+
+    Ring(const Ring &) = delete;
+    Ring &operator=(const Ring &) = delete;
+
+    /// @brief Queue a read or write. @p data is given back with its completion.
+    void push(bool write, int fd, const iovec *iov, uint64_t offset, uint64_t data) {
+      const unsigned tail = *sqTail;
+      const unsigned index = tail & *sqMask;
+      io_uring_sqe &sqe = sqes[index];
+      memset(&sqe, 0, sizeof(sqe));
+      sqe.opcode = write ? IORING_OP_WRITEV : IORING_OP_READV;
+      sqe.fd = fd;
+      sqe.addr = reinterpret_cast<uint64_t>(iov);
+      sqe.len = 1;
+      sqe.off = offset;
+      sqe.user_data = data;
+      sqArray[index] = index;
+      __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    }
+
+    /// @brief Submit queued requests and wait for at least one completion.
+    void submitAndWait() {
+      for (;;) {
+        const unsigned pending = *sqTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+        if (syscall(__NR_io_uring_enter, ringFd, pending, 1, IORING_ENTER_GETEVENTS, nullptr, 0) >= 0) return;
+        if (errno != EINTR) throw Error("Cannot submit io_uring requests: {}", strerror(errno));
+      }
+    }
+
+    /// @brief Call @p complete with data and result of every completion.
+    template <typename F> void reap(F &&complete) {
+      unsigned head = *cqHead;
+      for (const unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE); head != tail; head++) {
+        const io_uring_cqe &cqe = cqes[head & *cqMask];
+        complete(cqe.user_data, cqe.res);
+      }
+      __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+    }
+  }; // class Ring
+#endif
+
+  using AlignedBuffer = std::unique_ptr<char, decltype(&free)>;
+
+  uint64_t blockSize = 0, testFileSize = 0;
+  unsigned int jobCount = 1, ioDepth = 1, readPercent = 50, runtime = 0;
+  std::vector<std::string> workloadNames, sweepBlockSizes;
+  std::vector<int> sweepJobs;
+  std::string engine, jsonFile, partitionName;
   std::filesystem::path testPath;
-  bool doNotReadTest = false;
+  bool doNotReadTest = false, direct = false, buffered = false, scratch = false;
+  Helper::CMDLine::Option *blockSizeOption = nullptr, *jobsOption = nullptr;
+
+  static constexpr uint64_t MIN_BLOCK_SIZE = 512;               ///< 512B minimum block size
+  static constexpr uint64_t MAX_BLOCK_SIZE = 64ULL * 1024 * 1024; ///< 64MB maximum block size
+  static constexpr uint64_t DIRECT_ALIGNMENT = 4096;            ///< Alignment of buffers, offsets and sizes for O_DIRECT
+
+  /// @brief Allocate a buffer aligned for O_DIRECT.
+  static AlignedBuffer alignedBuffer(size_t size) {
+    void *buffer = nullptr;
+    if (posix_memalign(&buffer, DIRECT_ALIGNMENT, size) != 0) throw Error("Cannot allocate {} bytes of I/O buffer.", size);
+    return {static_cast<char *>(buffer), &free};
+  }
+
+  /// @brief Fill buffer with random data (so compressing or deduplicating storage can't skip writes).
+  static void fillRandom(char *buffer, size_t size, std::mt19937_64 &random) {
+    for (size_t i = 0; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+      const uint64_t value = random();
+      memcpy(buffer + i, &value, sizeof(value));
+    }
+  }
+
+  /// @brief Check whether io_uring can be used (kernel support, SELinux and seccomp policy).
+  static bool ringAvailable() {
+#ifdef HAVE_IO_URING
+    try {
+      Ring ring(1);
+      return true;
+    } catch (const Error &) {
+      return false;
+    }
+#else
+    return false;
+#endif
+  }
+
+  /// @brief Parse workload names (read, write, randread, randwrite, rw, randrw), @p defaults if none were given.
+  std::vector<Workload> parseWorkloads(const std::vector<std::string> &defaults) const {
+    std::vector<Workload> workloads;
+    for (const auto &name : workloadNames.empty() ? defaults : workloadNames)
+      workloads.push_back(IOStats::parseWorkload(name, readPercent));
+
+    if (doNotReadTest)
+      workloads.erase(std::remove_if(workloads.begin(), workloads.end(), [](const Workload &w) { return w.readPercent > 0; }),
+                      workloads.end());
+    if (workloads.empty()) throw Error("No workload left to run.");
+    return workloads;
+  }
+
+  static std::string formatSize(uint64_t size) {
+    if (size % MB(1) == 0) return fmt::format("{}MB", size / MB(1));
+    if (size % KB(1) == 0) return fmt::format("{}KB", size / KB(1));
+    return fmt::format("{}B", size);
+  }
+
+  /// @brief Describe I/O mode of test file flags (like "direct reads, synchronous writes").
+  static std::string describeMode(const int readFlags, const int writeFlags) {
+    const auto kind = [](const int flags) -> std::string {
+      return flags & O_DIRECT ? "direct" : flags & O_SYNC ? "synchronous" : "buffered";
+    };
+    if (kind(readFlags) == kind(writeFlags)) return kind(readFlags);
+    return fmt::format("{} reads, {} writes", kind(readFlags), kind(writeFlags));
+  }
+
+  /// @brief Print result of a benchmark.
+  static void printResult(const Result &result) {
+    const Spec &spec = result.spec;
+    Log::println("{}: {} blocks, {} job(s), depth {}, {}, {}, {:.2f}s", spec.workload.name, formatSize(spec.blockSize), spec.jobs,
+                 spec.useRing ? spec.depth : 1, spec.useRing ? "io_uring" : "psync", spec.mode, result.seconds);
+
+    for (const auto &[name, stats] : {std::make_pair("read", &result.read), std::make_pair("write", &result.write)}) {
+      if (stats->calls == 0) continue;
+      const PartitionMap::IOSummary summary = IOStats::summarize(*stats, result.seconds);
+      Log::println("  {:<5} {:.1f} MiB/s, {:.0f} IOPS, latency avg {} p50 {} p90 {} p99 {} p99.9 {} max {}{}", name,
+                   summary.bandwidth / (1024.0 * 1024.0), summary.iops, IOStats::formatLatency(summary.meanNs),
+                   IOStats::formatLatency(summary.p50Ns), IOStats::formatLatency(summary.p90Ns), IOStats::formatLatency(summary.p99Ns),
+                   IOStats::formatLatency(summary.p999Ns), IOStats::formatLatency(summary.maxNs),
+                   stats->short_ops > 0 ? fmt::format(", {} short", stats->short_ops) : "");
+    }
+  }
+
+  /// @brief Print fastest block size and job count of every workload in a sweep.
+  static void printBest(const std::vector<Result> &results) {
+    std::vector<const Result *> best;
+    const auto throughput = [](const Result *r) { return static_cast<double>(r->read.bytes + r->write.bytes) / r->seconds; };
+    for (const auto &result : results) {
+      const auto sameWorkload = [&result](const Result *r) { return r->spec.workload.name == result.spec.workload.name; };
+      auto it = std::find_if(best.begin(), best.end(), sameWorkload);
+      if (it == best.end()) best.push_back(&result);
+      else if (throughput(&result) > throughput(*it)) *it = &result;
+    }
+
+    if (results.size() <= best.size()) return; // Nothing was swept.
+    for (const Result *result : best)
+      Log::println("Best {}: {} blocks, {} job(s), {:.1f} MiB/s", result->spec.workload.name, formatSize(result->spec.blockSize),
+                   result->spec.jobs, throughput(result) / (1024.0 * 1024.0));
+  }
+
+  static rapidjson::Value directionToJson(const openpart_io_stats_t &stats, double seconds,
+                                          rapidjson::Document::AllocatorType &allocator) {
+    const PartitionMap::IOSummary summary = IOStats::summarize(stats, seconds);
+    rapidjson::Value object(rapidjson::kObjectType), latency(rapidjson::kObjectType);
+    object.AddMember("bytes", stats.bytes, allocator);
+    object.AddMember("ios", stats.calls, allocator);
+    object.AddMember("shortOps", stats.short_ops, allocator);
+    object.AddMember("errors", stats.errors, allocator);
+    object.AddMember("bandwidth", summary.bandwidth, allocator);
+    object.AddMember("iops", summary.iops, allocator);
+    latency.AddMember("mean", summary.meanNs, allocator);
+    latency.AddMember("p50", summary.p50Ns, allocator);
+    latency.AddMember("p90", summary.p90Ns, allocator);
+    latency.AddMember("p99", summary.p99Ns, allocator);
+    latency.AddMember("p99.9", summary.p999Ns, allocator);
+    latency.AddMember("max", summary.maxNs, allocator);
+    object.AddMember("latencyNs", latency, allocator);
+    return object;
+  }
+
+  /// @brief Write results to JSON file.
+  void writeJson(const std::string &target, const std::vector<Result> &results) const {
+    rapidjson::Document d;
+    d.SetObject();
+    auto &allocator = d.GetAllocator();
+    rapidjson::Value vTarget, list(rapidjson::kArrayType);
+    vTarget.SetString(target.c_str(), target.length(), allocator);
+    d.AddMember("target", vTarget, allocator);
+
+    for (const auto &result : results) {
+      const Spec &spec = result.spec;
+      rapidjson::Value object(rapidjson::kObjectType), vName, vMode;
+      vName.SetString(spec.workload.name.c_str(), spec.workload.name.length(), allocator);
+      vMode.SetString(spec.mode.c_str(), spec.mode.length(), allocator);
+      object.AddMember("workload", vName, allocator);
+      object.AddMember("random", spec.workload.random, allocator);
+      object.AddMember("readPercent", spec.workload.readPercent, allocator);
+      object.AddMember("size", spec.size, allocator);
+      object.AddMember("blockSize", spec.blockSize, allocator);
+      object.AddMember("jobs", spec.jobs, allocator);
+      object.AddMember("depth", spec.useRing ? spec.depth : 1, allocator);
+      object.AddMember("engine", rapidjson::StringRef(spec.useRing ? "io_uring" : "psync"), allocator);
+      object.AddMember("mode", vMode, allocator);
+      object.AddMember("seconds", result.seconds, allocator);
+      object.AddMember("read", directionToJson(result.read, result.seconds, allocator), allocator);
+      object.AddMember("write", directionToJson(result.write, result.seconds, allocator), allocator);
+      list.PushBack(object, allocator);
+    }
+    d.AddMember("results", list, allocator);
+
+    rapidjson::StringBuffer buffer;
+    rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+    d.Accept(writer);
+    Helper::UniqueFP fp(jsonFile, "w");
+    if (!fp || fp.printf("{}\n", buffer.GetString()) < 0) throw Error("Cannot write results to {}: {}", jsonFile, strerror(errno));
+  }
+
+  /**
+   * @brief Run one job of a benchmark.
+   *
+   * Sequential jobs work on their own slice of the region, random jobs on the whole region. Each job does its share of
+   * the region size, or runs until @p deadline for time based benchmarks.
+   *
+   * @param spec Benchmark parameters.
+   * @param index Index of job.
+   * @param result Result of benchmark, statistics are added to it.
+   * @param deadline End of time based benchmarks.
+   * @return AsyncResult_t Result of the asynchronous operation.
+   */
+  PLUGIN_SECTION AsyncResult_t runJob(const Spec &spec, unsigned index, Result &result, Clock::time_point deadline) const {
+    Helper::Trace::Span span("job", "{} job #{}", spec.workload.name, index);
+    try {
+      const std::unique_ptr<Target> target = spec.open();
+      const uint64_t blocks = spec.size / spec.blockSize, sliceBlocks = blocks / spec.jobs, firstBlock = sliceBlocks * index;
+      const bool timeBased = spec.runtime.count() > 0;
+      std::mt19937_64 random(std::random_device{}() + index);
+      uint64_t issued = 0;
+
+      // Pick direction and offset of next request, false if the job is done.
+      const auto next = [&](bool &write, uint64_t &offset) {
+        if (timeBased ? Clock::now() >= deadline : issued >= sliceBlocks) return false;
+        write = random() % 100 >= spec.workload.readPercent;
+        offset = (spec.workload.random ? random() % blocks : firstBlock + issued % sliceBlocks) * spec.blockSize;
+        issued++;
+        return true;
+      };
+      const auto record = [&result, &spec](bool write, ssize_t ret, Clock::time_point start) {
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+        openpart_stats_add(write ? &result.write : &result.read, spec.blockSize, ret, static_cast<uint64_t>(ns));
+      };
+
+      std::vector<AlignedBuffer> buffers;
+      for (unsigned i = 0; i < (spec.useRing ? spec.depth : 1); i++) {
+        buffers.push_back(alignedBuffer(spec.blockSize));
+        fillRandom(buffers.back().get(), spec.blockSize, random);
+      }
+
+      if (!spec.useRing) {
+        bool write;
+        uint64_t offset;
+        while (next(write, offset)) {
+          const auto start = Clock::now();
+          const ssize_t ret = write ? target->writeAt(buffers[0].get(), spec.blockSize, offset)
+                                    : target->readAt(buffers[0].get(), spec.blockSize, offset);
+          record(write, ret, start);
+          if (ret < 0) return AsyncResult_t::Error("{} at {} failed: {}", write ? "Write" : "Read", offset, strerror(errno));
+        }
+        return AsyncResult_t::Success();
+      }
+
+#ifdef HAVE_IO_URING
+      struct Slot {
+        iovec iov;
+        bool write;
+        Clock::time_point start;
+      };
+
+      Ring ring(spec.depth);
+      std::vector<Slot> slots(spec.depth);
+      std::string failure;
+      unsigned inflight = 0;
+
+      const auto issue = [&](uint64_t i) {
+        Slot &slot = slots[i];
+        uint64_t offset;
+        if (!failure.empty() || !next(slot.write, offset)) return false;
+        slot.iov = {buffers[i].get(), spec.blockSize};
+        slot.start = Clock::now();
+        ring.push(slot.write, target->fd(slot.write), &slot.iov, offset, i);
+        inflight++;
+        return true;
+      };
+
+      for (uint64_t i = 0; i < slots.size() && issue(i); i++) {
+      }
+      while (inflight > 0) {
+        ring.submitAndWait();
+        ring.reap([&](uint64_t i, int res) {
+          const Slot &slot = slots[i];
+          errno = res < 0 ? -res : 0;
+          record(slot.write, res < 0 ? -1 : res, slot.start);
+          if (res < 0 && failure.empty()) failure = fmt::format("{} failed: {}", slot.write ? "Write" : "Read", strerror(-res));
+          inflight--;
+          issue(i);
+        });
+      }
+      if (!failure.empty()) return AsyncResult_t::Error(failure);
+#endif
+      return AsyncResult_t::Success();
+    } catch (const Error &err) {
+      return AsyncResult_t::Error(err.what());
+    }
+  }
+
+  /// @brief Run a benchmark with parallel jobs.
+  Result runBenchmark(const Spec &spec) const {
+    Result result{spec};
+    Helper::AsyncManager<AsyncResult_t> manager;
+    manager.print = false;
+
+    const auto start = Clock::now();
+    for (unsigned i = 0; i < spec.jobs; i++)
+      manager.addProcess(&MemoryTestPlugin::runJob, this, std::cref(spec), i, std::ref(result), start + spec.runtime);
+    manager.startAll();
+    for (const auto &job : manager.getResults())
+      if (job.isError()) throw Error("{} test failed: {}", spec.workload.name, job.getMessage());
+
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return result;
+  }
+
+  /// @brief Write test file once with buffered I/O, so reads don't hit holes.
+  static void layOut(const std::string &path, uint64_t size) {
+    Log::info("Laying out test file ({} bytes).", size);
+    auto fd = Helper::UniqueFD(path, O_WRONLY);
+    if (!fd) throw Error("Can't open test file: {}", strerror(errno));
+
+    std::mt19937_64 random(std::random_device{}());
+    const AlignedBuffer buffer = alignedBuffer(MB(4));
+    fillRandom(buffer.get(), MB(4), random);
+    for (uint64_t offset = 0; offset < size; offset += MB(4)) {
+      const size_t count = std::min<uint64_t>(MB(4), size - offset);
+      if (pwrite(fd.fd(), buffer.get(), count, static_cast<off_t>(offset)) != static_cast<ssize_t>(count))
+        throw Error("Can't write to test file: {}", strerror(errno));
+    }
+    if (fdatasync(fd.fd()) != 0) throw Error("Can't sync test file: {}", strerror(errno));
+  }
+
+  /// @brief Drop cached pages of test file, so reads of a workload aren't served from cache written by previous one.
+  static void dropCache(const std::string &path) {
+    auto fd = Helper::UniqueFD(path, O_RDWR);
+    if (!fd) return;
+    fdatasync(fd.fd());
+    posix_fadvise(fd.fd(), 0, 0, POSIX_FADV_DONTNEED);
+  }
+
+  /// @brief Flush writes of partition and drop its cached pages (openpart uses buffered I/O).
+  static void dropCache(const PartitionMap::Partition_t &partition) {
+    const int fd = openpart_get_fd(partition.openPart(OP_RDONLY));
+    if (fd == -1) return;
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  }
+
+  /// @brief Check whether partition is mounted. Logical partitions accessed through super have no mapped device to mount.
+  static bool isMounted(const PartitionMap::Partition_t &partition) {
+    const std::string path = partition.absolutePath().string();
+    if (!Helper::fileIsExists(path)) return false;
+
+    openpart_t *op = openpart_open(path.c_str(), OP_RDONLY, 0);
+    if (!op) throw Error("Cannot open {}: {}", path, strerror(errno));
+    const int mounted = openpart_is_mounted(op);
+    openpart_close(&op);
+    if (mounted < 0) throw Error("Cannot check whether {} is mounted.", path);
+    return mounted == 1;
+  }
+
+  /// @brief Copy first @p size bytes of partition to @p backup, or back to partition if @p restore is true.
+  static void copyRegion(const PartitionMap::Partition_t &partition, const std::string &backup, uint64_t size, bool restore) {
+    auto fd = restore ? Helper::UniqueFD(backup, O_RDONLY) : Helper::UniqueFD(backup, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (!fd) throw Error("Can't open backup file {}: {}", backup, strerror(errno));
+
+    const AlignedBuffer buffer = alignedBuffer(MB(4));
+    for (uint64_t offset = 0; offset < size; offset += MB(4)) {
+      const size_t count = std::min<uint64_t>(MB(4), size - offset);
+      const auto expected = static_cast<ssize_t>(count);
+      const ssize_t received = restore ? pread(fd.fd(), buffer.get(), count, static_cast<off_t>(offset))
+                                       : partition.readAt(buffer.get(), count, offset);
+      if (received != expected)
+        throw Error("Can't read {} at {}: {}", restore ? backup : partition.nameRef(), offset, strerror(errno));
+
+      const ssize_t written = restore ? partition.writeAt(buffer.get(), count, offset)
+                                      : pwrite(fd.fd(), buffer.get(), count, static_cast<off_t>(offset));
+      if (written != expected)
+        throw Error("Can't write {} at {}: {}", restore ? partition.nameRef() : backup, offset, strerror(errno));
+    }
+
+    if (restore ? openpart_sync(partition.openPart(OP_RDWR)) != 0 : fdatasync(fd.fd()) != 0)
+      throw Error("Can't sync {}: {}", restore ? partition.nameRef() : backup, strerror(errno));
+  }
+
+  /// @brief Compare first @p size bytes of partition with @p backup.
+  static bool regionMatches(const PartitionMap::Partition_t &partition, const std::string &backup, uint64_t size) {
+    auto fd = Helper::UniqueFD(backup, O_RDONLY);
+    if (!fd) throw Error("Can't open backup file {}: {}", backup, strerror(errno));
+
+    const AlignedBuffer expected = alignedBuffer(MB(4)), actual = alignedBuffer(MB(4));
+    for (uint64_t offset = 0; offset < size; offset += MB(4)) {
+      const size_t count = std::min<uint64_t>(MB(4), size - offset);
+      if (pread(fd.fd(), expected.get(), count, static_cast<off_t>(offset)) != static_cast<ssize_t>(count) ||
+          partition.readAt(actual.get(), count, offset) != static_cast<ssize_t>(count))
+        throw Error("Can't read data at {} for verifying: {}", offset, strerror(errno));
+      if (memcmp(expected.get(), actual.get(), count) != 0) return false;
+    }
+    return true;
+  }
+
+  /// @brief Restore scratch partition from backup and verify it. The backup is kept if anything fails.
+  static bool restoreRegion(const PartitionMap::Partition_t &partition, const std::string &backup, uint64_t size) {
+    try {
+      Log::info("Restoring first {} bytes of {} from {}.", size, partition.nameRef(), backup);
+      copyRegion(partition, backup, size, true);
+      dropCache(partition);
+      if (!regionMatches(partition, backup, size)) throw Error("restored data doesn't match the backup");
+    } catch (const Error &err) {
+      Log::error("Cannot restore {}: {}. Backup is kept in {}.", partition.nameRef(), err.what(), backup);
+      return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::remove(backup, ec);
+    Log::info("Partition {} is restored.", partition.nameRef());
+    return true;
+  }
+
+  /// @brief Parse block sizes of the sweep (like 64KB).
+  std::vector<uint64_t> sweptBlockSizes() const {
+    if (blockSizeOption->isUsed()) return {blockSize};
+
+    std::vector<uint64_t> sizes;
+    for (const auto &value : sweepBlockSizes) {
+      try {
+        sizes.push_back(std::stoull(Helper::CMDLine::Transformers::AsSizeValue(false)(value)));
+      } catch (const std::exception &) {
+        throw Error("Invalid block size in --sweep-block-sizes: {}", value);
+      }
+    }
+    return sizes;
+  }
+
+  /// @brief Get job counts of the sweep.
+  std::vector<unsigned> sweptJobCounts() const {
+    if (jobsOption->isUsed()) return {jobCount};
+
+    std::vector<unsigned> counts;
+    for (const int count : sweepJobs) {
+      if (count < 1) throw Error("Job counts in --sweep-jobs must be at least 1.");
+      counts.push_back(static_cast<unsigned>(count));
+    }
+    return counts;
+  }
+
+  /**
+   * @brief Benchmark a partition through openpart.
+   *
+   * Every workload is run with every combination of the swept block sizes and job counts on the first --file-size bytes
+   * of the partition. Workloads with writes need --scratch: the tested region is backed up to the test directory before
+   * and restored (and verified) after the benchmarks, even if a benchmark fails.
+   *
+   * @return true if the operation succeeded.
+   */
+  PLUGIN_SECTION bool runOnPartition() {
+    std::optional<PartitionMap::TableType> tType;
+    auto *table = getCorrectTableObj(partitionName, Flags.partitionTables.first.get(), Flags.partitionTables.second.get(), tType);
+    const PartitionMap::Partition_t *partition = setupPartition(partitionName, table);
+    if (!partition) throw Error("Couldn't find partition: {}", partitionName);
+    if (partition->size() == 0) throw Error("Partition {} is empty", partitionName);
+
+    if (engine == "io_uring")
+      throw Error("io_uring engine cannot be used with --partition, partitions are accessed through openpart.");
+    if (ioDepth > 1) Log::warning("Partitions are accessed with one request in flight per job, --iodepth is ignored.");
+    if (direct || buffered)
+      Log::warning("Partitions are accessed with buffered I/O through openpart, --direct and --buffered are ignored.");
+
+    const std::vector<Workload> workloads = parseWorkloads({"read", "randread"});
+    const bool writes = std::any_of(workloads.begin(), workloads.end(), [](const Workload &w) { return w.readPercent < 100; });
+    if (writes && !scratch)
+      throw Error("Workloads with writes overwrite data of {}. Use --scratch if it's a partition you can lose for a while "
+                  "(tested region is backed up and restored).",
+                  partitionName);
+    if (!writes && scratch) Log::warning("There is no workload with writes, --scratch is ignored.");
+
+    const std::vector<uint64_t> blockSizes = sweptBlockSizes();
+    const std::vector<unsigned> jobCounts = sweptJobCounts();
+    if (blockSizes.empty() || jobCounts.empty()) throw Error("Nothing to sweep, block size and job count lists are empty.");
+    for (const uint64_t size : blockSizes)
+      if (size < MIN_BLOCK_SIZE || size > MAX_BLOCK_SIZE || size % MIN_BLOCK_SIZE != 0)
+        throw Error("Block sizes must be multiples of {} between {} and {}.", formatSize(MIN_BLOCK_SIZE), formatSize(MIN_BLOCK_SIZE),
+                    formatSize(MAX_BLOCK_SIZE));
+
+    const uint64_t region = std::min<uint64_t>(partition->size(), testFileSize) / MIN_BLOCK_SIZE * MIN_BLOCK_SIZE;
+    Log::info("Starting benchmark on first {} bytes of partition {}.", region, partitionName);
+
+    std::string backup;
+    if (writes) {
+      if (isMounted(*partition)) throw Error("Partition {} is mounted, it cannot be used as a scratch partition.", partitionName);
+      partition->openPart(OP_RDWR); // Fail before the backup if the partition cannot be opened for writing.
+
+      backup = Helper::pathJoin(testPath, partitionName + ".memtest-backup.img");
+      Log::info("Backing up first {} bytes of {} to {}.", region, partitionName, backup);
+      try {
+        copyRegion(*partition, backup, region, false);
+      } catch (const Error &) {
+        std::error_code ec;
+        std::filesystem::remove(backup, ec);
+        throw;
+      }
+    }
+
+    std::vector<Result> results;
+    bool restored = true;
+    {
+      auto restore = Helper::makeScopeGuard([&] {
+        if (writes) restored = restoreRegion(*partition, backup, region);
+      });
+
+      for (const uint64_t size : blockSizes) {
+        for (const unsigned jobs : jobCounts) {
+          const uint64_t tested = region / (size * jobs) * (size * jobs);
+          if (tested == 0) {
+            Log::warning("Skipping {} blocks with {} job(s), partition is smaller than block size * job count.", formatSize(size),
+                         jobs);
+            continue;
+          }
+
+          for (const auto &workload : workloads) {
+            dropCache(*partition);
+            Log::info("{} test started ({} blocks, {} job(s))!", workload.name, formatSize(size), jobs);
+            const Spec spec{workload, tested, size, jobs, 1, false, "buffered, through openpart", std::chrono::seconds(runtime),
+                            [partition] { return std::make_unique<PartitionTarget>(*partition); }};
+            Result result = runBenchmark(spec);
+
+            // Writes are buffered by openpart, so the flush at the end is part of the benchmark (like end_fsync of fio).
+            if (workload.readPercent < 100) {
+              const auto start = Clock::now();
+              if (openpart_sync(partition->openPart(OP_RDWR)) != 0) throw Error("Can't sync {}: {}", partitionName, strerror(errno));
+              result.seconds += std::chrono::duration<double>(Clock::now() - start).count();
+            }
+
+            results.push_back(std::move(result));
+            printResult(results.back());
+          }
+        }
+      }
+    }
+    if (!restored) throw Error("Partition {} couldn't be restored, flash {} back to it.", partitionName, backup);
+
+    printBest(results);
+    if (!jsonFile.empty()) writeJson(partitionName, results);
+    return true;
+  }
 
 public:
   Helper::CMDLine::Subcommand *cmd = nullptr;
@@ -66,7 +757,8 @@ public:
    */
   PLUGIN_SECTION bool onLoad(Helper::CMDLine::App &mainApp, BasicFlags &mainFlags) override {
     Log::info("{}::onLoad() trigger. Initializing...", PLUGIN);
-    cmd = mainApp.addSubcommand("memtest", "Test your write/read speed of device.");
+    cmd = mainApp.addSubcommand("memtest", "Test your write/read speed of device.")
+              ->footer("Workloads: read, write (sequential), randread, randwrite (random), rw, randrw (mixed, see --rwmix-read).");
     flags = &mainFlags;
     cmd->addOption("testDirectory", testPath, "Path to test directory")
         ->defaultValue("/data/local/tmp")
@@ -80,10 +772,30 @@ public:
 
           return std::string();
         });
-    cmd->addOption("-s,--file-size", testFileSize, "File size of test file")
+    cmd->addOption("-s,--file-size", testFileSize, "File size of test file (size of tested region with --partition)")
         ->transform(Helper::CMDLine::Transformers::AsSizeValue(false))
         ->defaultValue("1GB");
-    cmd->addFlag("--no-read-test", doNotReadTest, "Don't read test data from disk")->defaultValue(false);
+    cmd->addOption("--rw", workloadNames, "Workload(s) to run in order (default: write read)");
+    blockSizeOption = cmd->addOption("-b,--block-size", blockSize, "Size of each read/write request")
+                          ->transform(Helper::CMDLine::Transformers::AsSizeValue(false))
+                          ->defaultValue("4MB");
+    jobsOption = cmd->addOption("-j,--jobs", jobCount, "Count of parallel jobs")->defaultValue(1);
+    cmd->addOption("--iodepth", ioDepth, "Requests in flight per job (needs io_uring)")->defaultValue(1);
+    cmd->addOption("--rwmix-read", readPercent, "Percentage of reads in mixed workloads")->defaultValue(50);
+    cmd->addOption("--engine", engine, "I/O engine (auto: io_uring if --iodepth is more than 1)")
+        ->defaultValue("auto")
+        ->check(Helper::CMDLine::Checkers::IsMember({"auto", "io_uring", "psync"}));
+    cmd->addFlag("--direct", direct, "Use direct I/O for reads and writes (default: direct reads, synchronous writes)");
+    cmd->addFlag("--buffered", buffered, "Use buffered I/O for reads and writes");
+    cmd->addOption("-t,--runtime", runtime, "Run each workload for the given seconds instead of until file size is transferred")
+        ->defaultValue(0);
+    cmd->addOption("-o,--json", jsonFile, "Write results to the input file as JSON");
+    cmd->addFlag("--no-read-test", doNotReadTest, "Skip workloads with reads")->defaultValue(false);
+    cmd->addOption("--partition", partitionName, "Benchmark the input partition through openpart (default workloads: read randread)");
+    cmd->addOption("--sweep-block-sizes", sweepBlockSizes, "Block sizes to sweep with --partition (unless --block-size is used)")
+        ->defaultValue("64KB,512KB,4MB");
+    cmd->addOption("--sweep-jobs", sweepJobs, "Job counts to sweep with --partition (unless --jobs is used)")->defaultValue("1,2,4");
+    cmd->addFlag("--scratch", scratch, "Allow workloads with writes on --partition (tested region is backed up and restored)");
     cmd->addFlag("-v,--version", nullptr, "View version of plugin.")
         ->superior()
         ->callback(Helper::CMDLine::Callbacks::ViewPluginVersion(PLUGIN, PLUGIN_VERSION));
@@ -109,85 +821,76 @@ public:
    */
   PLUGIN_SECTION bool used() override { return cmd->isUsed(); }
 
+  /**
+   * @brief Check if the plugin needs GPT data.
+   *
+   * @return true if a partition is benchmarked.
+   */
+  PLUGIN_SECTION bool needsGptData() override { return !partitionName.empty(); }
+
   /**
    * @brief Run the memory test operation.
    *
    * @return true if the operation succeeded.
    */
   PLUGIN_SECTION bool run() override {
+    if (direct && buffered) throw Error("--direct and --buffered cannot be used together.");
+    if (jobCount == 0 || ioDepth == 0) throw Error("Job count and queue depth must be at least 1.");
+    if (readPercent > 100) throw Error("--rwmix-read must be between 0 and 100.");
+    if (!partitionName.empty()) return runOnPartition();
+
     if (testFileSize > GB(2) && !Flags.forceProcess)
       throw Error("File size is more than 2GB! Sizes over 2GB may not give accurate "
                   "results in the write test. Use -f (--force) for skip this error.");
+    if (blockSize < MIN_BLOCK_SIZE || blockSize > MAX_BLOCK_SIZE)
+      throw Error("Block size must be between {} and {}.", formatSize(MIN_BLOCK_SIZE), formatSize(MAX_BLOCK_SIZE));
+    if (!buffered && blockSize % DIRECT_ALIGNMENT != 0)
+      throw Error("Block size must be a multiple of {} for direct I/O. Use --buffered for smaller blocks.",
+                  formatSize(DIRECT_ALIGNMENT));
+
+    const std::vector<Workload> workloads = parseWorkloads({"write", "read"});
+    const uint64_t size = testFileSize / (blockSize * jobCount) * (blockSize * jobCount);
+    if (size == 0) throw Error("File size must be at least block size * job count ({} bytes).", blockSize * jobCount);
+
+    bool useRing = false;
+    if (engine == "io_uring" || (engine == "auto" && ioDepth > 1)) {
+      useRing = ringAvailable();
+      if (!useRing && engine == "io_uring") throw Error("io_uring is not available on this device.");
+      if (!useRing) Log::warning("io_uring is not available, using pread()/pwrite() with one request in flight.");
+    } else if (ioDepth > 1) {
+      Log::warning("psync engine has one request in flight, --iodepth is ignored.");
+    }
 
     Log::info("Starting memory test on {}.", testPath.string());
     const std::string test = Helper::pathJoin(testPath, "test.bin");
-
-    Log::info("Generating random data for testing");
-    auto buffer = std::make_unique<char[]>(bufferSize);
-
-    for (size_t i = 0; i < bufferSize; i++)
-      buffer[i] = static_cast<char>(Helper::Random<1024>::getNumber());
-
     auto guard = Helper::makeScopeGuard([test] { std::filesystem::remove(test); });
+    if (!Helper::UniqueFD(test, O_WRONLY | O_CREAT | O_TRUNC, 0644)) throw Error("Can't open/create test file: {}", strerror(errno));
 
-    auto wfd = Helper::UniqueFD(test, O_WRONLY | O_CREAT | O_TRUNC | O_SYNC, 0644);
-    if (!wfd) throw Error("Can't open/create test file: {}", strerror(errno));
-
-    Log::info("Sequential write test started!");
-    const auto startWrite = std::chrono::high_resolution_clock::now();
-    ssize_t bytesWritten = 0;
-    while (bytesWritten < testFileSize) {
-      const ssize_t ret = wfd.write(buffer.get(), bufferSize);
-      if (ret < 0) throw Error("Can't write to test file: {}", strerror(errno));
-      bytesWritten += ret;
-    }
-
-    const auto endWrite = std::chrono::high_resolution_clock::now();
-
-    const double writeTime = std::chrono::duration<double>(endWrite - startWrite).count();
-    Log::println("Sequential write speed: {:3.0f} MB/s", (static_cast<double>(testFileSize) / (1024.0 * 1024.0)) / writeTime);
-    Log::info("Sequential write test done!");
-    wfd.close();
-
-    if (!doNotReadTest) {
-      auto rawBuffer = std::make_unique<char[]>(bufferSize + 4096);
-      auto *bufferRead = reinterpret_cast<char *>((reinterpret_cast<uintptr_t>(rawBuffer.get()) + 4096 - 1) & ~(4096 - 1));
-      auto rfd = Helper::UniqueFD(test, O_RDONLY | O_DIRECT);
-      if (rfd < 0) throw Error("Can't open test file: {}", strerror(errno));
-
-      Log::info("Sequential read test started!");
-      const auto startRead = std::chrono::high_resolution_clock::now();
-      size_t total = 0;
-      ssize_t bytesRead;
-
-      while (true) {
-        bytesRead = rfd.read(bufferRead, bufferSize);
-
-        if (bytesRead > 0)
-          total += bytesRead;
-        else if (bytesRead == 0)
-          break;
-        else {
-          if (errno == EINVAL) {
-            int flags_ = rfd.fcntl(F_GETFL);
-            if (flags_ != -1) {
-              rfd.fcntl(F_SETFL, flags_ & ~O_DIRECT);
-
-              bytesRead = rfd.read(bufferRead, bufferSize);
-              if (bytesRead > 0) total += bytesRead;
-            }
-          } else
-            throw Error("Read error during test: {}", strerror(errno));
-          break;
-        }
-      }
-
-      const auto endRead = std::chrono::high_resolution_clock::now();
-      const double read_time = std::chrono::duration<double>(endRead - startRead).count();
-      Log::println("Sequential read speed: {:3.0f} MB/s", (static_cast<double>(total) / (1024.0 * 1024.0)) / read_time);
-      Log::info("Sequential read test done!");
+    int readFlags = buffered ? 0 : O_DIRECT, writeFlags = direct ? O_DIRECT : buffered ? 0 : O_SYNC;
+    if (!buffered && !Helper::UniqueFD(test, O_RDONLY | O_DIRECT) && errno == EINVAL) {
+      Log::warning("Direct I/O is not supported in {}, using buffered I/O.", testPath.string());
+      readFlags = 0;
+      writeFlags &= ~O_DIRECT;
+    }
+    const std::string mode = describeMode(readFlags, writeFlags);
+
+    std::vector<Result> results;
+    bool laidOut = false;
+    for (const auto &workload : workloads) {
+      const bool fills = !workload.random && workload.readPercent == 0 && runtime == 0; // Sequential writes fill the file.
+      if (!laidOut && !fills) layOut(test, size);
+      dropCache(test);
+
+      Log::info("{} test started!", workload.name);
+      const Spec spec{workload, size, blockSize, jobCount, ioDepth, useRing, mode, std::chrono::seconds(runtime),
+                      [test, readFlags, writeFlags] { return std::make_unique<FileTarget>(test, readFlags, writeFlags); }};
+      results.push_back(runBenchmark(spec));
+      printResult(results.back());
+      Log::info("{} test done!", workload.name);
+      laidOut = true;
     }
 
+    if (!jsonFile.empty()) writeJson(testPath.string(), results);
     return true;
   }
 
@@ -89,6 +89,16 @@ public:
    */
   PLUGIN_SECTION bool used() override { return cmd->isUsed(); }
 
+  /**
+   * @brief Check if the plugin needs GPT data.
+   *
+   * @return false, only names, sizes and paths of partitions are used.
+   */
+  PLUGIN_SECTION bool needsGptData() override { return false; }
+
+  /// @brief Only resolves paths of partitions.
+  PLUGIN_SECTION bool writesPartitions() override { return false; }
+
   /**
    * @brief Run the real path display operation.
    *
@@ -86,6 +86,16 @@ public:
    */
   PLUGIN_SECTION bool used() override { return cmd->isUsed(); }
 
+  /**
+   * @brief Check if the plugin needs GPT data.
+   *
+   * @return false, partition tables are not used.
+   */
+  PLUGIN_SECTION bool needsGptData() override { return false; }
+
+  /// @brief Doesn't access partitions.
+  PLUGIN_SECTION bool writesPartitions() override { return false; }
+
   /**
    * @brief Run the reboot operation.
    *
@@ -0,0 +1,476 @@
+/*
+ * Copyright (C) 2026 Yağız Zengin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file SnapshotPlugin.cpp
+ * @author Yağız Zengin ([YZBruh](https://github.com/YZBruh))
+ * @brief Implementation of the SnapshotPlugin for whole-device snapshots.
+ *
+ * This file implements the SnapshotPlugin class which stores GPT tables, super
+ * metadata and all partitions of the device into one indexed archive, and
+ * restores or extracts single entries from it.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <fcntl.h>
+#include <thread>
+#include <unistd.h>
+#include <PartitionManager/PartitionManager.hpp>
+#include <PartitionManager/Plugin.hpp>
+#include <liblp/metadata_format.h>
+
+#define PLUGIN "SnapshotPlugin"
+#define PLUGIN_VERSION "1.0"
+
+namespace PartitionManager {
+
+/**
+ * @brief Plugin for whole-device snapshot archives.
+ *
+ * Archives contain GPT backup of every table, the metadata region of super and
+ * content of every partition. Partitions are read by concurrent workers and
+ * written by one ordered writer; any entry can be restored through the index.
+ */
+class SnapshotPlugin final : public BasicPlugin {
+public:
+  Helper::CMDLine::Subcommand *mainCmd = nullptr, *createCmd = nullptr, *listCmd = nullptr, *extractCmd = nullptr,
+                              *restoreCmd = nullptr;
+  BasicFlags *flags = nullptr;
+
+private:
+  std::string archive, outputDirectory;
+  std::vector<std::string> excludes, entryNames;
+  uint64_t chunkSize = 0;
+  unsigned int threadCount = 0;
+
+  static constexpr uint64_t MIN_CHUNK_SIZE = 64 * 1024;          ///< 64KB minimum chunk size
+  static constexpr uint64_t MAX_CHUNK_SIZE = 64ULL * 1024 * 1024; ///< 64MB maximum chunk size
+
+  /// @brief Get entry name for messages (like gpt:sda, lp-metadata or boot_a).
+  static std::string entryName(const PartitionMap::SnapshotEntry &entry) {
+    switch (entry.type) {
+      case PartitionMap::SnapshotEntry::GPT:
+        return "gpt:" + entry.name;
+      case PartitionMap::SnapshotEntry::LP_METADATA:
+        return "lp-metadata";
+      default:
+        return entry.name;
+    }
+  }
+
+  /// @brief Find entry by its name (see entryName()). Partitions can be given as table/name.
+  static const PartitionMap::SnapshotEntry *findEntry(const PartitionMap::SnapshotReader &reader, const std::string &name) {
+    if (name.rfind("gpt:", 0) == 0) return reader.find(PartitionMap::SnapshotEntry::GPT, name.substr(4));
+    if (name == "lp-metadata") return reader.find(PartitionMap::SnapshotEntry::LP_METADATA, "super");
+    if (const auto slash = name.find('/'); slash != std::string::npos)
+      return reader.find(PartitionMap::SnapshotEntry::PARTITION, name.substr(slash + 1), name.substr(0, slash));
+    return reader.find(PartitionMap::SnapshotEntry::PARTITION, name);
+  }
+
+  /// @brief Store a small in-memory entry.
+  void storeBuffer(PartitionMap::SnapshotWriter &writer, PartitionMap::SnapshotEntry::Type type, const std::string &name,
+                   const std::vector<char> &data) const {
+    const uint32_t id = writer.addEntry(type, name, "", data.size());
+    for (uint64_t offset = 0; offset < data.size(); offset += writer.chunkSize()) {
+      const uint64_t size = std::min<uint64_t>(writer.chunkSize(), data.size() - offset);
+      writer.write(id, offset, std::vector<char>(data.begin() + offset, data.begin() + offset + size));
+    }
+  }
+
+  /// @brief Store GPT backups of all tables (gptfdisk backup format, same as gpt backup-table).
+  void storeTables(PartitionMap::SnapshotWriter &writer) const {
+    auto *pTab = GET_PARTITION_TABLE_DATA_PTR();
+    std::vector<std::string> tables(pTab->tableNames().begin(), pTab->tableNames().end());
+    std::sort(tables.begin(), tables.end());
+
+    const std::string temporary = archive + ".gpt.tmp";
+    for (const auto &table : tables) {
+      Helper::Silencer silencer;
+      const bool saved = pTab->GPTDataOf(table)->SaveGPTBackup(temporary);
+      silencer.stop();
+      if (!saved) throw Error("Cannot backup GPT of {}.", table);
+
+      std::ifstream file(temporary, std::ios::binary);
+      const std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+      std::filesystem::remove(temporary);
+      storeBuffer(writer, PartitionMap::SnapshotEntry::GPT, table, data);
+      Log::info("Stored GPT of {} ({} bytes).", table, data.size());
+    }
+  }
+
+  /// @brief Store metadata region of super (reserved area, geometry and all metadata slots with backups).
+  void storeLpMetadata(PartitionMap::SnapshotWriter &writer) const {
+    const auto *dTab = GET_DYNAMIC_TABLE_DATA_PTR();
+    const auto super = Tables.partition("super");
+    if (!dTab || !dTab->isSupported() || !super) return;
+
+    const auto &geometry = dTab->getMetadata().geometry;
+    const uint64_t slots = static_cast<uint64_t>(geometry.metadata_max_size) * geometry.metadata_slot_count;
+    const uint64_t size = LP_PARTITION_RESERVED_BYTES + (LP_METADATA_GEOMETRY_SIZE + slots) * 2;
+
+    std::vector<char> data(size);
+    if (super->get().readAt(data.data(), data.size(), 0) != static_cast<ssize_t>(data.size()))
+      throw Error("Cannot read metadata region of super: {}", strerror(errno));
+    storeBuffer(writer, PartitionMap::SnapshotEntry::LP_METADATA, "super", data);
+    Log::info("Stored super metadata region ({} bytes).", size);
+  }
+
+  /**
+   * @brief Store partitions. Each worker takes the next partition and reads it chunk by chunk.
+   *
+   * @param writer Archive writer.
+   * @param targets Partitions.
+   * @param next Index of next partition, shared by workers.
+   * @param progress Optional total progress.
+   * @return AsyncResult_t Result of the asynchronous operation.
+   */
+  PLUGIN_SECTION AsyncResult_t storeAsync(PartitionMap::SnapshotWriter &writer,
+                                          const std::vector<const PartitionMap::Partition_t *> &targets, std::atomic<size_t> &next,
+                                          PartitionMap::Progress_t *progress) const {
+    for (size_t i = next.fetch_add(1); i < targets.size(); i = next.fetch_add(1)) {
+      const PartitionMap::Partition_t &partition = *targets[i];
+      Helper::Trace::Span span("job", "store {}", partition.nameRef());
+      try {
+        const uint64_t size = partition.size();
+        const uint32_t id = writer.addEntry(PartitionMap::SnapshotEntry::PARTITION, partition.name(), partition.tableName(), size);
+
+        for (uint64_t offset = 0; offset < size; offset += writer.chunkSize()) {
+          std::vector<char> data(std::min<uint64_t>(writer.chunkSize(), size - offset));
+          if (partition.readAt(data.data(), data.size(), offset) != static_cast<ssize_t>(data.size()))
+            throw Error("Cannot read {}: {}", partition.path().string(), strerror(errno));
+
+          if (progress) progress->done.fetch_add(data.size(), std::memory_order_relaxed);
+          writer.write(id, offset, std::move(data));
+        }
+      } catch (Error &err) {
+        next.store(targets.size()); // Stop other workers.
+        if (progress) progress->failed.store(true, std::memory_order_relaxed);
+        return AsyncResult_t::Error("Failed to store {} to snapshot: {}", partition.name(), err.what());
+      }
+    }
+
+    return AsyncResult_t::Success();
+  }
+
+  /**
+   * @brief Create snapshot archive of the device.
+   *
+   * @return true if successful.
+   */
+  bool create() {
+    if (Helper::fileIsExists(archive) && !Flags.forceProcess)
+      throw Error("File {} already exists. Remove it, or use --force (-f) flag.", archive);
+
+    std::vector<const PartitionMap::Partition_t *> targets;
+    uint64_t totalSize = 0;
+    Tables.forEach([&](const PartitionMap::Partition_t &partition) {
+      if (std::find(excludes.begin(), excludes.end(), partition.name()) != excludes.end()) {
+        Log::info("Excluding {} from snapshot.", partition.name());
+      } else if (partition.size() != 0) {
+        targets.push_back(&partition);
+        totalSize += partition.size();
+      }
+      return true;
+    });
+
+    const unsigned int workers = std::max(1u, threadCount == 0 ? std::thread::hardware_concurrency() : threadCount);
+    PartitionMap::SnapshotWriter writer(archive, static_cast<uint32_t>(chunkSize), workers * 2);
+
+    try {
+      storeTables(writer);
+      storeLpMetadata(writer);
+
+      Helper::AsyncManager<AsyncResult_t> manager;
+      manager.print = false;
+      std::unique_ptr<PartitionMap::ProgressRenderer> renderer;
+      std::shared_ptr<PartitionMap::Progress_t> progress;
+      if (Flags.showProgress()) {
+        renderer = std::make_unique<PartitionMap::ProgressRenderer>(Flags.quietProcess);
+        progress = renderer->add("snapshot", totalSize);
+      }
+
+      std::atomic<size_t> next{0};
+      for (unsigned int i = 0; i < std::min<size_t>(workers, targets.size()); i++)
+        manager.addProcess(&SnapshotPlugin::storeAsync, this, std::ref(writer), std::cref(targets), std::ref(next), progress.get());
+      Log::info("Created {} worker(s) for storing {} partition(s).", std::min<size_t>(workers, targets.size()), targets.size());
+
+      if (renderer) renderer->start();
+      manager.startAll();
+      manager.getResults();
+      if (progress) progress->finished.store(true, std::memory_order_relaxed);
+      if (renderer) renderer->stop();
+      manager.finalize();
+
+      const auto entries = writer.finish();
+      uint64_t stored = 0;
+      for (const auto &entry : entries)
+        stored += entry.storedSize;
+      Log::println("Snapshot saved to {} ({} entries, {} of {} bytes stored)", archive, entries.size(), stored, totalSize);
+    } catch (Error &) {
+      std::filesystem::remove(archive);
+      throw;
+    }
+
+    return true;
+  }
+
+  /**
+   * @brief List entries of snapshot archive.
+   *
+   * @return true if successful.
+   */
+  bool list() const {
+    const PartitionMap::SnapshotReader reader(archive);
+    for (const auto &entry : reader.entries()) {
+      Log::println("name={} table={} size={} stored_size={} chunks={}", entryName(entry), entry.table, entry.size, entry.storedSize,
+                   entry.chunkCount);
+    }
+
+    return true;
+  }
+
+  /**
+   * @brief Extract an entry to a file.
+   *
+   * @param reader Archive reader.
+   * @param entry Entry.
+   * @param renderer Optional progress renderer for displaying progress.
+   * @return AsyncResult_t Result of the asynchronous operation.
+   */
+  PLUGIN_SECTION AsyncResult_t extractAsync(const PartitionMap::SnapshotReader &reader, const PartitionMap::SnapshotEntry &entry,
+                                            PartitionMap::ProgressRenderer *renderer) const {
+    Helper::Trace::Span span("job", "extract {}", entry.name);
+    std::string output = entry.type == PartitionMap::SnapshotEntry::GPT           ? entry.name + ".gpt"
+                         : entry.type == PartitionMap::SnapshotEntry::LP_METADATA ? "super_metadata.img"
+                                                                                  : entry.name + ".img";
+    if (!outputDirectory.empty()) output.insert(0, outputDirectory + '/');
+    if (Helper::fileIsExists(output) && !Flags.forceProcess)
+      return AsyncResult_t::Error("File {} already exists. Remove it, or use --force (-f) flag.", output);
+
+    std::shared_ptr<PartitionMap::Progress_t> progress;
+    if (renderer) progress = renderer->add(entryName(entry), entry.size);
+
+    try {
+      auto fd = Helper::UniqueFD(output, O_WRONLY | O_CREAT | O_TRUNC, DEFAULT_FILE_PERMS);
+      if (!fd) throw Error("Cannot create {}: {}", output, strerror(errno));
+      reader.extract(entry, fd.fd(), false, [&progress](uint64_t done, uint64_t) {
+        if (progress) progress->done.store(done, std::memory_order_relaxed);
+      });
+    } catch (Error &err) {
+      if (progress) progress->failed.store(true, std::memory_order_relaxed);
+      return AsyncResult_t::Error("Failed to extract {}: {}", entryName(entry), err.what());
+    }
+
+    if (progress) progress->finished.store(true, std::memory_order_relaxed);
+    return AsyncResult_t::Success("{} successfully extracted to {}", entryName(entry), output);
+  }
+
+  /**
+   * @brief Restore a partition or super metadata from archive.
+   *
+   * @param reader Archive reader.
+   * @param entry Entry.
+   * @param renderer Optional progress renderer for displaying progress.
+   * @return AsyncResult_t Result of the asynchronous operation.
+   */
+  PLUGIN_SECTION AsyncResult_t restoreAsync(const PartitionMap::SnapshotReader &reader, const PartitionMap::SnapshotEntry &entry,
+                                            PartitionMap::ProgressRenderer *renderer) const {
+    Helper::Trace::Span span("job", "restore {}", entry.name);
+    const bool metadata = entry.type == PartitionMap::SnapshotEntry::LP_METADATA;
+    const auto partition = Tables.partition(metadata ? "super" : entry.name, metadata ? "" : entry.table);
+    if (!partition) return AsyncResult_t::Error("Couldn't find partition for {} on this device.", entryName(entry));
+    if (partition->get().size() < entry.size)
+      return AsyncResult_t::Error("Partition {} is smaller than {} ({} < {})", partition->get().name(), entryName(entry),
+                                  partition->get().size(), entry.size);
+
+    std::shared_ptr<PartitionMap::Progress_t> progress;
+    if (renderer) progress = renderer->add(entryName(entry), entry.size);
+
+    // Written through writeAt(), so unmapped logical partitions are restored through super.
+    const PartitionMap::Partition_t &target = partition->get();
+    try {
+      const auto write = [&target](const void *buffer, size_t size, uint64_t offset) {
+        if (target.writeAt(buffer, size, offset) != static_cast<ssize_t>(size))
+          throw Error("Cannot write {} at {}: {}", target.name(), offset, strerror(errno));
+      };
+      reader.extract(entry, write, true, [&progress](uint64_t done, uint64_t) {
+        if (progress) progress->done.store(done, std::memory_order_relaxed);
+      });
+      if (openpart_sync(target.openPart(OP_RDWR)) != 0) throw Error("Cannot sync {}: {}", target.name(), strerror(errno));
+    } catch (Error &err) {
+      if (progress) progress->failed.store(true, std::memory_order_relaxed);
+      return AsyncResult_t::Error("Failed to restore {}: {}", entryName(entry), err.what());
+    }
+
+    if (progress) progress->finished.store(true, std::memory_order_relaxed);
+    return AsyncResult_t::Success("{} successfully restored to {}", entryName(entry), target.name());
+  }
+
+  /// @brief Restore GPT of a table from archive (same as gpt restore-table).
+  void restoreTable(const PartitionMap::SnapshotReader &reader, const PartitionMap::SnapshotEntry &entry) const {
+    auto *pTab = GET_PARTITION_TABLE_DATA_PTR();
+    if (!pTab->hasTable(entry.name)) throw Error("Couldn't find table on this device: {}", entry.name);
+
+    const std::string temporary = archive + ".gpt.tmp";
+    {
+      const auto data = reader.read(entry);
+      std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+      file.write(data.data(), static_cast<std::streamsize>(data.size()));
+      if (!file) throw Error("Cannot write {}", temporary);
+    }
+
+    Helper::Silencer silencer;
+    const bool restored = pTab->GPTDataOf(entry.name)->LoadGPTBackup(temporary) && pTab->sync(entry.name);
+    silencer.stop();
+    std::filesystem::remove(temporary);
+    if (!restored) throw Error("Failed to restore GPT of {}.", entry.name);
+    Log::println("GPT of {} successfully restored", entry.name);
+  }
+
+  /**
+   * @brief Extract or restore selected entries.
+   *
+   * @param restore Restore to device instead of extracting to files.
+   * @return true if all entries processed.
+   */
+  bool extractOrRestore(bool restore) {
+    const PartitionMap::SnapshotReader reader(archive);
+
+    std::vector<const PartitionMap::SnapshotEntry *> entries;
+    if (entryNames.empty()) {
+      if (restore) throw Error("Entries to restore must be given explicitly.");
+      for (const auto &entry : reader.entries())
+        entries.push_back(&entry);
+    }
+    for (const auto &name : entryNames) {
+      const auto *entry = findEntry(reader, name);
+      if (!entry) throw Error("Couldn't find entry in {}: {}", archive, name);
+      entries.push_back(entry);
+    }
+
+    if (restore && !Flags.forceProcess) {
+      if (!Helper::confirmPrompt("Are you sure you want to continue? Partitions will be overwritten. Do not continue if you "
+                                 "do not know what you are doing!"))
+        throw Error("Operation canceled by user.");
+    }
+
+    Helper::AsyncManager<AsyncResult_t> manager;
+    manager.print = false;
+    std::unique_ptr<PartitionMap::ProgressRenderer> renderer;
+    if (Flags.showProgress()) renderer = std::make_unique<PartitionMap::ProgressRenderer>(Flags.quietProcess);
+
+    for (const auto *entry : entries) {
+      if (restore && entry->type == PartitionMap::SnapshotEntry::GPT)
+        restoreTable(reader, *entry); // Tables are restored before partitions.
+      else if (restore)
+        manager.addProcess(&SnapshotPlugin::restoreAsync, this, std::cref(reader), std::cref(*entry), renderer.get());
+      else
+        manager.addProcess(&SnapshotPlugin::extractAsync, this, std::cref(reader), std::cref(*entry), renderer.get());
+    }
+
+    PLUGIN_END_WITH_RENDERER(renderer, manager);
+  }
+
+public:
+  /// @brief Default constructor.
+  PLUGIN_SECTION SnapshotPlugin() = default;
+  /// @brief Default destructor.
+  PLUGIN_SECTION ~SnapshotPlugin() override = default;
+
+  /**
+   * @brief Load the plugin and register its subcommands.
+   *
+   * @param mainApp The main application instance.
+   * @param mainFlags The global flags structure.
+   * @return true if the plugin loaded successfully.
+   */
+  PLUGIN_SECTION bool onLoad(Helper::CMDLine::App &mainApp, BasicFlags &mainFlags) override {
+    flags = &mainFlags;
+    Log::info("{}::onLoad() trigger. Initializing...", PLUGIN);
+    mainCmd = mainApp.addSubcommand("snapshot", "Whole-device snapshot archives.")->requiresSubcommand();
+
+    createCmd = mainCmd->addSubcommand("create", "Store GPT of all tables, super metadata and all partitions into one archive.");
+    createCmd->addOption("archive", archive, "Output archive")->required();
+    createCmd->addOption("-x,--exclude", excludes, "Partition name(s) to exclude (like userdata)");
+    createCmd->addOption("--chunk-size", chunkSize, "Size of archive chunks (read by each worker at once)")
+        ->transform(Helper::CMDLine::Transformers::AsSizeValue(false))
+        ->defaultValue("4MB")
+        ->check(Helper::CMDLine::Checkers::BufferSizeCheck(MIN_CHUNK_SIZE, MAX_CHUNK_SIZE));
+    createCmd->addOption("-j,--threads", threadCount, "Worker count for reading partitions (0 for CPU count)")->defaultValue(0);
+
+    listCmd = mainCmd->addSubcommand("list", "List entries of snapshot archive.");
+    listCmd->addOption("archive", archive, "Snapshot archive")->required();
+
+    extractCmd = mainCmd->addSubcommand("extract", "Extract entries of snapshot archive to files.")
+                     ->footer("Entries are partition names (or table/name), gpt:<table> and lp-metadata. All entries are extracted if "
+                              "no entry is given.");
+    extractCmd->addOption("archive", archive, "Snapshot archive")->required();
+    extractCmd->addOption("entries", entryNames, "Entry name(s)");
+    extractCmd->addOption("-O,--output-directory", outputDirectory, "Directory to save the extracted file(s)")
+        ->check(Helper::CMDLine::Checkers::ExistingDirectory());
+
+    restoreCmd = mainCmd->addSubcommand("restore", "Restore entries of snapshot archive to the device.")
+                     ->footer("Entries are partition names (or table/name), gpt:<table> and lp-metadata.");
+    restoreCmd->addOption("archive", archive, "Snapshot archive")->required();
+    restoreCmd->addOption("entries", entryNames, "Entry name(s)")->required();
+
+    mainCmd->addFlag("-v,--version", nullptr, "View version of plugin.")
+        ->superior()
+        ->callback(Helper::CMDLine::Callbacks::ViewPluginVersion(PLUGIN, PLUGIN_VERSION));
+    return true;
+  }
+
+  /// @brief Unload the plugin and clean up resources.
+  PLUGIN_SECTION bool onUnload() override {
+    Log::info("{}::onUnload() trigger. Bye!", PLUGIN);
+    mainCmd = nullptr;
+    return true;
+  }
+
+  /// @brief Check if the plugin's subcommand was used.
+  PLUGIN_SECTION bool used() override { return mainCmd->isUsed(); }
+
+  /// @brief GPT data is only needed for storing and restoring tables.
+  PLUGIN_SECTION bool needsGptData() override { return createCmd->isUsed() || restoreCmd->isUsed(); }
+
+  /// @brief Only restoring writes to partitions.
+  PLUGIN_SECTION bool writesPartitions() override { return restoreCmd->isUsed(); }
+
+  /**
+   * @brief Run the snapshot operation.
+   *
+   * @return true if the operation succeeded.
+   */
+  PLUGIN_SECTION bool run() override {
+    if (createCmd->isUsed()) return create();
+    if (listCmd->isUsed()) return list();
+    if (extractCmd->isUsed()) return extractOrRestore(false);
+    if (restoreCmd->isUsed()) return extractOrRestore(true);
+    return false;
+  }
+
+  /// @brief Get the plugin name.
+  PLUGIN_SECTION std::string getName() override { return PLUGIN; }
+
+  /// @brief Get the plugin version.
+  PLUGIN_SECTION std::string getVersion() override { return PLUGIN_VERSION; }
+};
+
+} // namespace PartitionManager
+
+REGISTER_PLUGIN(PartitionManager, SnapshotPlugin)
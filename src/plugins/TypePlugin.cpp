@@ -25,12 +25,15 @@
  * filesystems and Android-specific images.
  */
 
-#include <map>
+#include <algorithm>
+#include <atomic>
+#include <optional>
+#include <thread>
 #include <PartitionManager/PartitionManager.hpp>
 #include <PartitionManager/Plugin.hpp>
 
 #define PLUGIN "TypePlugin"
-#define PLUGIN_VERSION "1.2"
+#define PLUGIN_VERSION "1.4"
 
 namespace PartitionManager {
 
@@ -42,8 +45,9 @@ namespace PartitionManager {
  */
 class TypePlugin final : public BasicPlugin {
   std::vector<std::string> contents;
-  bool onlyCheckAndroidMagics = false, onlyCheckFileSystemMagics = false;
-  uint64_t bufferSize = 0;
+  bool onlyCheckAndroidMagics = false, onlyCheckFileSystemMagics = false, deep = false;
+  uint64_t bufferSize = 0, chunkSize = 0;
+  unsigned int threadCount = 0;
 
 public:
   Helper::CMDLine::Subcommand *cmd = nullptr;
@@ -66,9 +70,16 @@ public:
     cmd = mainApp.addSubcommand("type", "Get type of the partition(s) or image(s).");
     flags = &mainFlags;
     cmd->addOption("content(s)", contents, "Content(s)")->required();
+    cmd->footer("Use get-all as content name for detecting types of all partitions in parallel.");
     cmd->addOption("-b,--buffer-size", bufferSize, "Buffer size for max seek depth")
         ->transform(Helper::CMDLine::Transformers::AsSizeValue(false))
         ->defaultValue("4KB");
+    cmd->addFlag("--deep", deep, "Scan whole content for embedded structures and print every match with its offset.")
+        ->defaultValue(false);
+    cmd->addOption("--chunk-size", chunkSize, "Chunk size for --deep (read by each worker at once)")
+        ->transform(Helper::CMDLine::Transformers::AsSizeValue(false))
+        ->defaultValue("4MB");
+    cmd->addOption("-j,--threads", threadCount, "Worker count for --deep (0 for CPU count, at most CPU count)")->defaultValue(0);
     cmd->addFlag("--only-check-android-magics", onlyCheckAndroidMagics, "Only check Android magic values.")->defaultValue(false);
     cmd->addFlag("--only-check-filesystem-magics", onlyCheckFileSystemMagics, "Only check filesystem magic values.")
         ->defaultValue(false);
@@ -97,19 +108,32 @@ public:
    */
   PLUGIN_SECTION bool used() override { return cmd->isUsed(); }
 
+  /**
+   * @brief Check if the plugin needs GPT data.
+   *
+   * @return false, only names, sizes and paths of partitions are used.
+   */
+  PLUGIN_SECTION bool needsGptData() override { return false; }
+
+  /// @brief Only reads magic numbers of partitions.
+  PLUGIN_SECTION bool writesPartitions() override { return false; }
+
   /**
    * @brief Run the type detection operation.
    *
    * @return true if the operation succeeded.
    */
   PLUGIN_SECTION bool run() override {
-    std::map<uint64_t, std::string> magics;
+    int classes = PartitionMap::Extra::ALL_MAGICS;
     if (onlyCheckAndroidMagics)
-      magics.merge(PartitionMap::Extra::AndroidMagics);
+      classes = PartitionMap::Extra::ANDROID_MAGICS;
     else if (onlyCheckFileSystemMagics)
-      magics.merge(PartitionMap::Extra::FileSystemMagics);
-    else
-      magics.merge(PartitionMap::Extra::Magics);
+      classes = PartitionMap::Extra::FILESYSTEM_MAGICS;
+
+    if (contents.back() == "get-all") {
+      if (deep) throw Error("--deep cannot be used with get-all");
+      return runForAll(classes);
+    }
 
     for (const auto &content : contents) {
       std::optional<PartitionMap::TableType> tType;
@@ -118,17 +142,75 @@ public:
 
       if ((!tType && !partition) && !Helper::fileIsExists(content)) throw Error("Couldn't find partition or image file: {}", content);
 
-      bool found = false;
-      for (const auto &[magic, name] : magics) {
-        if (PartitionMap::Extra::hasMagic(magic, static_cast<ssize_t>(bufferSize),
-                                          Helper::fileIsExists(content) ? content : partition->absolutePath().c_str())) {
-          Log::println("{} contains {} magic ({})", content, name, PartitionMap::Extra::formatMagic(magic));
-          found = true;
-          break;
-        }
+      const std::string path = Helper::fileIsExists(content) ? content : partition->absolutePath().string();
+      if (deep) {
+        runDeep(content, path);
+        continue;
       }
 
-      if (!found) throw Error("Couldn't determine type of {}", content) << (content == "userdata" ? " (encrypted filesystem?)" : "");
+      const auto match = PartitionMap::Extra::detectMagic(path, bufferSize, classes);
+      if (!match) throw Error("Couldn't determine type of {}", content) << (content == "userdata" ? " (encrypted filesystem?)" : "");
+
+      Log::println("{} contains {} magic ({})", content, match->signature->name,
+                   PartitionMap::Extra::formatMagic(match->signature->magic));
+    }
+
+    return true;
+  }
+
+  /**
+   * @brief Scan whole content for embedded structures.
+   *
+   * @param content Name of partition or image.
+   * @param path Path of partition or image.
+   */
+  PLUGIN_SECTION void runDeep(const std::string &content, const std::string &path) const {
+    const auto matches = PartitionMap::Extra::deepScan(path, chunkSize, threadCount);
+    if (matches.empty()) {
+      Log::println("{} does not contain any known structure", content);
+      return;
+    }
+
+    for (const auto &match : matches)
+      Log::println("{} contains {} at offset {} ({:#x})", content, match.signature->name, match.offset, match.offset);
+  }
+
+  /**
+   * @brief Detect types of all partitions concurrently.
+   *
+   * @param classes Magic classes to match.
+   * @return true if the operation succeeded.
+   */
+  PLUGIN_SECTION bool runForAll(int classes) const {
+    std::vector<std::pair<std::string, std::string>> targets; // Name and path.
+    auto collector = [&targets] FOREACH_PARTITIONS_LAMBDA_PARAMETERS_CONST -> bool {
+      targets.emplace_back(partition.name(), partition.absolutePath().string());
+      return true;
+    };
+
+    GET_PARTITION_TABLE_DATA_PTR()->forEach(collector);
+    GET_DYNAMIC_TABLE_DATA_PTR()->forEach(collector);
+
+    // Workers share the list, a thread per partition would start dozens of them.
+    std::vector<std::optional<PartitionMap::Extra::MagicMatch>> results(targets.size());
+    std::atomic<size_t> next{0};
+    const size_t workers = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, std::max<size_t>(targets.size(), 1));
+    Helper::AsyncManager<bool> manager;
+    for (size_t i = 0; i < workers; ++i)
+      manager.addProcess([&] {
+        for (size_t index = next.fetch_add(1); index < targets.size(); index = next.fetch_add(1))
+          results[index] = PartitionMap::Extra::detectMagic(targets[index].second, bufferSize, classes);
+        return true;
+      });
+
+    manager.startAll();
+    manager.getResults();
+    for (size_t i = 0; i < targets.size(); ++i) {
+      if (results[i])
+        Log::println("{} contains {} magic ({})", targets[i].first, results[i]->signature->name,
+                     PartitionMap::Extra::formatMagic(results[i]->signature->magic));
+      else
+        Log::println("{} type is unknown", targets[i].first);
     }
 
     return true;
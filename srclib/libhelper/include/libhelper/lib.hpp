@@ -32,5 +32,6 @@
 #include <libhelper/capsule.hpp>
 #include <libhelper/functions.hpp>
 #include <libhelper/random.hpp>
+#include <libhelper/trace.hpp>
 
 #endif // #ifndef LIBHELPER_LIB_HPP
@@ -74,6 +74,9 @@
     Helper::Logger(level, __func__, file, name, __FILE__, __LINE__)
 /** @} */
 
+#include <ctime>
+#include <functional>
+#include <tuple>
 #include <sstream>
 #include <string>
 #include <fstream>
@@ -90,14 +93,27 @@ namespace std {
  * @return Quoted input string.
  */
 template <typename _T> std::string quoted_string(_T &&s) {
-  std::ostringstream oss;
-  if constexpr (std::is_same_v<std::decay_t<_T>, std::filesystem::path> || std::is_same_v<std::decay_t<_T>, std::string>)
-    oss << std::quoted(s.c_str());
-  else if constexpr (std::is_same_v<std::decay_t<_T>, std::string_view>)
-    oss << std::quoted(s.data());
-  else
+  if constexpr (std::is_same_v<std::decay_t<_T>, std::filesystem::path> || std::is_same_v<std::decay_t<_T>, std::string> ||
+                std::is_same_v<std::decay_t<_T>, std::string_view>) {
+    std::string_view view;
+    if constexpr (std::is_same_v<std::decay_t<_T>, std::filesystem::path>)
+      view = s.native();
+    else
+      view = s;
+    std::string quoted;
+    quoted.reserve(view.size() + 2);
+    quoted += '"';
+    for (const char c : view) {
+      if (c == '"' || c == '\\') quoted += '\\';
+      quoted += c;
+    }
+    quoted += '"';
+    return quoted;
+  } else {
+    std::ostringstream oss;
     oss << s;
-  return oss.str();
+    return oss.str();
+  }
 }
 
 } // namespace std
@@ -112,6 +128,68 @@ enum LogLevels {
   ABORT = static_cast<int>('A')
 };
 
+/// @brief Get severity of a logging level (INFO < WARNING < ERROR < ABORT).
+constexpr int severityOf(LogLevels level) {
+  switch (level) {
+    case LogLevels::INFO:
+      return 0;
+    case LogLevels::WARNING:
+      return 1;
+    case LogLevels::ERROR:
+      return 2;
+    default:
+      return 3;
+  }
+}
+
+#ifdef STRIP_INFO_LOGS
+inline constexpr bool INFO_LOGS_ENABLED = false; ///< INFO logs are removed at compile time (STRIP_INFO_LOGS build option).
+#else
+inline constexpr bool INFO_LOGS_ENABLED = true; ///< INFO logs are removed at compile time (STRIP_INFO_LOGS build option).
+#endif
+
+/**
+ * @brief Background writer of log lines.
+ *
+ * Lines are pushed to a lock-free ring buffer and written by one thread to log files that are kept open, so logging doesn't
+ * open or stat the log file for each line. Lines are written in push order and never interleave with each other.
+ * Pending lines are flushed on exit.
+ */
+class LogSink {
+public:
+  static constexpr size_t CAPACITY = 4096; ///< Capacity of ring buffer (lines). Producers wait while it's full.
+
+  /**
+   * @brief Queue a line to be written to a log file. Thread-safe.
+   * @param file Log file.
+   * @param line Complete log line.
+   */
+  static void push(const std::string &file, std::string line);
+
+  /**
+   * @brief Queue a deferred log record. It's formatted by the writer thread when it's written. Thread-safe.
+   * @note If a signal handler can't get them written by the writer thread, unwritten deferred records are counted instead.
+   * @param file Log file.
+   * @param record Returns complete log line.
+   */
+  static void push(const std::string &file, std::function<std::string()> record);
+
+  /// @brief Wait until all queued lines are written.
+  static void flush();
+
+  /**
+   * @brief Flush queued lines from a signal handler. Only async-signal-safe calls are used.
+   *
+   * Waits (up to a second) for the writer thread to format and write queued lines in order; signals are blocked in the
+   * writer thread, so it keeps running. If it doesn't respond, formatted lines are written from the calling thread and
+   * deferred records are counted in a note line.
+   */
+  static void flushFromSignal() noexcept;
+
+  /// @brief Flush and stop writer thread. Lines pushed later are written directly. Called automatically on exit.
+  static void shutdown();
+};
+
 /**
  * @brief Modern, functional logger class.
  * @note It is recommended to use ready-made macros to benefit from this class.
@@ -123,11 +201,6 @@ class Logger {
   std::string function, logFile, file;
   int line;
 
-  std::string stripQuotes(const std::string &s) {
-    if (s.size() >= 2 && s.front() == '"' && s.back() == '"') return s.substr(1, s.size() - 2);
-    return s;
-  }
-
 public:
   /**
    * @brief Transfers the contents of the old log file to the new one.
@@ -157,14 +230,25 @@ public:
   public:
     inline static std::string FILE = "last_logs.log";
     inline static bool PRINT_TO_STDOUT = false, DISABLE = false;
+    inline static LogLevels MIN_LEVEL = LogLevels::INFO;
     inline static int tries = 0;
 
+    /**
+     * @brief Checks whether logs of the level are written. Checked before any formatting.
+     * @param level Logging level.
+     */
+    static bool enabled(LogLevels level) {
+      if (level == LogLevels::INFO && !INFO_LOGS_ENABLED) return false;
+      return !DISABLE && severityOf(level) >= severityOf(MIN_LEVEL);
+    }
+
     /**
      * @brief Change log file.
      * @param file New log file.
      * @param remove Will the old log file be deleted?
      */
     static void setFile(const std::string &file, bool remove = false) {
+      LogSink::flush(); // Old log file must be complete before moving.
       moveOldLogs(FILE, file, remove);
       FILE = file;
     }
@@ -181,66 +265,48 @@ public:
      */
     static void setLogging(bool state) { DISABLE = !state; }
 
+    /**
+     * @brief Set minimum level of written logs.
+     * @param level Logging level.
+     */
+    static void setLevel(LogLevels level) { MIN_LEVEL = level; }
+
     /// @brief Reset logging properties to defaults.
     static void reset() {
       FILE = "last_logs.log";
       PRINT_TO_STDOUT = false;
       DISABLE = false;
+      MIN_LEVEL = LogLevels::INFO;
       tries = 0;
     }
   };
 
-  /// @brief The log text is finalized, and if necessary, write operations to a file or to @c stdout are performed.
-  ~Logger() {
-    if (Properties::DISABLE) return;
-
-    const time_t t = time(nullptr);
-    const tm *date = localtime(&t);
-    const std::string min = std::to_string(date ? date->tm_min : 0);
-    std::ostringstream __oss;
-    __oss << "<" << static_cast<char>(level) << "> [ "
-          << "<on " << stripQuotes(file) << ":" << line << "> " << date->tm_mday << "/" << date->tm_mon + 1 << "/"
-          << date->tm_year + 1900 << " " << date->tm_hour << ":" << (min.length() == 1 ? "0" + min : min) << ":" << date->tm_sec
-          << "] " << function << "(): " << oss.str();
-    std::string logLine = __oss.str();
-
-    if (!std::filesystem::exists(logFile)) {
-      if (Properties::tries >= 3) return;
-
-      if (std::ofstream tempFile(logFile, std::ios::out); !tempFile) {
-        fprintf(stderr, "[Logger] Cannot create log file %s: %s\n", logFile.c_str(), strerror(errno));
-
-        Properties::setFile("last_logs.log");
-        logFile = "last_logs.log";
-
-        fprintf(stderr, "[Logger] Falling back to: %s\n", logFile.c_str());
-      }
-    }
+  /**
+   * @brief Build a complete log line.
+   *
+   * @param level Logging level.
+   * @param function Function name.
+   * @param file Source file.
+   * @param line Source line.
+   * @param time Time of log.
+   * @param message Log message.
+   */
+  static std::string formatLine(LogLevels level, std::string_view function, std::string_view file, int line, time_t time,
+                                std::string_view message) {
+    tm date{};
+    localtime_r(&time, &date);
+    if (file.size() >= 2 && file.front() == '"' && file.back() == '"') file = file.substr(1, file.size() - 2);
+    return fmt::format("<{}> [ <on {}:{}> {}/{}/{} {}:{:02}:{}] {}(): {}", static_cast<char>(level), file, line, date.tm_mday,
+                       date.tm_mon + 1, date.tm_year + 1900, date.tm_hour, date.tm_min, date.tm_sec, function, message);
+  }
 
-    if (std::fstream fileStream(logFile, std::ios::app | std::ios::in | std::ios::out); fileStream) {
-      if (std::filesystem::file_size(logFile) == 0)
-        fileStream << std::string(46, '-') << std::endl
-                   << " LOGGING BEGIN! LOGGING BEGIN! LOGGING BEGIN!" << std::endl
-                   << std::string(46, '-') << std::endl;
-      fileStream << logLine;
-    } else {
-      if (Properties::tries >= 3) return;
-
-      fprintf(stderr, "[Logger] Cannot write to log file %s: %s\n", logFile.c_str(), strerror(errno));
-
-      Properties::setFile("last_logs.log");
-      logFile = "last_logs.log";
-
-      fprintf(stderr, "[Logger] Logging file redirected to: %s\n", logFile.c_str());
-      if (std::fstream fallbackStream(logFile, std::ios::app | std::ios::out); fallbackStream)
-        fallbackStream << logLine;
-      else {
-        fprintf(stderr, "[Logger] Fallback file %s also failed!\n", logFile.c_str());
-        ++Properties::tries;
-      }
-    }
+  /// @brief The log text is finalized and queued to @c Helper::LogSink, and if necessary, written to @c stdout.
+  ~Logger() {
+    if (!Properties::enabled(level)) return;
 
+    std::string logLine = formatLine(level, function, file, line, time(nullptr), oss.str());
     if (Properties::PRINT_TO_STDOUT) fprintf(stdout, "%s", logLine.c_str());
+    LogSink::push(logFile, std::move(logLine));
   }
 
   Logger() = delete;
@@ -302,6 +368,7 @@ inline std::string parseFunctionName(const std::string &full) {
 }
 
 /// @brief Custom format struct for logger.
+/// @note Format must be a string literal, it's referenced by deferred log records until they're written.
 struct log_fmt {
   std::string_view fmt;
   Helper::SourceLocation loc;
@@ -321,65 +388,84 @@ template <typename... Args> inline void println(const fmt::format_string<Args...
   fprintf(stdout, "%s\n", message.c_str());
 }
 
-/// @brief Logs an @c INFO level message.
-template <typename... Args> inline void info(const log_fmt &fmt, Args &&...args) {
+/// @brief Argument type stored in deferred log records. Pointers to characters are copied as strings, they may not live until
+/// the record is written.
+template <typename T>
+using log_arg_t = std::conditional_t<std::is_same_v<std::decay_t<T>, char *> || std::is_same_v<std::decay_t<T>, const char *> ||
+                                         std::is_same_v<std::decay_t<T>, std::string_view>,
+                                     std::string, std::decay_t<T>>;
+
+/// @brief Prints format problem of a log message and exits.
+[[noreturn]] inline void formatFailure(const log_fmt &fmt, const fmt::format_error &err) {
+  Log::println("Failed to format string: {}", err.what());
+  Log::println("This string format problem occurred on {}:{}():L{}", fmt.loc.file_name, parseFunctionName(fmt.loc.function),
+               fmt.loc.line);
+  exit(EINVAL);
+}
+
+/**
+ * @brief Logs a message.
+ *
+ * Nothing is formatted if the level is disabled. Otherwise, @c INFO arguments are copied to a record which is formatted by
+ * the writer thread of @c Helper::LogSink. Warnings and errors are formatted immediately, so they're written by signal
+ * handlers too; so are messages printed to @c stdout.
+ */
+template <typename... Args> inline void write(Helper::LogLevels level, const log_fmt &fmt, Args &&...args) {
+  if (!Helper::Logger::Properties::enabled(level)) return;
+  const time_t now = time(nullptr);
+
+  if constexpr ((std::is_copy_constructible_v<log_arg_t<Args>> && ...)) {
+    if (!Helper::Logger::Properties::PRINT_TO_STDOUT && Helper::severityOf(level) < Helper::severityOf(Helper::LogLevels::WARNING)) {
+      Helper::LogSink::push(Helper::Logger::Properties::FILE,
+                            [level, fmt, now, stored = std::make_tuple(log_arg_t<Args>(std::forward<Args>(args))...)]() mutable {
+                              std::string message;
+                              try {
+                                message = std::apply(
+                                    [&fmt](auto &...values) {
+                                      return fmt::vformat(fmt.fmt, fmt::make_format_args(values...));
+                                    },
+                                    stored);
+                              } catch (fmt::format_error &err) {
+                                message = fmt::format("Failed to format string: {}", err.what());
+                              }
+                              return Helper::Logger::formatLine(level, parseFunctionName(fmt.loc.function), fmt.loc.file_name,
+                                                                fmt.loc.line, now, message + '\n');
+                            });
+      return;
+    }
+  }
+
   std::string message;
   try {
     message = fmt::vformat(fmt.fmt, fmt::make_format_args(args...));
   } catch (fmt::format_error &err) {
-    Log::println("Failed to format string: {}", err.what());
-    Log::println("This string format problem occurred on {}:{}():L{}", fmt.loc.file_name, parseFunctionName(fmt.loc.function),
-                 fmt.loc.line);
-    exit(EINVAL);
+    formatFailure(fmt, err);
   }
-  Helper::Logger(INFO, parseFunctionName(fmt.loc.function), Helper::Logger::Properties::FILE.c_str(), fmt.loc.file_name, fmt.loc.line)
-      << message << std::endl;
+
+  std::string logLine =
+      Helper::Logger::formatLine(level, parseFunctionName(fmt.loc.function), fmt.loc.file_name, fmt.loc.line, now, message + '\n');
+  if (Helper::Logger::Properties::PRINT_TO_STDOUT) fprintf(stdout, "%s", logLine.c_str());
+  Helper::LogSink::push(Helper::Logger::Properties::FILE, std::move(logLine));
+}
+
+/// @brief Logs an @c INFO level message. Removed at compile time with @c STRIP_INFO_LOGS build option.
+template <typename... Args> inline void info(const log_fmt &fmt, Args &&...args) {
+  if constexpr (Helper::INFO_LOGS_ENABLED) Log::write(Helper::LogLevels::INFO, fmt, std::forward<Args>(args)...);
 }
 
 /// @brief Logs a @c WARNING level message.
 template <typename... Args> inline void warning(const log_fmt &fmt, Args &&...args) {
-  std::string message;
-  try {
-    message = fmt::vformat(fmt.fmt, fmt::make_format_args(args...));
-  } catch (fmt::format_error &err) {
-    Log::println("Failed to format string: {}", err.what());
-    Log::println("This string format problem occurred on {}:{}():L{}", fmt.loc.file_name, parseFunctionName(fmt.loc.function),
-                 fmt.loc.line);
-    exit(EINVAL);
-  }
-  Helper::Logger(WARNING, parseFunctionName(fmt.loc.function), Helper::Logger::Properties::FILE.c_str(), fmt.loc.file_name,
-                 fmt.loc.line)
-      << message << std::endl;
+  Log::write(Helper::LogLevels::WARNING, fmt, std::forward<Args>(args)...);
 }
 
 /// @brief Logs an @c ERROR level message.
 template <typename... Args> inline void error(const log_fmt &fmt, Args &&...args) {
-  std::string message;
-  try {
-    message = fmt::vformat(fmt.fmt, fmt::make_format_args(args...));
-  } catch (fmt::format_error &err) {
-    Log::println("Failed to format string: {}", err.what());
-    Log::println("This string format problem occurred on {}:{}():L{}", fmt.loc.file_name, parseFunctionName(fmt.loc.function),
-                 fmt.loc.line);
-    exit(EINVAL);
-  }
-  Helper::Logger(ERROR, parseFunctionName(fmt.loc.function), Helper::Logger::Properties::FILE.c_str(), fmt.loc.file_name, fmt.loc.line)
-      << message << std::endl;
+  Log::write(Helper::LogLevels::ERROR, fmt, std::forward<Args>(args)...);
 }
 
 /// @brief Logs an @c ABORT level message.
 template <typename... Args> inline void abort(const log_fmt &fmt, Args &&...args) {
-  std::string message;
-  try {
-    message = fmt::vformat(fmt.fmt, fmt::make_format_args(args...));
-  } catch (fmt::format_error &err) {
-    Log::println("Failed to format string: {}", err.what());
-    Log::println("This string format problem occurred on {}:{}():L{}", fmt.loc.file_name, parseFunctionName(fmt.loc.function),
-                 fmt.loc.line);
-    exit(EINVAL);
-  }
-  Helper::Logger(INFO, parseFunctionName(fmt.loc.function), Helper::Logger::Properties::FILE.c_str(), fmt.loc.file_name, fmt.loc.line)
-      << message << std::endl;
+  Log::write(Helper::LogLevels::ABORT, fmt, std::forward<Args>(args)...);
 }
 
 } // namespace Log
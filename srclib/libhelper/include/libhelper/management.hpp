@@ -33,12 +33,16 @@
 #include <iostream>
 #include <filesystem>
 #include <optional>
+#include <mutex>
+#include <streambuf>
+#include <string>
 #include <dirent.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <fmt/format.h>
 #include <sys/stat.h>
 #include <libhelper/error.hpp>
+#include <libhelper/trace.hpp>
 
 namespace Helper {
 
@@ -214,7 +218,15 @@ public:
   void startAll() {
     for (auto &task : tasks) {
       futures.push_back(task.get_future());
-      std::thread(std::move(task)).detach();
+      if (Trace::enabled()) {
+        std::thread([task = std::move(task), job = futures.size()]() mutable {
+          Trace::nameThread(fmt::format("job #{}", job));
+          Trace::Span span("async", "job #{}", job);
+          task();
+        }).detach();
+      } else {
+        std::thread(std::move(task)).detach();
+      }
     }
     tasks.clear();
   }
@@ -227,6 +239,7 @@ public:
    */
   std::vector<RetT> getResults() {
     if (!get) {
+      Trace::Span span("wait", "wait for {} job(s)", futures.size());
       std::for_each(futures.begin(), futures.end(), [&](auto &future) { results.push_back(future.get()); });
       get = true;
     }
@@ -611,7 +624,10 @@ public:
 
   off_t lseek(off_t offset, int whence) { return ::lseek(fd_, offset, whence); }
 
-  int fsync() { return ::fsync(fd_); }
+  int fsync() {
+    Trace::Span span("sync", "fsync");
+    return ::fsync(fd_);
+  }
 
   template <typename... Args> int fcntl(int op, Args... args) { return ::fcntl(fd_, op, args...); }
 
@@ -1003,6 +1019,7 @@ template <typename... Args, typename = std::enable_if_t<sizeof...(Args) >= 1>> i
 }
 
 /// @brief Redirect stdout and stderr to /dev/null and block std::cout and std::cerr.
+/// @note Process-wide and not thread-safe. Use OutputCapture in worker threads.
 class Silencer {
   std::streambuf *saved_cout = nullptr;
   std::streambuf *saved_cerr = nullptr;
@@ -1067,6 +1084,95 @@ public:
   }
 };
 
+/**
+ * @brief Capture std::cout and std::cerr output of the calling thread.
+ *
+ * Unlike Silencer, this never touches file descriptors. Both streams get a
+ * routing buffer once; a thread with an active capture writes into its own
+ * string and every other thread still reaches the original buffer.
+ * C stdio (printf, Log::print etc.) is not affected.
+ */
+class OutputCapture {
+  class Router final : public std::streambuf {
+    std::streambuf *original;
+
+  protected:
+    int_type overflow(const int_type c) override {
+      if (traits_type::eq_int_type(c, traits_type::eof())) return traits_type::not_eof(c);
+      if (target) {
+        target->push_back(traits_type::to_char_type(c));
+        return c;
+      }
+      return original->sputc(traits_type::to_char_type(c));
+    }
+
+    std::streamsize xsputn(const char *s, const std::streamsize n) override {
+      if (target) {
+        target->append(s, static_cast<size_t>(n));
+        return n;
+      }
+      return original->sputn(s, n);
+    }
+
+    int sync() override { return target ? 0 : original->pubsync(); }
+
+  public:
+    explicit Router(std::streambuf *buf) : original(buf) {}
+  };
+
+  static inline thread_local std::string *target = nullptr;
+  static inline std::mutex installMutex;
+
+  std::string captured;
+  std::string *previous = nullptr;
+  bool active = false;
+
+  static void install(std::ostream &stream) {
+    if (dynamic_cast<Router *>(stream.rdbuf()) != nullptr) return;
+    stream.flush();
+    stream.rdbuf(new Router(stream.rdbuf())); // Never freed; streams may be used during static destruction.
+  }
+
+  static void install() {
+    // Re-checked every time, a Silencer may have swapped the buffers in between.
+    std::lock_guard lock(installMutex);
+    install(std::cout);
+    install(std::cerr);
+  }
+
+public:
+  explicit OutputCapture(bool do_capture = true) {
+    if (do_capture) start();
+  }
+
+  ~OutputCapture() { stop(); }
+
+  OutputCapture(const OutputCapture &) = delete;
+  OutputCapture &operator=(const OutputCapture &) = delete;
+
+  /// @brief Start capturing output of the calling thread.
+  void start() {
+    if (active) return;
+    install();
+    previous = std::exchange(target, &captured);
+    active = true;
+  }
+
+  /// @brief Stop capturing. Restores the outer capture if nested.
+  void stop() {
+    if (!active) return;
+    target = previous;
+    previous = nullptr;
+    active = false;
+  }
+
+  /// @brief Get the captured output.
+  [[nodiscard]] const std::string &output() const noexcept { return captured; }
+
+  /// @brief Clear the captured output.
+  void clear() noexcept { captured.clear(); }
+};
+
 } // namespace Helper
 
 #endif // #ifndef LIBHELPER_MANAGEMENT_HPP
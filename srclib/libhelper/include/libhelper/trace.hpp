@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2026 Yağız Zengin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file trace.hpp
+ * @author Yağız Zengin ([YZBruh](https://github.com/YZBruh))
+ * @brief Timeline recorder, writes Chrome trace-event files (viewable in Perfetto or chrome://tracing).
+ */
+
+#ifndef LIBHELPER_TRACE_HPP
+#define LIBHELPER_TRACE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <fmt/format.h>
+
+namespace Helper {
+
+/**
+ * @brief Records spans of operations to a Chrome trace-event file.
+ *
+ * Recording is disabled until start() is called; while disabled, creating a Span costs one atomic load and names are
+ * never formatted. Events are kept in memory and written by finish() (called automatically on exit).
+ *
+ * @code
+ * Helper::Trace::start("trace.json");
+ * {
+ *   Helper::Trace::Span span("io", "read {}", name); // Recorded when span is destroyed.
+ *   // ...
+ * }
+ * @endcode
+ *
+ * @note This class cannot be constructible; its purpose is to function like a namespace.
+ */
+class Trace {
+  static std::atomic<bool> recording;
+
+public:
+  Trace() = delete;
+
+  /**
+   * @brief Start recording.
+   * @param file Output file. It's written by finish().
+   */
+  static void start(const std::filesystem::path &file);
+
+  /**
+   * @brief Write recorded events and stop recording. Called automatically on exit.
+   * @note Events are not written if they are still locked after a short wait (like when a signal interrupted recording).
+   */
+  static void finish();
+
+  /// @brief Check recording is enabled.
+  static bool enabled() noexcept { return recording.load(std::memory_order_acquire); }
+
+  /// @brief Get time since start() as microseconds.
+  static uint64_t now() noexcept;
+
+  /**
+   * @brief Record a completed span. Thread-safe.
+   * @param category Category of span (like @c io ). Must be a string literal.
+   * @param name Name of span.
+   * @param start Start time, from now().
+   * @param duration Duration as microseconds.
+   */
+  static void complete(const char *category, std::string name, uint64_t start, uint64_t duration) noexcept;
+
+  /// @brief Name the calling thread in the timeline. Thread-safe.
+  static void nameThread(std::string name) noexcept;
+
+  /// @brief Records the lifetime of the object as a span.
+  class Span {
+    const char *category = nullptr;
+    std::string name;
+    uint64_t begin = 0;
+
+  public:
+    /**
+     * @brief Start span. Name is only formatted if recording is enabled.
+     * @param category Category of span. Must be a string literal.
+     * @param fmt Name of span.
+     * @param args Format arguments.
+     */
+    template <typename... Args> Span(const char *category, fmt::format_string<Args...> fmt, Args &&...args) noexcept {
+      if (!enabled()) return;
+      try {
+        name = fmt::format(fmt, std::forward<Args>(args)...);
+      } catch (...) {
+        return; // Spans never throw, they're used in destructors too.
+      }
+      this->category = category;
+      begin = now();
+    }
+
+    /// @brief End span.
+    ~Span() {
+      if (category) complete(category, std::move(name), begin, now() - begin);
+    }
+
+    Span(const Span &) = delete;
+    Span &operator=(const Span &) = delete;
+  };
+};
+
+} // namespace Helper
+
+#endif // #ifndef LIBHELPER_TRACE_HPP
@@ -0,0 +1,356 @@
+/*
+ * Copyright (C) 2026 Yağız Zengin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <libhelper/logging.hpp>
+
+namespace Helper {
+
+namespace {
+
+constexpr char LOG_BANNER[] = "----------------------------------------------\n"
+                              " LOGGING BEGIN! LOGGING BEGIN! LOGGING BEGIN!\n"
+                              "----------------------------------------------\n";
+constexpr char FALLBACK_LOG_FILE[] = "last_logs.log";
+constexpr size_t MAX_BATCH_SIZE = 64 * 1024; // Lines are written with one write() up to this size.
+constexpr size_t RING_MASK = LogSink::CAPACITY - 1;
+constexpr int SIGNAL_FLUSH_TIMEOUT_MS = 1000; // Signal handlers wait for writer thread up to this time.
+static_assert((LogSink::CAPACITY & RING_MASK) == 0, "Capacity of ring buffer must be a power of two");
+
+/// @brief Write whole buffer. Async-signal-safe.
+bool writeAll(int fd, const char *data, size_t size) noexcept {
+  while (size > 0) {
+    const ssize_t result = write(fd, data, size);
+    if (result == -1 && errno == EINTR) continue;
+    if (result <= 0) return false;
+    data += result;
+    size -= static_cast<size_t>(result);
+  }
+  return true;
+}
+
+/// @brief A line in ring buffer. Strings are only released by producers (when the slot is reused), never by consumers.
+struct Slot {
+  std::atomic<size_t> sequence{0};
+  std::string file, line;
+  std::function<std::string()> record; // Deferred record, formatted to line by consumer.
+
+  /// @brief Get line of slot, format deferred record if needed.
+  const std::string &text() {
+    if (record) line = record();
+    return line;
+  }
+};
+
+/**
+ * Bounded multi-producer multi-consumer ring buffer (sequence numbered slots). The writer thread is the consumer,
+ * a signal handler may also consume while flushing.
+ */
+class SinkState {
+  Slot slots[LogSink::CAPACITY];
+  alignas(64) std::atomic<size_t> enqueuePos{0};
+  alignas(64) std::atomic<size_t> dequeuePos{0};
+
+  // Only used by writer thread (or by pushing threads after shutdown, under mutex).
+  int fd = -1;
+  std::string openedFile;
+
+public:
+  std::atomic<size_t> written{0}; // Count of consumed lines which are written.
+  std::atomic<int> currentFd{-1}; // For signal handlers.
+  std::atomic<bool> sleeping{false}, stopping{false}, stopped{false}, signaled{false}, shutDown{false};
+  std::atomic<bool> abandoned{false}; // A signal handler gave up waiting and writes remaining lines itself.
+  std::atomic<bool> busy{false};      // Writer thread has lines which are popped but not written yet.
+  std::atomic<pid_t> writerTid{0};
+  std::mutex mutex;
+  std::condition_variable wake, drained;
+  std::thread writer;
+  const pid_t owner = getpid();
+
+  SinkState() {
+    for (size_t i = 0; i < LogSink::CAPACITY; i++)
+      slots[i].sequence.store(i, std::memory_order_relaxed);
+
+    // Signals are handled by other threads, so a signal handler can wait for the writer thread to flush.
+    sigset_t all, previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &previous);
+    writer = std::thread(&SinkState::run, this);
+    pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+  }
+
+  /// @brief Check writer thread wrote everything that can be popped. Async-signal-safe.
+  bool idle() const { return !busy.load() && !hasPending(); }
+
+  size_t pushed() const { return enqueuePos.load(std::memory_order_acquire); }
+
+  bool tryPush(const std::string &file, std::string &line, std::function<std::string()> &record) {
+    size_t pos = enqueuePos.load(std::memory_order_relaxed);
+    for (;;) {
+      Slot &slot = slots[pos & RING_MASK];
+      const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+      const auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          slot.file = file;
+          slot.line = std::move(line);
+          slot.record = std::move(record);
+          slot.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false; // Full.
+      } else {
+        pos = enqueuePos.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  template <typename F> bool pop(F &&process) {
+    size_t pos = dequeuePos.load(std::memory_order_relaxed);
+    for (;;) {
+      Slot &slot = slots[pos & RING_MASK];
+      const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+      const auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          process(slot);
+          slot.sequence.store(pos + LogSink::CAPACITY, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false; // Empty.
+      } else {
+        pos = dequeuePos.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool hasPending() const {
+    const size_t pos = dequeuePos.load(std::memory_order_relaxed);
+    return slots[pos & RING_MASK].sequence.load(std::memory_order_acquire) == pos + 1;
+  }
+
+  /// @brief Get descriptor of log file. The file is reopened if its path changed or it was removed.
+  int openLog(const std::string &file) {
+    if (fd != -1 && file == openedFile) {
+      struct stat st{};
+      if (fstat(fd, &st) == 0 && st.st_nlink > 0) return fd;
+    }
+
+    if (fd != -1) close(fd);
+    fd = open(file.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, DEFAULT_FILE_PERMS);
+    if (fd == -1 && Logger::Properties::tries < 3) {
+      fprintf(stderr, "[Logger] Cannot open log file %s: %s\n", file.c_str(), strerror(errno));
+      fprintf(stderr, "[Logger] Falling back to: %s\n", FALLBACK_LOG_FILE);
+      fd = open(FALLBACK_LOG_FILE, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, DEFAULT_FILE_PERMS);
+      if (fd == -1) {
+        fprintf(stderr, "[Logger] Fallback file %s also failed!\n", FALLBACK_LOG_FILE);
+        ++Logger::Properties::tries;
+      }
+    }
+    openedFile = file;
+
+    if (struct stat st{}; fd != -1 && fstat(fd, &st) == 0 && st.st_size == 0) writeAll(fd, LOG_BANNER, sizeof(LOG_BANNER) - 1);
+    currentFd.store(fd, std::memory_order_release);
+    return fd;
+  }
+
+  /// @brief Write lines without writer thread (after shutdown). Must be called with locked mutex.
+  void writeDirect(const std::string &file, const std::string &line) {
+    if (const int out = openLog(file); out != -1) writeAll(out, line.data(), line.size());
+    written.fetch_add(1, std::memory_order_release);
+  }
+
+  /// @brief Queue a line or a deferred record, wait while ring buffer is full.
+  void push(const std::string &file, std::string line, std::function<std::string()> record) {
+    if (stopped.load()) {
+      std::lock_guard lock(mutex);
+      writeDirect(file, record ? record() : line);
+      return;
+    }
+
+    while (!tryPush(file, line, record)) {
+      wake.notify_one();
+      std::this_thread::yield();
+    }
+
+    if (sleeping.load()) {
+      std::lock_guard lock(mutex);
+      wake.notify_one();
+    }
+
+    if (stopped.load()) { // Shut down while pushing, write remaining lines here.
+      std::lock_guard lock(mutex);
+      while (pop([this](Slot &slot) { writeDirect(slot.file, slot.text()); })) {
+      }
+    }
+  }
+
+  /// @brief Loop of writer thread. Consecutive lines of same file are written with one write().
+  void run() {
+    std::string batch, batchFile;
+    size_t batchLines = 0;
+    batch.reserve(MAX_BATCH_SIZE);
+    writerTid.store(static_cast<pid_t>(syscall(SYS_gettid)));
+
+    const auto commit = [&] {
+      if (!batch.empty()) {
+        if (const int out = openLog(batchFile); out != -1) writeAll(out, batch.data(), batch.size());
+        batch.clear();
+      }
+      written.fetch_add(batchLines, std::memory_order_release);
+      batchLines = 0;
+      drained.notify_all();
+    };
+
+    for (;;) {
+      busy.store(true);
+      while (!abandoned.load() && pop([&](Slot &slot) {
+        const std::string &text = slot.text();
+        if (slot.file != batchFile || batch.size() + text.size() > MAX_BATCH_SIZE) {
+          commit();
+          batchFile = slot.file;
+        }
+        batch += text;
+        batchLines++;
+      })) {
+      }
+      commit();
+      busy.store(false);
+      if (abandoned.load() || (stopping.load() && !hasPending())) break;
+
+      std::unique_lock lock(mutex);
+      sleeping.store(true);
+      wake.wait_for(lock, std::chrono::milliseconds(50), [this] { return stopping.load() || hasPending(); });
+      sleeping.store(false);
+    }
+  }
+};
+
+std::atomic<SinkState *> instance{nullptr};
+
+SinkState *state() {
+  static SinkState *created = [] {
+    auto *sink = new SinkState(); // Never deleted, it may be used by destructors of other static objects.
+    instance.store(sink, std::memory_order_release);
+    atexit(LogSink::shutdown);
+    return sink;
+  }();
+  return created;
+}
+
+} // namespace
+
+void LogSink::push(const std::string &file, std::string line) { state()->push(file, std::move(line), nullptr); }
+
+void LogSink::push(const std::string &file, std::function<std::string()> record) { state()->push(file, {}, std::move(record)); }
+
+void LogSink::flush() {
+  SinkState *sink = instance.load(std::memory_order_acquire);
+  if (!sink || sink->stopped.load() || sink->signaled.load()) return;
+
+  const size_t target = sink->pushed();
+  std::unique_lock lock(sink->mutex);
+  sink->wake.notify_one();
+  while (sink->written.load(std::memory_order_acquire) < target && !sink->stopped.load())
+    sink->drained.wait_for(lock, std::chrono::milliseconds(10));
+}
+
+void LogSink::flushFromSignal() noexcept {
+  SinkState *sink = instance.load(std::memory_order_acquire);
+  if (!sink) return;
+  sink->signaled.store(true);
+
+  // The writer thread formats deferred records and writes all lines in order; it polls the queue at least every 50 ms.
+  // It can only be stuck if the interrupted thread holds a lock it needs, so the wait is bounded.
+  const timespec delay = {0, 1000 * 1000};
+  const bool onWriter = sink->writerTid.load() == static_cast<pid_t>(syscall(SYS_gettid));
+  for (int i = 0; !onWriter && !sink->abandoned.load() && i < SIGNAL_FLUSH_TIMEOUT_MS; i++) {
+    if (sink->idle()) return;
+    nanosleep(&delay, nullptr);
+  }
+
+  // Writer thread doesn't respond: write formatted lines here, let writer thread finish its current batch first.
+  sink->abandoned.store(true);
+  for (int i = 0; !onWriter && i < 100 && sink->busy.load(); i++)
+    nanosleep(&delay, nullptr);
+
+  // Formatting deferred records is not async-signal-safe, they are counted instead. Only INFO records are deferred.
+  size_t unformatted = 0;
+  char file[4096] = {}; // Log file of the last line, slots may be reused while writing.
+  const auto writeLine = [sink](const char *path, const char *data, size_t size) {
+    int out = sink->currentFd.load(std::memory_order_acquire);
+    const bool own = out == -1;
+    if (own) out = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, DEFAULT_FILE_PERMS);
+    if (out != -1) writeAll(out, data, size);
+    if (own && out != -1) close(out);
+  };
+  while (sink->pop([&](Slot &slot) {
+    strncpy(file, slot.file.c_str(), sizeof(file) - 1);
+    if (slot.record) unformatted++;
+    else writeLine(file, slot.line.data(), slot.line.size());
+  })) {
+  }
+  if (unformatted == 0) return;
+
+  char digits[24], *count = digits + sizeof(digits);
+  do {
+    *--count = static_cast<char>('0' + unformatted % 10);
+  } while (unformatted /= 10);
+  constexpr char note[] = " INFO line(s) are lost, the writer thread did not respond.\n";
+  writeLine(file, "[Logger] ", 9);
+  writeLine(file, count, static_cast<size_t>(digits + sizeof(digits) - count));
+  writeLine(file, note, sizeof(note) - 1);
+}
+
+void LogSink::shutdown() {
+  SinkState *sink = instance.load(std::memory_order_acquire);
+  if (!sink || sink->owner != getpid() || sink->shutDown.exchange(true)) return;
+  if (sink->signaled.load()) { // Exit from a signal handler, the interrupted thread may hold the mutex.
+    flushFromSignal();
+    return;
+  }
+
+  {
+    std::lock_guard lock(sink->mutex);
+    sink->stopping.store(true);
+    sink->wake.notify_one();
+  }
+  if (sink->writer.joinable()) sink->writer.join();
+
+  std::lock_guard lock(sink->mutex);
+  sink->stopped.store(true);
+  while (sink->pop([sink](Slot &slot) { sink->writeDirect(slot.file, slot.text()); })) {
+  }
+}
+
+} // namespace Helper
@@ -21,6 +21,7 @@
 #include <string>
 #include <vector>
 #include <libhelper/functions.hpp>
+#include <libhelper/trace.hpp>
 #include <openssl/sha.h>
 
 namespace Helper {
@@ -33,6 +34,7 @@ static std::string bytesToHexString(const unsigned char *bytes, size_t length) {
 
 std::optional<std::string> sha256Of(const std::filesystem::path &path) {
   Log::info("Trying to get sha256 of {}.", std::quoted_string(path));
+  Trace::Span span("hash", "sha256 {}", path.string());
 
   const std::string fp = (isLink(path)) ? readSymlink(path) : path.string();
   if (!isExists(fp)) throw Error("Is not exists or not file: {}", fp);
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2026 Yağız Zengin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <libhelper/management.hpp>
+#include <libhelper/logging.hpp>
+#include <libhelper/trace.hpp>
+
+namespace Helper {
+
+namespace {
+
+struct TraceEvent {
+  const char *category; // nullptr for thread name events.
+  std::string name;
+  uint64_t start, duration;
+  pid_t tid;
+};
+
+std::mutex traceMutex;
+thread_local bool holdsTraceMutex = false; // finish() may run from a signal handler that interrupted complete().
+std::vector<TraceEvent> events;
+std::filesystem::path traceFile;
+std::chrono::steady_clock::time_point traceStart;
+
+pid_t currentTid() { return static_cast<pid_t>(syscall(SYS_gettid)); }
+
+/// @brief Append string as JSON string literal.
+void appendJsonString(std::string &out, const std::string &text) {
+  out += '"';
+  for (const char c : text) {
+    switch (c) {
+      case '"': out += "\\\""; break;
+      case '\\': out += "\\\\"; break;
+      case '\n': out += "\\n"; break;
+      case '\t': out += "\\t"; break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) out += fmt::format("\\u{:04x}", static_cast<int>(c));
+        else out += c;
+    }
+  }
+  out += '"';
+}
+
+} // namespace
+
+std::atomic<bool> Trace::recording{false};
+
+void Trace::start(const std::filesystem::path &file) {
+  {
+    std::lock_guard lock(traceMutex);
+    traceFile = file;
+    traceStart = std::chrono::steady_clock::now();
+    events.clear();
+    events.reserve(4096);
+  }
+
+  static std::once_flag registered;
+  std::call_once(registered, [] { atexit(Trace::finish); });
+  recording.store(true);
+  nameThread("main");
+}
+
+uint64_t Trace::now() noexcept {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - traceStart).count());
+}
+
+void Trace::complete(const char *category, std::string name, uint64_t start, uint64_t duration) noexcept {
+  if (!enabled()) return;
+  const pid_t tid = currentTid();
+  std::lock_guard lock(traceMutex);
+  holdsTraceMutex = true;
+  try {
+    events.push_back({category, std::move(name), start, duration, tid});
+  } catch (...) { // Out of memory, drop event.
+  }
+  holdsTraceMutex = false;
+}
+
+void Trace::nameThread(std::string name) noexcept { complete(nullptr, std::move(name), 0, 0); }
+
+void Trace::finish() {
+  if (!recording.exchange(false)) return;
+
+  // Runs from exit(), also when a signal handler exits. Never block on a mutex the interrupted code may hold; other
+  // threads release it quickly since recording is stopped.
+  std::unique_lock lock(traceMutex, std::defer_lock);
+  for (int tries = 0; !holdsTraceMutex && !lock.try_lock() && tries < 100; tries++)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  if (!lock.owns_lock()) {
+    Log::warning("Trace is busy, it's not written to {}.", std::quoted_string(traceFile));
+    return;
+  }
+  const pid_t pid = getpid();
+  std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  for (size_t i = 0; i < events.size(); i++) {
+    const TraceEvent &event = events[i];
+    if (event.category) {
+      out += "{\"name\":";
+      appendJsonString(out, event.name);
+      out += fmt::format(",\"cat\":\"{}\",\"ph\":\"X\",\"ts\":{},\"dur\":{},\"pid\":{},\"tid\":{}}}", event.category, event.start,
+                         event.duration, pid, event.tid);
+    } else { // Thread name (metadata event).
+      out += fmt::format("{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":{},\"tid\":{},\"args\":{{\"name\":", pid, event.tid);
+      appendJsonString(out, event.name);
+      out += "}}";
+    }
+    out += i + 1 < events.size() ? ",\n" : "\n";
+  }
+  out += "]}\n";
+  events.clear();
+
+  auto fp = UniqueFP(traceFile, "w");
+  if (!fp || fp.write(out.data(), 1, out.size()) != out.size())
+    Log::error("Cannot write trace to {}: {}", std::quoted_string(traceFile), strerror(errno));
+}
+
+} // namespace Helper
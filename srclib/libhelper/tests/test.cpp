@@ -91,12 +91,19 @@ int main(int argc, char **argv) {
     std::cout << "pathJoin() test 3: " << Helper::pathJoin("mydir/", "/dir2") << std::endl;
     std::cout << "pathJoin() test 4: " << Helper::pathJoin("mydir", "/dir2") << std::endl;
 
+    Helper::OutputCapture capture;
+    std::cout << "hello from capture";
+    capture.stop();
+    std::cout << "OutputCapture test: " << capture.output() << std::endl;
+
     std::cout << Helper::getLibVersion() << std::endl;
 
     LOG(INFO) << "Info message" << std::endl;
     LOG(WARNING) << "Warning message" << std::endl;
     LOG(ERROR) << "Error message" << std::endl;
     LOG(ABORT) << "Abort message" << std::endl;
+    Helper::LogSink::flush();
+    std::cout << "Size of log file after flush: " << Helper::fileSize(Helper::Logger::Properties::FILE) << std::endl;
   } catch (std::exception &err) {
     std::cout << err.what() << std::endl;
     return 1;
@@ -60,6 +60,10 @@ __BEGIN_DECLS
 #define OP_CKSUM_SHA256 0x2 ///< Check SHA256.
 #define OP_CKSUM_MD5 0x3    ///< Check MD5.
 
+#define OP_GPT_NAME_MAX 109 ///< Buffer size for a GPT partition name converted to UTF-8 (36 UTF-16 units + NUL).
+
+#define OP_STATS_BUCKETS 64 ///< Count of latency histogram buckets (two buckets per power of two of microseconds).
+
 #define openpart_get_size2(op, out)                                                                                                   \
   openpart_get((op), OP_INFO_SIZE, (void **)(out)) ///< @c openpart_get() implementation for @c OP_INFO_SIZE.
 #define openpart_get_uuid2(op, out)                                                                                                   \
@@ -83,6 +87,53 @@ __BEGIN_DECLS
 
 typedef struct openpart
     openpart_t; ///< Opaque @c openpart_t type defination. The struct body is available in the @c src/internal.h file.
+typedef struct openpart_gpt
+    openpart_gpt_t; ///< Opaque parsed GPT table type defination. The struct body is available in the @c src/internal.h file.
+
+/// @brief GPT partition entry (first 128 bytes of an on-disk entry, little-endian).
+typedef struct __attribute__((packed)) openpart_gpt_entry {
+  uint8_t type_guid[16];   ///< Partition type GUID (all zero if the entry is unused).
+  uint8_t unique_guid[16]; ///< Unique partition GUID.
+  uint64_t first_lba;      ///< First LBA of partition.
+  uint64_t last_lba;       ///< Last LBA of partition (inclusive).
+  uint64_t attributes;     ///< Attribute flags.
+  uint16_t name[36];       ///< Partition name (UTF-16LE).
+} openpart_gpt_entry_t;
+
+/// @brief Header information of a parsed GPT table.
+typedef struct openpart_gpt_info {
+  uint64_t sector_size;      ///< Logical sector size of the disk.
+  uint64_t first_usable_lba; ///< First usable LBA for partitions.
+  uint64_t last_usable_lba;  ///< Last usable LBA for partitions.
+  uint64_t alternate_lba;    ///< LBA of the other GPT header.
+  uint32_t header_crc32;     ///< CRC32 of the used header.
+  uint32_t entries_crc32;    ///< CRC32 of the partition entry array.
+  uint32_t num_entries;      ///< Count of entry slots (used and unused).
+  uint32_t from_backup;      ///< 1 if the primary table is corrupted and the backup table is used.
+  uint8_t disk_guid[16];     ///< Disk GUID.
+} openpart_gpt_info_t;
+
+/// @brief I/O statistics of one direction (read or write).
+typedef struct openpart_io_stats {
+  uint64_t calls;     ///< Count of @c pread() / @c pwrite() calls.
+  uint64_t bytes;     ///< Transferred bytes.
+  uint64_t retries;   ///< Calls interrupted with @c EINTR (retried).
+  uint64_t short_ops; ///< Calls which transferred less than requested.
+  uint64_t errors;    ///< Failed calls.
+  uint64_t stalls;    ///< Calls slower than the stall threshold.
+  uint64_t total_ns;  ///< Total latency.
+  uint64_t max_ns;    ///< Maximum latency.
+  uint64_t histogram[OP_STATS_BUCKETS]; ///< Latency histogram, use @c openpart_stats_percentile() for reading.
+} openpart_io_stats_t;
+
+/// @brief I/O statistics of an @c openpart_t* object.
+typedef struct openpart_stats {
+  openpart_io_stats_t read;  ///< Read statistics.
+  openpart_io_stats_t write; ///< Write statistics.
+} openpart_stats_t;
+
+/// @brief Stall handler. Called from the I/O thread with partition path, direction (1 = write), offset, size and latency.
+typedef void (*openpart_stall_handler_t)(const char *path, int write, uint64_t offset, size_t count, uint64_t ns);
 /** @} */
 
 /**
@@ -216,30 +267,65 @@ uint64_t openpart_get_size(openpart_t *op);
  * @brief Get partition name.
  *
  * @param op @c openpart_t* object.
+ * @note Resolved once by @c openpart_open(), the returned pointer is valid until @c openpart_close().
  * @return NULL on error, otherwise partition name.
  */
 const char *openpart_get_part_name(openpart_t *op);
 
+/**
+ * @brief Get partition name (reentrant).
+ *
+ * @param op @c openpart_t* object.
+ * @param buf Output buffer (@c OP_GPT_NAME_MAX bytes is always enough).
+ * @param len Output buffer length.
+ * @return 1 (true) on success, otherwise -1.
+ */
+int openpart_get_part_name_r(openpart_t *op, char *buf, size_t len);
+
 /**
  * @brief Get partition path.
  *
  * @param op @c openpart_t* object.
+ * @note Resolved once by @c openpart_open(), the returned pointer is valid until @c openpart_close().
  * @return NULL on error, otherwise partition path.
  */
 const char *openpart_get_part_path(openpart_t *op);
 
+/**
+ * @brief Get partition path (reentrant).
+ *
+ * @param op @c openpart_t* object.
+ * @param buf Output buffer.
+ * @param len Output buffer length.
+ * @return 1 (true) on success, otherwise -1.
+ */
+int openpart_get_part_path_r(openpart_t *op, char *buf, size_t len);
+
 /**
  * @brief Get partition table path (reading from sysfs).
  *
  * @param op @c openpart_t* object.
+ * @note Resolved once by @c openpart_open(), the returned pointer is valid until @c openpart_close().
  * @return NULL on error, otherwise partition table path.
  */
 const char *openpart_get_disk_path(openpart_t *op);
 
+/**
+ * @brief Get partition table path (reentrant).
+ *
+ * @param op @c openpart_t* object.
+ * @param buf Output buffer.
+ * @param len Output buffer length.
+ * @return 1 (true) on success, otherwise -1.
+ */
+int openpart_get_disk_path_r(openpart_t *op, char *buf, size_t len);
+
 /**
  * @brief Get filesystem UUID.
  *
  * @param op @c openpart_t* object.
+ * @note The superblock is read on the first call of @c openpart_get_uuid(), @c openpart_get_label() or
+ *       @c openpart_get_fstype(). Size, sector size and fd are known after @c openpart_open() without reading.
  * @return NULL on error, otherwise filesystem UUID.
  */
 const char *openpart_get_uuid(openpart_t *op);
@@ -248,6 +334,8 @@ const char *openpart_get_uuid(openpart_t *op);
  * @brief Get filesystem label.
  *
  * @param op @c openpart_t* object.
+ * @note The superblock is read on the first call of @c openpart_get_uuid(), @c openpart_get_label() or
+ *       @c openpart_get_fstype(). Size, sector size and fd are known after @c openpart_open() without reading.
  * @return NULL on error, otherwise filesystem label.
  */
 const char *openpart_get_label(openpart_t *op);
@@ -256,6 +344,8 @@ const char *openpart_get_label(openpart_t *op);
  * @brief Get filesystem type.
  *
  * @param op @c openpart_t* object.
+ * @note The superblock is read on the first call of @c openpart_get_uuid(), @c openpart_get_label() or
+ *       @c openpart_get_fstype(). Size, sector size and fd are known after @c openpart_open() without reading.
  * @return NULL on error, otherwise filesystem type (as name).
  */
 const char *openpart_get_fstype(openpart_t *op);
@@ -283,6 +373,99 @@ int openpart_get_fd(openpart_t *op);
  * @return 1 (true) on success, otherwise -1 or 0.
  */
 int openpart_get_is_blkdev(openpart_t *op);
+
+/**
+ * @brief Probe filesystems (type, UUID, label) of many partitions concurrently.
+ *
+ * Each partition is probed with one aligned read covering all known superblock offsets, already probed handles are skipped.
+ * After this, @c openpart_get_fstype(), @c openpart_get_uuid() and @c openpart_get_label() do not read the partitions.
+ *
+ * @param ops Array of @c openpart_t* objects (@c NULL entries are skipped). A handle must not appear twice.
+ * @param count Count of @p ops.
+ * @param threads Worker thread count (0 for CPU count).
+ * @return Count of successfully probed handles, -1 on error. Errors of handles are stored in them (see @c openpart_errno() ).
+ */
+int openpart_probe_all(openpart_t **ops, size_t count, unsigned int threads);
+/** @} */
+
+/**
+ * @name OpenPart GPT functions.
+ * @brief Read GPT tables without external libraries.
+ *
+ * @{
+ */
+
+/**
+ * @brief Read GPT table of disk.
+ *
+ * The header and entry array are read with one @c pread() when the array follows the header (as usual), otherwise with two.
+ * Header and entry array CRC32s are verified; if the primary table is corrupted, the backup table is used.
+ * Parsed tables are cached per disk until @c openpart_gpt_invalidate() is called, so later calls do not read the disk.
+ *
+ * @param disk_path Path to the disk (like @c /dev/block/sda ) or disk image.
+ * @warning Returned object is must be closed with @c openpart_gpt_close().
+ * @return @c NULL on error (@c errno is @c EBADMSG if no valid table is found), otherwise pointer to the parsed table.
+ */
+openpart_gpt_t *openpart_gpt_open(const char *disk_path);
+
+/**
+ * @brief Release parsed GPT table. It stays in the cache until @c openpart_gpt_invalidate() is called.
+ *
+ * @param gpt Pointer to the @c openpart_gpt_t* object.
+ */
+void openpart_gpt_close(openpart_gpt_t **gpt);
+
+/**
+ * @brief Drop cached GPT table of disk. Must be called after the table is modified.
+ *
+ * @param disk_path Path to the disk. @c NULL drops all cached tables.
+ */
+void openpart_gpt_invalidate(const char *disk_path);
+
+/**
+ * @brief Get header information of parsed GPT table.
+ *
+ * @param gpt @c openpart_gpt_t* object.
+ * @return NULL on error, otherwise pointer to the header information.
+ */
+const openpart_gpt_info_t *openpart_gpt_info(const openpart_gpt_t *gpt);
+
+/**
+ * @brief Get entry of parsed GPT table.
+ *
+ * @param gpt @c openpart_gpt_t* object.
+ * @param index Entry index (0 to @c num_entries - 1).
+ * @return NULL on error, otherwise pointer to the entry.
+ */
+const openpart_gpt_entry_t *openpart_gpt_entry(const openpart_gpt_t *gpt, uint32_t index);
+
+/**
+ * @brief Find used entry by first LBA.
+ *
+ * @param gpt @c openpart_gpt_t* object.
+ * @param first_lba First LBA of partition (in sectors of disk).
+ * @param index Output for entry index (can be @c NULL ).
+ * @return NULL if not found, otherwise pointer to the entry.
+ */
+const openpart_gpt_entry_t *openpart_gpt_find_lba(const openpart_gpt_t *gpt, uint64_t first_lba, uint32_t *index);
+
+/**
+ * @brief Check entry is used or not.
+ *
+ * @param entry @c openpart_gpt_entry_t* object.
+ * @return 1 (true) if used, otherwise 0.
+ */
+int openpart_gpt_entry_is_used(const openpart_gpt_entry_t *entry);
+
+/**
+ * @brief Convert entry name to UTF-8.
+ *
+ * @param entry @c openpart_gpt_entry_t* object.
+ * @param buf Output buffer (@c OP_GPT_NAME_MAX bytes is always enough).
+ * @param len Output buffer length.
+ * @return 1 (true) on success, otherwise -1.
+ */
+int openpart_gpt_entry_name(const openpart_gpt_entry_t *entry, char *buf, size_t len);
 /** @} */
 
 /**
@@ -322,9 +505,20 @@ int openpart_umount(openpart_t *op);
  * @brief Get mount path of partition.
  *
  * @param op @c openpart_t* object.
+ * @note Result is stored in a thread-local buffer, it is overwritten by the next call on the same thread.
  * @return NULL on error, otherwise mount path.
  */
 const char *openpart_mntpath(openpart_t *op);
+
+/**
+ * @brief Get mount path of partition (reentrant).
+ *
+ * @param op @c openpart_t* object.
+ * @param buf Output buffer.
+ * @param len Output buffer length.
+ * @return 1 (true) on success, otherwise -1.
+ */
+int openpart_mntpath_r(openpart_t *op, char *buf, size_t len);
 /** @} */
 
 /**
@@ -368,6 +562,68 @@ int openpart_hexdump(openpart_t *op, uint64_t offset, size_t size, int fd);
 const char *openpart_whatis_magic();
 /** @} */
 
+/**
+ * @name OpenPart statistics functions.
+ * @brief Count bytes, calls, retries and errors of partition I/O, keep latency histograms.
+ *
+ * @{
+ */
+
+/**
+ * @brief Enable or disable statistics for partitions opened after this call.
+ *
+ * Statistics are disabled by default; if disabled, I/O functions don't read the clock.
+ *
+ * @param enable 1 for enable, 0 for disable.
+ */
+void openpart_stats_enable(int enable);
+
+/**
+ * @brief Set stall threshold. Every read or write slower than the threshold is counted as a stall.
+ *
+ * @param threshold_ns Threshold as nanoseconds (0 = disabled).
+ * @param handler Called for every stall (can be @c NULL). Must be thread-safe.
+ */
+void openpart_stats_set_stall(uint64_t threshold_ns, openpart_stall_handler_t handler);
+
+/**
+ * @brief Get statistics of partition. Thread-safe.
+ *
+ * @param op @c openpart_t* object.
+ * @param out Output.
+ * @return 0 on success, -1 if statistics weren't enabled when the partition is opened.
+ */
+int openpart_get_stats(openpart_t *op, openpart_stats_t *out);
+
+/**
+ * @brief Add statistics to another (for merging statistics of multiple handles).
+ *
+ * @param into Target.
+ * @param from Source.
+ */
+void openpart_stats_merge(openpart_stats_t *into, const openpart_stats_t *from);
+
+/**
+ * @brief Record a read or write call into statistics (for I/O done without an @c openpart_t* object). Thread-safe.
+ *
+ * @param stats Statistics of the direction.
+ * @param count Requested size.
+ * @param ret Return value of the call; if negative, @c errno tells whether it was interrupted ( @c EINTR ) or failed.
+ * @param ns Latency as nanoseconds.
+ */
+void openpart_stats_add(openpart_io_stats_t *stats, size_t count, ssize_t ret, uint64_t ns);
+
+/**
+ * @brief Get latency percentile from histogram.
+ *
+ * @param stats Statistics of one direction.
+ * @param percentile Percentile (like 50 or 99).
+ * @return Upper bound of the histogram bucket as nanoseconds (not larger than @c max_ns , @c max_ns for the last bucket), 0 if there
+ *         are no calls.
+ */
+uint64_t openpart_stats_percentile(const openpart_io_stats_t *stats, double percentile);
+/** @} */
+
 /**
  * @name OpenPart error functions.
  * @brief Get error information.
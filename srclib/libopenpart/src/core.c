@@ -30,16 +30,23 @@
 
 __BEGIN_DECLS
 
-const char *path_from_fd(int fd)
+int copy_to_buf(const char *value, char *buf, size_t len)
 {
-  static char buf[PATH_MAX];
-  char link[64];
-  snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
-  ssize_t ret = readlink(link, buf, sizeof(buf) - 1);
-  if (ret < 0)
-    return NULL;
-  buf[ret] = '\0';
-  return buf;
+  size_t n;
+
+  if (!buf || len == 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  n = strlen(value);
+  if (n >= len) {
+    errno = ERANGE;
+    return -1;
+  }
+
+  memcpy(buf, value, n + 1);
+  return 1;
 }
 
 openpart_t *openpart_open(const char *path, int flags, uint32_t extra_oflags)
@@ -75,12 +82,33 @@ openpart_t *openpart_open(const char *path, int flags, uint32_t extra_oflags)
   else if (flags & OP_WRONLY) oflags |= O_WRONLY;
   else oflags |= O_RDWR;
   fd = open(real_path, oflags);
-  free(real_path);
-  if (fd < 0)
+  if (fd < 0) {
+    free(real_path);
     return NULL;
+  }
 
   op = malloc(sizeof(struct openpart));
   if (!op) {
+    free(real_path);
+    close(fd);
+    return NULL;
+  }
+
+  /* Resolve identity once, so getters do not readlink() and concurrent handles do not share static buffers. */
+  strncpy(op->path, real_path, sizeof(op->path) - 1);
+  op->path[sizeof(op->path) - 1] = '\0';
+  free(real_path);
+  op->disk_path[0] = '\0';
+  op->part_name[0] = '\0';
+  if (get_parent_disk(op->path, op->disk_path) == 0) {
+    if (find_partition_name(op->path, op->disk_path, op->part_name, sizeof(op->part_name)) < 0)
+      op->part_name[0] = '\0'; // Not a GPT partition.
+  } else {
+    op->disk_path[0] = '\0'; // Not a partition (like disk images).
+  }
+
+  if (stats_alloc(op) < 0) {
+    free(op);
     close(fd);
     return NULL;
   }
@@ -100,6 +128,7 @@ openpart_t *openpart_open(const char *path, int flags, uint32_t extra_oflags)
     struct stat st;
     if (fstat(fd, &st) < 0) {
       op->err = errno;
+      free(op->stats);
       free(op);
       close(fd);
       return NULL;
@@ -110,6 +139,7 @@ openpart_t *openpart_open(const char *path, int flags, uint32_t extra_oflags)
     uint64_t tmp_size = 0;
     if (ioctl(fd, BLKGETSIZE64, &tmp_size) < 0) {
       op->err = errno;
+      free(op->stats);
       free(op);
       close(fd);
       return NULL;
@@ -119,6 +149,7 @@ openpart_t *openpart_open(const char *path, int flags, uint32_t extra_oflags)
     uint64_t tmp_sector_size = 0;
     if (ioctl(fd, BLKSSZGET, &tmp_sector_size) < 0) {
       op->err = errno;
+      free(op->stats);
       free(op);
       close(fd);
       return NULL;
@@ -137,6 +168,7 @@ void openpart_close(openpart_t **op)
     close((*op)->fd);
     (*op)->fd = -1;
   }
+  free((*op)->stats);
   free(*op);
   *op = NULL;
 }
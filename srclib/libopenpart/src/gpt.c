@@ -25,10 +25,409 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <inttypes.h>
+#include <pthread.h>
+#include <zlib.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+
+#include <linux/fs.h>
+
+#define GPT_SIGNATURE 0x5452415020494645ULL
+#define GPT_MIN_HEADER_SIZE 92
+#define GPT_DEFAULT_ENTRIES_SIZE 16384          // 128 entries of 128 bytes, read together with the header.
+#define GPT_MAX_ENTRIES_SIZE (4 * 1024 * 1024) // Reject absurd entry arrays instead of allocating them.
 
 __BEGIN_DECLS
 
-static int get_parent_disk(const char *part_path, char *disk_path)
+struct gpt_cache_node {
+  char path[PATH_MAX];
+  openpart_gpt_t *gpt;
+  struct gpt_cache_node *next;
+};
+
+static pthread_mutex_t gpt_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct gpt_cache_node *gpt_cache = NULL;
+
+static int read_full(int fd, void *buf, size_t count, uint64_t offset)
+{
+  size_t done = 0;
+  while (done < count) {
+    ssize_t ret = pread(fd, (char *)buf + done, count - done, (off_t)(offset + done));
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    if (ret == 0) {
+      errno = EIO;
+      return -1;
+    }
+    done += (size_t)ret;
+  }
+  return 0;
+}
+
+static int check_header(const gpt_header_t *header, uint64_t lba, uint64_t sector_size)
+{
+  uint8_t raw[GPT_MIN_HEADER_SIZE];
+  uint64_t entries_size;
+  gpt_header_t copy;
+
+  if (header->signature != GPT_SIGNATURE || header->my_lba != lba)
+    return -1;
+  if (header->header_size < GPT_MIN_HEADER_SIZE || header->header_size > sector_size)
+    return -1;
+  if (header->partition_entry_size < sizeof(openpart_gpt_entry_t) || header->partition_entry_size % 8 != 0)
+    return -1;
+
+  entries_size = (uint64_t)header->num_partition_entries * header->partition_entry_size;
+  if (entries_size == 0 || entries_size > GPT_MAX_ENTRIES_SIZE)
+    return -1;
+
+  /* CRC covers header_size bytes with the CRC field itself zeroed. */
+  memcpy(&copy, header, sizeof(copy));
+  copy.header_crc32 = 0;
+  memcpy(raw, &copy, sizeof(raw));
+
+  uLong crc = crc32(0L, Z_NULL, 0);
+  crc = crc32(crc, raw, sizeof(raw));
+  if (header->header_size > sizeof(raw))
+    crc = crc32(crc, (const Bytef *)header + sizeof(raw), header->header_size - sizeof(raw));
+
+  return (uint32_t)crc == header->header_crc32 ? 0 : -1;
+}
+
+/*
+ * Read a table whose header is at lba. The header is read together with GPT_DEFAULT_ENTRIES_SIZE bytes after it,
+ * so the usual layout (entries at lba + 1) needs a single read. Sets *alternate_lba if the header signature is valid.
+ */
+static openpart_gpt_t *read_table(int fd, uint64_t sector_size, uint64_t lba, uint64_t *alternate_lba)
+{
+  gpt_header_t header;
+  openpart_gpt_t *gpt;
+  uint8_t *window, *entries;
+  uint64_t entries_size, window_size;
+  uint32_t i;
+
+  window_size = sector_size + GPT_DEFAULT_ENTRIES_SIZE;
+  window = malloc(window_size);
+  if (!window)
+    return NULL;
+
+  if (read_full(fd, window, window_size, lba * sector_size) < 0) {
+    /* The window may exceed the disk when reading the backup header, retry with header only. */
+    window_size = sector_size;
+    if (read_full(fd, window, window_size, lba * sector_size) < 0) {
+      free(window);
+      return NULL;
+    }
+  }
+
+  memcpy(&header, window, sizeof(header));
+  if (header.signature == GPT_SIGNATURE && alternate_lba)
+    *alternate_lba = header.alternate_lba;
+
+  if (check_header((const gpt_header_t *)window, lba, sector_size) < 0) {
+    free(window);
+    errno = EBADMSG;
+    return NULL;
+  }
+
+  entries_size = (uint64_t)header.num_partition_entries * header.partition_entry_size;
+  if (header.partition_entry_lba == lba + 1 && sector_size + entries_size <= window_size) {
+    entries = window + sector_size;
+  } else {
+    entries = malloc(entries_size);
+    if (!entries || read_full(fd, entries, entries_size, header.partition_entry_lba * sector_size) < 0) {
+      free(entries);
+      free(window);
+      return NULL;
+    }
+  }
+
+  uLong crc = crc32(0L, Z_NULL, 0);
+  crc = crc32(crc, entries, (uInt)entries_size);
+  if ((uint32_t)crc != header.partition_entry_crc32) {
+    if (entries != window + sector_size)
+      free(entries);
+    free(window);
+    errno = EBADMSG;
+    return NULL;
+  }
+
+  gpt = calloc(1, sizeof(*gpt));
+  if (gpt)
+    gpt->entries = calloc(header.num_partition_entries, sizeof(openpart_gpt_entry_t));
+
+  if (gpt && gpt->entries) {
+    gpt->refs = 1;
+    gpt->info.sector_size = sector_size;
+    gpt->info.first_usable_lba = header.first_usable_lba;
+    gpt->info.last_usable_lba = header.last_usable_lba;
+    gpt->info.alternate_lba = header.alternate_lba;
+    gpt->info.header_crc32 = header.header_crc32;
+    gpt->info.entries_crc32 = header.partition_entry_crc32;
+    gpt->info.num_entries = header.num_partition_entries;
+    memcpy(gpt->info.disk_guid, header.disk_guid, sizeof(gpt->info.disk_guid));
+
+    for (i = 0; i < header.num_partition_entries; i++)
+      memcpy(&gpt->entries[i], entries + (uint64_t)i * header.partition_entry_size, sizeof(openpart_gpt_entry_t));
+  } else if (gpt) {
+    free(gpt);
+    gpt = NULL;
+  }
+
+  if (entries != window + sector_size)
+    free(entries);
+  free(window);
+  return gpt;
+}
+
+static openpart_gpt_t *read_disk(const char *disk_path)
+{
+  static const uint64_t image_sector_sizes[] = {512, 4096};
+  const uint64_t *sector_sizes = image_sector_sizes;
+  size_t sector_size_count = 2, i;
+  openpart_gpt_t *gpt = NULL;
+  uint64_t disk_size = 0;
+  struct stat st;
+  int fd, err = EBADMSG;
+
+  fd = open(disk_path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return NULL;
+
+  if (fstat(fd, &st) < 0) {
+    close(fd);
+    return NULL;
+  }
+
+  uint64_t blk_sector_size;
+  if (S_ISBLK(st.st_mode)) {
+    int tmp_sector_size = 0;
+    if (ioctl(fd, BLKSSZGET, &tmp_sector_size) < 0 || ioctl(fd, BLKGETSIZE64, &disk_size) < 0) {
+      err = errno;
+      close(fd);
+      errno = err;
+      return NULL;
+    }
+    blk_sector_size = (uint64_t)tmp_sector_size;
+    sector_sizes = &blk_sector_size;
+    sector_size_count = 1;
+  } else {
+    disk_size = (uint64_t)st.st_size; // Disk image, the sector size is unknown.
+  }
+
+  for (i = 0; i < sector_size_count && !gpt; i++) {
+    uint64_t alternate_lba = 0;
+
+    gpt = read_table(fd, sector_sizes[i], 1, &alternate_lba);
+    if (gpt || errno != EBADMSG)
+      continue;
+
+    if (alternate_lba == 0 && disk_size / sector_sizes[i] > 1)
+      alternate_lba = disk_size / sector_sizes[i] - 1;
+    if (alternate_lba <= 1)
+      continue;
+
+    gpt = read_table(fd, sector_sizes[i], alternate_lba, NULL);
+    if (gpt)
+      gpt->info.from_backup = 1;
+  }
+
+  if (!gpt)
+    err = errno;
+  close(fd);
+  if (!gpt)
+    errno = err;
+  return gpt;
+}
+
+static void gpt_release(openpart_gpt_t *gpt)
+{
+  if (__atomic_sub_fetch(&gpt->refs, 1, __ATOMIC_ACQ_REL) != 0)
+    return;
+
+  free(gpt->entries);
+  free(gpt);
+}
+
+openpart_gpt_t *openpart_gpt_open(const char *disk_path)
+{
+  struct gpt_cache_node *node;
+  openpart_gpt_t *gpt;
+
+  if (!disk_path || strlen(disk_path) >= PATH_MAX) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  pthread_mutex_lock(&gpt_cache_lock);
+  for (node = gpt_cache; node; node = node->next) {
+    if (strcmp(node->path, disk_path) == 0) {
+      __atomic_add_fetch(&node->gpt->refs, 1, __ATOMIC_RELAXED);
+      pthread_mutex_unlock(&gpt_cache_lock);
+      return node->gpt;
+    }
+  }
+  pthread_mutex_unlock(&gpt_cache_lock);
+
+  /* Read without holding the lock, so different disks can be read concurrently. */
+  gpt = read_disk(disk_path);
+  if (!gpt)
+    return NULL;
+
+  pthread_mutex_lock(&gpt_cache_lock);
+  for (node = gpt_cache; node; node = node->next) {
+    if (strcmp(node->path, disk_path) == 0) { // Another thread was faster.
+      __atomic_add_fetch(&node->gpt->refs, 1, __ATOMIC_RELAXED);
+      pthread_mutex_unlock(&gpt_cache_lock);
+      gpt_release(gpt);
+      return node->gpt;
+    }
+  }
+
+  node = malloc(sizeof(*node));
+  if (node) {
+    strcpy(node->path, disk_path);
+    node->gpt = gpt;
+    node->next = gpt_cache;
+    gpt_cache = node;
+    gpt->refs++; // Reference of the cache.
+  }
+  pthread_mutex_unlock(&gpt_cache_lock);
+
+  return gpt;
+}
+
+void openpart_gpt_close(openpart_gpt_t **gpt)
+{
+  if (!gpt || !*gpt)
+    return;
+
+  gpt_release(*gpt);
+  *gpt = NULL;
+}
+
+void openpart_gpt_invalidate(const char *disk_path)
+{
+  struct gpt_cache_node **link, *node;
+
+  pthread_mutex_lock(&gpt_cache_lock);
+  for (link = &gpt_cache; (node = *link);) {
+    if (disk_path && strcmp(node->path, disk_path) != 0) {
+      link = &node->next;
+      continue;
+    }
+
+    *link = node->next;
+    gpt_release(node->gpt);
+    free(node);
+  }
+  pthread_mutex_unlock(&gpt_cache_lock);
+}
+
+const openpart_gpt_info_t *openpart_gpt_info(const openpart_gpt_t *gpt)
+{
+  if (!gpt) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  return &gpt->info;
+}
+
+const openpart_gpt_entry_t *openpart_gpt_entry(const openpart_gpt_t *gpt, uint32_t index)
+{
+  if (!gpt || index >= gpt->info.num_entries) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  return &gpt->entries[index];
+}
+
+int openpart_gpt_entry_is_used(const openpart_gpt_entry_t *entry)
+{
+  static const uint8_t unused[16] = {0};
+  return entry && memcmp(entry->type_guid, unused, sizeof(unused)) != 0;
+}
+
+const openpart_gpt_entry_t *openpart_gpt_find_lba(const openpart_gpt_t *gpt, uint64_t first_lba, uint32_t *index)
+{
+  uint32_t i;
+
+  if (!gpt) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  for (i = 0; i < gpt->info.num_entries; i++) {
+    if (gpt->entries[i].first_lba == first_lba && openpart_gpt_entry_is_used(&gpt->entries[i])) {
+      if (index)
+        *index = i;
+      return &gpt->entries[i];
+    }
+  }
+
+  errno = ENOENT;
+  return NULL;
+}
+
+int openpart_gpt_entry_name(const openpart_gpt_entry_t *entry, char *buf, size_t len)
+{
+  size_t i, pos = 0;
+
+  if (!entry || !buf || len == 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  for (i = 0; i < 36 && entry->name[i]; i++) {
+    uint32_t cp = entry->name[i];
+    char out[4];
+    size_t n;
+
+    if (cp >= 0xD800 && cp <= 0xDBFF && i + 1 < 36 && entry->name[i + 1] >= 0xDC00 && entry->name[i + 1] <= 0xDFFF)
+      cp = 0x10000 + ((cp - 0xD800) << 10) + (entry->name[++i] - 0xDC00);
+    else if (cp >= 0xD800 && cp <= 0xDFFF)
+      cp = 0xFFFD; // Unpaired surrogate.
+
+    if (cp < 0x80) {
+      out[0] = (char)cp;
+      n = 1;
+    } else if (cp < 0x800) {
+      out[0] = (char)(0xC0 | (cp >> 6));
+      out[1] = (char)(0x80 | (cp & 0x3F));
+      n = 2;
+    } else if (cp < 0x10000) {
+      out[0] = (char)(0xE0 | (cp >> 12));
+      out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+      out[2] = (char)(0x80 | (cp & 0x3F));
+      n = 3;
+    } else {
+      out[0] = (char)(0xF0 | (cp >> 18));
+      out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+      out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+      out[3] = (char)(0x80 | (cp & 0x3F));
+      n = 4;
+    }
+
+    if (pos + n >= len) {
+      buf[pos] = '\0';
+      errno = ENAMETOOLONG;
+      return -1;
+    }
+
+    memcpy(buf + pos, out, n);
+    pos += n;
+  }
+
+  buf[pos] = '\0';
+  return 1;
+}
+
+int get_parent_disk(const char *part_path, char *disk_path)
 {
   char sysfs[PATH_MAX];
   char resolved[PATH_MAX];
@@ -39,6 +438,11 @@ static int get_parent_disk(const char *part_path, char *disk_path)
     return -1;
   part_name++;
 
+  /* Whole disks and virtual devices have no parent disk. */
+  snprintf(sysfs, sizeof(sysfs), "/sys/class/block/%s/partition", part_name);
+  if (access(sysfs, F_OK) < 0)
+    return -1;
+
   /* /sys/class/block/sda3/.. -> /sys/class/block/sda */
   snprintf(sysfs, sizeof(sysfs), "/sys/class/block/%s/..", part_name);
 
@@ -74,101 +478,74 @@ static int get_partition_start_lba(const char *part_name, uint64_t *start_lba)
   return 0;
 }
 
-int find_partition_name(openpart_t* op, const char *part_path, char *name_out)
+int find_partition_name(const char *part_path, const char *disk_path, char *name_out, size_t len)
 {
-  char disk_path[PATH_MAX];
-  char part_name[64];
-  gpt_header_t header;
-  gpt_entry_t entry;
-  int disk_fd;
-  uint64_t offset;
+  const openpart_gpt_entry_t *entry;
+  openpart_gpt_t *gpt;
   uint64_t start_lba;
-  uint32_t i;
   const char *pname;
+  int ret;
 
   pname = strrchr(part_path, '/');
   if (!pname)
     return -1;
   pname++;
 
-  strncpy(part_name, pname, sizeof(part_name) - 1);
-  part_name[sizeof(part_name) - 1] = '\0';
-
-  if (get_partition_start_lba(part_name, &start_lba) < 0)
-    return -1;
-  start_lba = start_lba / (op->sector_size / 512);
-
-  if (get_parent_disk(part_path, disk_path) < 0)
-    return -1;
-
-  printf("Looking for LBA: %" PRIu64 "\n", start_lba);
-  disk_fd = open(disk_path, O_RDONLY);
-  if (disk_fd < 0)
-    return -1;
-
-  if (pread(disk_fd, &header, sizeof(header), op->sector_size) < 0) {
-    close(disk_fd);
+  if (get_partition_start_lba(pname, &start_lba) < 0)
     return -1;
-  }
 
-  if (header.signature != 0x5452415020494645ULL) {
-    close(disk_fd);
+  gpt = openpart_gpt_open(disk_path);
+  if (!gpt)
     return -1;
-  }
-
-  offset = header.partition_entry_lba * op->sector_size;
-
-  for (i = 0; i < header.num_partition_entries; i++) {
-    size_t j;
-
-    if (pread(disk_fd, &entry, header.partition_entry_size, (off_t)offset) < 0)
-      break;
 
-    offset += header.partition_entry_size;
-
-    if (entry.first_lba == 0 && entry.last_lba == 0)
-      continue;
-
-    if (entry.first_lba == start_lba) {
-      for (j = 0; j < PATH_MAX - 1 && j < 36 && entry.name[j]; j++)
-        name_out[j] = (char)(entry.name[j] & 0xFF);
-      name_out[j] = '\0';
-      close(disk_fd);
-      return 0;
-    }
-  }
+  /* sysfs start is always in 512-byte units. */
+  entry = openpart_gpt_find_lba(gpt, start_lba * 512 / gpt->info.sector_size, NULL);
+  ret = entry ? openpart_gpt_entry_name(entry, name_out, len) : -1;
 
-  close(disk_fd);
-  return -1;
+  openpart_gpt_close(&gpt);
+  return ret < 0 ? -1 : 0;
 }
 
 const char *openpart_get_part_name(openpart_t *op)
 {
-  static char name[64];
-  const char *path;
-  if (!op)
+  if (!op) {
+    errno = EINVAL;
     return NULL;
+  }
 
-  path = path_from_fd(op->fd);
-  if (!path)
+  if (op->part_name[0] == '\0') {
+    op->err = ENOENT;
     return NULL;
+  }
 
-  if (find_partition_name(op, path, name) < 0)
-    return NULL;
+  return op->part_name;
+}
 
-  return name;
+int openpart_get_part_name_r(openpart_t *op, char *buf, size_t len)
+{
+  const char *name = openpart_get_part_name(op);
+  return name ? copy_to_buf(name, buf, len) : -1;
 }
 
-const char* openpart_get_disk_path(openpart_t* op)
+const char *openpart_get_disk_path(openpart_t *op)
 {
-  if (!op)
+  if (!op) {
+    errno = EINVAL;
     return NULL;
+  }
 
-  static char disk_path[PATH_MAX];
-  if (get_parent_disk(path_from_fd(op->fd), disk_path) < 0)
+  if (op->disk_path[0] == '\0') {
+    op->err = ENOENT;
     return NULL;
+  }
 
-  return disk_path;
+  return op->disk_path;
+}
+
+int openpart_get_disk_path_r(openpart_t *op, char *buf, size_t len)
+{
+  const char *path = openpart_get_disk_path(op);
+  return path ? copy_to_buf(path, buf, len) : -1;
 }
 
 __END_DECLS
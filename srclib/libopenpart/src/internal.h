@@ -18,17 +18,25 @@
 #ifndef LIB_OPENPART__INTERNAL_H
 #define LIB_OPENPART__INTERNAL_H
 
+#include <limits.h>
 #include <stdint.h>
 #include <sys/cdefs.h>
 #include <uuid.h>
 
 #define EROFS_SUPER_OFFSET 1024
-#define QUICK_GET_CONTROLS(op, ret)                                                                                                   \
+/* Cheap facts (fd, size, sector size, path) are filled by openpart_open(), only the handle is checked. */
+#define QUICK_CHECK_CONTROLS(op, ret)                                                                                                 \
   do {                                                                                                                                \
     if (!op) {                                                                                                                        \
       errno = EINVAL;                                                                                                                 \
       return ret;                                                                                                                     \
     }                                                                                                                                 \
+  } while (0)
+
+/* Filesystem facts (uuid, label, fstype) are probed from superblocks on first request. */
+#define QUICK_GET_CONTROLS(op, ret)                                                                                                   \
+  do {                                                                                                                                \
+    QUICK_CHECK_CONTROLS(op, ret);                                                                                                    \
     if (!op->info_loaded) {                                                                                                           \
       if (load_info(op) < 0) {                                                                                                        \
         op->err = errno;                                                                                                              \
@@ -51,6 +59,10 @@ struct __attribute__((packed)) openpart {
   char uuid[37];
   char label[256];
   char fstype[32];
+  char path[PATH_MAX];                // Resolved path, cached at open.
+  char disk_path[PATH_MAX];           // Parent disk path, cached at open. Empty if not a partition.
+  char part_name[OP_GPT_NAME_MAX];    // GPT partition name, cached at open. Empty if not found.
+  openpart_stats_t *stats;            // I/O statistics. NULL if statistics were disabled at open.
 };
 
 // FROM: https://android.googlesource.com/platform/external/erofs-utils/+/refs/heads/main/include/erofs_fs.h
@@ -106,18 +118,19 @@ typedef struct __attribute__((packed)) {
   uint32_t partition_entry_crc32;
 } gpt_header_t;
 
-typedef struct __attribute__((packed)) {
-  uuid_t type_guid;
-  uuid_t unique_guid;
-  uint64_t first_lba;
-  uint64_t last_lba;
-  uint64_t attributes;
-  uint16_t name[36];
-} gpt_entry_t;
+struct openpart_gpt {
+  uint32_t refs; // One for the cache, one for each openpart_gpt_open() caller.
+  openpart_gpt_info_t info;
+  openpart_gpt_entry_t *entries; // info.num_entries entries, compacted to 128 bytes.
+};
 
 int load_info(openpart_t *op);
-const char *path_from_fd(int fd);
-int find_partition_name(openpart_t *op, const char *part_path, char *name_out);
+int copy_to_buf(const char *value, char *buf, size_t len);
+int get_parent_disk(const char *part_path, char *disk_path);
+int find_partition_name(const char *part_path, const char *disk_path, char *name_out, size_t len);
+int stats_alloc(openpart_t *op);
+uint64_t stats_now(void);
+void stats_record(openpart_t *op, int write, uint64_t offset, size_t count, ssize_t ret, uint64_t start_ns);
 
 __END_DECLS
 #endif // #ifndef LIB_OPENPART__INTERNAL_H
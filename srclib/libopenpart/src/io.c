@@ -21,6 +21,8 @@
 #include <unistd.h>
 #include <errno.h>
 #include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
 #include <ext2fs/ext2fs.h>
 #include <ext2fs/ext2_fs.h>
 #include <f2fs_fs.h>
@@ -32,6 +34,16 @@
 #define EROFS_SUPER_MAGIC_V1 0xE0F5E1E2
 #endif
 
+#define PROBE_MAX(a, b) ((a) > (b) ? (a) : (b))
+#define PROBE_WINDOW_ALIGN 4096
+#define PROBE_MAX_THREADS 64
+
+/* One aligned read from offset 0 covers superblocks of all supported filesystems. */
+#define PROBE_WINDOW_END                                                                                                              \
+  PROBE_MAX(PROBE_MAX(SUPERBLOCK_OFFSET + sizeof(struct ext2_super_block), F2FS_SUPER_OFFSET + sizeof(struct f2fs_super_block)),     \
+            PROBE_MAX(EROFS_SUPER_OFFSET + sizeof(struct erofs_super_block), sizeof(struct fat_boot_sector)))
+#define PROBE_WINDOW_SIZE ((PROBE_WINDOW_END + PROBE_WINDOW_ALIGN - 1) / PROBE_WINDOW_ALIGN * PROBE_WINDOW_ALIGN)
+
 __BEGIN_DECLS
 
 static uint32_t read_le32(const uint8_t *buf)
@@ -48,12 +60,10 @@ static uint16_t read_le16(const uint8_t *buf)
          ((uint16_t)buf[1] << 8);
 }
 
-static int read_ext4_info(openpart_t *op)
+static void read_ext4_info(openpart_t *op, const uint8_t *window)
 {
   struct ext2_super_block sb;
-
-  if (pread(op->fd, &sb, sizeof(sb), 1024) < 0)
-    return -1;
+  memcpy(&sb, window + SUPERBLOCK_OFFSET, sizeof(sb));
 
   /* UUID */
   uuid_unparse(sb.s_uuid, op->uuid);
@@ -61,16 +71,12 @@ static int read_ext4_info(openpart_t *op)
   /* label */
   strncpy(op->label, (char *)sb.s_volume_name, sizeof(op->label) - 1);
   op->label[sizeof(op->label) - 1] = '\0';
-
-  return 0;
 }
 
-static int read_f2fs_info(openpart_t *op)
+static void read_f2fs_info(openpart_t *op, const uint8_t *window)
 {
   struct f2fs_super_block sb;
-
-  if (pread(op->fd, &sb, sizeof(sb), F2FS_SUPER_OFFSET) < 0)
-    return -1;
+  memcpy(&sb, window + F2FS_SUPER_OFFSET, sizeof(sb));
 
   /* UUID */
   uuid_unparse(sb.uuid, op->uuid);
@@ -81,33 +87,26 @@ static int read_f2fs_info(openpart_t *op)
   for (i = 0; i < sizeof(op->label) - 1 && sb.volume_name[i]; i++)
     op->label[i] = (char)(sb.volume_name[i] & 0xFF);
   op->label[i] = '\0';
-
-  return 0;
 }
 
-static int read_erofs_info(openpart_t *op)
+static void read_erofs_info(openpart_t *op, const uint8_t *window)
 {
   struct erofs_super_block sb;
-
-  if (pread(op->fd, &sb, sizeof(sb), EROFS_SUPER_OFFSET) < 0)
-    return -1;
+  memcpy(&sb, window + EROFS_SUPER_OFFSET, sizeof(sb));
 
   /* UUID */
   uuid_unparse(sb.uuid, op->uuid);
 
   /* label */
-  strncpy(op->label, (char *)sb.volume_name, sizeof(op->label) - 1);
-  op->label[sizeof(op->label) - 1] = '\0';
-
-  return 0;
+  size_t n = sizeof(sb.volume_name) < sizeof(op->label) - 1 ? sizeof(sb.volume_name) : sizeof(op->label) - 1;
+  memcpy(op->label, sb.volume_name, n);
+  op->label[n] = '\0';
 }
 
-static int read_vfat_info(openpart_t *op)
+static void read_vfat_info(openpart_t *op, const uint8_t *window)
 {
   struct fat_boot_sector bs;
-
-  if (pread(op->fd, &bs, sizeof(bs), 0) < 0)
-    return -1;
+  memcpy(&bs, window, sizeof(bs));
 
   __u8 *vol_id;
   __u8 *vol_label;
@@ -129,79 +128,144 @@ static int read_vfat_info(openpart_t *op)
   /* clean trailing space */
   for (int i = MSDOS_NAME - 1; i >= 0 && op->label[i] == ' '; i--)
     op->label[i] = '\0';
-
-  return 0;
 }
 
-static int detect_fstype(openpart_t *op)
+/* Detect filesystem and read its info from the probe window, without further I/O. */
+static void probe_window(openpart_t *op, const uint8_t *window)
 {
-  uint8_t buf[4096];
-  uint32_t magic32;
-  uint16_t magic16;
-
-  if (pread(op->fd, buf, sizeof(buf), 1024) < 0)
-    return -1;
-  magic32 = read_le32(buf);
-
-  if (magic32 == EXT2_SUPER_MAGIC) {
-    struct ext2_super_block sb;
-    if (pread(op->fd, &sb, sizeof(sb), 1024) < 0) {
-      snprintf(op->fstype, sizeof(op->fstype), "ext4");
-      return 0;
-    }
-
-    if ((sb.s_feature_incompat & EXT3_FEATURE_INCOMPAT_EXTENTS) ||
-        (sb.s_feature_incompat & EXT4_FEATURE_INCOMPAT_64BIT) ||
-        (sb.s_feature_incompat & EXT4_FEATURE_INCOMPAT_FLEX_BG)) {
+  struct ext2_super_block ext;
+  uint32_t magic32 = read_le32(window + SUPERBLOCK_OFFSET);
+
+  memcpy(&ext, window + SUPERBLOCK_OFFSET, sizeof(ext));
+  if (ext.s_magic == EXT2_SUPER_MAGIC) {
+    if ((ext.s_feature_incompat & EXT3_FEATURE_INCOMPAT_EXTENTS) ||
+        (ext.s_feature_incompat & EXT4_FEATURE_INCOMPAT_64BIT) ||
+        (ext.s_feature_incompat & EXT4_FEATURE_INCOMPAT_FLEX_BG)) {
       snprintf(op->fstype, sizeof(op->fstype), "ext4");
-    } else if ((sb.s_feature_incompat & EXT3_FEATURE_INCOMPAT_RECOVER) ||
-               (sb.s_feature_compat & EXT3_FEATURE_COMPAT_HAS_JOURNAL)) {
+    } else if ((ext.s_feature_incompat & EXT3_FEATURE_INCOMPAT_RECOVER) ||
+               (ext.s_feature_compat & EXT3_FEATURE_COMPAT_HAS_JOURNAL)) {
       snprintf(op->fstype, sizeof(op->fstype), "ext3");
     } else {
       snprintf(op->fstype, sizeof(op->fstype), "ext2");
     }
 
-    return 0;
+    read_ext4_info(op, window);
+    return;
   }
   if (magic32 == F2FS_SUPER_MAGIC) {
     snprintf(op->fstype, sizeof(op->fstype), "f2fs");
-    return 0;
+    read_f2fs_info(op, window);
+    return;
   }
   if (magic32 == EROFS_SUPER_MAGIC_V1) {
     snprintf(op->fstype, sizeof(op->fstype), "erofs");
-    return 0;
+    read_erofs_info(op, window);
+    return;
   }
-
-  if (pread(op->fd, buf, 2, 510) < 0)
-    return -1;
-
-  magic16 = read_le16(buf);
-  if (magic16 == 0xAA55) {
+  if (read_le16(window + 510) == 0xAA55) {
     snprintf(op->fstype, sizeof(op->fstype), "vfat");
-    return 0;
+    read_vfat_info(op, window);
+    return;
   }
 
   snprintf(op->fstype, sizeof(op->fstype), "unknown");
-  return 0;
 }
 
 int load_info(openpart_t *op)
 {
-  if (detect_fstype(op) < 0)
+  uint8_t *window;
+  ssize_t ret;
+
+  if (posix_memalign((void **)&window, PROBE_WINDOW_ALIGN, PROBE_WINDOW_SIZE) != 0) {
+    errno = ENOMEM;
     return -1;
+  }
 
-  if (strcmp(op->fstype, "ext4") == 0)
-    return read_ext4_info(op);
-  else if (strcmp(op->fstype, "f2fs") == 0)
-    return read_f2fs_info(op);
-  else if (strcmp(op->fstype, "erofs") == 0)
-    return read_erofs_info(op);
-  else if (strcmp(op->fstype, "vfat") == 0)
-    return read_vfat_info(op);
+  /* Partitions smaller than the window are read partially, the rest stays zero. */
+  memset(window, 0, PROBE_WINDOW_SIZE);
+  do {
+    ret = pread(op->fd, window, PROBE_WINDOW_SIZE, 0);
+  } while (ret < 0 && errno == EINTR);
+
+  if (ret < 0) {
+    int err = errno;
+    free(window);
+    errno = err;
+    return -1;
+  }
 
+  probe_window(op, window);
+  free(window);
   return 0;
 }
 
+struct probe_job {
+  openpart_t **ops;
+  size_t count;
+  size_t next;
+  size_t probed;
+};
+
+static void *probe_worker(void *arg)
+{
+  struct probe_job *job = arg;
+
+  for (;;) {
+    size_t i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+    if (i >= job->count)
+      break;
+
+    openpart_t *op = job->ops[i];
+    if (!op)
+      continue;
+
+    if (!op->info_loaded) {
+      if (load_info(op) < 0) {
+        op->err = errno;
+        continue;
+      }
+      op->info_loaded = 1;
+    }
+    __atomic_fetch_add(&job->probed, 1, __ATOMIC_RELAXED);
+  }
+
+  return NULL;
+}
+
+int openpart_probe_all(openpart_t **ops, size_t count, unsigned int threads)
+{
+  struct probe_job job = {ops, count, 0, 0};
+  pthread_t workers[PROBE_MAX_THREADS];
+  size_t started = 0, i;
+
+  if (!ops) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (threads == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = cpus > 0 ? (unsigned int)cpus : 1;
+  }
+  if (threads > PROBE_MAX_THREADS)
+    threads = PROBE_MAX_THREADS;
+  if (threads > count)
+    threads = (unsigned int)count;
+
+  /* The calling thread is a worker too. */
+  for (i = 1; i < threads; i++) {
+    if (pthread_create(&workers[started], NULL, probe_worker, &job) != 0)
+      break;
+    started++;
+  }
+
+  probe_worker(&job);
+  for (i = 0; i < started; i++)
+    pthread_join(workers[i], NULL);
+
+  return (int)job.probed;
+}
+
 ssize_t openpart_read(openpart_t *op, void *buf, size_t count, uint64_t offset)
 {
   ssize_t ret;
@@ -211,7 +275,12 @@ ssize_t openpart_read(openpart_t *op, void *buf, size_t count, uint64_t offset)
     return -1;
   }
 
-  ret = pread(op->fd, buf, count, (off_t)offset);
+  do {
+    uint64_t start = op->stats ? stats_now() : 0;
+    ret = pread(op->fd, buf, count, (off_t)offset);
+    if (op->stats)
+      stats_record(op, 0, offset, count, ret, start);
+  } while (ret < 0 && errno == EINTR);
   if (ret < 0)
     op->err = errno;
 
@@ -232,7 +301,12 @@ ssize_t openpart_write(openpart_t *op, const void *buf, size_t count, uint64_t o
     return -1;
   }
 
-  ret = pwrite(op->fd, buf, count, (off_t)offset);
+  do {
+    uint64_t start = op->stats ? stats_now() : 0;
+    ret = pwrite(op->fd, buf, count, (off_t)offset);
+    if (op->stats)
+      stats_record(op, 1, offset, count, ret, start);
+  } while (ret < 0 && errno == EINTR);
   if (ret < 0)
     op->err = errno;
 
@@ -269,7 +343,9 @@ ssize_t openpart_write_sector(openpart_t *op, const void *buf, uint64_t sector,
 
 int openpart_get(openpart_t *op, int info, void **out)
 {
-  QUICK_GET_CONTROLS(op, -1);
+  QUICK_CHECK_CONTROLS(op, -1);
+  if (info == OP_INFO_UUID || info == OP_INFO_LABEL || info == OP_INFO_FSTYPE)
+    QUICK_GET_CONTROLS(op, -1);
 
   switch (info) {
     case OP_INFO_SIZE: {
@@ -314,41 +390,14 @@ int openpart_get(openpart_t *op, int info, void **out)
       *out = is_blkdev;
       return 0;
     }
-    case OP_INFO_PART_NAME: {
-      char *part_name = malloc(PATH_MAX);
-      if (!part_name) { op->err = errno; return -1; }
-
-      const char *path = path_from_fd(op->fd);
-      if (!path) {
-        free(part_name);
-        op->err = errno;
-        return -1;
-      }
-
-      if (find_partition_name(op, path, part_name) < 0) {
-        free(part_name);
-        op->err = ENOENT;
-        return -1;
-      }
-
-      *out = part_name;
-      return 0;
-    }
-    case OP_INFO_PART_PATH: {
-      const char *path = path_from_fd(op->fd);
-      if (!path) { op->err = errno; return -1; }
-      char *result = malloc(strlen(path) + 1);
-      if (!result) { op->err = errno; return -1; }
-      strcpy(result, path);
-      *out = result;
-      return 0;
-    }
+    case OP_INFO_PART_NAME:
+    case OP_INFO_PART_PATH:
     case OP_INFO_DISK_PATH: {
-      const char* path = openpart_get_disk_path(op);
-      if (!path) { op->err = errno; return -1; }
-      char* result = malloc(strlen(path) + 1);
+      const char *value = info == OP_INFO_PART_PATH ? op->path : info == OP_INFO_PART_NAME ? op->part_name : op->disk_path;
+      if (value[0] == '\0') { op->err = ENOENT; return -1; }
+      char *result = malloc(strlen(value) + 1);
       if (!result) { op->err = errno; return -1; }
-      strcpy(result, path);
+      strcpy(result, value);
       *out = result;
       return 0;
     }
@@ -367,7 +416,7 @@ int openpart_get(openpart_t *op, int info, void **out)
 
 uint64_t openpart_get_size(openpart_t* op)
 {
-  QUICK_GET_CONTROLS(op, UINT64_MAX);
+  QUICK_CHECK_CONTROLS(op, UINT64_MAX);
   return op->size;
 }
 
@@ -391,19 +440,19 @@ const char* openpart_get_fstype(openpart_t* op)
 
 uint64_t openpart_get_sector_size(openpart_t* op)
 {
-  QUICK_GET_CONTROLS(op, UINT64_MAX);
+  QUICK_CHECK_CONTROLS(op, UINT64_MAX);
   return op->sector_size;
 }
 
 int openpart_get_fd(openpart_t* op)
 {
-  QUICK_GET_CONTROLS(op, -1);
+  QUICK_CHECK_CONTROLS(op, -1);
   return op->fd;
 }
 
 int openpart_get_is_blkdev(openpart_t* op)
 {
-  QUICK_GET_CONTROLS(op, -1);
+  QUICK_CHECK_CONTROLS(op, -1);
 
   if (op->flags & OP_IGNTYPE) {
     struct stat st;
@@ -417,8 +466,17 @@ int openpart_get_is_blkdev(openpart_t* op)
 
 const char* openpart_get_part_path(openpart_t* op)
 {
-  QUICK_GET_CONTROLS(op, NULL);
-  return path_from_fd(op->fd);
+  if (!op) {
+    errno = EINVAL;
+    return NULL;
+  }
+  return op->path;
+}
+
+int openpart_get_part_path_r(openpart_t *op, char *buf, size_t len)
+{
+  const char *path = openpart_get_part_path(op);
+  return path ? copy_to_buf(path, buf, len) : -1;
 }
 
 void openpart_free(void *out)
@@ -36,6 +36,13 @@ static inline int endmntent(FILE* fp) {
   }
   return 1;
 }
+
+static inline struct mntent* getmntent_r(FILE* fp, struct mntent* e, char* buf, int len) {
+  (void)e;
+  (void)buf;
+  (void)len;
+  return getmntent(fp); // Not reentrant before API 21.
+}
 #endif
 
 __BEGIN_DECLS
@@ -43,28 +50,21 @@ __BEGIN_DECLS
 int openpart_is_mounted(openpart_t *op)
 {
   FILE *f;
-  struct mntent *mnt;
-  char fd_path[PATH_MAX];
-  char real_device_path[PATH_MAX];
+  struct mntent mnt_buf, *mnt;
+  char line[PATH_MAX * 2 + 256];
   int found = 0;
 
   if (!op)
     return -1;
 
-  snprintf(fd_path, sizeof(fd_path), "/proc/self/fd/%d", op->fd);
-  if (realpath(fd_path, real_device_path) == NULL) {
-    op->err = errno;
-    return -1;
-  }
-
   f = setmntent("/proc/mounts", "r");
   if (!f) {
     op->err = errno;
     return -1;
   }
 
-  while ((mnt = getmntent(f)) != NULL) {
-    if (strcmp(mnt->mnt_fsname, real_device_path) == 0) {
+  while ((mnt = getmntent_r(f, &mnt_buf, line, sizeof(line))) != NULL) {
+    if (strcmp(mnt->mnt_fsname, op->path) == 0) {
       found = 1;
       break;
     }
@@ -94,7 +94,7 @@ int openpart_mount(openpart_t *op, const char *target, int flags)
   if (flags & OP_MOUNT_RDONLY)
     mflags |= MS_RDONLY;
 
-  if (mount(path_from_fd(op->fd), target, op->fstype, mflags, NULL) < 0) {
+  if (mount(op->path, target, op->fstype, mflags, NULL) < 0) {
     op->err = errno;
     return -1;
   }
@@ -109,7 +109,7 @@ int openpart_umount(openpart_t *op)
     return -1;
   }
 
-  if (umount(path_from_fd(op->fd)) < 0) {
+  if (umount(op->path) < 0) {
     op->err = errno;
     return -1;
   }
@@ -117,38 +117,41 @@ int openpart_umount(openpart_t *op)
   return 0;
 }
 
-const char *openpart_mntpath(openpart_t *op)
+int openpart_mntpath_r(openpart_t *op, char *buf, size_t len)
 {
   FILE *f;
-  struct mntent *mnt;
-  static char mntpath[PATH_MAX];
+  struct mntent mnt_buf, *mnt;
+  char line[PATH_MAX * 2 + 256];
+  int ret = -1;
 
-  if (!op)
-    return NULL;
-
-  const char* path = path_from_fd(op->fd);
-  if (!path) {
-    op->err = errno;
-    return NULL;
+  if (!op) {
+    errno = EINVAL;
+    return -1;
   }
 
   f = setmntent("/proc/mounts", "r");
   if (!f) {
     op->err = errno;
-    return NULL;
+    return -1;
   }
 
-  while ((mnt = getmntent(f)) != NULL) {
-    if (strcmp(mnt->mnt_fsname, path) == 0) {
-      strncpy(mntpath, mnt->mnt_dir, sizeof(mntpath) - 1);
-      mntpath[sizeof(mntpath) - 1] = '\0';
-      endmntent(f);
-      return mntpath;
+  while ((mnt = getmntent_r(f, &mnt_buf, line, sizeof(line))) != NULL) {
+    if (strcmp(mnt->mnt_fsname, op->path) == 0) {
+      ret = copy_to_buf(mnt->mnt_dir, buf, len);
+      if (ret < 0)
+        op->err = errno;
+      break;
     }
   }
 
   endmntent(f);
-  return NULL;
+  return ret;
+}
+
+const char *openpart_mntpath(openpart_t *op)
+{
+  static __thread char mntpath[PATH_MAX];
+  return openpart_mntpath_r(op, mntpath, sizeof(mntpath)) == 1 ? mntpath : NULL;
 }
 
 __END_DECLS
@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2026 Yağız Zengin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <libopenpart/openpart.h>
+#include "internal.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+__BEGIN_DECLS
+
+static int stats_enabled = 0;
+static uint64_t stall_threshold_ns = 0;
+static openpart_stall_handler_t stall_handler = NULL;
+
+/*
+ * Latency histogram has two buckets per power of two of microseconds: bucket 2n covers [2^n, 1.5 * 2^n) us and
+ * bucket 2n + 1 covers [1.5 * 2^n, 2^(n + 1)) us. Buckets 0 and 1 are for 0 and 1 us.
+ */
+static unsigned int bucket_of(uint64_t ns)
+{
+  uint64_t us = ns / 1000;
+  unsigned int msb, bucket;
+
+  if (us < 2)
+    return (unsigned int)us;
+
+  msb = 63 - (unsigned int)__builtin_clzll(us);
+  bucket = 2 * msb + (unsigned int)((us >> (msb - 1)) & 1);
+  return bucket < OP_STATS_BUCKETS ? bucket : OP_STATS_BUCKETS - 1;
+}
+
+/* Upper bound of bucket in nanoseconds. */
+static uint64_t bucket_limit(unsigned int bucket)
+{
+  unsigned int msb;
+
+  if (bucket < 2)
+    return (uint64_t)(bucket + 1) * 1000;
+
+  bucket++;
+  msb = bucket / 2;
+  return ((uint64_t)(2 | (bucket & 1)) << (msb - 1)) * 1000;
+}
+
+static void atomic_max(uint64_t *target, uint64_t value)
+{
+  uint64_t current = __atomic_load_n(target, __ATOMIC_RELAXED);
+  while (current < value && !__atomic_compare_exchange_n(target, &current, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    ;
+}
+
+int stats_alloc(openpart_t *op)
+{
+  op->stats = NULL;
+  if (!__atomic_load_n(&stats_enabled, __ATOMIC_RELAXED))
+    return 0;
+
+  op->stats = calloc(1, sizeof(openpart_stats_t));
+  return op->stats ? 0 : -1;
+}
+
+uint64_t stats_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void stats_record(openpart_t *op, int write, uint64_t offset, size_t count, ssize_t ret, uint64_t start_ns)
+{
+  int saved_errno = errno;
+  openpart_io_stats_t *stats = write ? &op->stats->write : &op->stats->read;
+  uint64_t ns = stats_now() - start_ns;
+  uint64_t threshold = __atomic_load_n(&stall_threshold_ns, __ATOMIC_RELAXED);
+
+  openpart_stats_add(stats, count, ret, ns);
+
+  if (threshold != 0 && ns >= threshold) {
+    openpart_stall_handler_t handler = __atomic_load_n(&stall_handler, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->stalls, 1, __ATOMIC_RELAXED);
+    if (handler)
+      handler(op->path, write, offset, count, ns);
+  }
+
+  errno = saved_errno;
+}
+
+void openpart_stats_add(openpart_io_stats_t *stats, size_t count, ssize_t ret, uint64_t ns)
+{
+  int saved_errno = errno;
+
+  __atomic_fetch_add(&stats->calls, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&stats->total_ns, ns, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&stats->histogram[bucket_of(ns)], 1, __ATOMIC_RELAXED);
+  atomic_max(&stats->max_ns, ns);
+
+  if (ret < 0) {
+    if (saved_errno == EINTR)
+      __atomic_fetch_add(&stats->retries, 1, __ATOMIC_RELAXED);
+    else
+      __atomic_fetch_add(&stats->errors, 1, __ATOMIC_RELAXED);
+  } else {
+    __atomic_fetch_add(&stats->bytes, (uint64_t)ret, __ATOMIC_RELAXED);
+    if ((size_t)ret < count)
+      __atomic_fetch_add(&stats->short_ops, 1, __ATOMIC_RELAXED);
+  }
+
+  errno = saved_errno;
+}
+
+void openpart_stats_enable(int enable)
+{
+  __atomic_store_n(&stats_enabled, enable ? 1 : 0, __ATOMIC_RELAXED);
+}
+
+void openpart_stats_set_stall(uint64_t threshold_ns, openpart_stall_handler_t handler)
+{
+  __atomic_store_n(&stall_handler, handler, __ATOMIC_RELAXED);
+  __atomic_store_n(&stall_threshold_ns, threshold_ns, __ATOMIC_RELAXED);
+}
+
+int openpart_get_stats(openpart_t *op, openpart_stats_t *out)
+{
+  const uint64_t *from;
+  uint64_t *to;
+  size_t i;
+
+  if (!op || !out) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (!op->stats) {
+    op->err = ENODATA;
+    return -1;
+  }
+
+  /* Counters are updated concurrently, copy them one by one. */
+  from = (const uint64_t *)op->stats;
+  to = (uint64_t *)out;
+  for (i = 0; i < sizeof(openpart_stats_t) / sizeof(uint64_t); i++)
+    to[i] = __atomic_load_n(&from[i], __ATOMIC_RELAXED);
+
+  return 0;
+}
+
+void openpart_stats_merge(openpart_stats_t *into, const openpart_stats_t *from)
+{
+  openpart_io_stats_t *to_dirs[2] = {&into->read, &into->write};
+  const openpart_io_stats_t *from_dirs[2] = {&from->read, &from->write};
+  size_t d, i;
+
+  for (d = 0; d < 2; d++) {
+    openpart_io_stats_t *to = to_dirs[d];
+    const openpart_io_stats_t *src = from_dirs[d];
+
+    to->calls += src->calls;
+    to->bytes += src->bytes;
+    to->retries += src->retries;
+    to->short_ops += src->short_ops;
+    to->errors += src->errors;
+    to->stalls += src->stalls;
+    to->total_ns += src->total_ns;
+    if (src->max_ns > to->max_ns)
+      to->max_ns = src->max_ns;
+    for (i = 0; i < OP_STATS_BUCKETS; i++)
+      to->histogram[i] += src->histogram[i];
+  }
+}
+
+uint64_t openpart_stats_percentile(const openpart_io_stats_t *stats, double percentile)
+{
+  uint64_t total = 0, rank, seen = 0, limit;
+  unsigned int i;
+
+  if (!stats)
+    return 0;
+
+  for (i = 0; i < OP_STATS_BUCKETS; i++)
+    total += stats->histogram[i];
+  if (total == 0)
+    return 0;
+
+  rank = (uint64_t)(percentile / 100.0 * (double)total + 0.5);
+  if (rank == 0)
+    rank = 1;
+
+  for (i = 0; i < OP_STATS_BUCKETS; i++) {
+    seen += stats->histogram[i];
+    if (seen >= rank) {
+      /* Last bucket also holds everything over its range, it has no upper bound. */
+      if (i == OP_STATS_BUCKETS - 1)
+        return stats->max_ns;
+      limit = bucket_limit(i);
+      return limit < stats->max_ns ? limit : stats->max_ns;
+    }
+  }
+
+  return stats->max_ns;
+}
+
+__END_DECLS
@@ -76,6 +76,12 @@ static void test_info(openpart_t *op)
   else
     printf("Partition name: FAILED (%s)\n", openpart_strerror(op));
 
+  char name_buf[OP_GPT_NAME_MAX];
+  if (openpart_get_part_name_r(op, name_buf, sizeof(name_buf)) == 1)
+    printf("Partition name (reentrant): %s\n", name_buf);
+  else
+    printf("Partition name (reentrant): FAILED (%s)\n", openpart_strerror(op));
+
   const char* fstype = openpart_get_fstype(op);
   if (fstype != NULL)
     printf("Filesystem:  %s\n", fstype);
@@ -196,6 +202,39 @@ static void test_checksum(openpart_t *op)
   }
 }
 
+static void test_gpt(openpart_t *op)
+{
+  const char *disk_path = openpart_get_disk_path(op);
+  printf("\n=== GPT ===\n");
+  if (!disk_path) {
+    printf("Disk path:   FAILED (%s)\n", openpart_strerror(op));
+    return;
+  }
+
+  openpart_gpt_t *gpt = openpart_gpt_open(disk_path);
+  if (!gpt) {
+    printf("Read:        FAILED (%s)\n", strerror(errno));
+    return;
+  }
+
+  const openpart_gpt_info_t *info = openpart_gpt_info(gpt);
+  printf("Read:        OK (%s, sector size %" PRIu64 ", %s table)\n", disk_path, info->sector_size,
+         info->from_backup ? "backup" : "primary");
+
+  for (uint32_t i = 0; i < info->num_entries; i++) {
+    const openpart_gpt_entry_t *entry = openpart_gpt_entry(gpt, i);
+    char name[OP_GPT_NAME_MAX];
+    if (!openpart_gpt_entry_is_used(entry) || openpart_gpt_entry_name(entry, name, sizeof(name)) < 0)
+      continue;
+    printf("  %-4" PRIu32 " %-24s %" PRIu64 "-%" PRIu64 "\n", i, name, entry->first_lba, entry->last_lba);
+  }
+
+  openpart_gpt_t *cached = openpart_gpt_open(disk_path);
+  printf("Cache:       %s\n", cached == gpt ? "OK" : "FAILED (table is read again)");
+  openpart_gpt_close(&cached);
+  openpart_gpt_close(&gpt);
+}
+
 static void test_hexdump(openpart_t *op)
 {
   printf("\n=== HEXDUMP (first 64 byte) ===\n");
@@ -203,8 +242,119 @@ static void test_hexdump(openpart_t *op)
     printf("Hexdump:     FAILED (%s)\n", openpart_strerror(op));
 }
 
+/* Bucket of the only sample in stats, -1 if there isn't exactly one. */
+static int sample_bucket(const openpart_io_stats_t *stats)
+{
+  int bucket = -1;
+  unsigned int i;
+
+  for (i = 0; i < OP_STATS_BUCKETS; i++) {
+    if (stats->histogram[i] == 0)
+      continue;
+    if (stats->histogram[i] != 1 || bucket != -1)
+      return -1;
+    bucket = (int)i;
+  }
+  return bucket;
+}
+
+/* Bucket and upper bound of a latency, the bound is read as p0 with a slower sample as max. */
+static int bucket_of_sample(uint64_t ns, uint64_t *limit)
+{
+  openpart_io_stats_t stats;
+  int bucket;
+
+  memset(&stats, 0, sizeof(stats));
+  openpart_stats_add(&stats, 1, 1, ns);
+  bucket = sample_bucket(&stats);
+  openpart_stats_add(&stats, 1, 1, UINT64_MAX);
+  *limit = openpart_stats_percentile(&stats, 0);
+  return bucket;
+}
+
+static int test_stats(void)
+{
+  static const struct {
+    uint64_t ns;
+    int bucket;
+    uint64_t limit;
+  } cases[] = {
+      {0, 0, 1000},       {999, 0, 1000},     {1000, 1, 2000},    {1999, 1, 2000},     {2000, 2, 3000},
+      {2999, 2, 3000},    {3000, 3, 4000},    {3999, 3, 4000},    {4000, 4, 6000},     {5999, 4, 6000},
+      {6000, 5, 8000},    {7999, 5, 8000},    {8000, 6, 12000},   {10000, 6, 12000},   {12000, 7, 16000},
+      {100000, 13, 128000}, {1000000, 19, 1024000},
+  };
+  openpart_io_stats_t stats;
+  uint64_t ns = 0, limit, next_limit;
+  unsigned int i;
+  int bucket, failed = 0;
+
+  printf("=== STATS ===\n");
+
+  for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    bucket = bucket_of_sample(cases[i].ns, &limit);
+    if (bucket != cases[i].bucket || limit != cases[i].limit) {
+      printf("Bucket:      FAILED (%" PRIu64 " ns is in bucket %d up to %" PRIu64 " ns, expected %d up to %" PRIu64 " ns)\n",
+             cases[i].ns, bucket, limit, cases[i].bucket, cases[i].limit);
+      failed = 1;
+    }
+  }
+
+  /* Buckets follow each other: the last nanosecond before a bound is in the bucket, the bound is in the next one. */
+  for (i = 0; i < OP_STATS_BUCKETS - 1; i++) {
+    bucket = bucket_of_sample(ns, &limit);
+    if (bucket != (int)i || limit <= ns || bucket_of_sample(limit - 1, &next_limit) != (int)i || next_limit != limit) {
+      printf("Bucket:      FAILED (bucket %u starting at %" PRIu64 " ns is %d up to %" PRIu64 " ns)\n", i, ns, bucket, limit);
+      failed = 1;
+      break;
+    }
+    ns = limit;
+  }
+  if (bucket_of_sample(ns, &limit) != OP_STATS_BUCKETS - 1 || bucket_of_sample(UINT64_MAX / 2, &limit) != OP_STATS_BUCKETS - 1) {
+    printf("Bucket:      FAILED (slow samples aren't in the last bucket)\n");
+    failed = 1;
+  }
+  if (!failed)
+    printf("Buckets:     OK (%d buckets, last starts at %" PRIu64 " ns)\n", OP_STATS_BUCKETS, ns);
+
+  /* Three 10 us samples and one 100 us sample. */
+  memset(&stats, 0, sizeof(stats));
+  for (i = 0; i < 3; i++)
+    openpart_stats_add(&stats, 1, 1, 10000);
+  openpart_stats_add(&stats, 1, 1, 100000);
+  if (openpart_stats_percentile(&stats, 0) != 12000 || openpart_stats_percentile(&stats, 50) != 12000
+      || openpart_stats_percentile(&stats, 75) != 12000 || openpart_stats_percentile(&stats, 90) != 100000
+      || openpart_stats_percentile(&stats, 100) != 100000) {
+    printf("Percentile:  FAILED (p50 %" PRIu64 ", p90 %" PRIu64 ", p100 %" PRIu64 ")\n", openpart_stats_percentile(&stats, 50),
+           openpart_stats_percentile(&stats, 90), openpart_stats_percentile(&stats, 100));
+    failed = 1;
+  }
+
+  /* Percentiles of the last bucket are the slowest sample, not the start of the bucket. */
+  memset(&stats, 0, sizeof(stats));
+  openpart_stats_add(&stats, 1, 1, UINT64_MAX / 2);
+  if (openpart_stats_percentile(&stats, 99) != UINT64_MAX / 2) {
+    printf("Percentile:  FAILED (last bucket is %" PRIu64 " ns)\n", openpart_stats_percentile(&stats, 99));
+    failed = 1;
+  }
+
+  memset(&stats, 0, sizeof(stats));
+  if (openpart_stats_percentile(&stats, 50) != 0 || openpart_stats_percentile(NULL, 50) != 0) {
+    printf("Percentile:  FAILED (empty statistics)\n");
+    failed = 1;
+  }
+  if (!failed)
+    printf("Percentile:  OK\n");
+
+  printf("\n");
+  return failed;
+}
+
 int main(int argc, char** argv)
 {
+  if (test_stats())
+    return 1;
+
   if (argc < 2) {
     fprintf(stderr, "Usage: %s <partition>\n", argv[0]);
     return 1;
@@ -222,6 +372,7 @@ int main(int argc, char** argv)
   test_io(op);
   test_mount(op);
   test_checksum(op);
+  test_gpt(op);
   test_hexdump(op);
 
   printf("\n=== SYNC ===\n");
@@ -26,6 +26,7 @@
 
 #include <filesystem>
 #include <string>
+#include <string_view>
 #include <map>
 #include <type_traits>
 #include <gpt.h>
@@ -53,6 +54,15 @@ enum SizeUnit : int { BYTE = 1, KiB = 2, MiB = 3, GiB = 4 };
 
 enum TableType : int { DYNAMIC = 1, CLASSIC = 2 };
 
+/**
+ * @brief Source of the partition list of @c PartitionTableData.
+ * @note Partitions listed from sysfs only have name, index, table and LBA range; GUIDs and attributes are empty.
+ *       Tables without partition names in sysfs are read with @c NATIVE_SCAN.
+ *       @c NATIVE_SCAN reads tables with the GPT reader of libopenpart; entries are complete.
+ *       In both, GPT data of the tables is still loaded with gptfdisk when requested.
+ */
+enum ScanSource : int { FULL_SCAN = 1, SYSFS_SCAN = 2, NATIVE_SCAN = 3 };
+
 /// @brief A struct that holds basic data about a partition.
 template <typename slot_type, typename = std::enable_if_t<std::is_integral_v<slot_type>>> struct basic_data_base {
   GPTPart gptPart;                 ///< @c GPTPart object.
@@ -170,6 +180,64 @@ inline constexpr uint64_t ELF = 0x464C457F;
 inline constexpr uint64_t RAW = 0x00000000;
 } // namespace AndroidMagic
 
+/// @brief Classes of magic signatures.
+enum MagicClass : int { ANDROID_MAGICS = 1, FILESYSTEM_MAGICS = 2, ALL_MAGICS = ANDROID_MAGICS | FILESYSTEM_MAGICS };
+
+/// @brief Magic signature used by detectMagic().
+struct MagicSignature {
+  uint64_t magic;     ///< Magic value, stored little-endian on disk.
+  const char *name;   ///< Human readable name.
+  int64_t offset;     ///< Byte offset of the magic; -1 if it can be anywhere in the buffer.
+  MagicClass type;    ///< Android or filesystem magic.
+};
+
+/// @brief Known magic signatures, most specific first. Order is the priority when more than one matches.
+inline constexpr MagicSignature MagicSignatures[] = {
+    {AndroidMagic::BOOT_IMAGE, "Android Boot Image", 0, ANDROID_MAGICS},
+    {AndroidMagic::VBOOT_IMAGE, "Android Vendor Boot Image", 0, ANDROID_MAGICS},
+    {AndroidMagic::SPARSE_IMAGE, "Android Sparse Image", 0, ANDROID_MAGICS},
+    {AndroidMagic::SUPER_IMAGE, "Android Super Image", 4096, ANDROID_MAGICS}, // Geometry after reserved bytes.
+    {AndroidMagic::DTBO_IMAGE, "Android DTBO Image", 0, ANDROID_MAGICS},
+    {AndroidMagic::VBMETA_IMAGE, "Android VBMeta Image", 0, ANDROID_MAGICS},
+    {AndroidMagic::ELF, "ELF", 0, ANDROID_MAGICS},
+    {FileSystemMagic::F2FS_FS, "F2FS", 1024, FILESYSTEM_MAGICS},
+    {FileSystemMagic::EROFS_FS, "EROFS", 1024, FILESYSTEM_MAGICS},
+    {FileSystemMagic::EXTFS_FS, "EXT2/3/4", 1024 + 0x38, FILESYSTEM_MAGICS}, // s_magic of superblock.
+    {FileSystemMagic::EXFAT_FS, "exFAT", 3, FILESYSTEM_MAGICS},
+    {FileSystemMagic::NTFS_FS, "NTFS", 3, FILESYSTEM_MAGICS},
+    {FileSystemMagic::FAT32_FS, "FAT32", 0x52, FILESYSTEM_MAGICS},
+    {FileSystemMagic::FAT16_FS, "FAT16", 0x36, FILESYSTEM_MAGICS},
+    {FileSystemMagic::FAT12_FS, "FAT12", 0x36, FILESYSTEM_MAGICS},
+    {AndroidMagic::ZTECFG, "ZTE Configuration", -1, ANDROID_MAGICS},
+    {AndroidMagic::DDR_IMAGE, "DDR Image", -1, ANDROID_MAGICS},
+    {AndroidMagic::LK_IMAGE, "Android LK (Bootloader)", -1, ANDROID_MAGICS},
+    {FileSystemMagic::MSDOS_FS, "MSDOS", -1, FILESYSTEM_MAGICS},
+};
+
+/// @brief Signature searched by deepScan() at every offset.
+struct DeepSignature {
+  const char *name;         ///< Human readable name.
+  std::string_view pattern; ///< Bytes of signature (at least 4, so random data rarely matches).
+};
+
+/// @brief Known signatures of embedded structures.
+inline constexpr DeepSignature DeepSignatures[] = {
+    {"Android Boot Image", std::string_view("ANDROID!", 8)},
+    {"Android Vendor Boot Image", std::string_view("VNDRBOOT", 8)},
+    {"Android Sparse Image", std::string_view("\xED\x26\xFF\x3A", 4)},
+    {"Android Super Metadata", std::string_view("glDa", 4)},
+    {"Android DTBO Image", std::string_view("\xD7\xB7\xAB\x1E", 4)},
+    {"Android VBMeta Image", std::string_view("AVB0", 4)},
+    {"AVB Footer", std::string_view("AVBf", 4)},
+    {"ELF", std::string_view("\x7F" "ELF", 4)},
+    {"gzip Stream", std::string_view("\x1F\x8B\x08\x00", 4)},
+    {"LZ4 Frame", std::string_view("\x04\x22\x4D\x18", 4)},
+    {"LZ4 Legacy Frame", std::string_view("\x02\x21\x4C\x18", 4)},
+    {"XZ Stream", std::string_view("\xFD" "7zXZ\x00", 6)},
+    {"Zstandard Frame", std::string_view("\x28\xB5\x2F\xFD", 4)},
+    {"bzip2 Block", std::string_view("1AY&SY", 6)},
+};
+
 extern std::map<uint64_t, std::string> FileSystemMagics;
 extern std::map<uint64_t, std::string> AndroidMagics;
 extern std::map<uint64_t, std::string> Magics;
@@ -24,7 +24,9 @@
 #ifndef LIBPARTITION_MAP_FUNCTIONS_HPP
 #define LIBPARTITION_MAP_FUNCTIONS_HPP
 
+#include <optional>
 #include <string>
+#include <vector>
 #include <libpartition_map/definations.hpp>
 
 namespace PartitionMap {
@@ -59,6 +61,56 @@ size_t getMagicLength(uint64_t magic);
  */
 bool hasMagic(uint64_t magic, ssize_t buf, const std::string &path);
 
+/// @brief Result of detectMagic().
+struct MagicMatch {
+  const MagicSignature *signature; ///< Matched signature (element of @c MagicSignatures ).
+  uint64_t offset;                 ///< Byte offset of the match.
+};
+
+/**
+ * @brief Detect magic of buffer, all signatures are matched in one pass.
+ *
+ * Signatures with known offsets are checked first, then the first @p scanLength bytes are scanned once for all
+ * signatures (anywhere in the buffer, like hasMagic()). When more than one matches, the earlier signature in
+ * @c MagicSignatures wins.
+ *
+ * @param buffer Buffer.
+ * @param size Size of buffer.
+ * @param scanLength Length of the scanned part of buffer (clamped to @p size ).
+ * @param classes @c MagicClass flags of signatures to match.
+ * @return Match, or @c std::nullopt if nothing matches.
+ */
+std::optional<MagicMatch> detectMagic(const uint8_t *buffer, size_t size, size_t scanLength, int classes = ALL_MAGICS);
+
+/**
+ * @brief Detect magic of file with a single read.
+ *
+ * @param path Path of file or partition.
+ * @param bufferSize Max seek depth for signatures without known offsets.
+ * @param classes @c MagicClass flags of signatures to match.
+ * @return Match, or @c std::nullopt if nothing matches or the file cannot be read.
+ */
+std::optional<MagicMatch> detectMagic(const std::string &path, size_t bufferSize, int classes = ALL_MAGICS);
+
+/// @brief Result of deepScan().
+struct DeepMatch {
+  const DeepSignature *signature; ///< Matched signature (element of @c DeepSignatures ).
+  uint64_t offset;                ///< Byte offset of the match.
+};
+
+/**
+ * @brief Search all @c DeepSignatures in the whole file or partition.
+ *
+ * The file is read in chunks by worker threads; each chunk is scanned once for all signatures.
+ *
+ * @param path Path of file or partition.
+ * @param chunkSize Size of chunks read by workers.
+ * @param threads Worker count (0 for CPU count). Limited to CPU count and chunk count.
+ * @return Every match, sorted by offset.
+ * @throws Helper::Error if the file cannot be opened or read.
+ */
+std::vector<DeepMatch> deepScan(const std::string &path, size_t chunkSize, unsigned int threads = 0);
+
 /**
  * @brief Format magic number.
  *
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2026 Yağız Zengin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file io_stats.hpp
+ * @author Yağız Zengin ([YZBruh](https://github.com/YZBruh))
+ * @brief Collects I/O statistics of closed partition handles.
+ */
+
+#ifndef LIBPARTITION_MAP_IO_STATS_HPP
+#define LIBPARTITION_MAP_IO_STATS_HPP
+
+#include <map>
+#include <string>
+#include <libopenpart/openpart.h>
+
+namespace PartitionMap {
+
+/// @brief Access pattern and read/write mix of a benchmark, named like the rw option of fio.
+struct IOWorkload {
+  std::string name;     ///< Workload name (like randread).
+  bool random;          ///< Random or sequential offsets.
+  unsigned readPercent; ///< 100 = only reads, 0 = only writes.
+};
+
+/// @brief Throughput and latency summary of one direction of a benchmark.
+struct IOSummary {
+  double bandwidth = 0; ///< Bytes per second.
+  double iops = 0;      ///< Calls per second.
+  uint64_t meanNs = 0, p50Ns = 0, p90Ns = 0, p99Ns = 0, p999Ns = 0, maxNs = 0; ///< Latencies.
+};
+
+/**
+ * @brief Process-wide I/O statistics of partitions.
+ *
+ * libopenpart keeps statistics in the handle, so they're lost when the handle is closed. Partition objects pass their
+ * handle here before closing it; statistics are merged by device path (the same device may be opened many times).
+ * Statistics must be enabled with @c openpart_stats_enable() before partitions are opened.
+ *
+ * @note This class cannot be constructible; its purpose is to function like a namespace.
+ */
+class IOStats {
+public:
+  IOStats() = delete;
+
+  /**
+   * @brief Add statistics of a handle which is being closed. Thread-safe.
+   * @param op @c openpart_t* object. Nothing is done if statistics weren't enabled for it.
+   */
+  static void collect(openpart_t *op);
+
+  /// @brief Get collected statistics, keyed by device path (like @c /dev/block/sdc4 ). Thread-safe.
+  static std::map<std::string, openpart_stats_t> collected();
+
+  /// @brief Drop collected statistics.
+  static void clear();
+
+  /**
+   * @brief Parse a workload name: read, write, randread, randwrite, rw or randrw.
+   * @param name Workload name.
+   * @param mixedReadPercent Read percentage of rw and randrw.
+   * @throws Helper::Error if the name is unknown.
+   */
+  static IOWorkload parseWorkload(const std::string &name, unsigned mixedReadPercent);
+
+  /**
+   * @brief Summarize statistics of one direction, collected by any count of jobs.
+   * @param stats Statistics of the direction.
+   * @param seconds Duration of the run. Rates are 0 if it's not positive.
+   */
+  static IOSummary summarize(const openpart_io_stats_t &stats, double seconds);
+
+  /// @brief Format latency for reports (like 12.0us or 1.02ms).
+  static std::string formatLatency(uint64_t ns);
+}; // class IOStats
+
+} // namespace PartitionMap
+
+#endif // #ifndef LIBPARTITION_MAP_IO_STATS_HPP
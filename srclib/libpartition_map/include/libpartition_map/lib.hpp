@@ -26,8 +26,12 @@
 
 #include <libpartition_map/functions.hpp>
 #include <libpartition_map/definations.hpp>
+#include <libpartition_map/io_stats.hpp>
 #include <libpartition_map/partition.hpp>
 #include <libpartition_map/table_data_collection.hpp>
 #include <libpartition_map/builder.hpp>
+#include <libpartition_map/scan_cache.hpp>
+#include <libpartition_map/super_image.hpp>
+#include <libpartition_map/snapshot_archive.hpp>
 
 #endif // #ifndef LIBPARTITION_MAP_LIB_HPP
@@ -24,10 +24,23 @@
 #ifndef LIBPARTITION_MAP_PARTITION_HPP
 #define LIBPARTITION_MAP_PARTITION_HPP
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <exception>
 #include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_set>
 #include <tuple>
 #include <type_traits>
+#include <vector>
+#include <unistd.h>
 #include <asm-generic/fcntl.h>
 #include <gpt.h>
 #include <libhelper/management.hpp>
@@ -37,6 +50,7 @@
 #include <libhelper/definations.hpp>
 #include <libopenpart/openpart.h>
 #include <libpartition_map/definations.hpp>
+#include <libpartition_map/io_stats.hpp>
 
 /**
  * @brief Basic partition management class.
@@ -46,22 +60,251 @@
  * @tparam path_type Path type for holding partition path.
  */
 namespace PartitionMap {
+
+/// @brief Get interned copy of a partition name. The reference stays valid until the program exits.
+inline const std::string &internName(const std::string &name) {
+  static std::mutex mutex;
+  static auto *pool = new std::unordered_set<std::string>(); // Never freed, names may be used during static destruction.
+  std::lock_guard lock(mutex);
+  return *pool->insert(name).first;
+}
+
+/// @brief A piece of logical partition on the super partition. Used for accessing logical partitions without device-mapper.
+struct SuperExtent_t {
+  uint64_t logicalOffset;  ///< Offset in the logical partition.
+  uint64_t physicalOffset; ///< Offset in the super partition.
+  uint64_t size;           ///< Size of extent.
+  bool zero;               ///< Zero extent (reads as zero, not backed by super).
+};
+
 template <typename slot_type, typename size_type, typename path_type,
           typename =
               std::enable_if_t<IsSlotType_v<slot_type> && Helper::IsSizeType_v<size_type> && Helper::IsPathTypeLike_v<path_type>>>
 class BasicPartition_t {
-  path_type localTablePath;       // The table path to which the partition belongs (like /dev/block/sdc).
-  path_type logicalPartitionPath; // Path of logical partition.
-  slot_type localIndex = 0;       // The actual index of the partition within the table.
-  mutable GPTPart gptPart;        // Complete data for the partition.
-  openpart_t *op;                 // libopenpart object.
-
-  bool isLogical = false; // This class contains a logical partition?
+  path_type localTablePath;                     // The table path to which the partition belongs (like /dev/block/sdc).
+  path_type logicalPartitionPath;               // Path of logical partition.
+  slot_type localIndex = 0;                     // The actual index of the partition within the table.
+  mutable GPTPart gptPart;                      // Complete data for the partition.
+  mutable openpart_t *op = nullptr;             // libopenpart object. Opened on first I/O.
+  mutable int opMode = 0;                       // Open mode of op (OP_RDONLY or OP_RDWR).
+  mutable std::mutex opMutex;                   // Guards lazy opening of op.
+  mutable std::vector<openpart_t *> retiredOps; // Objects replaced by openPart(), other threads may still use them.
+  uint64_t sectorSize = 0;                      // Logical sector size of the table (0 = unknown).
+
+  mutable const std::string *internedName = nullptr;   // Interned name, computed on first use.
+  mutable std::optional<path_type> cachedPathByName;   // Cached result of pathByName().
+  mutable std::optional<path_type> cachedAbsolutePath; // Cached result of absolutePath().
+  mutable std::mutex cacheMutex;                       // Guards cached values above.
+
+  std::optional<uint64_t> knownSize; // Size of logical partition calculated from super metadata.
+  bool isLogical = false;            // This class contains a logical partition?
+
+  path_type superPath;                                          // Super partition of logical partition (for direct I/O).
+  std::shared_ptr<const std::vector<SuperExtent_t>> extents;    // Extents of logical partition on super, sorted by logical offset.
+  bool direct = false;                                          // I/O is done through super instead of device-mapper?
+  std::string directWriteProblem;                               // Why writes through super are refused, empty if allowed.
+
+  static constexpr uint64_t DIRECT_RANGE_SIZE = 64ULL * 1024 * 1024; // Maximum size of one parallel direct I/O range.
 
   void process_ctor(const slot_type &index) { localIndex = index; }
   void process_ctor(const GPTPart &part) { gptPart = part; }
   void process_ctor(const path_type &path) { localTablePath = path; }
-  void process_ctor(openpart_t *_op) { op = _op; }
+  void process_ctor(openpart_t *_op) {
+    op = _op;
+    if (op) opMode = OP_RDWR;
+  }
+
+  /// @brief Releases the openpart object (if opened) and objects replaced by openPart().
+  void release() const {
+    for (openpart_t *retired : retiredOps) {
+      IOStats::collect(retired);
+      openpart_close(&retired);
+    }
+    retiredOps.clear();
+
+    if (op) IOStats::collect(op); // Statistics of the handle are lost on close.
+    openpart_close(&op);
+    opMode = 0;
+  }
+
+  /// @brief Drops cached name and paths. Must be called when GPT data or paths are changed.
+  void invalidateCache() {
+    std::lock_guard lock(cacheMutex);
+    internedName = nullptr;
+    cachedPathByName.reset();
+    cachedAbsolutePath.reset();
+  }
+
+  /**
+   * @brief Split extents of logical partition into independent I/O ranges.
+   *
+   * Ranges never cross extent boundaries, and large extents are split into @c DIRECT_RANGE_SIZE pieces
+   * so a partition with a single extent is still processed in parallel.
+   */
+  std::vector<SuperExtent_t> directRanges() const {
+    std::vector<SuperExtent_t> ranges;
+    for (const auto &extent : *extents) {
+      for (uint64_t pos = 0; pos < extent.size; pos += DIRECT_RANGE_SIZE) {
+        const uint64_t size = std::min<uint64_t>(DIRECT_RANGE_SIZE, extent.size - pos);
+        ranges.push_back({extent.logicalOffset + pos, extent.zero ? 0 : extent.physicalOffset + pos, size, extent.zero});
+      }
+    }
+    return ranges;
+  }
+
+  /**
+   * @brief Extra threads which direct I/O ranges may still start. Shared by all partitions, so concurrent dumps and
+   * writes (like jobs of AsyncManager) don't start one thread per CPU each.
+   */
+  static std::atomic<size_t> &rangeThreadBudget() {
+    static std::atomic<size_t> budget(std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return budget;
+  }
+
+  /**
+   * @brief Run @p func for all ranges concurrently. The first exception is rethrown after all workers are stopped.
+   *
+   * The calling thread always works, extra threads are taken from @ref rangeThreadBudget() and returned when done.
+   * Without a free budget the ranges are processed sequentially.
+   */
+  template <typename Func> static void forEachRange(const std::vector<SuperExtent_t> &ranges, Func &&func) {
+    if (ranges.empty()) return;
+
+    std::atomic<size_t> &budget = rangeThreadBudget();
+    size_t extra = budget.load();
+    while (!budget.compare_exchange_weak(extra, extra - std::min(extra, ranges.size() - 1))) {}
+    extra = std::min(extra, ranges.size() - 1);
+    auto giveBack = Helper::makeScopeGuard([&budget, extra] { budget.fetch_add(extra); });
+
+    std::atomic<size_t> next{0};
+    std::exception_ptr error;
+    std::mutex errorMutex;
+
+    auto worker = [&] {
+      for (size_t i = next.fetch_add(1); i < ranges.size(); i = next.fetch_add(1)) {
+        try {
+          func(ranges[i]);
+        } catch (...) {
+          std::lock_guard lock(errorMutex);
+          if (!error) error = std::current_exception();
+          next.store(ranges.size());
+        }
+      }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < extra; i++)
+      threads.emplace_back(worker);
+    worker();
+    for (auto &thread : threads)
+      thread.join();
+
+    if (error) std::rethrow_exception(error);
+  }
+
+  /// @brief Find the extent which contains the given offset of logical partition.
+  const SuperExtent_t *extentOf(uint64_t offset) const {
+    const auto it = std::upper_bound(extents->begin(), extents->end(), offset,
+                                     [](uint64_t value, const SuperExtent_t &extent) { return value < extent.logicalOffset; });
+    if (it == extents->begin()) return nullptr;
+    const SuperExtent_t &extent = *std::prev(it);
+    return offset < extent.logicalOffset + extent.size ? &extent : nullptr;
+  }
+
+  /// @brief Dump image of partition through super.
+  bool dumpDirect(const path_type &dest, size_type bufsize, const std::function<void(size_type, size_type)> &callback) const {
+    openpart_t *handle = openPart(OP_RDONLY);
+    const size_type totalBytesToRead = size();
+
+    auto outfd = Helper::UniqueFD(dest, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (!outfd) throw Error("Cannot create/open {}: {}", dest.string(), strerror(errno));
+    if (ftruncate(outfd.fd(), static_cast<off_t>(totalBytesToRead)) != 0)
+      throw Error("Cannot resize {}: {}", dest.string(), strerror(errno));
+
+    std::atomic<size_type> bytesReadSoFar{0};
+    std::mutex callbackMutex;
+    const auto ranges = directRanges();
+    Log::info("Reading {} through {} in {} range(s).", name(), superPath.string(), ranges.size());
+
+    forEachRange(ranges, [&](const SuperExtent_t &range) {
+      Helper::Trace::Span span("read", "read {} range at {}", nameRef(), range.logicalOffset);
+      std::vector<char> buffer(range.zero ? 0 : std::min<uint64_t>(bufsize, range.size));
+      for (uint64_t pos = 0; pos < range.size;) {
+        const uint64_t toRead = std::min<uint64_t>(range.zero ? range.size : buffer.size(), range.size - pos);
+
+        if (!range.zero) { // Zero extents are left as holes.
+          const ssize_t bytesRead = openpart_read(handle, buffer.data(), toRead, range.physicalOffset + pos);
+          if (bytesRead != static_cast<ssize_t>(toRead)) throw Error("Cannot read {}: {}", superPath.string(), strerror(errno));
+          if (pwrite(outfd.fd(), buffer.data(), toRead, static_cast<off_t>(range.logicalOffset + pos)) != static_cast<ssize_t>(toRead))
+            throw Error("Cannot write {}: {}", dest.string(), strerror(errno));
+        }
+
+        pos += toRead;
+        const size_type done = bytesReadSoFar.fetch_add(toRead) + toRead;
+        if (callback) {
+          std::lock_guard lock(callbackMutex);
+          callback(done, totalBytesToRead);
+        }
+      }
+    });
+
+    return bytesReadSoFar.load() == totalBytesToRead;
+  }
+
+  /// @brief Write input image to partition through super.
+  bool writeDirect(const path_type &image, size_type imageSize, size_type bufsize,
+                   const std::function<void(size_type, size_type)> &callback) {
+    openpart_t *handle = openPart(OP_RDWR);
+    auto imagefd = Helper::UniqueFD(image, O_RDONLY);
+    if (!imagefd) throw Error("Cannot open {}: {}", image.string(), strerror(errno));
+    imagefd.syncOnClose = false;
+
+    std::atomic<size_type> bytesWrittenSoFar{0};
+    std::mutex callbackMutex;
+    const auto ranges = directRanges();
+    Log::info("Writing {} through {} in {} range(s).", name(), superPath.string(), ranges.size());
+
+    forEachRange(ranges, [&](const SuperExtent_t &range) {
+      if (range.zero) return; // Writes to zero extents are discarded by device-mapper too.
+      Helper::Trace::Span span("write", "write {} range at {}", nameRef(), range.logicalOffset);
+
+      std::vector<char> buffer(std::min<uint64_t>(bufsize, range.size));
+      for (uint64_t pos = 0; pos < range.size;) {
+        const uint64_t offset = range.logicalOffset + pos, toWrite = std::min<uint64_t>(buffer.size(), range.size - pos);
+        const uint64_t fromImage = offset < imageSize ? std::min<uint64_t>(toWrite, imageSize - offset) : 0;
+
+        if (fromImage > 0 &&
+            pread(imagefd.fd(), buffer.data(), fromImage, static_cast<off_t>(offset)) != static_cast<ssize_t>(fromImage))
+          throw Error("Cannot read {}: {}", image.string(), strerror(errno));
+        std::fill(buffer.begin() + static_cast<std::ptrdiff_t>(fromImage), buffer.begin() + static_cast<std::ptrdiff_t>(toWrite),
+                  0x00);
+
+        if (openpart_write(handle, buffer.data(), toWrite, range.physicalOffset + pos) != static_cast<ssize_t>(toWrite))
+          throw Error("Cannot write {}: {}", superPath.string(), strerror(errno));
+
+        pos += toWrite;
+        if (fromImage == 0) continue;
+        const size_type done = bytesWrittenSoFar.fetch_add(fromImage) + fromImage;
+        if (callback) {
+          std::lock_guard lock(callbackMutex);
+          callback(done, imageSize);
+        }
+      }
+    });
+
+    Log::info("Syncing {}...", superPath.string());
+    Helper::Trace::Span span("sync", "sync {}", superPath.string());
+    openpart_sync(handle);
+    return bytesWrittenSoFar.load() >= imageSize;
+  }
+
+  /// @brief Copies cached name and paths from another object.
+  void copyCache(const BasicPartition_t &other) {
+    std::scoped_lock lock(cacheMutex, other.cacheMutex);
+    internedName = other.internedName;
+    cachedPathByName = other.cachedPathByName;
+    cachedAbsolutePath = other.cachedAbsolutePath;
+  }
 
 public:
   /// @brief Extra functions for partition management.
@@ -81,38 +324,44 @@ public:
     orig.isLogical = true;
     orig.logicalPartitionPath = path;
     orig.gptPart = GPTPart();
-
-    openpart_close(&orig.op);
-    orig.op = openpart_open(path.string().c_str(), OP_RDWR, 0);
-    if (!orig.op) throw Error("Cannot create openpart object: {}", openpart_strerror(orig.op));
+    orig.knownSize.reset();
+    orig.superPath.clear();
+    orig.extents.reset();
+    orig.direct = false;
+    orig.directWriteProblem.clear();
+    orig.release();
+    orig.invalidateCache();
 
     return orig;
   }
 
   /// @brief Destructor.
-  ~BasicPartition_t() { openpart_close(&op); }
+  ~BasicPartition_t() { release(); }
 
   /// @brief Default constructor.
   BasicPartition_t() : gptPart(GPTPart()), op(nullptr) {}
-  /// @brief Copy constructor.
+  /// @brief Copy constructor. The openpart object is not shared, the copy opens its own on first I/O.
   BasicPartition_t(const BasicPartition_t &other)
       : localTablePath(other.localTablePath), logicalPartitionPath(other.logicalPartitionPath), localIndex(other.localIndex),
-        gptPart(other.gptPart), isLogical(other.isLogical) {
-    if (other.op) {
-      std::string path = other.isLogical ? other.logicalPartitionPath.string() : std::string(openpart_get_part_path(other.op));
-      op = openpart_open(path.c_str(), OP_RDWR, 0);
-      if (!op) throw Error("Cannot create openpart object: {}", openpart_strerror(op));
-    } else
-      op = nullptr;
+        gptPart(other.gptPart), op(nullptr), sectorSize(other.sectorSize), knownSize(other.knownSize), isLogical(other.isLogical),
+        superPath(other.superPath), extents(other.extents), direct(other.direct), directWriteProblem(other.directWriteProblem) {
+    copyCache(other);
   }
   /// @brief Move constructor.
   BasicPartition_t(BasicPartition_t &&other) noexcept
       : localTablePath(std::move(other.localTablePath)), logicalPartitionPath(std::move(other.logicalPartitionPath)),
-        localIndex(other.localIndex), gptPart(other.gptPart), op(other.op), isLogical(other.isLogical) {
+        localIndex(other.localIndex), gptPart(other.gptPart), op(other.op), opMode(other.opMode),
+        retiredOps(std::move(other.retiredOps)), sectorSize(other.sectorSize), knownSize(other.knownSize), isLogical(other.isLogical),
+        superPath(std::move(other.superPath)), extents(std::move(other.extents)), direct(other.direct),
+        directWriteProblem(std::move(other.directWriteProblem)) {
+    copyCache(other);
     other.localIndex = 0;
     other.gptPart = GPTPart();
     other.op = nullptr;
+    other.opMode = 0;
     other.isLogical = false;
+    other.direct = false;
+    other.invalidateCache();
   }
 
   /**
@@ -144,14 +393,7 @@ public:
    * @param input Basic data.
    */
   explicit BasicPartition_t(const basic_data_base<slot_type> &input)
-      : localTablePath(input.tablePath), localIndex(input.index), gptPart(input.gptPart) {
-    if (input.op) {
-      const char *path = openpart_get_part_path(input.op);
-      op = openpart_open(path, OP_RDWR, 0);
-      if (!op) throw Error("Cannot create openpart object: {}", openpart_strerror(op));
-    } else
-      op = nullptr;
-  }
+      : localTablePath(input.tablePath), localIndex(input.index), gptPart(input.gptPart), op(nullptr) {}
 
   /**
    * @brief Constructor for logical partitions.
@@ -164,10 +406,7 @@ public:
    * @param path Logical partition path.
    */
   explicit BasicPartition_t(const path_type &path) /* NOLINT(modernize-pass-by-value) */
-      : logicalPartitionPath(path), gptPart(GPTPart()), isLogical(true) {
-    op = openpart_open(path.string().c_str(), OP_RDWR, 0);
-    if (!op) throw Error("Cannot create openpart object: {}", openpart_strerror(op));
-  }
+      : logicalPartitionPath(path), gptPart(GPTPart()), op(nullptr), isLogical(true) {}
 
   /// @brief Get copy of @c GPTPart data.
   GPTPart getGPTPart() const {
@@ -175,24 +414,50 @@ public:
     return gptPart;
   }
 
-  /// @brief Get reference of @c GPTPart data (non-constant reference).
-  GPTPart *getGPTPartRef() {
-    if (isLogical) throw Error("Cannot get GPTPart data: Is logical partition");
-    return &gptPart;
-  }
-
-  /// @brief Get reference of @c GPTPart data (constant reference).
+  /**
+   * @brief Get reference of @c GPTPart data (constant reference).
+   * @note Partition tables index partitions by name; use @c PartitionTableData::renamePartition() for renaming.
+   */
   const GPTPart *getGPTPartRef() const {
     if (isLogical) throw Error("Cannot get GPTPart data: Is logical partition");
     return &gptPart;
   }
 
-  /// @brief Get openpart object.
+  /// @brief Get openpart object. Returns @c nullptr if the partition is not opened yet.
   openpart_t *getOpenPart() { return op; }
 
-  /// @brief Get openpart object (constant reference).
+  /// @brief Get openpart object (constant reference). Returns @c nullptr if the partition is not opened yet.
   const openpart_t *getOpenPart() const { return op; }
 
+  /**
+   * @brief Get openpart object, opens the partition on first use.
+   *
+   * @param mode @c OP_RDONLY or @c OP_RDWR. An already opened read-only object is reopened when @c OP_RDWR is requested;
+   *             the old object is kept open until the partition is released, other threads may still use it.
+   * @return Opened openpart object.
+   * @note With direct I/O the super partition is opened, use readAt() and writeAt() for partition offsets.
+   */
+  openpart_t *openPart(int mode = OP_RDONLY) const {
+    std::lock_guard lock(opMutex);
+    if (op && (opMode == OP_RDWR || mode == OP_RDONLY)) return op;
+
+    if (direct && mode == OP_RDWR && !directWriteProblem.empty())
+      throw Error("Cannot write {} through {}: {}", name(), superPath.string(), directWriteProblem);
+
+    const path_type toOpen = direct ? superPath : path();
+    if (op) Log::info("Reopening {} as read-write.", std::quoted_string(toOpen));
+
+    openpart_t *opened = openpart_open(toOpen.string().c_str(), mode, 0);
+    if (!opened) throw Error("Cannot open {}: {}", toOpen.string(), strerror(errno));
+    if (op) retiredOps.push_back(op); // Returned to other callers before, closed with this object.
+    op = opened;
+    opMode = mode;
+    return op;
+  }
+
+  /// @brief Checks whether the openpart object is opened.
+  bool isOpened() const { return op != nullptr; }
+
   /// @brief Get partition path (like @c /dev/block/sdc4 ).
   path_type path() const {
     const std::string suffix = isdigit(localTablePath.string().back()) ? "p" : "";
@@ -202,11 +467,19 @@ public:
 
   /**
    * @brief Get absolute partition path.
-   * @return std::filesystem::read_symlink(getPath()) For normal partitions.
+   * @return Target of the logical partition link (like @c /dev/block/dm-4 ), or path() if it cannot be read (not mapped).
    */
   path_type absolutePath() const {
-    if (isLogical) return std::filesystem::read_symlink(logicalPartitionPath);
-    return path();
+    if (!isLogical || direct) return path();
+
+    std::lock_guard lock(cacheMutex);
+    if (!cachedAbsolutePath) {
+      std::error_code ec;
+      auto target = std::filesystem::read_symlink(logicalPartitionPath, ec);
+      if (ec) return logicalPartitionPath; // Not cached, the partition may be mapped later.
+      cachedAbsolutePath = std::move(target);
+    }
+    return *cachedAbsolutePath;
   }
 
   /// @brief Get @c tablePath variable.
@@ -218,19 +491,30 @@ public:
   /// @brief Get partition path by name.
   path_type pathByName() const {
     if (isLogical) return logicalPartitionPath;
+
+    const std::string &partName = nameRef();
+    std::lock_guard lock(cacheMutex);
+    if (cachedPathByName) return *cachedPathByName;
+
     path_type result = "/dev/block/by-name";
-    result.append(gptPart.GetDescription());
+    result.append(partName);
 
-    if (!std::filesystem::exists("/dev/block/by-name") || std::filesystem::read_symlink(result) != path()) return {};
+    std::error_code ec;
+    if (!std::filesystem::exists("/dev/block/by-name", ec) || std::filesystem::read_symlink(result, ec) != path()) result.clear();
+    cachedPathByName = result;
     return result;
   }
 
-  /// @brief Get partition name.
-  std::string name() const {
-    if (isLogical) return logicalPartitionPath.filename().string();
-    return gptPart.GetDescription();
+  /// @brief Get interned partition name. The GPT name is converted only once.
+  const std::string &nameRef() const {
+    std::lock_guard lock(cacheMutex);
+    if (!internedName) internedName = &internName(isLogical ? logicalPartitionPath.filename().string() : gptPart.GetDescription());
+    return *internedName;
   }
 
+  /// @brief Get partition name.
+  std::string name() const { return nameRef(); }
+
   /// @brief Get table name.
   std::string tableName() const {
     if (isLogical) throw Error("Cannot return table name: Is logical partition");
@@ -283,23 +567,33 @@ public:
     return localIndex;
   }
 
-  /// @brief Get partition size in bytes.
+  /// @brief Get partition size in bytes. Calculated from GPT data or super metadata if they are known.
   size_type size() const {
-    uint64_t size = openpart_get_size(op);
-    if (size == UINT64_MAX) throw Error("Cannot get size of {}: {}", name(), openpart_strerror(op));
+    if (isLogical && knownSize) return *knownSize;
+    if (!isLogical && sectorSize != 0) return (gptPart.GetLastLBA() - gptPart.GetFirstLBA() + 1) * sectorSize;
+
+    openpart_t *handle = openPart(OP_RDONLY);
+    uint64_t size = openpart_get_size(handle);
+    if (size == UINT64_MAX) throw Error("Cannot get size of {}: {}", name(), openpart_strerror(handle));
     return size;
   }
 
+  /// @brief Get sector size of the partition table.
+  size_type sectorSizeOfTable() const {
+    if (sectorSize != 0) return sectorSize;
+    return openpart_get_sector_size(openPart(OP_RDONLY));
+  }
+
   /// @brief Get starting byte address.
   size_type start() const {
     if (isLogical) throw Error("Cannot return start address: Is logical partition");
-    return gptPart.GetFirstLBA() * openpart_get_sector_size(op);
+    return gptPart.GetFirstLBA() * sectorSizeOfTable();
   }
 
   /// @brief Get ending byte address.
   size_type end() const {
     if (isLogical) throw Error("Cannot return end address: Is logical partition");
-    return (gptPart.GetLastLBA() + 1) * openpart_get_sector_size(op);
+    return (gptPart.GetLastLBA() + 1) * sectorSizeOfTable();
   }
 
   /// @brief Get partition GUID.
@@ -311,9 +605,10 @@ public:
   /// @brief Dump image of partition.
   [[maybe_unused]] bool dump(const path_type &destination = "", size_type bufsize = MB(1), IOCallback callback = nullptr) const {
     const path_type dest = destination.empty() ? (path_type("./") += name() + ".img") : destination;
+    Helper::Trace::Span span("read", "read {}", nameRef());
+    if (direct) return dumpDirect(dest, bufsize, callback);
     const path_type toOpen = isLogical ? absolutePath() : path();
-
-    if (!op) throw Error("openpart_t* object invalid: {}", std::quoted_string(toOpen.c_str()));
+    openpart_t *handle = openPart(OP_RDONLY);
 
     auto outfd = Helper::UniqueFD(dest, O_WRONLY | O_CREAT | O_TRUNC, 0644);
     if (!outfd) throw Error("Cannot create/open {}: {}", dest.string(), strerror(errno));
@@ -327,7 +622,7 @@ public:
     while (bytesReadSoFar < totalBytesToRead) {
       size_type toRead = std::min(bufferSize, totalBytesToRead - bytesReadSoFar);
 
-      ssize_t bytesRead = openpart_read(op, buffer.data(), toRead, bytesReadSoFar);
+      ssize_t bytesRead = openpart_read(handle, buffer.data(), toRead, bytesReadSoFar);
       if (bytesRead <= 0) {
         if (errno == EPERM) throw Error("Cannot read {}: {}", toOpen.string(), strerror(errno));
       }
@@ -345,11 +640,12 @@ public:
   /// @brief Write input image to partition.
   [[maybe_unused]] bool write(const path_type &image, size_type bufsize = MB(1), IOCallback callback = nullptr) {
     const path_type toWrite = isLogical ? absolutePath() : path();
+    openpart_t *handle = openPart(OP_RDWR);
     const int64_t imageSize = Helper::fileSize(image);
     if (imageSize < 0) throw Error("Cannot get size of {}: {}", image.string(), strerror(errno));
     if (imageSize > size()) throw Error("Image is too large: {} ({} > {})", image.string(), imageSize, size());
-
-    if (!op) throw Error("openpart_t* object invalid: {}", std::quoted_string(toWrite.c_str()));
+    Helper::Trace::Span span("write", "write {}", nameRef());
+    if (direct) return writeDirect(image, imageSize, bufsize, callback);
 
     auto imagefd = Helper::UniqueFD(image, O_RDONLY);
     if (!imagefd) throw Error("Cannot open {}: {}", image.string(), strerror(errno));
@@ -364,7 +660,7 @@ public:
       ssize_t bytesRead = imagefd.read(buffer.data(), toRead);
       if (bytesRead <= 0) throw Error("Cannot read {}: {}", image.string(), strerror(errno));
 
-      if (const ssize_t bytesWritten = openpart_write(op, buffer.data(), bytesRead, bytesWrittenSoFar); bytesWritten != bytesRead)
+      if (const ssize_t bytesWritten = openpart_write(handle, buffer.data(), bytesRead, bytesWrittenSoFar); bytesWritten != bytesRead)
         throw Error("Cannot write {}: {}", toWrite.string(), strerror(errno));
 
       bytesWrittenSoFar += bytesRead;
@@ -377,7 +673,7 @@ public:
 
       while (remainingBytes > 0) {
         size_type toWriteSize = std::min<uint64_t>(buffer.size(), remainingBytes);
-        ssize_t written = openpart_write(op, buffer.data(), toWriteSize, bytesWrittenSoFar);
+        ssize_t written = openpart_write(handle, buffer.data(), toWriteSize, bytesWrittenSoFar);
 
         if (written <= 0) throw Error("Cannot fill the outside of partition (of image): {}", strerror(errno));
         remainingBytes -= written;
@@ -386,7 +682,8 @@ public:
     }
 
     Log::info("Syncing {}...", toWrite.string());
-    openpart_sync(op);
+    Helper::Trace::Span syncSpan("sync", "sync {}", toWrite.string());
+    openpart_sync(handle);
     return bytesWrittenSoFar == imageSize;
   }
 
@@ -394,34 +691,147 @@ public:
   void set(const basic_data_base<slot_type> &data) {
     if (isLogical) throw Error("This is not a normal partition object!");
     gptPart = data.gptPart;
+    release();
     op = data.op;
+    if (op) opMode = OP_RDWR;
     localTablePath = data.tablePath;
     localIndex = data.index;
+    invalidateCache();
   }
 
   /// @brief Set partition path. Only for logical partitions.
   void setPartitionPath(const path_type &path) {
     if (!isLogical) throw Error("This is not a logical partition object!");
     logicalPartitionPath = path;
+    invalidateCache();
   }
 
   /// @brief Set partition index.
   void setIndex(slot_type new_index) {
     if (isLogical) throw Error("This is not a normal partition object!");
     localIndex = new_index;
+    invalidateCache();
   }
 
   /// @brief Set @c GPTPart object.
   void setGptPart(const GPTPart &otherGptPart) {
     if (isLogical) throw Error("This is not a normal partition object!");
     gptPart = otherGptPart;
+    invalidateCache();
   }
 
   /// @brief Set openpart object. Available openpart_t* objects is releasing.
   void setOpenPart(openpart_t *_op) {
     if (isLogical) throw Error("This is not a normal partition object!");
-    openpart_close(&op);
+    release();
     op = _op;
+    if (op) opMode = OP_RDWR;
+  }
+
+  /// @brief Set sector size of the partition table. Used for calculating size and addresses without opening the partition.
+  void setSectorSize(uint64_t size) { sectorSize = size; }
+
+  /// @brief Set size of logical partition calculated from super metadata. The partition is not opened for getting size.
+  void setLogicalSize(uint64_t size) {
+    if (!isLogical) throw Error("This is not a logical partition object!");
+    knownSize = size;
+  }
+
+  /**
+   * @brief Set extents of logical partition on the super partition. Direct I/O can be enabled after this.
+   *
+   * @param super Path of super partition.
+   * @param superExtents Extents sorted by logical offset. Size of partition is set to total size of extents.
+   */
+  void setSuperExtents(const path_type &super, std::vector<SuperExtent_t> superExtents) {
+    if (!isLogical) throw Error("This is not a logical partition object!");
+    uint64_t total = 0;
+    for (const auto &extent : superExtents)
+      total += extent.size;
+
+    std::lock_guard lock(opMutex);
+    superPath = super;
+    extents = std::make_shared<const std::vector<SuperExtent_t>>(std::move(superExtents));
+    knownSize = total;
+  }
+
+  /**
+   * @brief Enable or disable direct I/O.
+   *
+   * With direct I/O, offsets of logical partition are translated through its extents onto the super partition,
+   * so the partition can be read and written without a device-mapper device (like in recovery or early boot).
+   */
+  void setDirectIO(bool enable) {
+    if (enable && !extents) throw Error("Cannot enable direct I/O for {}: Extents on super are unknown", name());
+
+    std::lock_guard lock(opMutex);
+    if (direct == enable) return;
+    direct = enable;
+    release(); // The other device is opened on next I/O.
+  }
+
+  /// @brief Checks whether the partition is accessed through super (without device-mapper).
+  bool isDirectIO() const { return direct; }
+
+  /**
+   * @brief Refuse writes through super. Reads are still allowed, opening for writing with direct I/O throws.
+   * @param problem Reason shown in the error, an empty string allows writes again.
+   */
+  void refuseDirectWrites(std::string problem) {
+    std::lock_guard lock(opMutex);
+    directWriteProblem = std::move(problem);
+  }
+
+  /**
+   * @brief Read from partition. Offsets are translated through extents with direct I/O.
+   * @return Read size, or -1 on error.
+   */
+  ssize_t readAt(void *buffer, size_t count, uint64_t offset) const {
+    openpart_t *handle = openPart(OP_RDONLY);
+    if (!direct) return openpart_read(handle, buffer, count, offset);
+
+    size_t done = 0;
+    while (done < count) {
+      const SuperExtent_t *extent = extentOf(offset + done);
+      if (!extent) break; // End of partition.
+
+      const uint64_t inExtent = offset + done - extent->logicalOffset;
+      const size_t toRead = std::min<uint64_t>(count - done, extent->size - inExtent);
+      if (extent->zero)
+        std::memset(static_cast<char *>(buffer) + done, 0, toRead);
+      else if (openpart_read(handle, static_cast<char *>(buffer) + done, toRead, extent->physicalOffset + inExtent) !=
+               static_cast<ssize_t>(toRead))
+        return -1;
+      done += toRead;
+    }
+    return static_cast<ssize_t>(done);
+  }
+
+  /**
+   * @brief Write to partition. Offsets are translated through extents with direct I/O.
+   * @return Written size, or -1 on error.
+   */
+  ssize_t writeAt(const void *buffer, size_t count, uint64_t offset) const {
+    openpart_t *handle = openPart(OP_RDWR);
+    if (!direct) return openpart_write(handle, buffer, count, offset);
+
+    size_t done = 0;
+    while (done < count) {
+      const SuperExtent_t *extent = extentOf(offset + done);
+      if (!extent) break; // End of partition.
+
+      const uint64_t inExtent = offset + done - extent->logicalOffset;
+      const size_t toWrite = std::min<uint64_t>(count - done, extent->size - inExtent);
+      if (extent->zero) {
+        done += toWrite;
+        continue;
+      }
+      if (openpart_write(handle, static_cast<const char *>(buffer) + done, toWrite, extent->physicalOffset + inExtent) !=
+          static_cast<ssize_t>(toWrite))
+        return -1;
+      done += toWrite;
+    }
+    return static_cast<ssize_t>(done);
   }
 
   /// @brief Checks whether the partition is dynamic or not.
@@ -436,8 +846,12 @@ public:
   /// @brief Checks whether the partition info is empty or not.
   bool empty() const { return isLogical ? logicalPartitionPath.empty() : !gptPart.IsUsed() && localTablePath.empty(); }
 
-  /// @brief Closes the file descriptor.
-  bool closeFdNow() { return close(openpart_get_fd(op)) == 0; }
+  /// @brief Closes the file descriptor. The partition is reopened on next I/O.
+  bool closeFdNow() {
+    std::lock_guard lock(opMutex);
+    release();
+    return true;
+  }
 
   /**
    * @name @c BasicPartition_t's operators.
@@ -479,18 +893,15 @@ public:
       logicalPartitionPath = other.logicalPartitionPath;
       localIndex = other.localIndex;
       gptPart = other.gptPart;
+      sectorSize = other.sectorSize;
+      knownSize = other.knownSize;
       isLogical = other.isLogical;
-
-      if (op) {
-        openpart_close(&op);
-        op = nullptr;
-      }
-      if (other.op) {
-        std::string path = other.isLogical ? other.logicalPartitionPath.string() : std::string(openpart_get_part_path(other.op));
-        op = openpart_open(path.c_str(), O_RDWR, 0);
-        if (!op) throw Error("Cannot create openpart object: {}", openpart_strerror(op));
-      } else
-        op = nullptr;
+      superPath = other.superPath;
+      extents = other.extents;
+      direct = other.direct;
+      directWriteProblem = other.directWriteProblem;
+      release();
+      copyCache(other);
     }
 
     return *this;
@@ -503,15 +914,28 @@ public:
       localIndex = other.localIndex;
       logicalPartitionPath = std::move(other.logicalPartitionPath);
       gptPart = other.gptPart;
+      sectorSize = other.sectorSize;
+      knownSize = other.knownSize;
       isLogical = other.isLogical;
+      superPath = std::move(other.superPath);
+      extents = std::move(other.extents);
+      direct = other.direct;
+      directWriteProblem = std::move(other.directWriteProblem);
 
-      if (op) openpart_close(&op);
+      release();
       op = other.op;
+      opMode = other.opMode;
+      retiredOps = std::move(other.retiredOps);
       other.op = nullptr;
+      other.opMode = 0;
+      other.retiredOps.clear();
 
+      copyCache(other);
       other.localIndex = 0;
       other.gptPart = GPTPart();
       other.isLogical = false;
+      other.direct = false;
+      other.invalidateCache();
     }
 
     return *this;
@@ -556,93 +980,72 @@ struct Progress_t {
   Progress_t &operator=(const Progress_t &) = delete; ///< Deleted copy assignment.
 };
 
-/// @brief Progress renderer class.
+/**
+ * @brief Progress renderer class.
+ *
+ * Draws a bar with throughput and ETA for every entry and a total line. If there are more than @c MAX_LINES entries,
+ * only the total and running entries are drawn. Only changed lines are redrawn. If standard output is not a terminal,
+ * a line is printed when an entry ends instead. In quiet mode nothing is printed.
+ *
+ * Progress can also be written to a file descriptor as JSON lines (see setEventFd()).
+ */
 class ProgressRenderer {
-  std::vector<std::shared_ptr<Progress_t>> _entries;
+  using Clock = std::chrono::steady_clock;
+
+  /// @brief Renderer-side state of an entry.
+  struct Entry {
+    std::shared_ptr<Progress_t> progress;
+    Clock::time_point added, sampled;   // Added time, time of last throughput sample.
+    Progress_t::size_type lastDone = 0; // Done size at last sample.
+    double rate = 0;                    // Smoothed throughput (bytes/s).
+    bool ended = false;                 // End is reported.
+  };
+
+  std::vector<Entry> _entries;
+  std::vector<std::string> _lines; // Lines on the terminal.
   std::thread _thread;
   std::atomic<bool> _running{false};
   std::mutex _mutex;
-  size_t _drawnCount = 0;
+  Clock::time_point _started, _sampled;
+  Progress_t::size_type _lastTotalDone = 0;
+  double _totalRate = 0;
+  const bool _quiet, _terminal;
 
   /// @brief Render loop.
-  void render() {
-    while (_running.load(std::memory_order_relaxed)) {
-      draw();
-      std::this_thread::sleep_for(std::chrono::milliseconds(100));
-    }
-  }
+  void render();
 
-  /// @brief Draw progress bar.
-  void draw() {
-    std::lock_guard lock(_mutex);
-    const size_t count = _entries.size();
-    if (count == 0) return;
+  /// @brief Update rates, report events and draw changed lines.
+  void draw();
 
-    if (_drawnCount > 0) std::cout << "\033[" << _drawnCount << "A";
-    _drawnCount = 0;
+  /// @brief Build lines for terminal.
+  std::vector<std::string> buildLines() const;
 
-    for (const auto &p : _entries) {
-      const Progress_t::size_type done = p->done.load(std::memory_order_relaxed);
-      const Progress_t::size_type total = p->total;
-
-      if (p->failed.load(std::memory_order_relaxed)) {
-        std::cout << "\033[2K\r\n";
-        _drawnCount++;
-        continue;
-      }
-
-      const float pct = total > 0 ? static_cast<float>(done) / static_cast<float>(total) : 0.0f;
-      const int filled = static_cast<int>(pct * 20.0f);
-
-      std::string bar;
-      bar.reserve(20 * 3);
-      for (int i = 0; i < filled; i++)
-        bar += "━";
-      for (int i = filled; i < 20; i++)
-        bar += "╌";
-
-      std::cout << std::left << std::setw(16) << p->name << " [" << bar << "] " << std::right << std::setw(3)
-                << static_cast<int>(pct * 100) << "%"
-                << "\033[K"
-                << "\r\n";
-      _drawnCount++;
-    }
+public:
+  static constexpr size_t MAX_LINES = 8; ///< Maximum count of drawn lines, more entries are collapsed.
 
-    std::cout.flush();
-  }
+  /**
+   * @brief Write progress events of all renderers to a file descriptor as JSON lines.
+   * @param fd File descriptor (-1 = disable).
+   * @throws Helper::Error if the file descriptor is not opened.
+   */
+  static void setEventFd(int fd);
 
-public:
   ~ProgressRenderer() { stop(); }
 
   /// @brief Add a new progress entry.
-  std::shared_ptr<Progress_t> add(const std::string &name, Progress_t::size_type total) {
-    std::lock_guard lock(_mutex);
-    auto p = std::make_shared<Progress_t>(name, total);
-    _entries.push_back(p);
-    return p;
-  }
+  std::shared_ptr<Progress_t> add(const std::string &name, Progress_t::size_type total);
 
   /// @brief Start the progress renderer.
-  void start() {
-    {
-      std::lock_guard lock(_mutex);
-      for (size_t i = 0; i < _entries.size(); i++)
-        std::cout << "\n";
-      std::cout.flush();
-    }
-    _running.store(true, std::memory_order_relaxed);
-    _thread = std::thread(&ProgressRenderer::render, this);
-  }
+  void start();
 
   /// @brief Stop the progress renderer.
-  void stop() {
-    _running.store(false, std::memory_order_relaxed);
-    if (_thread.joinable()) _thread.join();
-    draw();
-  }
+  void stop();
 
-  /// @brief Default constructor.
-  ProgressRenderer() = default;
+  /**
+   * @brief Constructor.
+   * @param quiet Don't print to standard output, only write events (see setEventFd()).
+   */
+  explicit ProgressRenderer(bool quiet = false);
   ProgressRenderer(const ProgressRenderer &) = delete;
   ProgressRenderer &operator=(const ProgressRenderer &) = delete;
 }; // class ProgressRenderer
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2026 Yağız Zengin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file scan_cache.hpp
+ * @author Yağız Zengin ([YZBruh](https://github.com/YZBruh))
+ * @brief Persistent on-disk cache of scanned partition tables.
+ */
+
+#ifndef LIBPARTITION_MAP_SCAN_CACHE_HPP
+#define LIBPARTITION_MAP_SCAN_CACHE_HPP
+
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <optional>
+#include <vector>
+#include <gpt.h>
+#include <liblp/liblp.h>
+#include <libpartition_map/partition.hpp>
+
+namespace PartitionMap {
+
+/**
+ * @brief Binary cache of scanned GPT tables and super metadata.
+ *
+ * Cache files are memory-mapped on load. GPT data is keyed by disk GUID and CRC of both GPT headers of each table,
+ * super metadata by header checksum of the metadata slot it was read from. Before a cache file is used, only these headers are
+ * read from the disk; any difference makes the caller run a full scan.
+ *
+ * The cache directory is @ref DEFAULT_DIRECTORY by default. It can be changed with the @c PMT_SCAN_CACHE environment
+ * variable or @ref setDirectory. An empty value, @c 0 or @c off disables the cache. The directory is created with mode
+ * 0700 and files with mode 0600; a directory or file with another owner than the effective user (root) or with group
+ * or other permissions is ignored.
+ *
+ * @note This class cannot be constructible; its purpose is to function like a namespace.
+ */
+class ScanCache {
+public:
+  ScanCache() = delete;
+
+  /// @brief Default cache directory.
+  static constexpr char DEFAULT_DIRECTORY[] = "/data/local/tmp/pmt-cache";
+
+  /// @brief Partitions restored from the GPT cache.
+  struct GptCatalog {
+    std::vector<Partition_t> partitions; // Used partitions of all tables.
+    bool valid = false;                  // Result of GPTData verification when the cache was written.
+  };
+
+  /// @brief Set cache directory. An empty path disables the cache.
+  static void setDirectory(const std::filesystem::path &directory);
+
+  /// @brief Get cache directory. Empty if the cache is disabled.
+  static std::filesystem::path directory();
+
+  /// @brief Check the cache is enabled.
+  static bool enabled();
+
+  /**
+   * @brief Load cached partitions of tables.
+   * @param tables Paths of the tables to be scanned (like /dev/block/sda).
+   * @retval std::nullopt Cache is disabled, missing, corrupted or outdated.
+   */
+  static std::optional<GptCatalog> loadGpt(const std::vector<std::filesystem::path> &tables);
+
+  /**
+   * @brief Write cache of loaded GPT tables.
+   * @param collection Loaded tables.
+   * @param valid Result of GPTData verification.
+   * @return true if successful.
+   */
+  static bool storeGpt(const std::map<std::filesystem::path, std::shared_ptr<GPTData>> &collection, bool valid);
+
+  /**
+   * @brief Load cached super metadata.
+   * @param super Path of the super partition.
+   * @param slot Metadata slot, cache of another slot is not used.
+   * @retval nullptr Cache is disabled, missing, corrupted or outdated.
+   */
+  static std::unique_ptr<android::fs_mgr::LpMetadata> loadLp(const std::filesystem::path &super, uint32_t slot);
+
+  /**
+   * @brief Write cache of super metadata.
+   * @param super Path of the super partition.
+   * @param metadata Metadata read from @p super.
+   * @param slot Metadata slot which @p metadata was read from.
+   * @return true if successful.
+   */
+  static bool storeLp(const std::filesystem::path &super, const android::fs_mgr::LpMetadata &metadata, uint32_t slot);
+
+  /// @brief Remove all cache files.
+  static void invalidate();
+};
+
+} // namespace PartitionMap
+
+#endif // #ifndef LIBPARTITION_MAP_SCAN_CACHE_HPP
@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2026 Yağız Zengin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file snapshot_archive.hpp
+ * @author Yağız Zengin ([YZBruh](https://github.com/YZBruh))
+ * @brief Indexed archive format for whole-device snapshots.
+ */
+
+#ifndef LIBPARTITION_MAP_SNAPSHOT_ARCHIVE_HPP
+#define LIBPARTITION_MAP_SNAPSHOT_ARCHIVE_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <libhelper/management.hpp>
+
+namespace PartitionMap {
+
+/**
+ * @brief An entry (stored object) of a snapshot archive.
+ *
+ * Data of an entry is stored as chunks. Chunks of different entries may be interleaved in the archive,
+ * the index keeps chunks of every entry sorted by offset.
+ */
+struct SnapshotEntry {
+  /// @brief Type of stored data.
+  enum Type : uint32_t {
+    GPT = 1,         ///< GPT backup of a table (gptfdisk backup format). Table name is the entry name.
+    LP_METADATA = 2, ///< Metadata region of the super partition (geometry and all metadata slots).
+    PARTITION = 3    ///< Content of a partition.
+  };
+
+  Type type;           ///< Type of entry.
+  std::string name;    ///< Entry name (partition or table name).
+  std::string table;   ///< Table of partition (empty for other types).
+  uint64_t size;       ///< Size of stored data.
+  uint64_t firstChunk; ///< Index of first chunk in the index.
+  uint32_t chunkCount; ///< Count of chunks.
+  uint64_t storedSize; ///< Stored size (all-zero chunks are not stored).
+};
+
+/**
+ * @brief Writes a snapshot archive.
+ *
+ * Archive is a stream of chunks followed by an index and a fixed size trailer, so any entry can be read without scanning
+ * the archive. Every chunk has its own header, which lets the stream be walked even if the index is lost.
+ *
+ * Entries can be written concurrently: workers submit chunks to a bounded queue and one writer thread appends them
+ * in submission order. All-zero chunks are recorded in the index only.
+ *
+ * @code
+ * PartitionMap::SnapshotWriter writer("device.pmtsnap");
+ * const uint32_t id = writer.addEntry(PartitionMap::SnapshotEntry::PARTITION, "boot_a", "sdc", bootSize);
+ * writer.write(id, 0, std::move(data)); // From any thread.
+ * writer.finish();
+ * @endcode
+ */
+class SnapshotWriter {
+  struct Pending {
+    uint32_t entry;
+    uint64_t offset;
+    uint32_t size;
+    std::vector<char> data; // Empty for all-zero chunks.
+  };
+
+  struct ChunkRecord {
+    uint64_t fileOffset; // Offset of chunk data in archive (0 for zero chunks).
+    uint64_t offset;     // Offset in entry.
+    uint32_t size;       // Size of chunk.
+    uint32_t flags;      // Chunk flags.
+  };
+
+  Helper::UniqueFD fd;
+  std::filesystem::path archivePath;
+  uint64_t position = 0;
+  uint32_t chunkBytes;
+  size_t maxPending;
+
+  std::vector<SnapshotEntry> entries;
+  std::vector<std::vector<ChunkRecord>> chunks; // Chunks of entries, only used by writer thread until finish().
+  std::deque<Pending> queue;
+  std::mutex mutex;
+  std::condition_variable queueChanged;
+  std::thread writerThread;
+  std::string failure; // Error of writer thread.
+  bool closing = false, finished = false;
+
+  void writerLoop();
+  void append(const void *buffer, size_t size);
+
+public:
+  /**
+   * @brief Create archive.
+   * @param path Archive path. Existing file is truncated.
+   * @param chunkSize Maximum size of one chunk.
+   * @param maxQueuedChunks Workers are blocked while this many chunks are waiting to be written.
+   * @throws Helper::Error if the archive cannot be created.
+   */
+  explicit SnapshotWriter(const std::filesystem::path &path, uint32_t chunkSize = 4 * 1024 * 1024, size_t maxQueuedChunks = 32);
+
+  /// @brief Destructor. Stops writer thread; the archive has no index if finish() wasn't called.
+  ~SnapshotWriter();
+
+  SnapshotWriter(const SnapshotWriter &) = delete;
+  SnapshotWriter &operator=(const SnapshotWriter &) = delete;
+
+  /// @brief Get maximum size of one chunk.
+  uint32_t chunkSize() const noexcept { return chunkBytes; }
+
+  /**
+   * @brief Register an entry. Thread-safe.
+   * @return Entry ID for write().
+   */
+  uint32_t addEntry(SnapshotEntry::Type type, const std::string &name, const std::string &table, uint64_t size);
+
+  /**
+   * @brief Queue a chunk of an entry. Thread-safe, blocks while the queue is full.
+   * @param entry Entry ID.
+   * @param offset Offset of data in entry.
+   * @param data Data (not larger than chunkSize()).
+   * @throws Helper::Error if the writer thread failed.
+   */
+  void write(uint32_t entry, uint64_t offset, std::vector<char> &&data);
+
+  /**
+   * @brief Wait for queued chunks, then write index and trailer.
+   * @return Written entries.
+   * @throws Helper::Error on write errors or if an entry is incomplete.
+   */
+  std::vector<SnapshotEntry> finish();
+}; // class SnapshotWriter
+
+/**
+ * @brief Reads a snapshot archive through its index.
+ * @note All read functions use pread(), so one object can be used by multiple threads.
+ */
+class SnapshotReader {
+  struct ChunkRecord {
+    uint64_t fileOffset;
+    uint64_t offset;
+    uint32_t size;
+    uint32_t flags;
+  };
+
+  Helper::UniqueFD fd;
+  std::filesystem::path archivePath;
+  std::vector<SnapshotEntry> entryList;
+  std::vector<ChunkRecord> chunks;
+
+public:
+  /// @note First arg = written size, second arg = total size.
+  using IOCallback = std::function<void(uint64_t, uint64_t)>;
+  /// @brief Writes data at an entry offset (buffer, size, offset). Must throw on errors.
+  using WriteFunction = std::function<void(const void *, size_t, uint64_t)>;
+
+  /**
+   * @brief Open archive and read its index.
+   * @throws Helper::Error if the archive is not a valid snapshot archive.
+   */
+  explicit SnapshotReader(const std::filesystem::path &path);
+
+  SnapshotReader(const SnapshotReader &) = delete;
+  SnapshotReader &operator=(const SnapshotReader &) = delete;
+
+  /// @brief Get entries of archive.
+  const std::vector<SnapshotEntry> &entries() const noexcept { return entryList; }
+
+  /**
+   * @brief Find an entry.
+   * @param type Entry type.
+   * @param name Entry name.
+   * @param table Table of partition (empty = any).
+   * @retval nullptr Entry not found.
+   */
+  const SnapshotEntry *find(SnapshotEntry::Type type, const std::string &name, const std::string &table = "") const;
+
+  /// @brief Read whole entry to memory (for small entries like GPT and LP metadata).
+  std::vector<char> read(const SnapshotEntry &entry) const;
+
+  /**
+   * @brief Write data of entry to a file descriptor.
+   * @param entry Entry.
+   * @param out Output file descriptor. Data is written with pwrite() at entry offsets.
+   * @param writeZeros Write zero chunks (for block devices). Otherwise they're left as holes.
+   * @param callback Called after each chunk.
+   * @throws Helper::Error on I/O errors.
+   */
+  void extract(const SnapshotEntry &entry, int out, bool writeZeros, const IOCallback &callback = nullptr) const;
+
+  /**
+   * @brief Write data of entry through a function (like Partition_t::writeAt()).
+   * @param entry Entry.
+   * @param write Called for each chunk with entry offsets.
+   * @param writeZeros Also call @p write for zero chunks.
+   * @param callback Called after each chunk.
+   * @throws Helper::Error on read errors, and errors of @p write.
+   */
+  void extract(const SnapshotEntry &entry, const WriteFunction &write, bool writeZeros, const IOCallback &callback = nullptr) const;
+}; // class SnapshotReader
+
+} // namespace PartitionMap
+
+#endif // #ifndef LIBPARTITION_MAP_SNAPSHOT_ARCHIVE_HPP
@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2026 Yağız Zengin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file super_image.hpp
+ * @author Yağız Zengin ([YZBruh](https://github.com/YZBruh))
+ * @brief Offline access to super partitions and super images.
+ */
+
+#ifndef LIBPARTITION_MAP_SUPER_IMAGE_HPP
+#define LIBPARTITION_MAP_SUPER_IMAGE_HPP
+
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <libhelper/management.hpp>
+#include <liblp/liblp.h>
+
+namespace PartitionMap {
+
+/// @brief Layout of a super image to be packed (like arguments of lpmake).
+struct SuperLayout {
+  /// @brief A partition group.
+  struct Group {
+    std::string name;     ///< Group name.
+    uint64_t maximumSize; ///< Maximum size of group (0 = unlimited).
+  };
+
+  /// @brief A logical partition.
+  struct Partition {
+    std::string name;              ///< Partition name.
+    std::string group = "default"; ///< Group name.
+    uint32_t attributes = 0;       ///< LP_PARTITION_ATTR_* flags.
+    uint64_t size = 0;             ///< Partition size (0 = size of image).
+    std::filesystem::path image;   ///< Raw image to be written into the partition (optional).
+  };
+
+  uint64_t deviceSize = 0;           ///< Size of super partition.
+  uint32_t metadataSize = 65536;     ///< Maximum size of metadata.
+  uint32_t metadataSlots = 2;        ///< Count of metadata slots.
+  uint32_t alignment = 1024 * 1024;  ///< Partition alignment.
+  uint32_t blockSize = 4096;         ///< Logical block size.
+  std::vector<Group> groups;         ///< Groups (except default).
+  std::vector<Partition> partitions; ///< Partitions, extents are allocated in this order.
+};
+
+/**
+ * @brief Read-only view of a super partition or a super image.
+ *
+ * The image may be a raw image, an Android sparse image or a block device. LP metadata is read from the image itself,
+ * device-mapper is not used. Sparse images are not expanded; reads are served from their chunk list.
+ *
+ * @code
+ * PartitionMap::SuperImage super("super.img");
+ * super.extract("system_a", "system_a.img");
+ * @endcode
+ *
+ * @note All read functions use pread(), so one object can be used by multiple threads.
+ */
+class SuperImage {
+  /// @brief A chunk of sparse image which has data.
+  struct Chunk {
+    uint64_t offset;     // Offset in the expanded image.
+    uint64_t size;       // Size in the expanded image.
+    uint64_t fileOffset; // Offset of data in the sparse file (raw chunks only).
+    uint32_t fill;       // Fill value (fill chunks only).
+    bool raw;            // Raw or fill chunk.
+  };
+
+  Helper::UniqueFD fd;
+  std::filesystem::path imagePath;
+  std::vector<Chunk> chunks; // Sorted by offset. Offsets not covered by any chunk read as zero.
+  std::unique_ptr<android::fs_mgr::LpMetadata> metadata;
+  uint64_t imageSize = 0;
+  bool sparse = false;
+
+  void parseSparse();
+  void readMetadata(uint32_t slot);
+  void copyData(int out, uint64_t offset, uint64_t size, uint64_t outOffset) const;
+
+public:
+  /// @note First arg = written size, second arg = total size.
+  using IOCallback = std::function<void(uint64_t, uint64_t)>;
+  /// @note First arg = partition name, second arg = written size, third arg = total size.
+  using PackCallback = std::function<void(const std::string &, uint64_t, uint64_t)>;
+
+  /**
+   * @brief Open image and read its LP metadata.
+   * @param path Path of super image or super partition.
+   * @param slot Metadata slot.
+   * @throws Helper::Error if the image cannot be read or has no valid LP metadata.
+   */
+  explicit SuperImage(const std::filesystem::path &path, uint32_t slot = 0);
+
+  SuperImage(const SuperImage &) = delete;
+  SuperImage &operator=(const SuperImage &) = delete;
+
+  /// @brief Get LP metadata of image.
+  const android::fs_mgr::LpMetadata &getMetadata() const { return *metadata; }
+
+  /// @brief Checks whether the image is an Android sparse image.
+  bool isSparse() const noexcept { return sparse; }
+
+  /// @brief Get size of the (expanded) image.
+  uint64_t size() const noexcept { return imageSize; }
+
+  /// @brief Get path of the image.
+  const std::filesystem::path &path() const noexcept { return imagePath; }
+
+  /// @brief Get size of a logical partition, calculated from its extents. Returns @c UINT64_MAX if not found.
+  uint64_t partitionSize(const std::string &name) const;
+
+  /**
+   * @brief Read bytes of the (expanded) image.
+   * @return Read size. Smaller than @p size only at the end of image.
+   * @throws Helper::Error on read errors.
+   */
+  uint64_t read(void *buffer, uint64_t size, uint64_t offset) const;
+
+  /**
+   * @brief Extract a logical partition by copying its extents.
+   *
+   * Zero extents and unmapped parts of sparse images are left as holes. Data is copied in kernel with
+   * copy_file_range() when possible, and with pread()/pwrite() otherwise.
+   *
+   * @param name Partition name.
+   * @param output Output file.
+   * @param callback Called after each copied piece.
+   * @return Size of partition.
+   * @throws Helper::Error if the partition is not found or I/O fails.
+   */
+  uint64_t extract(const std::string &name, const std::filesystem::path &output, const IOCallback &callback = nullptr) const;
+
+  /**
+   * @brief Build LP metadata of layout with liblp @c MetadataBuilder.
+   * @throws Helper::Error if the layout is invalid or doesn't fit.
+   */
+  static std::unique_ptr<android::fs_mgr::LpMetadata> buildMetadata(const SuperLayout &layout);
+
+  /**
+   * @brief Pack a super image from layout.
+   *
+   * Metadata is written to all slots and images are streamed into their extents; a full-size raw image is never staged.
+   * Raw output is a file with holes, images are written into it concurrently (with copy_file_range() when possible).
+   * Sparse output refers to the images as chunks and is written as one stream by libsparse, unused space costs nothing.
+   *
+   * @param layout Layout.
+   * @param output Output file.
+   * @param sparse Write as Android sparse image.
+   * @param callback Called after each written piece of images (only for raw output).
+   * @return Built metadata.
+   * @throws Helper::Error if the layout is invalid or I/O fails.
+   */
+  static std::unique_ptr<android::fs_mgr::LpMetadata> pack(const SuperLayout &layout, const std::filesystem::path &output, bool sparse,
+                                                           const PackCallback &callback = nullptr);
+}; // class SuperImage
+
+} // namespace PartitionMap
+
+#endif // #ifndef LIBPARTITION_MAP_SUPER_IMAGE_HPP
@@ -27,16 +27,91 @@
 #include <vector>
 #include <filesystem>
 #include <map>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
 #include <unordered_set>
 #include <cassert>
+#include <functional>
 #include <gpt.h>
 #include <libhelper/definations.hpp>
 #include <libpartition_map/partition.hpp>
 #include <liblp/liblp.h>
 #include <liblp/metadata_format.h>
 
+namespace android::fs_mgr {
+class MetadataBuilder;
+} // namespace android::fs_mgr
+
 namespace PartitionMap {
 
+/**
+ * @brief Hash index from interned partition names to positions in a partition list.
+ * @note Duplicate named partitions (on different tables) keep all positions, in list order.
+ *       The index must be rebuilt when the list or names of partitions are changed.
+ */
+class PartitionIndex {
+  std::unordered_map<std::string_view, std::vector<size_t>> positions;
+
+public:
+  /// @brief Rebuild index of the list.
+  void build(const std::vector<Partition_t> &partitions) {
+    positions.clear();
+    positions.reserve(partitions.size());
+    for (size_t i = 0; i < partitions.size(); ++i)
+      positions[partitions[i].nameRef()].push_back(i);
+  }
+
+  /// @brief Get positions of partitions named @p name. Empty if not found.
+  const std::vector<size_t> &find(std::string_view name) const {
+    static const std::vector<size_t> none;
+    const auto it = positions.find(name);
+    return it == positions.end() ? none : it->second;
+  }
+
+  /// @brief Clear index.
+  void clear() noexcept { positions.clear(); }
+};
+
+/// @brief An extent of logical partition, converted to bytes.
+struct LogicalExtent {
+  uint64_t logicalOffset;  ///< Offset in the logical partition.
+  uint64_t physicalOffset; ///< Offset in the block device (only for linear extents).
+  uint64_t size;           ///< Size of extent.
+  uint32_t blockDevice;    ///< Index of block device in metadata (only for linear extents).
+  uint32_t partition;      ///< Index of owner partition in metadata.
+  bool zero;               ///< Extent is not mapped to a block device and reads as zero.
+};
+
+/// @brief Precomputed data of a logical partition.
+struct LogicalPartitionInfo {
+  uint64_t size;        ///< Size calculated from extents.
+  uint32_t group;       ///< Index of group in metadata.
+  uint32_t firstExtent; ///< Index of first extent in LogicalModel::extents.
+  uint32_t numExtents;  ///< Count of extents.
+};
+
+/// @brief Precomputed usage of a logical partition group.
+struct LogicalGroupInfo {
+  uint64_t maximumSize; ///< Maximum size of group (0 = unlimited).
+  uint64_t usedSize;    ///< Total size of partitions in the group.
+  uint32_t partitions;  ///< Count of partitions in the group.
+};
+
+/**
+ * @brief Model of super metadata, built once from liblp extents when the metadata is read.
+ * @note Partition, group and extent lists are in the same order with metadata lists.
+ */
+struct LogicalModel {
+  std::vector<LogicalPartitionInfo> partitions;
+  std::vector<LogicalGroupInfo> groups;
+  std::vector<LogicalExtent> extents;
+  std::vector<LogicalExtent> extentMap; ///< Linear extents, sorted by block device and physical offset.
+  std::unordered_map<std::string, uint32_t> groupIndex;
+  uint64_t usedSize = 0;                ///< Total size of logical partitions.
+  const char *problem = nullptr;        ///< Reason of inconsistency found while building, nullptr if metadata is consistent.
+};
+
 /// @brief Base table data class.
 class BaseTableData {
 public:
@@ -94,15 +169,21 @@ public:
  * @see [GPT fdisk](https://android.googlesource.com/platform/external/gptfdisk)
  */
 class PartitionTableData : public BaseTableData {
-  std::map<std::filesystem::path, std::shared_ptr<GPTData>> gptDataCollection;
+  mutable std::map<std::filesystem::path, std::shared_ptr<GPTData>> gptDataCollection;
   std::vector<Partition_t> localPartitions;
   std::unordered_set<std::string> localTableNames;
+  PartitionIndex nameIndex;
 
   bool buildAutoOnDiskChanges, isUFS;
+  ScanSource source = FULL_SCAN;          // Where the partition list is read from.
+  mutable bool gptDataPending = false;    // Partitions didn't come from gptfdisk, GPTData is loaded on first access.
+  std::optional<bool> cachedValidity;     // Result of valid() stored in ScanCache.
+  mutable bool cacheStorePending = false; // Fresh scan is written to ScanCache with the first result of valid().
 
   void scan();
   void findTablePaths();
   void reScan(bool auto_toggled);
+  void loadGPTData() const;
 
 public:
   /// @brief List type.
@@ -132,15 +213,27 @@ public:
     scan();
   }
 
+  /// @brief Constructor with scan source. Use @c SYSFS_SCAN if only names, sizes and paths of partitions are needed,
+  /// @c NATIVE_SCAN if complete entries are needed without gptfdisk.
+  explicit PartitionTableData(ScanSource scanSource) : buildAutoOnDiskChanges(true), isUFS(false), source(scanSource) {
+    findTablePaths();
+    scan();
+  }
+
   /// @brief Copy constructor.
   PartitionTableData(const PartitionTableData &other) = default;
 
   /// @brief Move constructor.
   PartitionTableData(PartitionTableData &&other) noexcept
       : gptDataCollection(std::move(other.gptDataCollection)), localPartitions(std::move(other.localPartitions)),
-        localTableNames(std::move(other.localTableNames)), buildAutoOnDiskChanges(other.buildAutoOnDiskChanges), isUFS(other.isUFS) {
+        localTableNames(std::move(other.localTableNames)), nameIndex(std::move(other.nameIndex)),
+        buildAutoOnDiskChanges(other.buildAutoOnDiskChanges), isUFS(other.isUFS),
+        source(other.source), gptDataPending(other.gptDataPending), cachedValidity(other.cachedValidity),
+        cacheStorePending(other.cacheStorePending) {
     other.buildAutoOnDiskChanges = true;
     other.isUFS = false;
+    other.gptDataPending = false;
+    other.cacheStorePending = false;
   }
 
   TableType type() const noexcept override { return static_type; }
@@ -305,6 +398,7 @@ public:
             typename = std::enable_if_t<Helper::Invocable_v<F, bool, const std::filesystem::path &, const std::shared_ptr<GPTData> &>>>
   bool forEachGptData(F &&function) const {
     Log::info("Foreaching input function for all GPTData data.");
+    loadGPTData();
     bool isSuccess = true;
     for (auto &[path, gptData] : gptDataCollection)
       isSuccess &= function(path, gptData);
@@ -317,6 +411,7 @@ public:
             typename = std::enable_if_t<Helper::Invocable_v<F, bool, const std::filesystem::path &, std::shared_ptr<GPTData> &>>>
   bool forEachGptData(F &&function) {
     Log::info("Foreaching input function for all GPTData data.");
+    loadGPTData();
     bool isSuccess = true;
     for (auto &[path, gptData] : gptDataCollection)
       isSuccess &= function(path, gptData);
@@ -367,6 +462,17 @@ public:
   /// @brief Set GPTData of the table.
   void setGPTDataOf(const std::string &name, std::shared_ptr<GPTData> data);
 
+  /**
+   * @brief Rename a partition in both the partition list and GPTData of its table. Use sync() to write the table.
+   *
+   * @param name Current partition name.
+   * @param newName New partition name (1-36 characters).
+   * @param from Table name of the partition, required if more than one partition has the same name.
+   * @throws Helper::Error if the partition cannot be found or the name is invalid.
+   * @note The partition list is sorted again, references to partitions of the table are invalidated.
+   */
+  void renamePartition(const std::string &name, const std::string &newName, const std::string &from = "");
+
   /// @brief Cleanup data (excepts auto scan state and seek name).
   void clear() override;
   /// @brief Cleanup (<tt>clear()</tt>) and reset variables.
@@ -395,7 +501,6 @@ public:
   operator[](const std::string &name) const;                     ///< <tt>const std::shared_ptr<GPTData> data = pd["sda"];</tt>
   std::shared_ptr<GPTData> &operator[](const std::string &name); ///< <tt>std::shared_ptr<GPTData> data = pd["sda"];</tt>
   const GPTPart *operator()(const std::string &name, uint32_t index) const; ///< <tt>const GPTPart* part = pd("sda", 3);</tt>
-  GPTPart *operator()(const std::string &name, uint32_t index);             ///< <tt>GPTPart* part = pd("sda", 3);</tt>F
 
   PartitionTableData &operator=(const PartitionTableData &other) = default; ///< Copy assignment.
   PartitionTableData &operator=(PartitionTableData &&other) noexcept;       ///< Move assignment.
@@ -415,9 +520,18 @@ public:
 class DynamicTableData : public BaseTableData {
   std::vector<Partition_t> localPartitions;
   std::unique_ptr<android::fs_mgr::LpMetadata> lpMetadata;
+  PartitionIndex nameIndex;
+  LogicalModel model;
+  uint32_t slot = 0; // Metadata slot of the current boot slot, 0 if the device is not A/B.
   bool supported = false;
+  mutable std::optional<std::string> writeProblem; // Why direct writes are unsafe, empty if they're safe. Checked on first use.
 
   void scan();
+  void buildModel();
+  void registerPartitions();
+  void setupDirectIO(Partition_t &partition, uint32_t index) const;
+  const std::string &directWriteProblem() const;
+  void updateMetadata(const std::function<void(android::fs_mgr::MetadataBuilder &)> &edit);
 
 public:
   /// @brief List type.
@@ -438,11 +552,17 @@ public:
   DynamicTableData(const DynamicTableData &other) {
     localPartitions = other.localPartitions;
     lpMetadata = std::make_unique<android::fs_mgr::LpMetadata>(*(other.lpMetadata));
+    nameIndex = other.nameIndex;
+    model = other.model;
+    slot = other.slot;
+    writeProblem = other.writeProblem;
   }
 
   /// @brief Move constructor.
   DynamicTableData(DynamicTableData &&other) noexcept
-      : localPartitions(std::move(other.localPartitions)), lpMetadata(std::move(other.lpMetadata)) {}
+      : localPartitions(std::move(other.localPartitions)), lpMetadata(std::move(other.lpMetadata)),
+        nameIndex(std::move(other.nameIndex)), model(std::move(other.model)), slot(other.slot),
+        writeProblem(std::move(other.writeProblem)) {}
 
   TableType type() const noexcept override { return static_type; }
 
@@ -473,6 +593,63 @@ public:
   /// @brief Get partition groups (const).
   const std::vector<LpMetadataPartitionGroup> &getGroups() const;
 
+  /// @brief Get precomputed model of metadata.
+  const LogicalModel &getModel() const;
+
+  /**
+   * @brief Get precomputed data of needed partition.
+   * @param name Partition name.
+   * @retval nullptr Partition not found.
+   */
+  const LogicalPartitionInfo *partitionInfo(const std::string &name) const;
+
+  /**
+   * @brief Get precomputed usage of needed group.
+   * @param name Group name.
+   * @retval nullptr Group not found.
+   */
+  const LogicalGroupInfo *groupInfo(const std::string &name) const;
+
+  /// @brief Get extents of needed partition in logical order. Empty if partition not found.
+  std::vector<LogicalExtent> extentsOf(const std::string &name) const;
+
+  /**
+   * @brief Find the linear extent which contains the given offset of a block device.
+   * @param offset Offset in the block device.
+   * @param blockDevice Index of block device in metadata.
+   * @retval nullptr Offset is not used by any partition.
+   */
+  const LogicalExtent *extentAt(uint64_t offset, uint32_t blockDevice = 0) const;
+
+  /**
+   * @brief Enable or disable direct I/O (through super, without device-mapper) for all logical partitions.
+   *
+   * Unmapped partitions use direct I/O automatically, so disabling doesn't affect them. Direct I/O is not enabled
+   * automatically and writes through super are refused while a snapshot merge is pending or metadata slots differ,
+   * extents of the current slot may not describe the data then.
+   */
+  void setDirectIO(bool enable);
+
+  /**
+   * @name In-place editing of super metadata.
+   * @brief Metadata is edited with liblp and written to all metadata slots of super. Only the metadata region is written,
+   * data of partitions is not touched. Growing allocates new extents from free space and shrinking drops extents from
+   * the end, so existing extents are never moved. Partitions and model are rebuilt from the written metadata.
+   * @throws Helper::Error if the edit is invalid, doesn't fit or metadata cannot be written.
+   * @{
+   */
+
+  /// @brief Resize a logical partition. Size is aligned up to logical block size.
+  void resizePartition(const std::string &name, uint64_t size);
+
+  /// @brief Create a logical partition in an existing group.
+  void createPartition(const std::string &name, const std::string &group, uint32_t attributes, uint64_t size);
+
+  /// @brief Remove a logical partition.
+  void removePartition(const std::string &name);
+
+  /** @} */
+
   /// @brief Get information about partitions.
   std::vector<BasicInfo> aboutPartitions() const override;
 
@@ -511,7 +688,7 @@ public:
   /// @brief Get free space of the super partition.
   uint64_t freeSpace() const;
 
-  /// @brief Get free space of an group.
+  /// @brief Get free space of an group. Returns @c UINT64_MAX if group not found.
   uint64_t freeSpace(const std::string &name) const;
 
   /// @brief Get total size of the super partition.
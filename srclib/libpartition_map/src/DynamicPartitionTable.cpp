@@ -16,31 +16,284 @@
  */
 
 #include <algorithm>
+#include <cstring>
 #include <utility>
+#include <libhelper/android.hpp>
 #include <libhelper/functions.hpp>
+#include <libhelper/trace.hpp>
 #include <libpartition_map/table_data_collection.hpp>
 #include <libpartition_map/definations.hpp>
+#include <libpartition_map/scan_cache.hpp>
 #include <liblp/liblp.h>
+#include <liblp/builder.h>
 
 using namespace android;
 
 namespace PartitionMap {
 
+static constexpr char SUPER_PATH[] = "/dev/block/by-name/super";
+
+// Metadata slot of the current boot slot. Devices without A/B only have slot 0.
+static uint32_t currentSlot() {
+  const auto suffix = Helper::Android::getProperty("ro.boot.slot_suffix");
+  return suffix && *suffix != "ERROR" && !suffix->empty() ? fs_mgr::SlotNumberForSlotSuffix(*suffix) : 0;
+}
+
+// Checks whether two metadata slots describe the same partitions on the same extents.
+static bool sameLayout(const fs_mgr::LpMetadata &a, const fs_mgr::LpMetadata &b) {
+  return a.partitions.size() == b.partitions.size() && a.extents.size() == b.extents.size() &&
+         std::memcmp(a.partitions.data(), b.partitions.data(), a.partitions.size() * sizeof(LpMetadataPartition)) == 0 &&
+         std::memcmp(a.extents.data(), b.extents.data(), a.extents.size() * sizeof(LpMetadataExtent)) == 0;
+}
+
 void DynamicTableData::scan() {
-  if (!Helper::isExists("/dev/block/by-name/super")) {
+  if (!Helper::isExists(SUPER_PATH)) {
     Log::info("This device not uses logical partitions.");
     return;
   } else
     supported = true;
 
-  Log::info("Scanning super metadata and partitions with liblp...");
-  lpMetadata = std::move(fs_mgr::ReadMetadata("/dev/block/by-name/super", 0));
+  Helper::Trace::Span span("scan", "scan super metadata");
+  slot = currentSlot();
+  if (lpMetadata = ScanCache::loadLp(SUPER_PATH, slot); !lpMetadata) {
+    Log::info("Scanning super metadata (slot {}) and partitions with liblp...", slot);
+    lpMetadata = std::move(fs_mgr::ReadMetadata(SUPER_PATH, slot));
+    if (lpMetadata && ScanCache::enabled()) ScanCache::storeLp(SUPER_PATH, *lpMetadata, slot);
+  }
 
-  for (const auto &partition : lpMetadata->partitions) {
+  if (!lpMetadata) {
+    Log::error("Cannot read super metadata.");
+    return;
+  }
+
+  buildModel();
+  registerPartitions();
+}
+
+void DynamicTableData::registerPartitions() {
+  localPartitions.clear();
+  localPartitions.reserve(lpMetadata->partitions.size());
+  for (size_t i = 0; i < lpMetadata->partitions.size(); ++i) {
+    const auto &partition = lpMetadata->partitions[i];
     Partition_t part;
     localPartitions.push_back(std::move(Partition_t::AsLogicalPartition(part, Helper::pathJoin("/dev/block/mapper", partition.name))));
+    localPartitions.back().setLogicalSize(model.partitions[i].size);
+    setupDirectIO(localPartitions.back(), i);
     Log::info("Registered logical partition: {}", std::quoted_string(partition.name));
   }
+  nameIndex.build(localPartitions);
+}
+
+void DynamicTableData::buildModel() {
+  Log::info("Building model of super metadata.");
+  model = LogicalModel();
+
+  model.groups.reserve(lpMetadata->groups.size());
+  for (uint32_t i = 0; i < lpMetadata->groups.size(); ++i) {
+    model.groups.push_back({lpMetadata->groups[i].maximum_size, 0, 0});
+    model.groupIndex.emplace(lpMetadata->groups[i].name, i);
+  }
+
+  model.extents.reserve(lpMetadata->extents.size());
+  for (const auto &extent : lpMetadata->extents) {
+    const bool zero = extent.target_type != LP_TARGET_TYPE_LINEAR;
+    LogicalExtent converted = {0, zero ? 0 : extent.target_data * LP_SECTOR_SIZE, extent.num_sectors * LP_SECTOR_SIZE,
+                               zero ? 0 : extent.target_source, UINT32_MAX, zero};
+
+    if (!zero && (extent.target_source >= lpMetadata->block_devices.size() ||
+                  converted.physicalOffset + converted.size > lpMetadata->block_devices[extent.target_source].size))
+      model.problem = "Extent Block Device limit has been exceeded.";
+    model.extents.push_back(converted);
+  }
+
+  model.partitions.reserve(lpMetadata->partitions.size());
+  for (uint32_t i = 0; i < lpMetadata->partitions.size(); ++i) {
+    const auto &partition = lpMetadata->partitions[i];
+    LogicalPartitionInfo info = {0, partition.group_index, partition.first_extent_index, partition.num_extents};
+
+    if (static_cast<uint64_t>(partition.first_extent_index) + partition.num_extents > model.extents.size()) {
+      model.problem = "The number of partition extents is inconsistent.";
+      info.numExtents = 0;
+    }
+
+    for (uint32_t e = info.firstExtent; e < info.firstExtent + info.numExtents; ++e) {
+      model.extents[e].logicalOffset = info.size;
+      model.extents[e].partition = i;
+      info.size += model.extents[e].size;
+    }
+
+    if (info.group < model.groups.size()) {
+      model.groups[info.group].usedSize += info.size;
+      model.groups[info.group].partitions++;
+    } else
+      model.problem = "Partition refers to non-existent group.";
+
+    model.usedSize += info.size;
+    model.partitions.push_back(info);
+  }
+
+  for (const auto &group : model.groups) {
+    if (group.maximumSize != 0 && group.usedSize > group.maximumSize) model.problem = "Group limits have been exceeded.";
+  }
+
+  for (const auto &extent : model.extents) {
+    if (!extent.zero && extent.partition != UINT32_MAX) model.extentMap.push_back(extent);
+  }
+
+  std::sort(model.extentMap.begin(), model.extentMap.end(), [](const LogicalExtent &a, const LogicalExtent &b) {
+    return a.blockDevice != b.blockDevice ? a.blockDevice < b.blockDevice : a.physicalOffset < b.physicalOffset;
+  });
+}
+
+void DynamicTableData::setupDirectIO(Partition_t &partition, const uint32_t index) const {
+  const LogicalPartitionInfo &info = model.partitions[index];
+  std::vector<SuperExtent_t> extents;
+  extents.reserve(info.numExtents);
+
+  for (uint32_t e = info.firstExtent; e < info.firstExtent + info.numExtents; ++e) {
+    const LogicalExtent &extent = model.extents[e];
+    if (!extent.zero && extent.blockDevice != 0) {
+      Log::info("{} has extents out of super, direct I/O is not available.", std::quoted_string(partition.name()));
+      return;
+    }
+    extents.push_back({extent.logicalOffset, extent.physicalOffset, extent.size, extent.zero});
+  }
+
+  partition.setSuperExtents(SUPER_PATH, std::move(extents));
+  if (Helper::isExists(partition.path())) return;
+
+  if (const std::string &problem = directWriteProblem(); !problem.empty()) {
+    Log::warning("{} is not mapped, but it's not accessed through super either: {}", std::quoted_string(partition.name()), problem);
+    return;
+  }
+
+  Log::info("{} is not mapped, it will be accessed through super.", std::quoted_string(partition.name()));
+  partition.setDirectIO(true);
+}
+
+const std::string &DynamicTableData::directWriteProblem() const {
+  if (writeProblem) return *writeProblem;
+  writeProblem.emplace();
+
+  // Virtual A/B keeps updated partitions in snapshots until the merge is completed, super holds only a part of their data.
+  std::error_code ec;
+  const bool snapshots = !std::filesystem::is_empty("/metadata/ota/snapshots", ec) && !ec;
+  if (snapshots || Helper::isExists("/metadata/ota/snapshot-boot")) {
+    *writeProblem = "A snapshot merge is pending.";
+    return *writeProblem;
+  }
+
+  for (const auto &partition : lpMetadata->partitions) {
+    if (partition.attributes & LP_PARTITION_ATTR_UPDATED) {
+      *writeProblem = fmt::format("{} is updated by an OTA which is not completed yet.", partition.name);
+      return *writeProblem;
+    }
+  }
+
+  for (uint32_t other = 0; other < lpMetadata->geometry.metadata_slot_count; ++other) {
+    if (other == slot) continue;
+    const auto metadata = fs_mgr::ReadMetadata(SUPER_PATH, other);
+    if (!metadata || !sameLayout(*lpMetadata, *metadata)) {
+      *writeProblem = fmt::format("Metadata of slot {} differs from metadata of current slot {}.", other, slot);
+      return *writeProblem;
+    }
+  }
+
+  return *writeProblem;
+}
+
+void DynamicTableData::setDirectIO(const bool enable) {
+  for (auto &partition : localPartitions) {
+    if (enable && !partition.isDirectIO()) {
+      try {
+        if (const std::string &problem = directWriteProblem(); !problem.empty()) {
+          Log::warning("Writes to {} through super are refused: {}", std::quoted_string(partition.name()), problem);
+          partition.refuseDirectWrites(problem);
+        }
+        partition.setDirectIO(true);
+      } catch (const Helper::Error &e) {
+        Log::warning("{}", e.what());
+      }
+    } else if (!enable && partition.isDirectIO() && Helper::isExists(partition.path()))
+      partition.setDirectIO(false);
+  }
+}
+
+void DynamicTableData::updateMetadata(const std::function<void(fs_mgr::MetadataBuilder &)> &edit) {
+  if (!lpMetadata) throw Error("Super metadata is not available.");
+
+  // Metadata of the other slot may differ (like while a Virtual A/B merge is pending), so A/B devices only get the
+  // current slot written. This is the slot scan() reads, so the edit is seen by the next run too. Every write is built
+  // from metadata read from disk, never from the cached copy.
+  std::vector<uint32_t> slots;
+  if (const auto suffix = Helper::Android::getProperty("ro.boot.slot_suffix"); suffix && *suffix != "ERROR" && !suffix->empty())
+    slots.push_back(slot);
+  else {
+    for (uint32_t other = 0; other < lpMetadata->geometry.metadata_slot_count; ++other)
+      slots.push_back(other);
+  }
+
+  for (const uint32_t target : slots) {
+    const auto current = fs_mgr::ReadMetadata(SUPER_PATH, target);
+    if (!current) throw Error("Cannot read super metadata of slot {}.", target);
+
+    auto builder = fs_mgr::MetadataBuilder::New(*current);
+    if (!builder) throw Error("Cannot create metadata builder from super metadata of slot {}.", target);
+    edit(*builder);
+
+    const auto exported = builder->Export();
+    if (!exported) throw Error("Cannot export edited super metadata of slot {}.", target);
+
+    // liblp writes the backup copy of the slot first, then the primary copy. Partition data is not touched.
+    Log::info("Writing super metadata to slot {}.", target);
+    if (!fs_mgr::UpdatePartitionTable(SUPER_PATH, *exported, target))
+      throw Error("Cannot write super metadata to slot {} (slots before it are already updated).", target);
+  }
+
+  // Read back instead of using the exported copy, checksums are calculated while writing.
+  auto written = fs_mgr::ReadMetadata(SUPER_PATH, slot);
+  if (!written) throw Error("Cannot read super metadata after writing.");
+  lpMetadata = std::move(written);
+  writeProblem.reset(); // Slots may differ now.
+  if (ScanCache::enabled()) ScanCache::storeLp(SUPER_PATH, *lpMetadata, slot);
+
+  buildModel();
+  registerPartitions();
+}
+
+void DynamicTableData::resizePartition(const std::string &name, const uint64_t size) {
+  updateMetadata([&](fs_mgr::MetadataBuilder &builder) {
+    fs_mgr::Partition *partition = builder.FindPartition(name);
+    if (!partition) throw Error("Couldn't find logical partition: {}", name);
+
+    Log::info("Resizing {} from {} to {} bytes.", std::quoted_string(name), partition->size(), size);
+    if (!builder.ResizePartition(partition, size))
+      throw Error("Cannot resize {} to {} bytes: Not enough free space in super or its group.", name, size);
+  });
+}
+
+void DynamicTableData::createPartition(const std::string &name, const std::string &group, const uint32_t attributes,
+                                       const uint64_t size) {
+  if (!groupInfo(group)) throw Error("Couldn't find logical partition group: {}", group);
+
+  updateMetadata([&](fs_mgr::MetadataBuilder &builder) {
+    if (builder.FindPartition(name)) throw Error("Logical partition already exists: {}", name);
+
+    Log::info("Creating {} in group {} with {} bytes.", std::quoted_string(name), std::quoted_string(group), size);
+    fs_mgr::Partition *partition = builder.AddPartition(name, group, attributes);
+    if (!partition) throw Error("Cannot add logical partition {} to group {}.", name, group);
+    if (size != 0 && !builder.ResizePartition(partition, size))
+      throw Error("Cannot allocate {} bytes for {}: Not enough free space in super or group {}.", size, name, group);
+  });
+}
+
+void DynamicTableData::removePartition(const std::string &name) {
+  updateMetadata([&](fs_mgr::MetadataBuilder &builder) {
+    if (!builder.FindPartition(name)) throw Error("Couldn't find logical partition: {}", name);
+
+    Log::info("Removing {}.", std::quoted_string(name));
+    builder.RemovePartition(name);
+  });
 }
 
 DynamicTableData::list_t DynamicTableData::partitions() {
@@ -75,75 +328,94 @@ std::vector<LpMetadataPartitionGroup> &DynamicTableData::getGroups() { return lp
 
 const std::vector<LpMetadataPartitionGroup> &DynamicTableData::getGroups() const { return lpMetadata->groups; }
 
+const LogicalModel &DynamicTableData::getModel() const { return model; }
+
+const LogicalPartitionInfo *DynamicTableData::partitionInfo(const std::string &name) const {
+  const auto &found = nameIndex.find(name);
+  return found.empty() ? nullptr : &model.partitions[found.front()];
+}
+
+const LogicalGroupInfo *DynamicTableData::groupInfo(const std::string &name) const {
+  const auto it = model.groupIndex.find(name);
+  return it == model.groupIndex.end() ? nullptr : &model.groups[it->second];
+}
+
+std::vector<LogicalExtent> DynamicTableData::extentsOf(const std::string &name) const {
+  const LogicalPartitionInfo *info = partitionInfo(name);
+  if (!info) return {};
+
+  const auto first = model.extents.begin() + info->firstExtent;
+  return std::vector<LogicalExtent>(first, first + info->numExtents);
+}
+
+const LogicalExtent *DynamicTableData::extentAt(const uint64_t offset, const uint32_t blockDevice) const {
+  auto it = std::upper_bound(model.extentMap.begin(), model.extentMap.end(), std::make_pair(blockDevice, offset),
+                             [](const std::pair<uint32_t, uint64_t> &key, const LogicalExtent &extent) {
+                               if (key.first != extent.blockDevice) return key.first < extent.blockDevice;
+                               return key.second < extent.physicalOffset;
+                             });
+  if (it == model.extentMap.begin()) return nullptr;
+
+  --it;
+  if (it->blockDevice != blockDevice || offset >= it->physicalOffset + it->size) return nullptr;
+  return &*it;
+}
+
 std::vector<BasicInfo> DynamicTableData::aboutPartitions() const {
   Log::info("Providing data of logical partitions.");
   std::vector<BasicInfo> parts;
-  for (const auto &p : partitions()) {
-    const Partition_t &part = p;
-    parts.push_back({part.name(), part.size(), false});
-  }
+  for (size_t i = 0; i < localPartitions.size(); ++i)
+    parts.push_back({localPartitions[i].name(), model.partitions[i].size, false});
 
   return parts;
 }
 
 std::optional<std::reference_wrapper<Partition_t>> DynamicTableData::partition(const std::string &name, const std::string &) {
-  auto it = std::find_if(localPartitions.begin(), localPartitions.end(), [&](const Partition_t &p) { return p.name() == name; });
-  if (it == localPartitions.end()) return std::nullopt;
+  const auto &found = nameIndex.find(name);
+  if (found.empty()) return std::nullopt;
 
   Log::info("Providing Partition_t object of {} logical partition.", std::quoted_string(name));
-  return std::ref(*it);
+  return std::ref(localPartitions[found.front()]);
 }
 
 std::optional<std::reference_wrapper<const Partition_t>> DynamicTableData::partition(const std::string &name,
                                                                                      const std::string &) const {
-  auto it = std::find_if(localPartitions.begin(), localPartitions.end(), [&](const Partition_t &p) { return p.name() == name; });
-  if (it == localPartitions.end()) return std::nullopt;
+  const auto &found = nameIndex.find(name);
+  if (found.empty()) return std::nullopt;
 
   Log::info("Providing Partition_t object of {} logical partition.", std::quoted_string(name));
-  return std::cref(*it);
+  return std::cref(localPartitions[found.front()]);
 }
 
 std::optional<std::reference_wrapper<LpMetadataPartition>> DynamicTableData::metadata(const std::string &name) {
-  auto it = std::find_if(lpMetadata->partitions.begin(), lpMetadata->partitions.end(),
-                         [&](const LpMetadataPartition &p) { return name == p.name; });
-  if (it == lpMetadata->partitions.end()) return std::nullopt;
+  const auto &found = nameIndex.find(name);
+  if (found.empty()) return std::nullopt;
 
   Log::info("Providing LpMetadataPartition object of {} logical partition.", std::quoted_string(name));
-  return std::ref(*it);
+  return std::ref(lpMetadata->partitions[found.front()]);
 }
 
 std::optional<std::reference_wrapper<const LpMetadataPartition>> DynamicTableData::metadata(const std::string &name) const {
-  auto it = std::find_if(lpMetadata->partitions.begin(), lpMetadata->partitions.end(),
-                         [&](const LpMetadataPartition &p) { return name == p.name; });
-  if (it == lpMetadata->partitions.end()) return std::nullopt;
+  const auto &found = nameIndex.find(name);
+  if (found.empty()) return std::nullopt;
 
   Log::info("Providing LpMetadataPartition object of {} logical partition.", std::quoted_string(name));
-  return std::cref(*it);
+  return std::cref(lpMetadata->partitions[found.front()]);
 }
 
 uint64_t DynamicTableData::freeSpace() const {
   Log::info("Providing free space of super partition.");
-  uint64_t total_part_sizes = 0;
-
-  for (const auto &p : localPartitions)
-    total_part_sizes += p.size();
-
-  return lpMetadata->block_devices[0].size - total_part_sizes;
+  const uint64_t total = lpMetadata->block_devices[0].size;
+  return total > model.usedSize ? total - model.usedSize : 0;
 }
 
 uint64_t DynamicTableData::freeSpace(const std::string &name) const {
   Log::info("Providing free space of {} group.", std::quoted_string(name));
-  auto it = std::find_if(lpMetadata->groups.begin(), lpMetadata->groups.end(),
-                         [&](const LpMetadataPartitionGroup &group) { return name == group.name; });
+  const LogicalGroupInfo *group = groupInfo(name);
+  if (!group) return UINT64_MAX;
+  if (group->maximumSize == 0) return freeSpace(); // Unlimited group, only limited by super.
 
-  if (it == lpMetadata->groups.end()) return UINT64_MAX;
-
-  uint64_t used_size = 0;
-  for (const auto &p : lpMetadata->partitions) {
-    if (lpMetadata->groups[p.group_index].name == name) used_size += partition(name)->get().size();
-  }
-
-  return (*it).maximum_size - used_size;
+  return group->maximumSize > group->usedSize ? group->maximumSize - group->usedSize : 0;
 }
 
 uint64_t DynamicTableData::size() const {
@@ -153,21 +425,13 @@ uint64_t DynamicTableData::size() const {
 
 uint64_t DynamicTableData::size(const std::string &name) {
   Log::info("Providing maximum size of {} group.", std::quoted_string(name));
-  auto it = std::find_if(lpMetadata->groups.begin(), lpMetadata->groups.end(),
-                         [&](const LpMetadataPartitionGroup &group) { return name == group.name; });
-
-  if (it == lpMetadata->groups.end()) return UINT64_MAX;
-  return (*it).maximum_size;
+  const LogicalGroupInfo *group = groupInfo(name);
+  return group ? group->maximumSize : UINT64_MAX;
 }
 
 bool DynamicTableData::hasPartition(const std::string &name) const {
   Log::info("Checking {} named logical partition is exists.", std::quoted_string(name));
-  bool found = false;
-  std::for_each(localPartitions.begin(), localPartitions.end(), [&](auto &part) {
-    if (part.name() == name) found = true;
-  });
-
-  return found;
+  return !nameIndex.find(name).empty();
 }
 
 bool DynamicTableData::sync() {
@@ -181,10 +445,10 @@ bool DynamicTableData::sync() {
 
 bool DynamicTableData::sync(const std::string &name) {
   Log::info("Syncing {} named logical partition.", std::quoted_string(name));
-  auto it = std::find_if(localPartitions.begin(), localPartitions.end(), [&](const Partition_t &part) { return part.name() == name; });
-  if (it == localPartitions.end()) return false;
-  auto op = it->getOpenPart();
-  return openpart_sync(op);
+  const auto &found = nameIndex.find(name);
+  if (found.empty()) return false;
+  auto op = localPartitions[found.front()].getOpenPart();
+  return op ? openpart_sync(op) : true; // Not opened, nothing to sync.
 }
 
 bool DynamicTableData::empty() const {
@@ -205,38 +469,9 @@ bool DynamicTableData::validMetadata() const {
       return false;
     }
 
-    for (const auto &group : lpMetadata->groups) {
-      if (group.maximum_size == 0) continue;
-
-      uint64_t total = 0;
-      for (const auto &p : lpMetadata->partitions) {
-        if (p.group_index == &group - &lpMetadata->groups[0]) total += partition(p.name)->get().size();
-      }
-
-      if (total > group.maximum_size) {
-        Log::error("Group limits have been exceeded.");
-        return false;
-      }
-    }
-
-    for (const auto &extent : lpMetadata->extents) {
-      if (extent.target_type != LP_TARGET_TYPE_LINEAR) continue;
-
-      const auto &bd = lpMetadata->block_devices[extent.target_source];
-      uint64_t end = (extent.target_data + extent.num_sectors) * 512;
-
-      if (end > bd.size) {
-        Log::error("Extent Block Device limit has been exceeded.");
-        return false;
-      }
-    }
-
-    for (const auto &partition : lpMetadata->partitions) {
-      uint32_t max_index = partition.first_extent_index + partition.num_extents;
-      if (max_index > lpMetadata->extents.size()) {
-        Log::error("The number of partition extents is inconsistent.");
-        return false;
-      }
+    if (model.problem) {
+      Log::error("{}", model.problem); // Found while building model.
+      return false;
     }
 
     return true;
@@ -248,6 +483,9 @@ bool DynamicTableData::validMetadata() const {
 void DynamicTableData::reScan() {
   Log::info("Rescanning logical partitions.");
   localPartitions.clear();
+  nameIndex.clear();
+  model = LogicalModel();
+  writeProblem.reset();
   scan();
 }
 
@@ -255,6 +493,9 @@ void DynamicTableData::clear() {
   Log::info("Clearing data.");
   localPartitions.clear();
   lpMetadata.reset();
+  nameIndex.clear();
+  model = LogicalModel();
+  writeProblem.reset();
 }
 
 void DynamicTableData::reset() { clear(); }
@@ -299,6 +540,10 @@ DynamicTableData &DynamicTableData::operator=(const DynamicTableData &other) {
   if (this != &other) {
     localPartitions = other.localPartitions;
     lpMetadata = std::make_unique<fs_mgr::LpMetadata>(*(other.lpMetadata));
+    nameIndex = other.nameIndex;
+    model = other.model;
+    slot = other.slot;
+    writeProblem = other.writeProblem;
   }
 
   return *this;
@@ -308,6 +553,10 @@ DynamicTableData &DynamicTableData::operator=(DynamicTableData &&other) noexcept
   if (this != &other) {
     localPartitions = std::move(other.localPartitions);
     lpMetadata = std::move(other.lpMetadata);
+    nameIndex = std::move(other.nameIndex);
+    model = std::move(other.model);
+    slot = other.slot;
+    writeProblem = std::move(other.writeProblem);
   }
 
   return *this;
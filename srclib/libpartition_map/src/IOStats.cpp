@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2026 Yağız Zengin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <mutex>
+#include <libhelper/error.hpp>
+#include <libpartition_map/io_stats.hpp>
+
+namespace PartitionMap {
+
+namespace {
+
+std::mutex statsMutex;
+std::map<std::string, openpart_stats_t> statsByPath;
+
+} // namespace
+
+void IOStats::collect(openpart_t *op) {
+  openpart_stats_t stats;
+  if (!op || openpart_get_stats(op, &stats) != 0) return;
+  const char *path = openpart_get_part_path(op);
+  if (!path) return;
+
+  std::lock_guard lock(statsMutex);
+  // Value-initialized on first use, so merging into a new entry copies the statistics.
+  openpart_stats_merge(&statsByPath[path], &stats);
+}
+
+std::map<std::string, openpart_stats_t> IOStats::collected() {
+  std::lock_guard lock(statsMutex);
+  return statsByPath;
+}
+
+void IOStats::clear() {
+  std::lock_guard lock(statsMutex);
+  statsByPath.clear();
+}
+
+IOWorkload IOStats::parseWorkload(const std::string &name, const unsigned mixedReadPercent) {
+  const bool random = name.rfind("rand", 0) == 0;
+  const std::string pattern = random ? name.substr(4) : name;
+  if (pattern == "read") return {name, random, 100};
+  if (pattern == "write") return {name, random, 0};
+  if (pattern == "rw") return {name, random, mixedReadPercent};
+  throw Helper::Error("Unknown workload: {} (must be one of read, write, randread, randwrite, rw, randrw).", name);
+}
+
+IOSummary IOStats::summarize(const openpart_io_stats_t &stats, const double seconds) {
+  IOSummary summary;
+  if (seconds > 0) {
+    summary.bandwidth = static_cast<double>(stats.bytes) / seconds;
+    summary.iops = static_cast<double>(stats.calls) / seconds;
+  }
+  summary.meanNs = stats.calls > 0 ? stats.total_ns / stats.calls : 0;
+  summary.p50Ns = openpart_stats_percentile(&stats, 50);
+  summary.p90Ns = openpart_stats_percentile(&stats, 90);
+  summary.p99Ns = openpart_stats_percentile(&stats, 99);
+  summary.p999Ns = openpart_stats_percentile(&stats, 99.9);
+  summary.maxNs = stats.max_ns;
+  return summary;
+}
+
+std::string IOStats::formatLatency(const uint64_t ns) {
+  if (ns < 1000 * 1000) return fmt::format("{:.1f}us", static_cast<double>(ns) / 1e3);
+  return fmt::format("{:.2f}ms", static_cast<double>(ns) / 1e6);
+}
+
+} // namespace PartitionMap
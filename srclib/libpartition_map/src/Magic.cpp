@@ -15,11 +15,18 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
 #include <iomanip>
+#include <iterator>
 #include <map>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <fcntl.h>
+#include <unistd.h>
 #include <libhelper/lib.hpp>
 #include <libpartition_map/definations.hpp>
 #include <libpartition_map/functions.hpp>
@@ -103,6 +110,234 @@ bool hasMagic(const uint64_t magic, const ssize_t buf, const std::string &path)
   return false;
 }
 
+namespace {
+
+constexpr size_t SIGNATURE_COUNT = std::size(MagicSignatures);
+
+/// @brief End of the farthest anchored signature; the read buffer always covers it.
+constexpr size_t anchoredEnd() {
+  size_t end = 0;
+  for (const auto &signature : MagicSignatures)
+    if (signature.offset >= 0) end = std::max(end, static_cast<size_t>(signature.offset) + sizeof(uint64_t));
+  return end;
+}
+
+/// @brief Signatures grouped by their first byte, so the buffer is scanned once for all of them.
+struct FirstByteTable {
+  std::array<std::vector<uint8_t>, 256> candidates; // Indexes in MagicSignatures.
+  std::array<std::array<uint8_t, 8>, SIGNATURE_COUNT> bytes{};
+  std::array<size_t, SIGNATURE_COUNT> lengths{};
+
+  FirstByteTable() {
+    static_assert(SIGNATURE_COUNT <= UINT8_MAX, "Signature index must fit uint8_t");
+    for (size_t i = 0; i < SIGNATURE_COUNT; ++i) {
+      lengths[i] = getMagicLength(MagicSignatures[i].magic);
+      for (size_t j = 0; j < 8; ++j)
+        bytes[i][j] = static_cast<uint8_t>(MagicSignatures[i].magic >> (8 * j));
+      if (lengths[i] > 0) candidates[bytes[i][0]].push_back(static_cast<uint8_t>(i));
+    }
+  }
+
+  bool matches(size_t index, const uint8_t *buffer, size_t size, size_t offset) const {
+    return lengths[index] > 0 && offset + lengths[index] <= size &&
+           std::memcmp(buffer + offset, bytes[index].data(), lengths[index]) == 0;
+  }
+};
+
+const FirstByteTable &firstByteTable() {
+  static const FirstByteTable table;
+  return table;
+}
+
+} // namespace
+
+std::optional<MagicMatch> detectMagic(const uint8_t *buffer, const size_t size, size_t scanLength, const int classes) {
+  const auto &table = firstByteTable();
+  scanLength = std::min(scanLength, size);
+
+  // Offset-anchored checks.
+  for (size_t i = 0; i < SIGNATURE_COUNT; ++i) {
+    const auto &signature = MagicSignatures[i];
+    if (!(signature.type & classes) || signature.offset < 0) continue;
+    if (table.matches(i, buffer, size, static_cast<size_t>(signature.offset)))
+      return MagicMatch{&signature, static_cast<uint64_t>(signature.offset)};
+  }
+
+  // Single pass for floating matches. Stop early when nothing better can be found.
+  std::optional<MagicMatch> best;
+  size_t bestIndex = SIGNATURE_COUNT;
+  for (size_t offset = 0; offset < scanLength && bestIndex > 0; ++offset) {
+    for (const uint8_t index : table.candidates[buffer[offset]]) {
+      if (index >= bestIndex || !(MagicSignatures[index].type & classes)) continue;
+      if (table.matches(index, buffer, scanLength, offset)) {
+        best = MagicMatch{&MagicSignatures[index], offset};
+        bestIndex = index;
+      }
+    }
+  }
+
+  return best;
+}
+
+std::optional<MagicMatch> detectMagic(const std::string &path, const size_t bufferSize, const int classes) {
+  Log::info("Detecting magic of {} with using {} byte buffer size.", path, bufferSize);
+  auto fd = Helper::UniqueFD(path, O_RDONLY);
+  if (!fd) return std::nullopt;
+  fd.syncOnClose = false; // Read only.
+
+  const size_t size = std::max(bufferSize, anchoredEnd());
+  auto buffer = std::make_unique<uint8_t[]>(size);
+  ssize_t bytesRead;
+  do {
+    bytesRead = ::pread(fd.fd(), buffer.get(), size, 0);
+  } while (bytesRead < 0 && errno == EINTR);
+  if (bytesRead < 0) {
+    Log::error("Cannot read {}: {}", path, strerror(errno));
+    return std::nullopt;
+  }
+
+  auto match = detectMagic(buffer.get(), static_cast<size_t>(bytesRead), bufferSize, classes);
+  if (match) Log::info("{} contains {:#x} at {}", path, match->signature->magic, match->offset);
+  else Log::info("{} does not contain any known magic", path);
+  return match;
+}
+
+namespace {
+
+using ByteVector = uint8_t __attribute__((vector_size(16))); // Compiles to SSE2 or NEON.
+
+/// @brief Scanner for DeepSignatures. 16 offsets are tested at once against the first two bytes of all signatures.
+class DeepScanner {
+  static constexpr size_t SIGNATURE_COUNT = std::size(DeepSignatures);
+  std::array<std::vector<uint8_t>, 256> candidates; // Signature indexes by first byte.
+  std::array<ByteVector, SIGNATURE_COUNT> firstBytes{}, secondBytes{}; // Broadcasted to all lanes.
+  size_t longest = 0;
+
+  void check(const uint8_t *data, const size_t size, const size_t offset, const uint64_t base, std::vector<DeepMatch> &out) const {
+    for (const uint8_t index : candidates[data[offset]]) {
+      const auto pattern = DeepSignatures[index].pattern;
+      if (offset + pattern.size() <= size && std::memcmp(data + offset, pattern.data(), pattern.size()) == 0)
+        out.push_back({&DeepSignatures[index], base + offset});
+    }
+  }
+
+public:
+  DeepScanner() {
+    for (size_t i = 0; i < SIGNATURE_COUNT; ++i) {
+      const auto pattern = DeepSignatures[i].pattern;
+      firstBytes[i] = ByteVector{} + static_cast<uint8_t>(pattern[0]);
+      secondBytes[i] = ByteVector{} + static_cast<uint8_t>(pattern[1]);
+      candidates[static_cast<uint8_t>(pattern[0])].push_back(static_cast<uint8_t>(i));
+      longest = std::max(longest, pattern.size());
+    }
+  }
+
+  size_t overlap() const { return longest - 1; }
+
+  /**
+   * @brief Scan data for matches starting before @p limit.
+   * @param data Chunk and the overlap after it.
+   * @param size Size of @p data.
+   * @param limit Size of the chunk itself; matches starting in the overlap belong to the next chunk.
+   * @param base File offset of @p data.
+   */
+  void scan(const uint8_t *data, const size_t size, const size_t limit, const uint64_t base, std::vector<DeepMatch> &out) const {
+    const auto first = firstBytes, second = secondBytes; // Locals stay in registers.
+    size_t offset = 0;
+    for (; offset + sizeof(ByteVector) <= limit && offset + sizeof(ByteVector) + 1 <= size; offset += sizeof(ByteVector)) {
+      ByteVector block, next, hits = {};
+      std::memcpy(&block, data + offset, sizeof(block));
+      std::memcpy(&next, data + offset + 1, sizeof(next));
+      for (size_t i = 0; i < SIGNATURE_COUNT; ++i)
+        hits |= reinterpret_cast<ByteVector>((block == first[i]) & (next == second[i]));
+
+      uint64_t lanes[2];
+      std::memcpy(lanes, &hits, sizeof(lanes));
+      if ((lanes[0] | lanes[1]) == 0) continue; // Usual case: zeros, erased blocks, unrelated data.
+
+      for (size_t i = 0; i < sizeof(ByteVector); ++i)
+        check(data, size, offset + i, base, out);
+    }
+
+    for (; offset < limit; ++offset)
+      check(data, size, offset, base, out);
+  }
+};
+
+} // namespace
+
+std::vector<DeepMatch> deepScan(const std::string &path, size_t chunkSize, unsigned int threads) {
+  static const DeepScanner scanner;
+
+  auto fd = Helper::UniqueFD(path, O_RDONLY);
+  if (!fd) throw Error("Cannot open {}: {}", path, strerror(errno));
+  fd.syncOnClose = false; // Read only.
+
+  const off_t end = ::lseek(fd.fd(), 0, SEEK_END); // Works for block devices too.
+  if (end < 0) throw Error("Cannot get size of {}: {}", path, strerror(errno));
+  const auto fileSize = static_cast<uint64_t>(end);
+
+  chunkSize = std::max<size_t>(chunkSize, 64 * 1024);
+  const uint64_t chunkCount = (fileSize + chunkSize - 1) / chunkSize;
+  // Workers share the chunk list; more workers than CPUs or chunks would only start idle threads.
+  const unsigned int cpus = std::max(1u, std::thread::hardware_concurrency());
+  if (threads == 0 || threads > cpus) threads = cpus;
+  threads = static_cast<unsigned int>(std::min<uint64_t>(threads, std::max<uint64_t>(chunkCount, 1)));
+
+  Log::info("Deep scanning {} ({} bytes) in {} chunks of {} bytes with {} workers.", path, fileSize, chunkCount, chunkSize, threads);
+  posix_fadvise(fd.fd(), 0, 0, POSIX_FADV_SEQUENTIAL);
+
+  std::atomic<uint64_t> nextChunk = 0;
+  std::atomic<bool> failed = false;
+  auto worker = [&]() -> std::vector<DeepMatch> {
+    std::vector<DeepMatch> matches;
+    auto buffer = std::make_unique<uint8_t[]>(chunkSize + scanner.overlap());
+
+    for (uint64_t chunk; !failed && (chunk = nextChunk.fetch_add(1, std::memory_order_relaxed)) < chunkCount;) {
+      const uint64_t offset = chunk * chunkSize;
+      const size_t limit = static_cast<size_t>(std::min<uint64_t>(chunkSize, fileSize - offset));
+      const size_t toRead = static_cast<size_t>(std::min<uint64_t>(limit + scanner.overlap(), fileSize - offset));
+
+      size_t done = 0;
+      int err = 0;
+      while (done < toRead) {
+        const ssize_t ret = ::pread(fd.fd(), buffer.get() + done, toRead - done, static_cast<off_t>(offset + done));
+        if (ret < 0 && errno == EINTR) continue;
+        if (ret <= 0) {
+          err = ret < 0 ? errno : EIO;
+          break;
+        }
+        done += static_cast<size_t>(ret);
+      }
+
+      if (done < limit) {
+        Log::error("Cannot read {} at {}: {}", path, offset + done, strerror(err));
+        failed = true;
+        break;
+      }
+
+      scanner.scan(buffer.get(), done, limit, offset, matches);
+    }
+
+    return matches;
+  };
+
+  Helper::AsyncManager<std::vector<DeepMatch>> manager;
+  for (unsigned int i = 0; i < threads; ++i)
+    manager.addProcess(worker);
+
+  manager.startAll();
+  std::vector<DeepMatch> matches;
+  for (auto &result : manager.getResults())
+    matches.insert(matches.end(), result.begin(), result.end());
+
+  if (failed) throw Error("Cannot read {}", path);
+
+  std::sort(matches.begin(), matches.end(), [](const DeepMatch &a, const DeepMatch &b) { return a.offset < b.offset; });
+  Log::info("Deep scan of {} complete, {} matches.", path, matches.size());
+  return matches;
+}
+
 std::string formatMagic(const uint64_t magic) {
   std::stringstream ss;
   ss << "0x" << std::uppercase << std::hex << std::setw(16) << std::setfill('0') << magic;
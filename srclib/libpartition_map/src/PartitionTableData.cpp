@@ -16,12 +16,21 @@
  */
 
 #include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <filesystem>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
 #include <utility>
 #include <libhelper/management.hpp>
+#include <libhelper/trace.hpp>
 #include <libpartition_map/table_data_collection.hpp>
 #include <libpartition_map/definations.hpp>
+#include <libpartition_map/scan_cache.hpp>
 
 #if defined(__ANDROID__) && __ANDROID_API__ <= 21 && __clang_major__ <= 16
 namespace std {
@@ -33,13 +42,44 @@ template <> struct hash<std::filesystem::path> {
 
 namespace PartitionMap {
 
-void PartitionTableData::scan() {
-  if (localTableNames.empty()) throw Error("Empty disk path.");
-  Log::info("Cleaning current data and scanning partitions...");
-  localPartitions.clear();
-  gptDataCollection.clear();
+namespace {
 
-  for (const auto &name : localTableNames) {
+/// @brief Result of scanning a single partition table.
+struct TableScanResult {
+  std::filesystem::path path;
+  std::shared_ptr<GPTData> gpt;        // Null if the table cannot be loaded.
+  std::vector<Partition_t> partitions; // Used partitions of the table.
+  std::string output;                  // Captured output of gptfdisk.
+};
+
+TableScanResult scanTable(const std::filesystem::path &path) {
+  Helper::Trace::Span span("scan", "gptfdisk {}", path.string());
+  TableScanResult result{path, std::make_shared<GPTData>(), {}, {}};
+  Helper::OutputCapture capture; // Per-thread, Silencer cannot be used here.
+
+  if (!result.gpt->LoadPartitions(path)) {
+    result.gpt.reset();
+    result.output = capture.output();
+    return result;
+  }
+
+  const auto &gpt = *result.gpt;
+  for (uint32_t i = 0; i < gpt.GetNumParts(); ++i) {
+    if (GPTPart part = gpt[i]; part.IsUsed()) {
+      Partition_t _part(path, part, static_cast<openpart_t *>(nullptr), i); // Opened on first I/O.
+      _part.setSectorSize(gpt.GetBlockSize());
+      result.partitions.push_back(std::move(_part));
+    }
+  }
+
+  result.output = capture.output();
+  return result;
+}
+
+/// @brief Get paths of non-removable tables.
+std::vector<std::filesystem::path> scanTargets(const std::unordered_set<std::string> &names) {
+  std::vector<std::filesystem::path> targets;
+  for (const auto &name : names) {
     std::filesystem::path p("/dev/block");
     p /= name; // Append device.
 
@@ -51,35 +91,188 @@ void PartitionTableData::scan() {
       }
     }
 
-    Log::info("Silencing stdout and stderr for scanning {}...", std::quoted_string(p));
-    Helper::Silencer silencer(true);
-    if (auto gpt = std::make_shared<GPTData>(); gpt->LoadPartitions(p)) {
-      gptDataCollection[p] = std::move(gpt); // Add to GPT data list.
-
-      auto &storedGpt = *gptDataCollection[p];
-      Log::info("Sector size of {}: {}.", std::quoted_string(p), storedGpt.GetBlockSize());
-      for (uint32_t i = 0; i < storedGpt.GetNumParts(); ++i) {
-        if (GPTPart part = storedGpt[i]; part.IsUsed()) {
-          const std::string partPath = p.string() + (isdigit(p.string().back()) ? "p" : "") + std::to_string(i + 1);
-          openpart_t *op = openpart_open(partPath.c_str(), OP_RDWR, 0);
-          Partition_t _part(p, part, op, i);
-          localPartitions.push_back(std::move(_part)); // Add to partition list.
-          silencer.stop();
-          Log::info("Registered partition: {}", part.GetDescription());
-          silencer.silence();
-        }
+    targets.push_back(std::move(p));
+  }
+
+  return targets;
+}
+
+/// @brief Build partition list of a table from sysfs, without reading the disk.
+std::vector<Partition_t> readSysfsTable(const std::filesystem::path &path) {
+  const std::filesystem::path sysDir = std::filesystem::path("/sys/block") / path.filename();
+  std::vector<Partition_t> partitions;
+
+  uint64_t sectorSize = 0;
+  if (const auto content = Helper::readFile(sysDir / "queue" / "logical_block_size"); content)
+    sectorSize = std::strtoull(content->c_str(), nullptr, 10);
+  if (sectorSize == 0) sectorSize = 512;
+
+  std::error_code ec;
+  for (const auto &entry : std::filesystem::directory_iterator(sysDir, ec)) {
+    const auto number = Helper::readFile(entry.path() / "partition");
+    if (!number) continue; // Not a partition (queue, device etc.).
+
+    const auto uevent = Helper::readFile(entry.path() / "uevent");
+    const auto start = Helper::readFile(entry.path() / "start");
+    const auto size = Helper::readFile(entry.path() / "size");
+    if (!uevent || !start || !size) continue;
+
+    std::string partName;
+    std::istringstream lines(*uevent);
+    for (std::string line; std::getline(lines, line);)
+      if (line.rfind("PARTNAME=", 0) == 0) partName = line.substr(9);
+
+    // start and size are always in 512-byte units.
+    const auto index = static_cast<uint32_t>(std::strtoul(number->c_str(), nullptr, 10));
+    const uint64_t firstLBA = std::strtoull(start->c_str(), nullptr, 10) * 512 / sectorSize;
+    const uint64_t sectors = std::strtoull(size->c_str(), nullptr, 10) * 512 / sectorSize;
+    if (partName.empty() || index == 0 || sectors == 0) {
+      Log::info("{} has no name or size, skipping.", std::quoted_string(entry.path()));
+      continue;
+    }
+
+    GPTPart part;
+    part.SetName(partName);
+    part.SetFirstLBA(firstLBA);
+    part.SetLastLBA(firstLBA + sectors - 1);
+
+    Partition_t _part(path, part, static_cast<openpart_t *>(nullptr), index - 1);
+    _part.setSectorSize(sectorSize);
+    partitions.push_back(std::move(_part));
+  }
+
+  if (ec) Log::error("Cannot list {}: {}", std::quoted_string(sysDir), ec.message());
+  return partitions;
+}
+
+/// @brief Build partition list of a table with the GPT reader of libopenpart, without gptfdisk.
+std::optional<std::vector<Partition_t>> readNativeTable(const std::filesystem::path &path) {
+  openpart_gpt_t *gpt = openpart_gpt_open(path.c_str());
+  if (gpt == nullptr) {
+    Log::error("Cannot read GPT of {}: {}", std::quoted_string(path), strerror(errno));
+    return std::nullopt;
+  }
+
+  const openpart_gpt_info_t *info = openpart_gpt_info(gpt);
+  if (info->from_backup) Log::warning("Primary GPT of {} is corrupted, backup GPT is used.", std::quoted_string(path));
+
+  std::vector<Partition_t> partitions;
+  for (uint32_t i = 0; i < info->num_entries; ++i) {
+    const openpart_gpt_entry_t *entry = openpart_gpt_entry(gpt, i);
+    if (!openpart_gpt_entry_is_used(entry)) continue;
+
+    GPTPart part;
+    std::memcpy(static_cast<void *>(&part), entry, sizeof(*entry)); // Same on-disk layout, see ScanCache.cpp.
+    Partition_t _part(path, part, static_cast<openpart_t *>(nullptr), i);
+    _part.setSectorSize(info->sector_size);
+    partitions.push_back(std::move(_part));
+  }
+
+  openpart_gpt_close(&gpt);
+  return partitions;
+}
+
+/// @brief Scan tables concurrently.
+std::vector<TableScanResult> scanTables(const std::vector<std::filesystem::path> &targets) {
+  // PartType builds its global type list with the first instance and frees it with the last one.
+  // Keep one alive while threads are running, so they never build or free it.
+  [[maybe_unused]] const PartType typeListInitializer;
+  Helper::AsyncManager<TableScanResult> manager;
+
+  for (const auto &p : targets) {
+    Log::info("Scanning {}...", std::quoted_string(p));
+    manager.addProcess(scanTable, p);
+  }
+
+  manager.startAll();
+  auto results = manager.getResults();
+  for (const auto &result : results) {
+    if (!result.output.empty()) Log::info("Output of gptfdisk for {}: {}", std::quoted_string(result.path), result.output);
+    if (!result.gpt) Log::error("Failed to load partitions from {}.", std::quoted_string(result.path));
+  }
+
+  return results;
+}
+
+} // namespace
+
+void PartitionTableData::scan() {
+  if (localTableNames.empty()) throw Error("Empty disk path.");
+  Helper::Trace::Span span("scan", "scan partition tables");
+  Log::info("Cleaning current data and scanning partitions...");
+  localPartitions.clear();
+  gptDataCollection.clear();
+  nameIndex.clear();
+  gptDataPending = false;
+  cachedValidity.reset();
+  cacheStorePending = false;
+  openpart_gpt_invalidate(nullptr); // Tables may be changed by other processes.
+
+  const auto targets = scanTargets(localTableNames);
+  if (source == SYSFS_SCAN || source == NATIVE_SCAN) {
+    Log::info("Listing partitions from {}, skipping gptfdisk.", source == SYSFS_SCAN ? "sysfs" : "GPT reader of libopenpart");
+    std::vector<std::filesystem::path> fallbackTargets;
+    for (const auto &p : targets) {
+      Helper::Trace::Span tableSpan("scan", "list {}", p.string());
+      auto parts = source == SYSFS_SCAN ? readSysfsTable(p) : std::vector<Partition_t>{};
+      if (parts.empty()) { // Kernel may not export partition names.
+        if (auto native = readNativeTable(p); native) parts = std::move(*native);
+        else fallbackTargets.push_back(p);
+      }
+      std::move(parts.begin(), parts.end(), std::back_inserter(localPartitions));
+    }
+
+    for (auto &result : scanTables(fallbackTargets)) {
+      if (!result.gpt) continue;
+      std::move(result.partitions.begin(), result.partitions.end(), std::back_inserter(localPartitions));
+      gptDataCollection[result.path] = std::move(result.gpt);
+    }
+    gptDataPending = true;
+  } else if (auto catalog = ScanCache::loadGpt(targets); catalog) {
+    localPartitions = std::move(catalog->partitions);
+    cachedValidity = catalog->valid;
+    gptDataPending = true;
+  } else {
+    for (auto &result : scanTables(targets)) {
+      if (!result.gpt) continue;
+
+      Log::info("Sector size of {}: {}.", std::quoted_string(result.path), result.gpt->GetBlockSize());
+      for (auto &part : result.partitions) {
+        Log::info("Registered partition: {}", part.name());
+        localPartitions.push_back(std::move(part)); // Add to partition list.
       }
-    } else
-      Log::error("Failed to load partitions from {}.", std::quoted_string(p));
+      gptDataCollection[result.path] = std::move(result.gpt); // Add to GPT data list.
+    }
+
+    cacheStorePending = ScanCache::enabled() && !gptDataCollection.empty(); // Written by valid(), don't verify twice.
   }
 
-  Log::info("Scan complete, sorting partitions by name...");
+  Log::info("Scan complete, sorting and indexing partitions by name...");
+  Helper::Trace::Span indexSpan("scan", "index partitions");
   std::sort(localPartitions.begin(), localPartitions.end(),
-            [](const Partition_t &a, const Partition_t &b) { return a.name() < b.name(); });
+            [](const Partition_t &a, const Partition_t &b) { return a.nameRef() < b.nameRef(); });
+  nameIndex.build(localPartitions);
+}
+
+void PartitionTableData::loadGPTData() const {
+  static std::mutex loadMutex;
+  std::lock_guard lock(loadMutex);
+  if (!gptDataPending) return;
+
+  Log::info("Loading GPTData of cached partition tables...");
+  Helper::Trace::Span span("scan", "load GPTData");
+  std::vector<std::filesystem::path> targets;
+  for (auto &p : scanTargets(localTableNames))
+    if (gptDataCollection.find(p) == gptDataCollection.end()) targets.push_back(std::move(p)); // Loaded by fallback scan.
+
+  for (auto &result : scanTables(targets))
+    if (result.gpt) gptDataCollection[result.path] = std::move(result.gpt);
+  gptDataPending = false;
 }
 
 void PartitionTableData::findTablePaths() {
   Log::info("Finding partition tables in {}...", std::quoted_string("/dev/block"));
+  Helper::Trace::Span span("scan", "find partition tables");
   try {
     std::vector<std::filesystem::directory_entry> entries{std::filesystem::directory_iterator("/dev/block"),
                                                           std::filesystem::directory_iterator()};
@@ -143,8 +336,9 @@ PartitionTableData::const_list_t PartitionTableData::partitionsByTable(const std
 std::vector<std::pair<bool, std::string>> PartitionTableData::duplicatePartitionPositions(const std::string &name) const {
   Log::info("Building and providing (non)duplicate partition status for {} partition.", std::quoted_string(name));
   std::vector<std::pair<bool, std::string>> parts;
-  for (auto &part : localPartitions) {
-    if (part.name() == name) parts.emplace_back(!part.pathByName().empty(), part.tableName());
+  for (const size_t i : nameIndex.find(name)) {
+    const auto &part = localPartitions[i];
+    parts.emplace_back(!part.pathByName().empty(), part.tableName());
   }
 
   return parts;
@@ -173,12 +367,14 @@ std::unordered_set<std::filesystem::path> PartitionTableData::tablePaths() const
 
 const std::map<std::filesystem::path, std::shared_ptr<GPTData>> &PartitionTableData::allGPTData() const {
   Log::info("Providing all GPTData.");
+  loadGPTData();
   return gptDataCollection;
 }
 
 const std::shared_ptr<GPTData> &PartitionTableData::GPTDataOf(const std::string &name) const {
   std::filesystem::path p("/dev/block");
   p /= name;
+  loadGPTData();
   if (gptDataCollection.find(p) == gptDataCollection.end()) throw Error("Can't find GPT data of {}", name);
   Log::info("Providing GPTData of {} table.", std::quoted_string(name));
   return gptDataCollection.at(p);
@@ -187,6 +383,7 @@ const std::shared_ptr<GPTData> &PartitionTableData::GPTDataOf(const std::string
 std::shared_ptr<GPTData> &PartitionTableData::GPTDataOf(const std::string &name) {
   std::filesystem::path p("/dev/block");
   p /= name;
+  loadGPTData();
   if (gptDataCollection.find(p) == gptDataCollection.end()) throw Error("Can't find GPT data of {}", name);
   Log::info("Providing GPTData of {} table.", std::quoted_string(name));
   return gptDataCollection.at(p);
@@ -215,24 +412,26 @@ std::vector<BasicInfo> PartitionTableData::aboutPartitionsByTable(const std::str
 }
 
 std::optional<std::reference_wrapper<Partition_t>> PartitionTableData::partition(const std::string &name, const std::string &from) {
-  auto it = std::find_if(localPartitions.begin(), localPartitions.end(), [&](const Partition_t &p) {
-    return from.empty() ? p.name() == name : p.name() == name && p.tableName() == from;
-  });
-  if (it == localPartitions.end()) return std::nullopt;
+  for (const size_t i : nameIndex.find(name)) {
+    if (from.empty() || localPartitions[i].tableName() == from) {
+      Log::info("Providing Partition_t object of {} partition.", std::quoted_string(name));
+      return std::ref(localPartitions[i]);
+    }
+  }
 
-  Log::info("Providing Partition_t object of {} partition.", std::quoted_string(name));
-  return std::ref(*it);
+  return std::nullopt;
 }
 
 std::optional<std::reference_wrapper<const Partition_t>> PartitionTableData::partition(const std::string &name,
                                                                                        const std::string &from) const {
-  auto it = std::find_if(localPartitions.begin(), localPartitions.end(), [&](const Partition_t &p) {
-    return from.empty() ? p.name() == name : p.name() == name && p.tableName() == from;
-  });
-  if (it == localPartitions.end()) return std::nullopt;
+  for (const size_t i : nameIndex.find(name)) {
+    if (from.empty() || localPartitions[i].tableName() == from) {
+      Log::info("Providing Partition_t object of {} partition.", std::quoted_string(name));
+      return std::cref(localPartitions[i]);
+    }
+  }
 
-  Log::info("Providing Partition_t object of {} partition.", std::quoted_string(name));
-  return std::cref(*it);
+  return std::nullopt;
 }
 
 std::optional<std::reference_wrapper<Partition_t>> PartitionTableData::partitionWithDupCheck(const std::string &name, bool check) {
@@ -306,12 +505,7 @@ std::optional<std::reference_wrapper<const Partition_t>> PartitionTableData::par
 
 bool PartitionTableData::hasPartition(const std::string &name) const {
   Log::info("Checking {} named partition is exists.", std::quoted_string(name));
-  bool found = false;
-  std::for_each(localPartitions.begin(), localPartitions.end(), [&](auto &part) {
-    if (part.name() == name) found = true;
-  });
-
-  return found;
+  return !nameIndex.find(name).empty();
 }
 
 bool PartitionTableData::sync() {
@@ -325,7 +519,9 @@ bool PartitionTableData::sync() {
 
 bool PartitionTableData::sync(const std::string &name) {
   auto &data = GPTDataOf(name);
-  return data->SaveGPTData(true) && data->SaveMBR();
+  const bool success = data->SaveGPTData(true) && data->SaveMBR();
+  openpart_gpt_invalidate(("/dev/block/" + name).c_str()); // Drop cached table of libopenpart.
+  return success;
 }
 
 bool PartitionTableData::hasTable(const std::string &name) const {
@@ -346,12 +542,7 @@ uint64_t PartitionTableData::freeSpaceOf(const std::string &name) const {
 
 int PartitionTableData::hasDuplicateNamedPartition(const std::string &name) const {
   Log::info("Checking {} named partition count.", std::quoted_string(name));
-  int i = 0;
-  std::for_each(localPartitions.begin(), localPartitions.end(), [&](const Partition_t &part) {
-    if (part.name() == name) i++;
-  });
-
-  return i;
+  return static_cast<int>(nameIndex.find(name).size());
 }
 
 bool PartitionTableData::isUsesUFS() const {
@@ -361,7 +552,7 @@ bool PartitionTableData::isUsesUFS() const {
 
 bool PartitionTableData::isHasSuperPartition() const {
   Log::info("Checking \"super\" partition is exists.");
-  return std::any_of(localPartitions.begin(), localPartitions.end(), [](const auto &part) { return part.name() == "super"; });
+  return !nameIndex.find("super").empty();
 }
 
 bool PartitionTableData::empty() const {
@@ -373,8 +564,15 @@ bool PartitionTableData::tableNamesEmpty() const { return localTableNames.empty(
 
 bool PartitionTableData::valid() const {
   Log::info("Checking GPTData integrity.");
+  if (gptDataPending && cachedValidity.has_value()) {
+    Log::info("GPTData is not loaded, using result stored in scan cache: {}", *cachedValidity ? "valid" : "invalid");
+    return *cachedValidity;
+  }
+
+  loadGPTData();
+
   bool hasGptProblems = false;
-  Helper::Silencer silencer;
+  Helper::OutputCapture capture;
   std::for_each(gptDataCollection.begin(), gptDataCollection.end(), [&](auto &pair) {
     if (pair.second->Verify() != 0 && pair.second->CheckHeaderValidity() != 3) {
       Log::error("FOUND PROBLEMS ON {}", pair.first.string());
@@ -383,6 +581,10 @@ bool PartitionTableData::valid() const {
   });
 
   Log::info("Found problem: {}", hasGptProblems ? "true" : "false");
+  if (cacheStorePending) {
+    cacheStorePending = false;
+    ScanCache::storeGpt(gptDataCollection, !hasGptProblems);
+  }
   return !hasGptProblems;
 }
 
@@ -420,9 +622,36 @@ PartitionTableData &PartitionTableData::withTables(const std::unordered_set<std:
 
 void PartitionTableData::setGPTDataOf(const std::string &name, std::shared_ptr<GPTData> data) {
   Log::info("Setting up GPTData of {} partition table.", std::quoted_string(name));
+  loadGPTData();
+  cacheStorePending = false;
   if (auto it = gptDataCollection.find("/dev/block/" + name); it != gptDataCollection.end()) it->second = std::move(data);
 }
 
+void PartitionTableData::renamePartition(const std::string &name, const std::string &newName, const std::string &from) {
+  Log::info("Renaming {} partition to {}.", std::quoted_string(name), std::quoted_string(newName));
+  if (newName.empty() || newName.size() > 36) throw Error("Invalid partition name: {}", newName);
+  if (from.empty() && hasDuplicateNamedPartition(name) > 1)
+    throw Error("More than one partition is named {}, specify its table", name);
+
+  auto found = partition(name, from);
+  if (!found) throw Error("Couldn't find partition: {}", name);
+  Partition_t &part = found->get();
+
+  loadGPTData();
+  const auto &data = GPTDataOf(part.tableName());
+  if (!data->SetName(part.index(), newName)) throw Error("Cannot rename {} in GPT data of {}", name, part.tableName());
+
+  GPTPart gptPart = *part.getGPTPartRef();
+  gptPart.SetName(newName);
+  part.setGptPart(gptPart);
+  cacheStorePending = false;
+
+  // Keep the list sorted and the name index in sync with it.
+  std::sort(localPartitions.begin(), localPartitions.end(),
+            [](const Partition_t &a, const Partition_t &b) { return a.nameRef() < b.nameRef(); });
+  nameIndex.build(localPartitions);
+}
+
 void PartitionTableData::setAutoScan(bool state) { buildAutoOnDiskChanges = state; }
 
 PartitionTableData &PartitionTableData::withAutoScan(bool state) {
@@ -435,6 +664,9 @@ void PartitionTableData::clear() {
   localPartitions.clear();
   localTableNames.clear();
   gptDataCollection.clear();
+  nameIndex.clear();
+  gptDataPending = false;
+  cacheStorePending = false;
 }
 
 void PartitionTableData::reset() {
@@ -460,6 +692,7 @@ PartitionTableData::const_iterator PartitionTableData::cbegin() const { return l
 PartitionTableData::const_iterator PartitionTableData::cend() const { return localPartitions.cend(); }
 
 bool PartitionTableData::operator==(const PartitionTableData &other) const {
+  loadGPTData();
   bool equal = true;
   std::for_each(gptDataCollection.begin(), gptDataCollection.end(), [&](auto &pair) {
     if (pair.second->GetDiskGUID() != other.GPTDataOf(pair.first)->GetDiskGUID()) equal = false;
@@ -494,42 +727,25 @@ PartitionTableData::list_t PartitionTableData::operator*() {
 
 const std::shared_ptr<GPTData> &PartitionTableData::operator[](const std::string &name) const {
   const std::filesystem::path p("/dev/block/" + name);
+  loadGPTData();
   if (gptDataCollection.find(p) == gptDataCollection.end()) throw Error("Can't find GPT data of {}", name);
   return gptDataCollection.at(p);
 }
 
 std::shared_ptr<GPTData> &PartitionTableData::operator[](const std::string &name) {
   const std::filesystem::path p("/dev/block/" + name);
+  loadGPTData();
   if (gptDataCollection.find(p) == gptDataCollection.end()) throw Error("Can't find GPT data of {}", name);
   return gptDataCollection.at(p);
 }
 
-GPTPart *PartitionTableData::operator()(const std::string &name, uint32_t index) {
-  if (!hasTable(name)) return nullptr;
-
-  std::string name_;
-  for (auto &part : localPartitions) {
-    if (part.tableName() == name && part.index() == index) {
-      name_ = part.name();
-      break;
-    }
-  }
-
-  return partition(name_)->get().getGPTPartRef();
-}
-
 const GPTPart *PartitionTableData::operator()(const std::string &name, uint32_t index) const {
   if (!hasTable(name)) return nullptr;
 
-  std::string name_;
-  for (auto &part : localPartitions) {
-    if (part.tableName() == name && part.index() == index) {
-      name_ = part.name();
-      break;
-    }
-  }
+  for (const auto &part : localPartitions)
+    if (part.index() == index && part.tableName() == name) return part.getGPTPartRef();
 
-  return partition(name_)->get().getGPTPartRef();
+  return nullptr;
 }
 
 PartitionTableData &PartitionTableData::operator=(PartitionTableData &&other) noexcept {
@@ -537,11 +753,18 @@ PartitionTableData &PartitionTableData::operator=(PartitionTableData &&other) no
     localPartitions = std::move(other.localPartitions);
     gptDataCollection = std::move(other.gptDataCollection);
     localTableNames = std::move(other.localTableNames);
+    nameIndex = std::move(other.nameIndex);
     buildAutoOnDiskChanges = other.buildAutoOnDiskChanges;
     isUFS = other.isUFS;
+    source = other.source;
+    gptDataPending = other.gptDataPending;
+    cachedValidity = other.cachedValidity;
+    cacheStorePending = other.cacheStorePending;
 
     other.buildAutoOnDiskChanges = true;
     other.isUFS = false;
+    other.gptDataPending = false;
+    other.cacheStorePending = false;
   }
 
   return *this;
@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2026 Yağız Zengin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <libhelper/lib.hpp>
+#include <libpartition_map/partition.hpp>
+
+namespace PartitionMap {
+
+namespace {
+
+constexpr double RATE_WINDOW = 2.0;  // Time constant of throughput smoothing, in seconds.
+constexpr double MIN_INTERVAL = 0.05; // Minimum interval between throughput samples, in seconds.
+constexpr double MIB = 1024.0 * 1024.0;
+constexpr int BAR_WIDTH = 20;
+
+std::atomic<int> eventFd{-1};
+
+double seconds(std::chrono::steady_clock::duration duration) { return std::chrono::duration<double>(duration).count(); }
+
+std::string jsonString(const std::string &text) {
+  std::string out = "\"";
+  for (const char c : text) {
+    if (c == '"' || c == '\\') out += {'\\', c};
+    else if (static_cast<unsigned char>(c) < 0x20) out += fmt::format("\\u{:04x}", static_cast<int>(c));
+    else out += c;
+  }
+  return out += '"';
+}
+
+std::string jsonEta(double eta) { return std::isfinite(eta) ? fmt::format("{:.1f}", eta) : "null"; }
+
+/// @brief Write one event line. A line is written with one write() call, so lines of concurrent writers don't mix.
+void writeEvent(const std::string &line) {
+  const int fd = eventFd.load(std::memory_order_relaxed);
+  if (fd == -1) return;
+
+  const std::string data = line + "\n";
+  for (size_t written = 0; written < data.size();) {
+    const ssize_t n = write(fd, data.data() + written, data.size() - written);
+    if (n == -1 && errno == EINTR) continue;
+    if (n <= 0) return; // Reader may be gone, progress is not worth failing the operation.
+    written += static_cast<size_t>(n);
+  }
+}
+
+std::string formatEta(double eta) {
+  if (!std::isfinite(eta)) return "ETA --:--";
+  const auto total = static_cast<uint64_t>(eta + 0.5);
+  if (total >= 3600) return fmt::format("ETA {}:{:02}:{:02}", total / 3600, total / 60 % 60, total % 60);
+  return fmt::format("ETA {}:{:02}", total / 60, total % 60);
+}
+
+std::string formatLine(const std::string &name, uint64_t done, uint64_t total, double rate, const std::string &tail) {
+  const double fraction = total > 0 ? std::min(1.0, static_cast<double>(done) / static_cast<double>(total)) : 0.0;
+  const int filled = static_cast<int>(fraction * BAR_WIDTH);
+
+  std::string bar;
+  bar.reserve(BAR_WIDTH * 3);
+  for (int i = 0; i < BAR_WIDTH; i++)
+    bar += i < filled ? "━" : "╌";
+
+  return fmt::format("{:<16} [{}] {:>3}% {:>7.1f} MiB/s {}", name, bar, static_cast<int>(fraction * 100), rate / MIB, tail);
+}
+
+} // namespace
+
+void ProgressRenderer::setEventFd(int fd) {
+  if (fd != -1 && fcntl(fd, F_GETFD) == -1) throw Error("Invalid progress file descriptor {}: {}", fd, strerror(errno));
+  eventFd.store(fd, std::memory_order_relaxed);
+}
+
+ProgressRenderer::ProgressRenderer(const bool quiet)
+    : _started(Clock::now()), _sampled(_started), _quiet(quiet), _terminal(!quiet && isatty(STDOUT_FILENO) == 1) {}
+
+std::shared_ptr<Progress_t> ProgressRenderer::add(const std::string &name, Progress_t::size_type total) {
+  std::lock_guard lock(_mutex);
+  auto p = std::make_shared<Progress_t>(name, total);
+  const auto now = Clock::now();
+  writeEvent(fmt::format(R"({{"event":"start","id":{},"name":{},"total":{},"time":{:.3f}}})", _entries.size(), jsonString(name),
+                         total, seconds(now - _started)));
+  _entries.push_back({p, now, now});
+  return p;
+}
+
+void ProgressRenderer::start() {
+  _running.store(true, std::memory_order_relaxed);
+  _thread = std::thread(&ProgressRenderer::render, this);
+}
+
+void ProgressRenderer::stop() {
+  _running.store(false, std::memory_order_relaxed);
+  if (_thread.joinable()) _thread.join();
+  draw();
+}
+
+void ProgressRenderer::render() {
+  while (_running.load(std::memory_order_relaxed)) {
+    draw();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+}
+
+void ProgressRenderer::draw() {
+  std::lock_guard lock(_mutex);
+  const auto now = Clock::now();
+  const double time = seconds(now - _started);
+  Progress_t::size_type totalDone = 0, total = 0;
+  size_t finished = 0, failed = 0;
+  bool ended = false;
+
+  for (size_t i = 0; i < _entries.size(); i++) {
+    Entry &entry = _entries[i];
+    const Progress_t &p = *entry.progress;
+    const Progress_t::size_type done = p.done.load(std::memory_order_relaxed);
+    const bool isFailed = p.failed.load(std::memory_order_relaxed);
+    const bool isFinished = isFailed || p.finished.load(std::memory_order_relaxed);
+    totalDone += done;
+    total += p.total;
+    if (isFailed) failed++;
+    else if (isFinished) finished++;
+    if (entry.ended) continue;
+
+    if (isFinished) { // Average rate is shown for ended entries.
+      const double elapsed = seconds(now - entry.added);
+      entry.rate = elapsed > 0 ? static_cast<double>(done) / elapsed : 0;
+      entry.ended = ended = true;
+      writeEvent(fmt::format(
+          R"({{"event":"end","id":{},"name":{},"status":"{}","done":{},"total":{},"elapsed":{:.3f},"rate":{:.0f},"time":{:.3f}}})", i,
+          jsonString(p.name), isFailed ? "failed" : "done", done, p.total, elapsed, entry.rate, time));
+      if (!_terminal && !_quiet)
+        std::cout << fmt::format("{}: {} ({:.1f} MiB in {:.1f}s, {:.1f} MiB/s)", p.name, isFailed ? "failed" : "done",
+                                 static_cast<double>(done) / MIB, elapsed, entry.rate / MIB)
+                  << std::endl;
+      continue;
+    }
+
+    const double dt = seconds(now - entry.sampled);
+    if (dt < MIN_INTERVAL) continue;
+    const double instant = static_cast<double>(done > entry.lastDone ? done - entry.lastDone : 0) / dt;
+    const double weight = entry.lastDone == 0 && entry.rate == 0 ? 1.0 : 1.0 - std::exp(-dt / RATE_WINDOW);
+    entry.rate += weight * (instant - entry.rate);
+    if (done != entry.lastDone) {
+      const double eta = entry.rate > 0 ? static_cast<double>(p.total > done ? p.total - done : 0) / entry.rate : NAN;
+      writeEvent(fmt::format(R"({{"event":"progress","id":{},"name":{},"done":{},"total":{},"rate":{:.0f},"eta":{},"time":{:.3f}}})",
+                             i, jsonString(p.name), done, p.total, entry.rate, jsonEta(eta), time));
+    }
+    entry.lastDone = done;
+    entry.sampled = now;
+  }
+
+  if (const double dt = seconds(now - _sampled); dt >= MIN_INTERVAL || ended) {
+    const double instant = dt > 0 ? static_cast<double>(totalDone > _lastTotalDone ? totalDone - _lastTotalDone : 0) / dt : 0;
+    _totalRate += (1.0 - std::exp(-dt / RATE_WINDOW)) * (instant - _totalRate);
+    if (totalDone != _lastTotalDone || ended) {
+      const double eta = _totalRate > 0 ? static_cast<double>(total > totalDone ? total - totalDone : 0) / _totalRate : NAN;
+      writeEvent(fmt::format(
+          R"({{"event":"total","done":{},"total":{},"rate":{:.0f},"eta":{},"entries":{},"finished":{},"failed":{},"time":{:.3f}}})",
+          totalDone, total, _totalRate, jsonEta(eta), _entries.size(), finished, failed, time));
+    }
+    _lastTotalDone = totalDone;
+    _sampled = now;
+  }
+  if (!_terminal) return;
+
+  // Lines are only redrawn from the first changed one; unchanged lines after it are skipped.
+  std::vector<std::string> lines = buildLines();
+  if (lines.size() < _lines.size()) lines.resize(_lines.size()); // Clear lines left from a longer view.
+  size_t first = 0;
+  while (first < lines.size() && first < _lines.size() && lines[first] == _lines[first])
+    first++;
+  if (first == lines.size()) return;
+
+  std::string out;
+  if (_lines.size() > first) out += fmt::format("\033[{}A", _lines.size() - first);
+  for (size_t i = first; i < lines.size(); i++) {
+    if (i < _lines.size() && lines[i] == _lines[i]) out += "\n";
+    else out += "\r" + lines[i] + "\033[K\r\n";
+  }
+  std::cout << out << std::flush;
+  _lines = std::move(lines);
+}
+
+std::vector<std::string> ProgressRenderer::buildLines() const {
+  std::vector<std::string> lines;
+  Progress_t::size_type totalDone = 0, total = 0;
+  size_t ended = 0, failed = 0;
+  const bool collapsed = _entries.size() >= MAX_LINES; // With the total line, entries wouldn't fit.
+
+  for (const Entry &entry : _entries) {
+    const Progress_t &p = *entry.progress;
+    const Progress_t::size_type done = p.done.load(std::memory_order_relaxed);
+    const bool isFailed = p.failed.load(std::memory_order_relaxed);
+    totalDone += done;
+    total += p.total;
+    if (entry.ended) ended++;
+    if (entry.ended && isFailed) failed++;
+
+    if (collapsed && (entry.ended || lines.size() >= MAX_LINES - 1)) continue; // Only running entries are shown.
+    const double eta = entry.rate > 0 ? static_cast<double>(p.total > done ? p.total - done : 0) / entry.rate : NAN;
+    lines.push_back(formatLine(p.name, done, p.total, entry.rate, !entry.ended ? formatEta(eta) : isFailed ? "failed" : "done"));
+  }
+
+  if (_entries.size() > 1) {
+    const double eta = _totalRate > 0 ? static_cast<double>(total > totalDone ? total - totalDone : 0) / _totalRate : NAN;
+    std::string tail = ended == _entries.size() ? "done" : formatEta(eta);
+    tail += fmt::format(" ({}/{} ended", ended, _entries.size());
+    tail += failed > 0 ? fmt::format(", {} failed)", failed) : ")";
+    lines.insert(lines.begin(), formatLine("total", totalDone, total, _totalRate, tail));
+  }
+  if (collapsed) lines.resize(MAX_LINES); // Keep height of view fixed.
+  return lines;
+}
+
+} // namespace PartitionMap
@@ -0,0 +1,486 @@
+/*
+ * Copyright (C) 2026 Yağız Zengin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <libhelper/lib.hpp>
+#include <libpartition_map/scan_cache.hpp>
+#include <libpartition_map/definations.hpp>
+#include <liblp/metadata_format.h>
+
+namespace PartitionMap {
+
+namespace {
+
+constexpr char kMagic[8] = {'P', 'M', 'T', 'S', 'C', 'A', 'N', '\0'};
+constexpr uint32_t kVersion = 2;
+constexpr uint32_t kKindGpt = 1;
+constexpr uint32_t kKindLp = 2;
+constexpr size_t kGptHeaderSize = 92;
+constexpr size_t kPathSize = 64;
+
+// gptfdisk reads on-disk entries directly into GPTPart objects, so do we.
+static_assert(sizeof(GPTPart) == 128, "GPTPart must have on-disk GPT entry layout");
+
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t kind;
+  uint64_t payloadSize;
+  uint64_t payloadHash; // FNV-1a of the payload.
+};
+
+struct GptTableRecord {
+  char path[kPathSize];
+  uint8_t diskGuid[16];
+  uint32_t primaryCrc;
+  uint32_t backupCrc;
+  uint32_t sectorSize;
+  uint32_t partitionCount;
+};
+
+struct GptEntryRecord {
+  uint32_t index;
+  uint32_t reserved;
+  uint8_t entry[sizeof(GPTPart)];
+};
+
+struct LpRecord {
+  char path[kPathSize];
+  uint32_t partitions;
+  uint32_t extents;
+  uint32_t groups;
+  uint32_t blockDevices;
+  uint32_t slot;
+};
+
+/// @brief Values read from the disk to check a GPT table is unchanged.
+struct GptKey {
+  std::array<uint8_t, 16> diskGuid{};
+  uint32_t primaryCrc = 0;
+  uint32_t backupCrc = 0;
+};
+
+std::mutex configMutex;
+std::optional<std::filesystem::path> configuredDirectory;
+
+uint64_t fnv1a(const uint8_t *data, const size_t size) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= data[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+bool copyPath(char (&out)[kPathSize], const std::filesystem::path &path) {
+  const std::string str = path.string();
+  if (str.size() >= kPathSize) return false;
+  std::memset(out, 0, kPathSize);
+  std::memcpy(out, str.data(), str.size());
+  return true;
+}
+
+std::string readPath(const char (&in)[kPathSize]) { return {in, strnlen(in, kPathSize)}; }
+
+template <typename T> void append(std::string &out, const T &value) { out.append(reinterpret_cast<const char *>(&value), sizeof(T)); }
+
+template <typename T> void appendAll(std::string &out, const std::vector<T> &values) {
+  out.append(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(T));
+}
+
+/// @brief Bounds-checked reader over a mapped cache file.
+class Reader {
+  const uint8_t *cur;
+  const uint8_t *end;
+
+public:
+  Reader(const uint8_t *data, const size_t size) : cur(data), end(data + size) {}
+
+  template <typename T> bool get(T &value) {
+    if (static_cast<size_t>(end - cur) < sizeof(T)) return false;
+    std::memcpy(static_cast<void *>(&value), cur, sizeof(T));
+    cur += sizeof(T);
+    return true;
+  }
+
+  template <typename T> bool getAll(std::vector<T> &values, const size_t count) {
+    if (static_cast<size_t>(end - cur) / sizeof(T) < count) return false;
+    values.resize(count);
+    std::memcpy(static_cast<void *>(values.data()), cur, count * sizeof(T));
+    cur += count * sizeof(T);
+    return true;
+  }
+
+  bool done() const { return cur == end; }
+};
+
+/// @brief Check a cache entry has the given type, is owned by the effective user (root) and isn't accessible by others.
+bool isPrivate(const struct stat &st, const mode_t type) {
+  return (st.st_mode & S_IFMT) == type && st.st_uid == geteuid() && (st.st_mode & 077) == 0;
+}
+
+/// @brief Check the cache directory is private. Symbolic links are not followed.
+bool isPrivateDirectory(const std::filesystem::path &dir) {
+  struct stat st{};
+  return lstat(dir.c_str(), &st) == 0 && isPrivate(st, S_IFDIR);
+}
+
+/// @brief Read-only mapping of a cache file. Files of other owners or with group/other permissions are not mapped.
+class Mapping {
+  void *data_ = MAP_FAILED;
+  size_t size_ = 0;
+
+public:
+  explicit Mapping(const std::filesystem::path &path) {
+    if (!isPrivateDirectory(path.parent_path())) {
+      if (Helper::directoryIsExists(path.parent_path()))
+        Log::warning("Ignoring scan cache directory {}: not private to root.", std::quoted_string(path.parent_path()));
+      return;
+    }
+
+    Helper::UniqueFD fd(path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    fd.syncOnClose = false;
+    if (!fd) return;
+
+    struct stat st{};
+    if (fstat(fd.fd(), &st) != 0) return;
+    if (!isPrivate(st, S_IFREG)) {
+      Log::warning("Ignoring scan cache file {}: not private to root.", std::quoted_string(path));
+      return;
+    }
+    if (st.st_size < static_cast<off_t>(sizeof(FileHeader))) return;
+    size_ = static_cast<size_t>(st.st_size);
+    data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd.fd(), 0);
+  }
+
+  ~Mapping() {
+    if (data_ != MAP_FAILED) munmap(data_, size_);
+  }
+
+  Mapping(const Mapping &) = delete;
+  Mapping &operator=(const Mapping &) = delete;
+
+  explicit operator bool() const noexcept { return data_ != MAP_FAILED; }
+  const uint8_t *data() const noexcept { return static_cast<const uint8_t *>(data_); }
+  size_t size() const noexcept { return size_; }
+};
+
+/// @brief Map cache file and check its header. Returns a reader positioned at the payload.
+std::optional<Reader> openCache(const Mapping &map, const uint32_t kind) {
+  if (!map) return std::nullopt;
+
+  FileHeader header{};
+  std::memcpy(&header, map.data(), sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion || header.kind != kind) return std::nullopt;
+  if (header.payloadSize != map.size() - sizeof(FileHeader)) return std::nullopt;
+
+  const uint8_t *payload = map.data() + sizeof(FileHeader);
+  if (fnv1a(payload, header.payloadSize) != header.payloadHash) return std::nullopt;
+  return Reader(payload, header.payloadSize);
+}
+
+/// @brief Atomically replace a cache file with the given payload.
+bool writeCache(const std::filesystem::path &path, const uint32_t kind, const std::string &payload) {
+  const std::filesystem::path dir = path.parent_path();
+  if (struct stat st{}; lstat(dir.c_str(), &st) != 0) {
+    const auto parent = dir.parent_path();
+    if ((!parent.empty() && !Helper::directoryIsExists(parent) && !Helper::makeRecursiveDirectory(parent)) ||
+        mkdir(dir.c_str(), 0700) != 0) {
+      Log::warning("Cannot create scan cache directory {}: {}", std::quoted_string(dir), strerror(errno));
+      return false;
+    }
+  }
+  if (!isPrivateDirectory(dir)) {
+    Log::warning("Not writing scan cache: {} is not a directory private to root.", std::quoted_string(dir));
+    return false;
+  }
+
+  FileHeader header{};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.kind = kind;
+  header.payloadSize = payload.size();
+  header.payloadHash = fnv1a(reinterpret_cast<const uint8_t *>(payload.data()), payload.size());
+
+  std::string content;
+  content.reserve(sizeof(header) + payload.size());
+  append(content, header);
+  content += payload;
+
+  const std::filesystem::path tmp = path.string() + ".tmp";
+  {
+    Helper::UniqueFD fd(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (!fd) {
+      Log::warning("Cannot create scan cache file {}: {}", std::quoted_string(tmp), strerror(errno));
+      return false;
+    }
+
+    if (fd.write(content.data(), content.size()) != static_cast<ssize_t>(content.size())) {
+      Log::warning("Cannot write scan cache file {}: {}", std::quoted_string(tmp), strerror(errno));
+      fd.close();
+      unlink(tmp.c_str());
+      return false;
+    }
+  } // Synced on close.
+
+  if (rename(tmp.c_str(), path.c_str()) != 0) {
+    Log::warning("Cannot rename {} to {}: {}", std::quoted_string(tmp), std::quoted_string(path), strerror(errno));
+    unlink(tmp.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+/// @brief Read both GPT headers of a table. This is the validation read of the GPT cache.
+std::optional<GptKey> readGptKey(const std::filesystem::path &path, const uint32_t sectorSize) {
+  if (sectorSize < kGptHeaderSize) return std::nullopt;
+
+  Helper::UniqueFD fd(path, O_RDONLY | O_CLOEXEC);
+  fd.syncOnClose = false;
+  if (!fd) return std::nullopt;
+
+  uint8_t header[kGptHeaderSize];
+  auto readHeader = [&](const uint64_t lba) {
+    return pread(fd.fd(), header, sizeof(header), static_cast<off_t>(lba * sectorSize)) == static_cast<ssize_t>(sizeof(header)) &&
+           std::memcmp(header, "EFI PART", 8) == 0;
+  };
+
+  GptKey key;
+  if (!readHeader(1)) return std::nullopt;
+  uint64_t backupLba = 0;
+  std::memcpy(&key.primaryCrc, header + 16, sizeof(key.primaryCrc));
+  std::memcpy(&backupLba, header + 32, sizeof(backupLba));
+  std::memcpy(key.diskGuid.data(), header + 56, key.diskGuid.size());
+
+  if (!readHeader(backupLba)) return std::nullopt;
+  std::memcpy(&key.backupCrc, header + 16, sizeof(key.backupCrc));
+  return key;
+}
+
+/// @brief Read header checksum of a metadata slot. This is the validation read of the LP cache.
+std::optional<std::array<uint8_t, 32>> readLpKey(const std::filesystem::path &path, const uint32_t slot,
+                                                 const uint32_t metadataMaxSize) {
+  Helper::UniqueFD fd(path, O_RDONLY | O_CLOEXEC);
+  fd.syncOnClose = false;
+  if (!fd) return std::nullopt;
+
+  LpMetadataHeader header{};
+  const off_t offset = LP_PARTITION_RESERVED_BYTES + LP_METADATA_GEOMETRY_SIZE * 2 + static_cast<off_t>(slot) * metadataMaxSize;
+  if (pread(fd.fd(), &header, sizeof(header), offset) != static_cast<ssize_t>(sizeof(header))) return std::nullopt;
+  if (header.magic != LP_METADATA_HEADER_MAGIC) return std::nullopt;
+
+  std::array<uint8_t, 32> checksum{};
+  std::memcpy(checksum.data(), header.header_checksum, checksum.size());
+  return checksum;
+}
+
+std::filesystem::path cacheFile(const char *name) {
+  const auto dir = ScanCache::directory();
+  return dir.empty() ? dir : dir / name;
+}
+
+} // namespace
+
+void ScanCache::setDirectory(const std::filesystem::path &directory) {
+  std::lock_guard lock(configMutex);
+  configuredDirectory = directory;
+}
+
+std::filesystem::path ScanCache::directory() {
+  std::lock_guard lock(configMutex);
+  if (!configuredDirectory) {
+    const char *env = getenv("PMT_SCAN_CACHE");
+    if (env == nullptr)
+      configuredDirectory = DEFAULT_DIRECTORY;
+    else if (const std::string value = env; value.empty() || value == "0" || value == "off")
+      configuredDirectory = std::filesystem::path();
+    else
+      configuredDirectory = value;
+  }
+
+  return *configuredDirectory;
+}
+
+bool ScanCache::enabled() { return !directory().empty(); }
+
+std::optional<ScanCache::GptCatalog> ScanCache::loadGpt(const std::vector<std::filesystem::path> &tables) {
+  const auto file = cacheFile("gpt.cache");
+  if (file.empty()) return std::nullopt;
+  Helper::Trace::Span span("scan", "load GPT cache");
+
+  const Mapping map(file);
+  auto reader = openCache(map, kKindGpt);
+  if (!reader) {
+    Log::info("No usable GPT scan cache in {}.", std::quoted_string(file));
+    return std::nullopt;
+  }
+
+  uint32_t tableCount = 0, valid = 0;
+  if (!reader->get(tableCount) || !reader->get(valid) || tableCount != tables.size()) return std::nullopt;
+
+  GptCatalog catalog;
+  catalog.valid = valid != 0;
+
+  for (uint32_t t = 0; t < tableCount; ++t) {
+    GptTableRecord record{};
+    if (!reader->get(record)) return std::nullopt;
+
+    const std::filesystem::path path = readPath(record.path);
+    if (std::find(tables.begin(), tables.end(), path) == tables.end()) {
+      Log::info("GPT scan cache is outdated: {} is not scanned anymore.", std::quoted_string(path));
+      return std::nullopt;
+    }
+
+    const auto key = readGptKey(path, record.sectorSize);
+    if (!key || key->primaryCrc != record.primaryCrc || key->backupCrc != record.backupCrc ||
+        std::memcmp(key->diskGuid.data(), record.diskGuid, sizeof(record.diskGuid)) != 0) {
+      Log::info("GPT scan cache is outdated: {} has changed.", std::quoted_string(path));
+      return std::nullopt;
+    }
+
+    for (uint32_t i = 0; i < record.partitionCount; ++i) {
+      GptEntryRecord entry{};
+      if (!reader->get(entry)) return std::nullopt;
+
+      GPTPart part;
+      std::memcpy(static_cast<void *>(&part), entry.entry, sizeof(entry.entry));
+      Partition_t _part(path, part, static_cast<openpart_t *>(nullptr), entry.index);
+      _part.setSectorSize(record.sectorSize);
+      catalog.partitions.push_back(std::move(_part));
+    }
+
+  }
+
+  if (!reader->done()) return std::nullopt;
+  Log::info("Loaded {} partitions of {} tables from GPT scan cache.", catalog.partitions.size(), tableCount);
+  return catalog;
+}
+
+bool ScanCache::storeGpt(const std::map<std::filesystem::path, std::shared_ptr<GPTData>> &collection, const bool valid) {
+  const auto file = cacheFile("gpt.cache");
+  if (file.empty()) return false;
+  Helper::Trace::Span span("scan", "store GPT cache");
+
+  std::string payload;
+  append(payload, static_cast<uint32_t>(collection.size()));
+  append(payload, static_cast<uint32_t>(valid));
+
+  for (const auto &[path, gpt] : collection) {
+    GptTableRecord record{};
+    const auto key = readGptKey(path, gpt->GetBlockSize());
+    if (!copyPath(record.path, path) || !key) {
+      Log::warning("Cannot create GPT scan cache key for {}.", std::quoted_string(path));
+      return false;
+    }
+
+    std::vector<GptEntryRecord> entries;
+    for (uint32_t i = 0; i < gpt->GetNumParts(); ++i) {
+      if (GPTPart part = (*gpt)[i]; part.IsUsed()) {
+        GptEntryRecord entry{};
+        entry.index = i;
+        std::memcpy(entry.entry, static_cast<const void *>(&part), sizeof(entry.entry));
+        entries.push_back(entry);
+      }
+    }
+
+    std::memcpy(record.diskGuid, key->diskGuid.data(), sizeof(record.diskGuid));
+    record.primaryCrc = key->primaryCrc;
+    record.backupCrc = key->backupCrc;
+    record.sectorSize = gpt->GetBlockSize();
+    record.partitionCount = static_cast<uint32_t>(entries.size());
+    append(payload, record);
+    appendAll(payload, entries);
+  }
+
+  if (!writeCache(file, kKindGpt, payload)) return false;
+  Log::info("GPT scan cache written to {}.", std::quoted_string(file));
+  return true;
+}
+
+std::unique_ptr<android::fs_mgr::LpMetadata> ScanCache::loadLp(const std::filesystem::path &super, const uint32_t slot) {
+  const auto file = cacheFile("lp.cache");
+  if (file.empty()) return nullptr;
+  Helper::Trace::Span span("scan", "load LP cache");
+
+  const Mapping map(file);
+  auto reader = openCache(map, kKindLp);
+  if (!reader) {
+    Log::info("No usable super metadata cache in {}.", std::quoted_string(file));
+    return nullptr;
+  }
+
+  LpRecord record{};
+  auto metadata = std::make_unique<android::fs_mgr::LpMetadata>();
+  if (!reader->get(record) || readPath(record.path) != super.string() || record.slot != slot || !reader->get(metadata->geometry) ||
+      !reader->get(metadata->header) || !reader->getAll(metadata->partitions, record.partitions) ||
+      !reader->getAll(metadata->extents, record.extents) || !reader->getAll(metadata->groups, record.groups) ||
+      !reader->getAll(metadata->block_devices, record.blockDevices) || !reader->done())
+    return nullptr;
+
+  if (const auto key = readLpKey(super, slot, metadata->geometry.metadata_max_size);
+      !key || std::memcmp(key->data(), metadata->header.header_checksum, key->size()) != 0) {
+    Log::info("Super metadata cache is outdated: {} has changed.", std::quoted_string(super));
+    return nullptr;
+  }
+
+  Log::info("Loaded super metadata from cache.");
+  return metadata;
+}
+
+bool ScanCache::storeLp(const std::filesystem::path &super, const android::fs_mgr::LpMetadata &metadata, const uint32_t slot) {
+  const auto file = cacheFile("lp.cache");
+  if (file.empty()) return false;
+  Helper::Trace::Span span("scan", "store LP cache");
+
+  LpRecord record{};
+  if (!copyPath(record.path, super)) return false;
+  record.partitions = static_cast<uint32_t>(metadata.partitions.size());
+  record.extents = static_cast<uint32_t>(metadata.extents.size());
+  record.groups = static_cast<uint32_t>(metadata.groups.size());
+  record.blockDevices = static_cast<uint32_t>(metadata.block_devices.size());
+  record.slot = slot;
+
+  std::string payload;
+  append(payload, record);
+  append(payload, metadata.geometry);
+  append(payload, metadata.header);
+  appendAll(payload, metadata.partitions);
+  appendAll(payload, metadata.extents);
+  appendAll(payload, metadata.groups);
+  appendAll(payload, metadata.block_devices);
+
+  if (!writeCache(file, kKindLp, payload)) return false;
+  Log::info("Super metadata cache written to {}.", std::quoted_string(file));
+  return true;
+}
+
+void ScanCache::invalidate() {
+  for (const char *name : {"gpt.cache", "lp.cache"})
+    if (const auto file = cacheFile(name); !file.empty()) unlink(file.c_str());
+}
+
+} // namespace PartitionMap
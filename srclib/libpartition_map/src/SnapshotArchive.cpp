@@ -0,0 +1,392 @@
+/*
+ * Copyright (C) 2026 Yağız Zengin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <libhelper/lib.hpp>
+#include <libpartition_map/definations.hpp>
+#include <libpartition_map/snapshot_archive.hpp>
+
+namespace PartitionMap {
+
+namespace {
+
+// Layout: FileHeader, then chunks (ChunkHeader + data), then index (EntryRecord[], DiskChunk[]) and Trailer.
+constexpr char kArchiveMagic[8] = {'P', 'M', 'T', 'S', 'N', 'A', 'P', '\0'};
+constexpr char kIndexMagic[8] = {'P', 'M', 'T', 'I', 'N', 'D', 'E', 'X'};
+constexpr uint32_t kChunkMagic = 0x4b4e4843; // "CHNK"
+constexpr uint32_t kVersion = 1;
+constexpr uint32_t kChunkZero = 1 << 0; // Chunk is all zero, no data is stored.
+
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t chunkSize;
+};
+
+struct ChunkHeader {
+  uint32_t magic;
+  uint32_t entry;
+  uint64_t offset;
+  uint32_t size;
+  uint32_t flags;
+};
+
+struct EntryRecord {
+  uint32_t type;
+  uint32_t chunkCount;
+  uint64_t size;
+  uint64_t firstChunk;
+  char name[72]; // Same limit as GPT partition names.
+  char table[40];
+};
+
+struct DiskChunk {
+  uint64_t fileOffset;
+  uint64_t offset;
+  uint32_t size;
+  uint32_t flags;
+};
+
+struct Trailer {
+  char magic[8];
+  uint64_t indexOffset;
+  uint64_t chunkCount;
+  uint32_t entryCount;
+  uint32_t version;
+};
+
+static_assert(sizeof(FileHeader) == 16 && sizeof(ChunkHeader) == 24 && sizeof(EntryRecord) == 136 && sizeof(DiskChunk) == 24 &&
+                  sizeof(Trailer) == 32,
+              "Unexpected snapshot archive layout");
+
+void readExactly(int fd, void *buffer, size_t size, uint64_t offset, const std::filesystem::path &path) {
+  auto *out = static_cast<uint8_t *>(buffer);
+  while (size > 0) {
+    const ssize_t n = pread(fd, out, size, static_cast<off_t>(offset));
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) throw Error("Cannot read {} at {}: {}", path.string(), offset, n == 0 ? "Unexpected end of file" : strerror(errno));
+    out += n;
+    size -= n;
+    offset += n;
+  }
+}
+
+void writeExactly(int fd, const void *buffer, size_t size, uint64_t offset) {
+  const auto *in = static_cast<const uint8_t *>(buffer);
+  while (size > 0) {
+    const ssize_t n = pwrite(fd, in, size, static_cast<off_t>(offset));
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) throw Error("Cannot write at {}: {}", offset, strerror(errno));
+    in += n;
+    size -= n;
+    offset += n;
+  }
+}
+
+bool isZero(const std::vector<char> &data) {
+  return std::all_of(data.begin(), data.end(), [](const char c) { return c == 0; });
+}
+
+} // namespace
+
+SnapshotWriter::SnapshotWriter(const std::filesystem::path &path, const uint32_t chunkSize, const size_t maxQueuedChunks)
+    : fd(path, O_WRONLY | O_CREAT | O_TRUNC, DEFAULT_FILE_PERMS), archivePath(path), chunkBytes(chunkSize),
+      maxPending(std::max<size_t>(maxQueuedChunks, 1)) {
+  if (!fd) throw Error("Cannot create {}: {}", path.string(), strerror(errno));
+  if (chunkSize == 0) throw Error("Chunk size of snapshot archive cannot be zero.");
+
+  FileHeader header = {};
+  std::memcpy(header.magic, kArchiveMagic, sizeof(header.magic));
+  header.version = kVersion;
+  header.chunkSize = chunkSize;
+  append(&header, sizeof(header));
+
+  writerThread = std::thread(&SnapshotWriter::writerLoop, this);
+}
+
+SnapshotWriter::~SnapshotWriter() {
+  {
+    std::lock_guard lock(mutex);
+    closing = true;
+  }
+  queueChanged.notify_all();
+  if (writerThread.joinable()) writerThread.join();
+}
+
+void SnapshotWriter::append(const void *buffer, const size_t size) {
+  const auto *in = static_cast<const uint8_t *>(buffer);
+  size_t done = 0;
+  while (done < size) {
+    const ssize_t n = fd.write(in + done, size - done);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) throw Error("Cannot write {}: {}", archivePath.string(), strerror(errno));
+    done += n;
+  }
+  position += size;
+}
+
+void SnapshotWriter::writerLoop() {
+  Helper::Trace::nameThread("snapshot writer");
+  for (;;) {
+    Pending item;
+    {
+      std::unique_lock lock(mutex);
+      queueChanged.wait(lock, [this] { return !queue.empty() || closing; });
+      if (queue.empty()) return;
+      item = std::move(queue.front());
+      queue.pop_front();
+    }
+    queueChanged.notify_all();
+
+    try {
+      const bool zero = item.data.empty();
+      const ChunkHeader header = {kChunkMagic, item.entry, item.offset, item.size, zero ? kChunkZero : 0};
+      append(&header, sizeof(header));
+
+      const uint64_t dataOffset = zero ? 0 : position;
+      if (!zero) {
+        Helper::Trace::Span span("write", "append chunk of entry #{}", item.entry);
+        append(item.data.data(), item.size);
+      }
+
+      std::lock_guard lock(mutex);
+      chunks[item.entry].push_back({dataOffset, item.offset, item.size, header.flags});
+      if (!zero) entries[item.entry].storedSize += item.size;
+    } catch (const std::exception &e) { // Also std::bad_alloc, the thread must not terminate the process.
+      std::lock_guard lock(mutex);
+      failure = e.what();
+      queue.clear();
+      closing = true;
+      queueChanged.notify_all();
+      return;
+    }
+  }
+}
+
+uint32_t SnapshotWriter::addEntry(const SnapshotEntry::Type type, const std::string &name, const std::string &table,
+                                  const uint64_t size) {
+  if (name.empty() || name.size() >= sizeof(EntryRecord::name)) throw Error("Invalid snapshot entry name: {}", name);
+  if (table.size() >= sizeof(EntryRecord::table)) throw Error("Invalid snapshot entry table name: {}", table);
+
+  std::lock_guard lock(mutex);
+  if (finished) throw Error("Snapshot archive {} is already finished.", archivePath.string());
+
+  entries.push_back({type, name, table, size, 0, 0, 0});
+  chunks.emplace_back();
+  Log::info("Added snapshot entry #{}: {} ({} bytes).", entries.size() - 1, std::quoted_string(name), size);
+  return static_cast<uint32_t>(entries.size() - 1);
+}
+
+void SnapshotWriter::write(const uint32_t entry, const uint64_t offset, std::vector<char> &&data) {
+  if (data.empty()) return;
+  if (data.size() > chunkBytes) throw Error("Chunk is larger than chunk size of archive ({} > {}).", data.size(), chunkBytes);
+
+  // Zero check is done by the caller thread, the writer thread only appends.
+  const auto size = static_cast<uint32_t>(data.size());
+  if (isZero(data)) data = std::vector<char>();
+
+  std::unique_lock lock(mutex);
+  if (entry >= entries.size()) throw Error("Invalid snapshot entry ID: {}", entry);
+  if (offset + size > entries[entry].size)
+    throw Error("Chunk is out of snapshot entry {} ({} > {}).", entries[entry].name, offset + size, entries[entry].size);
+
+  if (queue.size() >= maxPending && !closing) { // Writer thread is behind, wait for a free slot.
+    Helper::Trace::Span span("wait", "snapshot queue full");
+    queueChanged.wait(lock, [this] { return queue.size() < maxPending || closing; });
+  }
+  if (!failure.empty()) throw Error("Cannot write {}: {}", archivePath.string(), failure);
+  if (closing) throw Error("Snapshot archive {} is closed.", archivePath.string());
+
+  queue.push_back({entry, offset, size, std::move(data)});
+  lock.unlock();
+  queueChanged.notify_all();
+}
+
+std::vector<SnapshotEntry> SnapshotWriter::finish() {
+  {
+    std::lock_guard lock(mutex);
+    if (finished) return entries;
+    closing = true;
+  }
+  queueChanged.notify_all();
+  if (writerThread.joinable()) writerThread.join();
+  if (!failure.empty()) throw Error("Cannot write {}: {}", archivePath.string(), failure);
+
+  std::vector<DiskChunk> index;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    auto &list = chunks[i];
+    std::sort(list.begin(), list.end(), [](const ChunkRecord &a, const ChunkRecord &b) { return a.offset < b.offset; });
+
+    uint64_t expected = 0;
+    for (const auto &chunk : list) {
+      if (chunk.offset != expected) break;
+      expected += chunk.size;
+    }
+    if (expected != entries[i].size)
+      throw Error("Snapshot entry {} is incomplete ({} of {} bytes).", entries[i].name, expected, entries[i].size);
+
+    entries[i].firstChunk = index.size();
+    entries[i].chunkCount = static_cast<uint32_t>(list.size());
+    for (const auto &chunk : list)
+      index.push_back({chunk.fileOffset, chunk.offset, chunk.size, chunk.flags});
+  }
+
+  Log::info("Writing index of {} ({} entries, {} chunks).", std::quoted_string(archivePath.string()), entries.size(), index.size());
+  const uint64_t indexOffset = position;
+  for (const auto &entry : entries) {
+    EntryRecord record = {};
+    record.type = entry.type;
+    record.chunkCount = entry.chunkCount;
+    record.size = entry.size;
+    record.firstChunk = entry.firstChunk;
+    std::strncpy(record.name, entry.name.c_str(), sizeof(record.name) - 1);
+    std::strncpy(record.table, entry.table.c_str(), sizeof(record.table) - 1);
+    append(&record, sizeof(record));
+  }
+  if (!index.empty()) append(index.data(), index.size() * sizeof(DiskChunk));
+
+  Trailer trailer = {};
+  std::memcpy(trailer.magic, kIndexMagic, sizeof(trailer.magic));
+  trailer.indexOffset = indexOffset;
+  trailer.chunkCount = index.size();
+  trailer.entryCount = static_cast<uint32_t>(entries.size());
+  trailer.version = kVersion;
+  append(&trailer, sizeof(trailer));
+
+  if (fd.fsync() != 0) throw Error("Cannot sync {}: {}", archivePath.string(), strerror(errno));
+  finished = true;
+  return entries;
+}
+
+SnapshotReader::SnapshotReader(const std::filesystem::path &path) : fd(path, O_RDONLY), archivePath(path) {
+  if (!fd) throw Error("Cannot open {}: {}", path.string(), strerror(errno));
+  fd.syncOnClose = false;
+
+  struct stat st = {};
+  if (fstat(fd.fd(), &st) != 0) throw Error("Cannot stat {}: {}", path.string(), strerror(errno));
+  const auto fileSize = static_cast<uint64_t>(st.st_size);
+  if (fileSize < sizeof(FileHeader) + sizeof(Trailer)) throw Error("{} is not a snapshot archive.", path.string());
+
+  FileHeader header = {};
+  readExactly(fd.fd(), &header, sizeof(header), 0, path);
+  if (std::memcmp(header.magic, kArchiveMagic, sizeof(header.magic)) != 0) throw Error("{} is not a snapshot archive.", path.string());
+  if (header.version != kVersion) throw Error("Unsupported snapshot archive version: {}", header.version);
+
+  Trailer trailer = {};
+  readExactly(fd.fd(), &trailer, sizeof(trailer), fileSize - sizeof(Trailer), path);
+  if (std::memcmp(trailer.magic, kIndexMagic, sizeof(trailer.magic)) != 0)
+    throw Error("{} has no index (archive is incomplete).", path.string());
+  // Counts are checked against size of the index region before multiplying, so corrupted counts can't overflow.
+  if (trailer.indexOffset < sizeof(FileHeader) || trailer.indexOffset > fileSize - sizeof(Trailer))
+    throw Error("Index of {} is corrupted.", path.string());
+  const uint64_t indexSize = fileSize - sizeof(Trailer) - trailer.indexOffset;
+  if (trailer.entryCount > indexSize / sizeof(EntryRecord) ||
+      trailer.chunkCount > (indexSize - trailer.entryCount * sizeof(EntryRecord)) / sizeof(DiskChunk) ||
+      trailer.entryCount * sizeof(EntryRecord) + trailer.chunkCount * sizeof(DiskChunk) != indexSize)
+    throw Error("Index of {} is corrupted.", path.string());
+
+  std::vector<EntryRecord> records(trailer.entryCount);
+  std::vector<DiskChunk> diskChunks(trailer.chunkCount);
+  if (!records.empty()) readExactly(fd.fd(), records.data(), records.size() * sizeof(EntryRecord), trailer.indexOffset, path);
+  if (!diskChunks.empty())
+    readExactly(fd.fd(), diskChunks.data(), diskChunks.size() * sizeof(DiskChunk),
+                trailer.indexOffset + records.size() * sizeof(EntryRecord), path);
+
+  chunks.reserve(diskChunks.size());
+  for (const auto &chunk : diskChunks) {
+    if (!(chunk.flags & kChunkZero) && (chunk.size > trailer.indexOffset || chunk.fileOffset > trailer.indexOffset - chunk.size))
+      throw Error("Index of {} is corrupted.", path.string());
+    chunks.push_back({chunk.fileOffset, chunk.offset, chunk.size, chunk.flags});
+  }
+
+  entryList.reserve(records.size());
+  for (auto &record : records) {
+    if (record.firstChunk > chunks.size() || record.chunkCount > chunks.size() - record.firstChunk)
+      throw Error("Index of {} is corrupted.", path.string());
+    record.name[sizeof(record.name) - 1] = '\0';
+    record.table[sizeof(record.table) - 1] = '\0';
+
+    uint64_t stored = 0;
+    for (uint64_t i = record.firstChunk; i < record.firstChunk + record.chunkCount; ++i) {
+      if (chunks[i].offset > record.size || chunks[i].size > record.size - chunks[i].offset)
+        throw Error("Index of {} is corrupted: Chunk is out of entry {}.", path.string(), record.name);
+      if (!(chunks[i].flags & kChunkZero)) stored += chunks[i].size;
+    }
+    entryList.push_back({static_cast<SnapshotEntry::Type>(record.type), record.name, record.table, record.size, record.firstChunk,
+                         record.chunkCount, stored});
+  }
+
+  Log::info("Opened snapshot archive {} ({} entries).", std::quoted_string(path.string()), entryList.size());
+}
+
+const SnapshotEntry *SnapshotReader::find(const SnapshotEntry::Type type, const std::string &name, const std::string &table) const {
+  for (const auto &entry : entryList) {
+    if (entry.type == type && entry.name == name && (table.empty() || entry.table == table)) return &entry;
+  }
+  return nullptr;
+}
+
+std::vector<char> SnapshotReader::read(const SnapshotEntry &entry) const {
+  std::vector<char> data(entry.size, 0);
+  for (uint64_t i = entry.firstChunk; i < entry.firstChunk + entry.chunkCount; ++i) {
+    const auto &chunk = chunks[i];
+    if (!(chunk.flags & kChunkZero)) readExactly(fd.fd(), data.data() + chunk.offset, chunk.size, chunk.fileOffset, archivePath);
+  }
+  return data;
+}
+
+void SnapshotReader::extract(const SnapshotEntry &entry, const WriteFunction &write, const bool writeZeros,
+                             const IOCallback &callback) const {
+  uint32_t bufferSize = 0;
+  for (uint64_t i = entry.firstChunk; i < entry.firstChunk + entry.chunkCount; ++i)
+    bufferSize = std::max(bufferSize, chunks[i].size);
+  std::vector<char> buffer(bufferSize, 0);
+
+  uint64_t done = 0;
+  for (uint64_t i = entry.firstChunk; i < entry.firstChunk + entry.chunkCount; ++i) {
+    const auto &chunk = chunks[i];
+    if (chunk.flags & kChunkZero) {
+      if (writeZeros) {
+        std::fill(buffer.begin(), buffer.begin() + chunk.size, 0);
+        write(buffer.data(), chunk.size, chunk.offset);
+      }
+    } else {
+      readExactly(fd.fd(), buffer.data(), chunk.size, chunk.fileOffset, archivePath);
+      write(buffer.data(), chunk.size, chunk.offset);
+    }
+
+    done += chunk.size;
+    if (callback) callback(done, entry.size);
+  }
+}
+
+void SnapshotReader::extract(const SnapshotEntry &entry, const int out, const bool writeZeros, const IOCallback &callback) const {
+  extract(entry, [out](const void *buffer, size_t size, uint64_t offset) { writeExactly(out, buffer, size, offset); }, writeZeros,
+          callback);
+
+  // Trailing zero chunks of files are holes.
+  if (!writeZeros && ftruncate(out, static_cast<off_t>(entry.size)) != 0)
+    throw Error("Cannot resize output of {}: {}", entry.name, strerror(errno));
+}
+
+} // namespace PartitionMap
@@ -0,0 +1,503 @@
+/*
+ * Copyright (C) 2026 Yağız Zengin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <libhelper/lib.hpp>
+#include <libpartition_map/definations.hpp>
+#include <libpartition_map/super_image.hpp>
+#include <liblp/builder.h>
+#include <liblp/metadata_format.h>
+#include <liblp/partition_opener.h>
+#include <sparse/sparse.h>
+
+using namespace android;
+
+namespace PartitionMap {
+
+namespace {
+
+// Android sparse image format (see libsparse/sparse_format.h).
+constexpr uint32_t kSparseMagic = 0xed26ff3a;
+constexpr uint16_t kChunkRaw = 0xcac1;
+constexpr uint16_t kChunkFill = 0xcac2;
+constexpr uint16_t kChunkDontCare = 0xcac3;
+constexpr uint16_t kChunkCrc32 = 0xcac4;
+
+struct SparseHeader {
+  uint32_t magic;
+  uint16_t majorVersion;
+  uint16_t minorVersion;
+  uint16_t fileHeaderSize;
+  uint16_t chunkHeaderSize;
+  uint32_t blockSize;
+  uint32_t totalBlocks;
+  uint32_t totalChunks;
+  uint32_t imageChecksum;
+};
+
+struct ChunkHeader {
+  uint16_t type;
+  uint16_t reserved;
+  uint32_t blocks; // Size in blocks of the expanded image.
+  uint32_t size;   // Size in bytes of the chunk (header and data).
+};
+
+static_assert(sizeof(SparseHeader) == 28 && sizeof(ChunkHeader) == 12, "Unexpected sparse header layout");
+
+constexpr uint64_t kCopyStep = 64ULL * 1024 * 1024; // Progress is reported after each step.
+constexpr size_t kBufferSize = 1024 * 1024;
+
+void readExactly(int fd, void *buffer, size_t size, uint64_t offset, const std::filesystem::path &path) {
+  auto *out = static_cast<uint8_t *>(buffer);
+  while (size > 0) {
+    const ssize_t n = pread(fd, out, size, static_cast<off_t>(offset));
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) throw Error("Cannot read {} at {}: {}", path.string(), offset, n == 0 ? "Unexpected end of file" : strerror(errno));
+    out += n;
+    size -= n;
+    offset += n;
+  }
+}
+
+void writeExactly(int fd, const void *buffer, size_t size, uint64_t offset) {
+  const auto *in = static_cast<const uint8_t *>(buffer);
+  while (size > 0) {
+    const ssize_t n = pwrite(fd, in, size, static_cast<off_t>(offset));
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) throw Error("Cannot write at {}: {}", offset, strerror(errno));
+    in += n;
+    size -= n;
+    offset += n;
+  }
+}
+
+/// Copy with copy_file_range(). Returns false if the kernel or files don't support it, nothing is written then.
+bool copyInKernel(int in, uint64_t inOffset, int out, uint64_t outOffset, uint64_t size) {
+#ifdef __NR_copy_file_range
+  bool first = true;
+  while (size > 0) {
+    auto inOff = static_cast<loff_t>(inOffset), outOff = static_cast<loff_t>(outOffset);
+    const ssize_t n = syscall(__NR_copy_file_range, in, &inOff, out, &outOff, size, 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) {
+      if (first && (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP)) return false;
+      throw Error("Cannot copy data: {}", n == 0 ? "Unexpected end of file" : strerror(errno));
+    }
+    first = false;
+    inOffset += n;
+    outOffset += n;
+    size -= n;
+  }
+  return true;
+#else
+  (void)in, (void)inOffset, (void)out, (void)outOffset, (void)size;
+  return false;
+#endif
+}
+
+/// Copy a range of file, in kernel if possible.
+void copyRange(int in, uint64_t inOffset, int out, uint64_t outOffset, uint64_t size, const std::filesystem::path &path) {
+  if (copyInKernel(in, inOffset, out, outOffset, size)) return;
+
+  auto buffer = std::make_unique<uint8_t[]>(std::min<uint64_t>(size, kBufferSize));
+  for (uint64_t done = 0; done < size;) {
+    const uint64_t n = std::min<uint64_t>(size - done, kBufferSize);
+    readExactly(in, buffer.get(), n, inOffset + done, path);
+    writeExactly(out, buffer.get(), n, outOffset + done);
+    done += n;
+  }
+}
+
+/// Partition opener for writing metadata into an already opened file with FlashPartitionTable().
+class FileOpener final : public fs_mgr::IPartitionOpener {
+  const int fd;
+  const fs_mgr::BlockDeviceInfo info;
+
+public:
+  FileOpener(int fd, fs_mgr::BlockDeviceInfo info) : fd(fd), info(std::move(info)) {}
+
+  base::unique_fd Open(const std::string &, int) const override { return base::unique_fd(dup(fd)); }
+
+  bool GetInfo(const std::string &, fs_mgr::BlockDeviceInfo *out) const override {
+    *out = info;
+    return true;
+  }
+
+  std::string GetDeviceString(const std::string &name) const override { return name; }
+};
+
+/// Write metadata to all slots of a file which has the size of super.
+void writeMetadata(int fd, const fs_mgr::LpMetadata &metadata, const SuperLayout &layout, const std::filesystem::path &path) {
+  const FileOpener opener(fd, fs_mgr::BlockDeviceInfo(metadata.block_devices[0].partition_name, layout.deviceSize, layout.alignment, 0,
+                                                      layout.blockSize));
+  if (!fs_mgr::FlashPartitionTable(opener, fs_mgr::GetBlockDevicePartitionName(metadata.block_devices[0]), metadata))
+    throw Error("Cannot write LP metadata to {}", path.string());
+}
+
+} // namespace
+
+SuperImage::SuperImage(const std::filesystem::path &path, const uint32_t slot) : fd(path, O_RDONLY | O_CLOEXEC), imagePath(path) {
+  fd.syncOnClose = false;
+  if (!fd) throw Error("Cannot open {}: {}", path.string(), strerror(errno));
+
+  parseSparse();
+  readMetadata(slot);
+}
+
+void SuperImage::parseSparse() {
+  SparseHeader header = {};
+  if (pread(fd.fd(), &header, sizeof(header), 0) != sizeof(header) || header.magic != kSparseMagic) {
+    const off_t end = lseek(fd.fd(), 0, SEEK_END);
+    if (end < 0) throw Error("Cannot get size of {}: {}", imagePath.string(), strerror(errno));
+    imageSize = static_cast<uint64_t>(end);
+    Log::info("{} is a raw image ({} bytes).", std::quoted_string(imagePath.string()), imageSize);
+    return;
+  }
+
+  if (header.majorVersion != 1 || header.fileHeaderSize < sizeof(SparseHeader) || header.chunkHeaderSize < sizeof(ChunkHeader) ||
+      header.blockSize == 0 || header.blockSize % 4 != 0)
+    throw Error("Unsupported sparse image: {}", imagePath.string());
+
+  sparse = true;
+  chunks.reserve(header.totalChunks);
+  uint64_t position = header.fileHeaderSize, block = 0;
+  for (uint32_t i = 0; i < header.totalChunks; ++i) {
+    ChunkHeader chunk = {};
+    readExactly(fd.fd(), &chunk, sizeof(chunk), position, imagePath);
+    const uint64_t dataOffset = position + header.chunkHeaderSize;
+    const uint64_t size = static_cast<uint64_t>(chunk.blocks) * header.blockSize;
+
+    switch (chunk.type) {
+      case kChunkRaw:
+        if (chunk.size != header.chunkHeaderSize + size) throw Error("Corrupted raw chunk #{} in {}", i, imagePath.string());
+        chunks.push_back({block * header.blockSize, size, dataOffset, 0, true});
+        break;
+      case kChunkFill: {
+        uint32_t fill = 0;
+        readExactly(fd.fd(), &fill, sizeof(fill), dataOffset, imagePath);
+        if (fill != 0) chunks.push_back({block * header.blockSize, size, 0, fill, false});
+        break;
+      }
+      case kChunkDontCare:
+      case kChunkCrc32:
+        break;
+      default:
+        throw Error("Unknown chunk type {:#x} in {}", chunk.type, imagePath.string());
+    }
+
+    block += chunk.blocks;
+    position += chunk.size;
+  }
+
+  imageSize = static_cast<uint64_t>(header.totalBlocks) * header.blockSize;
+  Log::info("{} is a sparse image ({} chunks, {} bytes expanded).", std::quoted_string(imagePath.string()), header.totalChunks,
+            imageSize);
+}
+
+void SuperImage::readMetadata(const uint32_t slot) {
+  // liblp reads metadata images as geometry followed by metadata; build one from each geometry and metadata copy.
+  auto blob = std::make_unique<uint8_t[]>(LP_METADATA_GEOMETRY_SIZE);
+  for (const uint64_t geometryOffset : {LP_PARTITION_RESERVED_BYTES, LP_PARTITION_RESERVED_BYTES + LP_METADATA_GEOMETRY_SIZE}) {
+    if (read(blob.get(), LP_METADATA_GEOMETRY_SIZE, geometryOffset) != LP_METADATA_GEOMETRY_SIZE) continue;
+
+    LpMetadataGeometry geometry = {};
+    memcpy(&geometry, blob.get(), sizeof(geometry));
+    if (geometry.magic != LP_METADATA_GEOMETRY_MAGIC || slot >= geometry.metadata_slot_count || geometry.metadata_max_size == 0)
+      continue;
+
+    const uint64_t metadataStart = LP_PARTITION_RESERVED_BYTES + LP_METADATA_GEOMETRY_SIZE * 2;
+    const uint64_t blobSize = LP_METADATA_GEOMETRY_SIZE + geometry.metadata_max_size;
+    auto full = std::make_unique<uint8_t[]>(blobSize);
+    memcpy(full.get(), blob.get(), LP_METADATA_GEOMETRY_SIZE);
+
+    for (const uint64_t metadataOffset : {metadataStart + static_cast<uint64_t>(slot) * geometry.metadata_max_size,
+                                          metadataStart + static_cast<uint64_t>(geometry.metadata_slot_count + slot) *
+                                                              geometry.metadata_max_size}) {
+      if (read(full.get() + LP_METADATA_GEOMETRY_SIZE, geometry.metadata_max_size, metadataOffset) != geometry.metadata_max_size)
+        continue;
+      if (metadata = fs_mgr::ReadFromImageBlob(full.get(), blobSize); metadata) {
+        Log::info("Read LP metadata of slot {} from {} (at {}).", slot, std::quoted_string(imagePath.string()), metadataOffset);
+        return;
+      }
+    }
+  }
+
+  throw Error("Cannot find valid LP metadata (slot {}) in {}", slot, imagePath.string());
+}
+
+uint64_t SuperImage::partitionSize(const std::string &name) const {
+  for (const auto &partition : metadata->partitions) {
+    if (name != partition.name) continue;
+
+    uint64_t size = 0;
+    for (uint32_t i = 0; i < partition.num_extents; ++i)
+      size += metadata->extents[partition.first_extent_index + i].num_sectors * LP_SECTOR_SIZE;
+    return size;
+  }
+
+  return UINT64_MAX;
+}
+
+uint64_t SuperImage::read(void *buffer, const uint64_t size, const uint64_t offset) const {
+  if (offset >= imageSize) return 0;
+  const uint64_t total = std::min(size, imageSize - offset);
+  if (!sparse) {
+    readExactly(fd.fd(), buffer, total, offset, imagePath);
+    return total;
+  }
+
+  auto *out = static_cast<uint8_t *>(buffer);
+  uint64_t done = 0;
+  auto it = std::upper_bound(chunks.begin(), chunks.end(), offset, [](uint64_t o, const Chunk &c) { return o < c.offset; });
+  if (it != chunks.begin()) --it;
+
+  while (done < total) {
+    const uint64_t position = offset + done;
+    while (it != chunks.end() && it->offset + it->size <= position)
+      ++it;
+
+    if (it == chunks.end() || position < it->offset) { // Not covered, reads as zero.
+      const uint64_t gap = std::min(total - done, (it == chunks.end() ? imageSize : it->offset) - position);
+      memset(out + done, 0, gap);
+      done += gap;
+      continue;
+    }
+
+    const uint64_t inChunk = position - it->offset;
+    const uint64_t length = std::min(total - done, it->size - inChunk);
+    if (it->raw)
+      readExactly(fd.fd(), out + done, length, it->fileOffset + inChunk, imagePath);
+    else {
+      const auto *pattern = reinterpret_cast<const uint8_t *>(&it->fill);
+      for (uint64_t i = 0; i < length; ++i)
+        out[done + i] = pattern[(inChunk + i) % 4]; // Chunks are block aligned, so the pattern starts at 4-byte boundaries.
+    }
+    done += length;
+  }
+
+  return total;
+}
+
+void SuperImage::copyData(const int out, const uint64_t offset, const uint64_t size, const uint64_t outOffset) const {
+  // Pieces with data in the file are copied in kernel if possible; the rest is read through read().
+  if (!sparse) return copyRange(fd.fd(), offset, out, outOffset, size, imagePath);
+
+  auto it = std::upper_bound(chunks.begin(), chunks.end(), offset, [](uint64_t o, const Chunk &c) { return o < c.offset; });
+  if (it != chunks.begin()) --it;
+
+  for (; it != chunks.end() && it->offset < offset + size; ++it) {
+    const uint64_t begin = std::max(offset, it->offset), end = std::min(offset + size, it->offset + it->size);
+    if (begin >= end) continue; // Holes are left in output.
+
+    if (it->raw)
+      copyRange(fd.fd(), it->fileOffset + (begin - it->offset), out, outOffset + (begin - offset), end - begin, imagePath);
+    else {
+      auto buffer = std::make_unique<uint8_t[]>(std::min<uint64_t>(end - begin, kBufferSize));
+      for (uint64_t position = begin; position < end;) {
+        const uint64_t n = read(buffer.get(), std::min<uint64_t>(end - position, kBufferSize), position);
+        writeExactly(out, buffer.get(), n, outOffset + (position - offset));
+        position += n;
+      }
+    }
+  }
+}
+
+uint64_t SuperImage::extract(const std::string &name, const std::filesystem::path &output, const IOCallback &callback) const {
+  const auto it = std::find_if(metadata->partitions.begin(), metadata->partitions.end(),
+                               [&](const LpMetadataPartition &p) { return name == p.name; });
+  if (it == metadata->partitions.end()) throw Error("Couldn't find logical partition in {}: {}", imagePath.string(), name);
+
+  const uint64_t total = partitionSize(name);
+  auto out = Helper::UniqueFD(output, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, DEFAULT_FILE_PERMS);
+  if (!out) throw Error("Cannot create/open {}: {}", output.string(), strerror(errno));
+  if (ftruncate(out.fd(), static_cast<off_t>(total)) != 0) throw Error("Cannot resize {}: {}", output.string(), strerror(errno));
+
+  uint64_t logicalOffset = 0;
+  for (uint32_t i = 0; i < it->num_extents; ++i) {
+    const auto &extent = metadata->extents[it->first_extent_index + i];
+    const uint64_t size = extent.num_sectors * LP_SECTOR_SIZE;
+
+    if (extent.target_type == LP_TARGET_TYPE_LINEAR) {
+      if (extent.target_source != 0)
+        throw Error("Extent of {} is on block device #{}, only the first block device is in {}", name, extent.target_source,
+                    imagePath.string());
+      if (extent.target_data * LP_SECTOR_SIZE + size > imageSize)
+        throw Error("Extent of {} is out of {} (truncated image?)", name, imagePath.string());
+
+      for (uint64_t done = 0; done < size;) {
+        const uint64_t step = std::min(size - done, kCopyStep);
+        copyData(out.fd(), extent.target_data * LP_SECTOR_SIZE + done, step, logicalOffset + done);
+        done += step;
+        if (callback) callback(logicalOffset + done, total);
+      }
+    }
+
+    logicalOffset += size;
+    if (callback && extent.target_type != LP_TARGET_TYPE_LINEAR) callback(logicalOffset, total);
+  }
+
+  return total;
+}
+
+std::unique_ptr<fs_mgr::LpMetadata> SuperImage::buildMetadata(const SuperLayout &layout) {
+  if (layout.deviceSize == 0 || layout.blockSize == 0 || layout.deviceSize % layout.blockSize != 0)
+    throw Error("Super size must be a multiple of block size ({})", layout.blockSize);
+
+  const fs_mgr::BlockDeviceInfo device("super", layout.deviceSize, layout.alignment, 0, layout.blockSize);
+  auto builder = fs_mgr::MetadataBuilder::New(device, layout.metadataSize, layout.metadataSlots);
+  if (!builder) throw Error("Invalid super geometry (size: {}, metadata size: {}, slots: {})", layout.deviceSize, layout.metadataSize,
+                            layout.metadataSlots);
+
+  for (const auto &group : layout.groups) {
+    if (!builder->AddGroup(group.name, group.maximumSize)) throw Error("Cannot add group: {}", group.name);
+  }
+
+  for (const auto &partition : layout.partitions) {
+    uint64_t size = partition.size;
+    if (!partition.image.empty()) {
+      struct stat st = {};
+      if (stat(partition.image.c_str(), &st) != 0) throw Error("Cannot stat {}: {}", partition.image.string(), strerror(errno));
+
+      uint32_t magic = 0;
+      auto in = Helper::UniqueFD(partition.image, O_RDONLY | O_CLOEXEC);
+      in.syncOnClose = false;
+      if (in && pread(in.fd(), &magic, sizeof(magic), 0) == sizeof(magic) && magic == kSparseMagic)
+        throw Error("Sparse images cannot be packed, convert {} to raw image first", partition.image.string());
+
+      if (size == 0) size = static_cast<uint64_t>(st.st_size);
+      if (static_cast<uint64_t>(st.st_size) > size)
+        throw Error("Image is too large for {}: {} ({} > {})", partition.name, partition.image.string(), st.st_size, size);
+    }
+
+    auto *added = builder->AddPartition(partition.name, partition.group, partition.attributes);
+    if (!added) throw Error("Cannot add partition {} to group {}", partition.name, partition.group);
+    if (!builder->ResizePartition(added, size)) throw Error("Not enough space in super or group {} for {} ({} bytes)", partition.group,
+                                                            partition.name, size);
+  }
+
+  auto metadata = builder->Export();
+  if (!metadata) throw Error("Cannot export LP metadata (too many partitions for metadata size?)");
+  return metadata;
+}
+
+std::unique_ptr<fs_mgr::LpMetadata> SuperImage::pack(const SuperLayout &layout, const std::filesystem::path &output, const bool sparse,
+                                                     const PackCallback &callback) {
+  auto metadata = buildMetadata(layout);
+  const uint64_t metadataEnd = LP_PARTITION_RESERVED_BYTES + LP_METADATA_GEOMETRY_SIZE * 2 +
+                               static_cast<uint64_t>(layout.metadataSize) * layout.metadataSlots * 2;
+
+  auto out = Helper::UniqueFD(output, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, DEFAULT_FILE_PERMS);
+  if (!out) throw Error("Cannot create/open {}: {}", output.string(), strerror(errno));
+
+  // Metadata is written to the output for raw images, to a hidden temporary file for sparse images.
+  std::filesystem::path metadataPath = output;
+  metadataPath += ".metadata";
+  auto metadataFd = sparse ? Helper::UniqueFD(metadataPath, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600) : Helper::UniqueFD();
+  if (sparse) {
+    if (!metadataFd) throw Error("Cannot create {}: {}", metadataPath.string(), strerror(errno));
+    unlink(metadataPath.c_str());
+    metadataFd.syncOnClose = false;
+  }
+
+  const int metadataTarget = sparse ? metadataFd.fd() : out.fd();
+  if (ftruncate(metadataTarget, static_cast<off_t>(layout.deviceSize)) != 0)
+    throw Error("Cannot resize {}: {}", output.string(), strerror(errno));
+  writeMetadata(metadataTarget, *metadata, layout, output);
+
+  // Image file descriptors stay open until sparse output is written.
+  std::vector<Helper::UniqueFD> images;
+  images.reserve(layout.partitions.size());
+  for (const auto &partition : layout.partitions) {
+    images.emplace_back(partition.image.empty() ? Helper::UniqueFD() : Helper::UniqueFD(partition.image, O_RDONLY | O_CLOEXEC));
+    images.back().syncOnClose = false;
+    if (!partition.image.empty() && !images.back()) throw Error("Cannot open {}: {}", partition.image.string(), strerror(errno));
+  }
+
+  // Calls function with image offset, super offset and length of every piece of image.
+  auto forEachPiece = [&metadata](const LpMetadataPartition &partition, uint64_t imageSize, const auto &function) {
+    uint64_t logicalOffset = 0;
+    for (uint32_t e = 0; e < partition.num_extents && logicalOffset < imageSize; ++e) {
+      const auto &extent = metadata->extents[partition.first_extent_index + e];
+      const uint64_t size = extent.num_sectors * LP_SECTOR_SIZE;
+      if (extent.target_type == LP_TARGET_TYPE_LINEAR)
+        function(logicalOffset, extent.target_data * LP_SECTOR_SIZE, std::min(size, imageSize - logicalOffset));
+      logicalOffset += size;
+    }
+  };
+
+  auto imageSizeOf = [&](size_t i) -> uint64_t {
+    struct stat st = {};
+    if (fstat(images[i].fd(), &st) != 0) throw Error("Cannot stat {}: {}", layout.partitions[i].image.string(), strerror(errno));
+    return static_cast<uint64_t>(st.st_size);
+  };
+
+  if (!sparse) {
+    Helper::AsyncManager<bool> manager;
+    for (size_t i = 0; i < layout.partitions.size(); ++i) {
+      if (layout.partitions[i].image.empty()) continue;
+
+      manager.addProcess([&, i] {
+        const auto &partition = layout.partitions[i];
+        const uint64_t imageSize = imageSizeOf(i);
+        uint64_t done = 0;
+        forEachPiece(metadata->partitions[i], imageSize, [&](uint64_t from, uint64_t to, uint64_t length) {
+          for (uint64_t copied = 0; copied < length;) {
+            const uint64_t step = std::min(length - copied, kCopyStep);
+            copyRange(images[i].fd(), from + copied, out.fd(), to + copied, step, partition.image);
+            copied += step;
+            done += step;
+            if (callback) callback(partition.name, done, imageSize);
+          }
+        });
+        return true;
+      });
+    }
+
+    manager.startAll();
+    manager.getResults(); // Rethrows errors of workers.
+    if (fsync(out.fd()) != 0) throw Error("Cannot sync {}: {}", output.string(), strerror(errno));
+    return metadata;
+  }
+
+  std::unique_ptr<sparse_file, decltype(&sparse_file_destroy)> file(
+      sparse_file_new(layout.blockSize, static_cast<int64_t>(layout.deviceSize)), sparse_file_destroy);
+  if (!file) throw Error("Cannot create sparse file");
+  if (sparse_file_add_fd(file.get(), metadataFd.fd(), 0, metadataEnd, 0) != 0) throw Error("Cannot add LP metadata to sparse file");
+
+  for (size_t i = 0; i < layout.partitions.size(); ++i) {
+    if (layout.partitions[i].image.empty()) continue;
+
+    forEachPiece(metadata->partitions[i], imageSizeOf(i), [&](uint64_t from, uint64_t to, uint64_t length) {
+      if (to % layout.blockSize != 0) throw Error("Extent of {} is not aligned to block size", layout.partitions[i].name);
+      if (sparse_file_add_fd(file.get(), images[i].fd(), static_cast<int64_t>(from), length, to / layout.blockSize) != 0)
+        throw Error("Cannot add {} to sparse file", layout.partitions[i].image.string());
+    });
+  }
+
+  if (sparse_file_write(file.get(), out.fd(), false, true, false) != 0) throw Error("Cannot write sparse image {}", output.string());
+  return metadata;
+}
+
+} // namespace PartitionMap
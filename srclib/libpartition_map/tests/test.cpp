@@ -16,8 +16,16 @@
  */
 
 #include <algorithm>
+#include <cerrno>
+#include <cstring>
 #include <filesystem>
+#include <functional>
 #include <iostream>
+#include <map>
+#include <thread>
+#include <tuple>
+#include <fcntl.h>
+#include <unistd.h>
 #include <libhelper/error.hpp>
 #include <libhelper/functions.hpp>
 #include <libhelper/android.hpp>
@@ -25,7 +33,416 @@
 
 using namespace Helper;
 
+/// @brief Check that @p function throws Helper::Error.
+template <typename F> static void expectError(const std::string &what, F &&function) {
+  try {
+    function();
+  } catch (const Error &) {
+    std::cout << what << " is rejected" << std::endl;
+    return;
+  }
+  throw Error("{} is accepted (UNEXPECTED)", what);
+}
+
+/// @brief Write, read and extract a snapshot archive, then check truncated and corrupted copies are rejected.
+static void testSnapshotArchive() {
+  const std::filesystem::path archive = std::filesystem::temp_directory_path() / "pmt_test.pmtsnap";
+  const std::filesystem::path extracted = std::filesystem::temp_directory_path() / "pmt_test.extracted";
+
+  std::vector<char> content(10000);
+  for (size_t i = 0; i < content.size(); ++i)
+    content[i] = static_cast<char>(i * 7 + 1);
+  std::fill(content.begin() + 4096, content.begin() + 8192, 0); // Stored as a zero chunk.
+  const std::vector<char> gpt(100, 'G');
+
+  {
+    PartitionMap::SnapshotWriter writer(archive, 4096);
+    const uint32_t boot = writer.addEntry(PartitionMap::SnapshotEntry::PARTITION, "boot", "sda", content.size());
+    const uint32_t table = writer.addEntry(PartitionMap::SnapshotEntry::GPT, "sda", "", gpt.size());
+    for (uint64_t offset = content.size(); offset > 0;) { // Out of order, the index sorts chunks.
+      const uint64_t start = (offset - 1) / 4096 * 4096;
+      writer.write(boot, start, std::vector<char>(content.begin() + start, content.begin() + offset));
+      offset = start;
+    }
+    writer.write(table, 0, std::vector<char>(gpt));
+    writer.finish();
+  }
+
+  {
+    const PartitionMap::SnapshotReader reader(archive);
+    const auto *boot = reader.find(PartitionMap::SnapshotEntry::PARTITION, "boot");
+    const auto *table = reader.find(PartitionMap::SnapshotEntry::GPT, "sda");
+    if (!boot || !table || reader.entries().size() != 2) throw Error("Snapshot entries are missing (UNEXPECTED)");
+    if (boot->storedSize != content.size() - 4096) throw Error("Zero chunk of snapshot is stored (UNEXPECTED)");
+    if (reader.read(*boot) != content || reader.read(*table) != gpt) throw Error("Snapshot data is different (UNEXPECTED)");
+
+    auto out = Helper::UniqueFD(extracted, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    reader.extract(*boot, out.fd(), false);
+    std::vector<char> data(content.size());
+    if (pread(out.fd(), data.data(), data.size(), 0) != static_cast<ssize_t>(data.size()) || data != content)
+      throw Error("Extracted snapshot data is different (UNEXPECTED)");
+  }
+  std::cout << "Snapshot archive round trip: OK" << std::endl;
+
+  const auto corruptCopy = [&](const std::function<void(int, uint64_t)> &corrupt) {
+    std::filesystem::copy_file(archive, extracted, std::filesystem::copy_options::overwrite_existing);
+    auto fd = Helper::UniqueFD(extracted, O_RDWR);
+    corrupt(fd.fd(), std::filesystem::file_size(extracted));
+  };
+  const auto patch = [](int fd, uint64_t offset, uint64_t value) {
+    if (pwrite(fd, &value, sizeof(value), static_cast<off_t>(offset)) != sizeof(value)) throw Error("Cannot patch archive");
+  };
+  const auto indexOffset = [](int fd, uint64_t size) {
+    uint64_t offset = 0;
+    if (pread(fd, &offset, sizeof(offset), static_cast<off_t>(size - 24)) != sizeof(offset)) throw Error("Cannot read trailer");
+    return offset;
+  };
+
+  corruptCopy([](int fd, uint64_t size) {
+    if (ftruncate(fd, static_cast<off_t>(size - 10)) != 0) throw Error("Cannot truncate archive");
+  });
+  expectError("Truncated snapshot archive", [&] { PartitionMap::SnapshotReader reader(extracted); });
+
+  // First chunk of boot (trailer: magic, indexOffset, chunkCount; 2 entry records of 136 bytes, then 24 byte chunks).
+  corruptCopy([&](int fd, uint64_t size) { patch(fd, indexOffset(fd, size) + 2 * 136 + 8, 1ULL << 40); });
+  expectError("Snapshot chunk out of its entry", [&] { PartitionMap::SnapshotReader reader(extracted); });
+
+  corruptCopy([&](int fd, uint64_t size) { patch(fd, size - 16, UINT64_MAX / 8); });
+  expectError("Snapshot index with overflowing chunk count", [&] { PartitionMap::SnapshotReader reader(extracted); });
+
+  std::filesystem::remove(archive);
+  std::filesystem::remove(extracted);
+}
+
+/// @brief Write a magic value as it's stored on disk (little-endian, without trailing zero bytes).
+static void putMagic(std::vector<uint8_t> &buffer, const size_t offset, const uint64_t magic) {
+  for (size_t i = 0; i < PartitionMap::Extra::getMagicLength(magic); ++i)
+    buffer[offset + i] = static_cast<uint8_t>(magic >> (8 * i));
+}
+
+/// @brief Check detectMagic() with every signature of the table, class filters, priority and buffer limits.
+static void testMagicSignatures() {
+  using namespace PartitionMap::Extra;
+  constexpr size_t size = 8192, floatingOffset = 100;
+
+  for (const auto &signature : MagicSignatures) {
+    std::vector<uint8_t> buffer(size);
+    const size_t offset = signature.offset >= 0 ? static_cast<size_t>(signature.offset) : floatingOffset;
+    putMagic(buffer, offset, signature.magic);
+
+    const auto match = detectMagic(buffer.data(), buffer.size(), buffer.size());
+    if (!match || match->signature != &signature || match->offset != offset)
+      throw Error("{} is not detected at {} (UNEXPECTED)", signature.name, offset);
+    const int otherClass = signature.type == ANDROID_MAGICS ? FILESYSTEM_MAGICS : ANDROID_MAGICS;
+    if (detectMagic(buffer.data(), buffer.size(), buffer.size(), otherClass))
+      throw Error("{} is detected with other magic class (UNEXPECTED)", signature.name);
+  }
+  std::cout << "All " << std::size(MagicSignatures) << " magic signatures are detected" << std::endl;
+
+  std::vector<uint8_t> buffer(size);
+  putMagic(buffer, 0, AndroidMagic::BOOT_IMAGE);
+  putMagic(buffer, 200, AndroidMagic::LK_IMAGE);
+  if (auto match = detectMagic(buffer.data(), buffer.size(), buffer.size());
+      !match || match->signature->magic != AndroidMagic::BOOT_IMAGE)
+    throw Error("Anchored boot image magic doesn't win over floating LK magic (UNEXPECTED)");
+
+  buffer.assign(size, 0);
+  putMagic(buffer, 200, AndroidMagic::LK_IMAGE);
+  if (detectMagic(buffer.data(), buffer.size(), 201)) throw Error("Floating magic crossing scan length is detected (UNEXPECTED)");
+  if (!detectMagic(buffer.data(), buffer.size(), 202)) throw Error("Floating magic in scan length is not detected (UNEXPECTED)");
+
+  buffer.assign(size, 0);
+  putMagic(buffer, 1024 + 0x38, FileSystemMagic::EXTFS_FS);
+  if (detectMagic(buffer.data(), 1024 + 0x38 + 1, size)) throw Error("Magic past end of buffer is detected (UNEXPECTED)");
+  std::cout << "Magic priority, scan length and buffer size are respected" << std::endl;
+}
+
+/// @brief Check deepScan() finds signatures at exact offsets, including ones split between chunks.
+static void testDeepScan() {
+  using namespace PartitionMap::Extra;
+  const std::filesystem::path image = std::filesystem::temp_directory_path() / "pmt_test.deepscan";
+  constexpr size_t chunkSize = 64 * 1024; // Minimum chunk size of deepScan().
+
+  std::vector<char> content(chunkSize * 4);
+  const std::vector<std::pair<uint64_t, std::string_view>> expected = {
+      {0, DeepSignatures[0].pattern}, {chunkSize - 3, DeepSignatures[5].pattern}, {chunkSize * 2 + 17, DeepSignatures[11].pattern},
+      {content.size() - 4, DeepSignatures[3].pattern}};
+  for (const auto &[offset, pattern] : expected)
+    std::memcpy(content.data() + offset, pattern.data(), pattern.size());
+
+  {
+    UniqueFD fd(image, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd.write(content.data(), content.size()) != static_cast<ssize_t>(content.size())) throw Error("Cannot write deep scan image");
+  }
+
+  for (unsigned int threads : {1u, 3u}) {
+    const auto matches = deepScan(image, chunkSize, threads);
+    if (matches.size() != expected.size())
+      throw Error("Deep scan found {} matches instead of {} (UNEXPECTED)", matches.size(), expected.size());
+    for (size_t i = 0; i < matches.size(); ++i) {
+      if (matches[i].offset != expected[i].first || matches[i].signature->pattern != expected[i].second)
+        throw Error("Deep scan match {} is {} at {} (UNEXPECTED)", i, matches[i].signature->name, matches[i].offset);
+    }
+  }
+  std::cout << "Deep scan found all signatures with exact offsets" << std::endl;
+
+  std::filesystem::remove(image);
+}
+
+/// @brief Write @p content to @p path, replacing it.
+static void writeBytes(const std::filesystem::path &path, const std::vector<char> &content) {
+  auto fd = Helper::UniqueFD(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd.write(content.data(), content.size()) != static_cast<ssize_t>(content.size())) throw Error("Cannot write {}", path.string());
+}
+
+/// @brief Read whole @p path.
+static std::vector<char> readBytes(const std::filesystem::path &path) {
+  std::vector<char> content(std::filesystem::file_size(path));
+  auto fd = Helper::UniqueFD(path, O_RDONLY);
+  if (pread(fd.fd(), content.data(), content.size(), 0) != static_cast<ssize_t>(content.size()))
+    throw Error("Cannot read {}", path.string());
+  return content;
+}
+
+/// @brief Append a chunk of Android sparse image (type, reserved, blocks, total size, then data).
+static void putSparseChunk(std::vector<char> &image, const uint16_t type, const uint32_t blocks, const char *data = nullptr,
+                           const uint32_t size = 0) {
+  const auto put = [&image](const auto value) {
+    const auto *bytes = reinterpret_cast<const char *>(&value);
+    image.insert(image.end(), bytes, bytes + sizeof(value));
+  };
+  put(type), put(uint16_t{0}), put(blocks), put(uint32_t{12} + size);
+  if (data) image.insert(image.end(), data, data + size);
+}
+
+/// @brief Start an Android sparse image with 4096 byte blocks; chunks are counted by @ref finishSparse().
+static std::vector<char> startSparse(const uint32_t totalBlocks) {
+  std::vector<char> image(28);
+  const uint32_t magic = 0xed26ff3a, blockSize = 4096;
+  const uint16_t versions[4] = {1, 0, 28, 12}; // Major, minor, file header size, chunk header size.
+  memcpy(image.data(), &magic, 4);
+  memcpy(image.data() + 4, versions, 8);
+  memcpy(image.data() + 12, &blockSize, 4);
+  memcpy(image.data() + 16, &totalBlocks, 4);
+  return image;
+}
+
+static void finishSparse(std::vector<char> &image, const uint32_t chunks) { memcpy(image.data() + 20, &chunks, 4); }
+
+/**
+ * @brief Pack a super image, check offsets of geometry and metadata copies, then read it back as raw, packed sparse and
+ * hand-made sparse images with every chunk type.
+ */
+static void testSuperImage() {
+  using PartitionMap::SuperImage;
+  const std::filesystem::path dir = std::filesystem::temp_directory_path() / "pmt_test.super";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+
+  PartitionMap::SuperLayout layout;
+  layout.deviceSize = 4 * 1024 * 1024;
+  layout.partitions = {{"system_a", "default", LP_PARTITION_ATTR_READONLY, 0, dir / "system_a.img"},
+                       {"vendor_a", "default", 0, 0, dir / "vendor_a.img"},
+                       {"odm_a", "default", 0, 64 * 1024, {}}};
+
+  std::map<std::string, std::vector<char>> images = {{"system_a", std::vector<char>(256 * 1024)},
+                                                     {"vendor_a", std::vector<char>(100 * 1024)}};
+  for (auto &[name, content] : images) {
+    for (size_t i = 0; i < content.size(); ++i)
+      content[i] = static_cast<char>(i * (name[0] == 's' ? 7 : 13) + i / 4096 + 1);
+    writeBytes(dir / (name + ".img"), content);
+  }
+
+  const std::filesystem::path raw = dir / "super.img";
+  const auto metadata = SuperImage::pack(layout, raw, false);
+  const std::vector<char> rawContent = readBytes(raw);
+  if (rawContent.size() != layout.deviceSize) throw Error("Packed super is {} bytes (UNEXPECTED)", rawContent.size());
+
+  // Geometry and its backup follow the reserved area, then primary and backup metadata of every slot.
+  const auto magicAt = [&rawContent](const uint64_t offset) {
+    uint32_t magic = 0;
+    memcpy(&magic, rawContent.data() + offset, sizeof(magic));
+    return magic;
+  };
+  const uint64_t metadataStart = LP_PARTITION_RESERVED_BYTES + LP_METADATA_GEOMETRY_SIZE * 2;
+  const uint64_t metadataEnd = metadataStart + static_cast<uint64_t>(layout.metadataSize) * layout.metadataSlots * 2;
+  if (std::any_of(rawContent.begin(), rawContent.begin() + LP_PARTITION_RESERVED_BYTES, [](char c) { return c != 0; }))
+    throw Error("Reserved area of super isn't empty (UNEXPECTED)");
+  if (magicAt(LP_PARTITION_RESERVED_BYTES) != LP_METADATA_GEOMETRY_MAGIC ||
+      magicAt(LP_PARTITION_RESERVED_BYTES + LP_METADATA_GEOMETRY_SIZE) != LP_METADATA_GEOMETRY_MAGIC)
+    throw Error("Geometry copies are not at {} and {} (UNEXPECTED)", LP_PARTITION_RESERVED_BYTES,
+                LP_PARTITION_RESERVED_BYTES + LP_METADATA_GEOMETRY_SIZE);
+  for (uint64_t offset = metadataStart; offset < metadataEnd; offset += layout.metadataSize) {
+    if (magicAt(offset) != LP_METADATA_HEADER_MAGIC) throw Error("Metadata copy is not at {} (UNEXPECTED)", offset);
+  }
+
+  // Extents must be block aligned and after the metadata; the hand-made sparse image below covers them with one raw chunk.
+  uint64_t dataBegin = UINT64_MAX, dataEnd = 0;
+  for (const auto &extent : metadata->extents) {
+    const uint64_t begin = extent.target_data * LP_SECTOR_SIZE, end = begin + extent.num_sectors * LP_SECTOR_SIZE;
+    if (extent.target_type != LP_TARGET_TYPE_LINEAR || begin < metadataEnd || begin % 4096 != 0 || end > layout.deviceSize)
+      throw Error("Extent at {} is out of the data area (UNEXPECTED)", begin);
+    dataBegin = std::min(dataBegin, begin), dataEnd = std::max(dataEnd, end);
+  }
+  std::cout << "Super geometry, metadata and extent offsets are correct" << std::endl;
+
+  const auto checkImage = [&](const std::filesystem::path &path, const bool sparse, const std::vector<char> &expected) {
+    const SuperImage super(path);
+    if (super.isSparse() != sparse || super.size() != expected.size())
+      throw Error("{} is opened as {} bytes (sparse: {}) (UNEXPECTED)", path.string(), super.size(), super.isSparse());
+
+    std::vector<char> content(expected.size());
+    for (uint64_t offset = 0; offset < content.size();) // Odd read size, so reads cross chunk boundaries.
+      offset += super.read(content.data() + offset, 5000, offset);
+    if (content != expected) throw Error("Content of {} is different (UNEXPECTED)", path.string());
+    if (super.read(content.data(), 16, expected.size()) != 0) throw Error("Read after end of {} (UNEXPECTED)", path.string());
+
+    for (const auto &partition : layout.partitions) {
+      std::vector<char> image = partition.image.empty() ? std::vector<char>() : images.at(partition.name);
+      image.resize(partition.size == 0 ? image.size() : partition.size);
+      const std::filesystem::path extracted = dir / (partition.name + ".out");
+      if (super.partitionSize(partition.name) != image.size() || super.extract(partition.name, extracted) != image.size() ||
+          readBytes(extracted) != image)
+        throw Error("Extracted {} from {} is different (UNEXPECTED)", partition.name, path.string());
+    }
+    if (super.partitionSize("product_a") != UINT64_MAX) throw Error("Size of missing partition is known (UNEXPECTED)");
+    expectError(fmt::format("Extracting missing partition from {}", path.filename().string()),
+                [&] { super.extract("product_a", dir / "product_a.out"); });
+  };
+
+  checkImage(raw, false, rawContent);
+  SuperImage::pack(layout, dir / "super_sparse.img", true);
+  checkImage(dir / "super_sparse.img", true, rawContent);
+  std::cout << "Packed raw and sparse super images round trip" << std::endl;
+
+  // Raw (metadata), don't care, raw (extents), CRC32, fill, zero fill and don't care chunks.
+  constexpr uint32_t blockSize = 4096, fillBlocks = 16, zeroBlocks = 4;
+  const auto blocks = static_cast<uint32_t>(layout.deviceSize / blockSize);
+  const auto metadataBlocks = static_cast<uint32_t>((metadataEnd + blockSize - 1) / blockSize);
+  const auto dataFirst = static_cast<uint32_t>(dataBegin / blockSize);
+  const auto dataLast = static_cast<uint32_t>((dataEnd + blockSize - 1) / blockSize);
+  if (dataLast + fillBlocks + zeroBlocks > blocks) throw Error("No free space after extents in super (UNEXPECTED)");
+
+  std::vector<char> expected(rawContent.size()), sparse = startSparse(blocks);
+  const uint32_t fill = 0x11223344, zero = 0;
+  std::copy_n(rawContent.begin(), metadataBlocks * blockSize, expected.begin());
+  std::copy_n(rawContent.begin() + dataFirst * blockSize, (dataLast - dataFirst) * blockSize,
+              expected.begin() + dataFirst * blockSize);
+  for (uint64_t offset = dataLast * blockSize; offset < (dataLast + fillBlocks) * blockSize; offset += sizeof(fill))
+    memcpy(expected.data() + offset, &fill, sizeof(fill));
+
+  putSparseChunk(sparse, 0xcac1, metadataBlocks, rawContent.data(), metadataBlocks * blockSize);
+  putSparseChunk(sparse, 0xcac3, dataFirst - metadataBlocks);
+  putSparseChunk(sparse, 0xcac1, dataLast - dataFirst, rawContent.data() + dataFirst * blockSize, (dataLast - dataFirst) * blockSize);
+  putSparseChunk(sparse, 0xcac4, 0, reinterpret_cast<const char *>(&zero), sizeof(zero));
+  putSparseChunk(sparse, 0xcac2, fillBlocks, reinterpret_cast<const char *>(&fill), sizeof(fill));
+  putSparseChunk(sparse, 0xcac2, zeroBlocks, reinterpret_cast<const char *>(&zero), sizeof(zero));
+  putSparseChunk(sparse, 0xcac3, blocks - dataLast - fillBlocks - zeroBlocks);
+  finishSparse(sparse, 7);
+  writeBytes(dir / "super_hand.img", sparse);
+  checkImage(dir / "super_hand.img", true, expected);
+  std::cout << "Sparse chunks are parsed" << std::endl;
+
+  std::vector<char> corrupted = startSparse(blocks);
+  putSparseChunk(corrupted, 0xcac1, 2, rawContent.data(), blockSize); // Size is one block short.
+  finishSparse(corrupted, 1);
+  writeBytes(dir / "super_bad.img", corrupted);
+  expectError("Sparse raw chunk with wrong size", [&] { SuperImage super(dir / "super_bad.img"); });
+
+  corrupted = startSparse(blocks);
+  putSparseChunk(corrupted, 0xcac5, blocks);
+  finishSparse(corrupted, 1);
+  writeBytes(dir / "super_bad.img", corrupted);
+  expectError("Unknown sparse chunk type", [&] { SuperImage super(dir / "super_bad.img"); });
+
+  // The primary geometry is optional, the backup is used without it.
+  corrupted = rawContent;
+  std::fill_n(corrupted.begin() + LP_PARTITION_RESERVED_BYTES, LP_METADATA_GEOMETRY_SIZE, 0);
+  writeBytes(dir / "super_bad.img", corrupted);
+  if (SuperImage(dir / "super_bad.img").partitionSize("system_a") != images.at("system_a").size())
+    throw Error("Backup geometry isn't used (UNEXPECTED)");
+  std::fill_n(corrupted.begin() + LP_PARTITION_RESERVED_BYTES + LP_METADATA_GEOMETRY_SIZE, LP_METADATA_GEOMETRY_SIZE, 0);
+  writeBytes(dir / "super_bad.img", corrupted);
+  expectError("Super without geometry", [&] { SuperImage super(dir / "super_bad.img"); });
+
+  std::filesystem::remove_all(dir);
+}
+
+/// @brief Parse workload names, then summarize statistics collected by parallel jobs.
+static void testIOStats() {
+  using PartitionMap::IOStats;
+  const std::vector<std::tuple<std::string, bool, unsigned>> workloads = {
+      {"read", false, 100},    {"write", false, 0},    {"rw", false, 70},
+      {"randread", true, 100}, {"randwrite", true, 0}, {"randrw", true, 70}};
+  for (const auto &[name, random, readPercent] : workloads) {
+    const PartitionMap::IOWorkload workload = IOStats::parseWorkload(name, 70);
+    if (workload.name != name || workload.random != random || workload.readPercent != readPercent)
+      throw Error("Workload {} is parsed as {}/{} (UNEXPECTED)", name, workload.random, workload.readPercent);
+  }
+  std::cout << "All workload names are parsed" << std::endl;
+  for (const std::string name : {"", "rand", "randomread", "readwrite", "Read"})
+    expectError(fmt::format("Workload name '{}'", name), [&name] { IOStats::parseWorkload(name, 50); });
+
+  // 1000 calls of 4096 bytes from 4 jobs: 900 take 10us, 90 take 100us, 9 take 1ms and 1 takes 10ms.
+  const auto latencyOf = [](const unsigned index) -> uint64_t {
+    return index < 900 ? 10000 : index < 990 ? 100000 : index < 999 ? 1000000 : 10000000;
+  };
+  openpart_io_stats_t stats = {};
+  std::vector<std::thread> jobs;
+  for (unsigned job = 0; job < 4; ++job)
+    jobs.emplace_back([&stats, &latencyOf, job] {
+      for (unsigned index = job; index < 1000; index += 4) openpart_stats_add(&stats, 4096, 4096, latencyOf(index));
+    });
+  for (auto &job : jobs) job.join();
+
+  if (stats.calls != 1000 || stats.bytes != 4096000 || stats.short_ops != 0 || stats.errors != 0)
+    throw Error("Parallel jobs recorded {} calls and {} bytes (UNEXPECTED)", stats.calls, stats.bytes);
+  const PartitionMap::IOSummary summary = IOStats::summarize(stats, 2.0);
+  if (summary.bandwidth != 2048000.0 || summary.iops != 500.0 || summary.meanNs != 37000 || summary.maxNs != 10000000)
+    throw Error("Summary is {} B/s, {} IOPS, mean {}ns, max {}ns (UNEXPECTED)", summary.bandwidth, summary.iops, summary.meanNs,
+                summary.maxNs);
+
+  // Percentiles are upper bounds of histogram buckets, a bucket is at most 1.5 times wider than its lower bound.
+  for (const auto &[percentile, value, sample] : {std::make_tuple("p50", summary.p50Ns, latencyOf(0)),
+                                                  std::make_tuple("p90", summary.p90Ns, latencyOf(899)),
+                                                  std::make_tuple("p99", summary.p99Ns, latencyOf(989)),
+                                                  std::make_tuple("p99.9", summary.p999Ns, latencyOf(998))}) {
+    if (value < sample || value >= sample + sample / 2)
+      throw Error("{} is {}ns for samples of {}ns (UNEXPECTED)", percentile, value, sample);
+  }
+  if (IOStats::formatLatency(summary.p50Ns) != "12.0us" || IOStats::formatLatency(summary.p999Ns) != "1.02ms")
+    throw Error("Latencies are formatted as {} and {} (UNEXPECTED)", IOStats::formatLatency(summary.p50Ns),
+                IOStats::formatLatency(summary.p999Ns));
+  std::cout << "Parallel statistics are summarized" << std::endl;
+
+  openpart_io_stats_t failures = {};
+  openpart_stats_add(&failures, 4096, 1024, 1000);
+  errno = EIO;
+  openpart_stats_add(&failures, 4096, -1, 1000);
+  errno = EINTR;
+  openpart_stats_add(&failures, 4096, -1, 1000);
+  if (failures.calls != 3 || failures.bytes != 1024 || failures.short_ops != 1 || failures.errors != 1 || failures.retries != 1)
+    throw Error("Failures are counted as {} short, {} errors, {} retries (UNEXPECTED)", failures.short_ops, failures.errors,
+                failures.retries);
+
+  const PartitionMap::IOSummary idle = IOStats::summarize(openpart_io_stats_t{}, 0);
+  if (idle.bandwidth != 0 || idle.iops != 0 || idle.meanNs != 0 || idle.p50Ns != 0 || idle.maxNs != 0)
+    throw Error("Summary of an idle run isn't empty (UNEXPECTED)");
+  std::cout << "Short, failed and interrupted calls are counted" << std::endl;
+}
+
 int main() {
+  try { // Offline tests, they don't need a device.
+    testSnapshotArchive();
+    testMagicSignatures();
+    testDeepScan();
+    testIOStats();
+    testSuperImage();
+  } catch (std::exception &error) {
+    std::cerr << error.what() << std::endl;
+    return 1;
+  }
+
   if (!Android::isHasRootPrivileges()) return 2; // Check root access.
 
   try {
@@ -49,11 +466,20 @@ int main() {
     auto data = partitions.hasTable("mmcblk0") ? partitions["mmcblk0"] : partitions["sda"];
     if (data->GetNumParts() == 0) throw Error("Can't get total partition number of mmcblk0 or sda (UNEXPECTED?)");
 
-    if (auto part = partitions(tableName, 0); !part->IsUsed())
+    if (GPTPart part = *partitions(tableName, 0); !part.IsUsed())
       std::cerr << "WARNING: (GPTPart part = partitions[0]) check failed "
                    "(part.IsUsed() returned false)"
                 << std::endl;
 
+    const auto &first = partitions.partitions().front().get();
+    const std::string renamed = first.name(), renamedTable = first.tableName();
+    const int count = partitions.hasDuplicateNamedPartition(renamed);
+    partitions.renamePartition(renamed, "pmt_test_renamed", renamedTable);
+    if (!partitions.hasPartition("pmt_test_renamed") || partitions.hasDuplicateNamedPartition(renamed) != count - 1)
+      throw Error("Name index is not updated after renamePartition() (UNEXPECTED)");
+    partitions.renamePartition("pmt_test_renamed", renamed);
+    std::cout << "Partition " << renamed << " is renamed in memory and back" << std::endl;
+
     auto partition_list = partitions.partitions();
     std::cout << "Listing partitions (data is getted from getPartitions()):" << std::endl;
     for (auto &part : partition_list)
@@ -126,6 +552,31 @@ int main() {
       std::cout << "    Block size: " << gptData->GetBlockSize() << std::endl;
       return true;
     };
+    if (dPartitions.isSupported()) {
+      uint64_t total = 0;
+      for (const auto &part : dPartitions)
+        total += part.size();
+      if (total != dPartitions.getModel().usedSize)
+        throw Error("Logical partition sizes and metadata model are different (UNEXPECTED)");
+      std::cout << "Free space of super: " << dPartitions.freeSpace() << std::endl;
+
+      dPartitions.setDirectIO(true);
+      for (const auto &part : dPartitions) {
+        if (!part.isDirectIO() || part.size() == 0) continue;
+        char direct[4096], mapped[4096];
+        if (part.readAt(direct, sizeof(direct), 0) != sizeof(direct)) throw Error("Cannot read {} through super", part.name());
+        if (!Helper::isExists(part.path())) continue;
+
+        auto fd = Helper::UniqueFD(part.path(), O_RDONLY);
+        fd.syncOnClose = false;
+        if (!fd || pread(fd.fd(), mapped, sizeof(mapped), 0) != sizeof(mapped)) throw Error("Cannot read {}", part.path().string());
+        if (memcmp(direct, mapped, sizeof(direct)) != 0)
+          throw Error("Direct and mapped reads of {} are different (UNEXPECTED)", part.name());
+      }
+      dPartitions.setDirectIO(false);
+      std::cout << "Direct I/O through super: OK" << std::endl;
+    }
+
     dPartitions.forEach(logicalPartTest);
     partitions.forEach(partitionTest);
     partitions.forEachGptData(gptDataTest);